@@ -17,14 +17,17 @@ import ase "aseprite"
 import "base:runtime"
 import "core:c"
 import "core:fmt"
+import "core:hash"
 import "core:image/png"
 import "core:log"
 import "core:os"
 import "core:path/slashpath"
 import "core:slice"
+import "core:strconv"
 import "core:strings"
 import "core:time"
 import "core:unicode/utf8"
+import "jobs"
 import stbim "vendor:stb/image"
 import stbrp "vendor:stb/rect_pack"
 import stbtt "vendor:stb/truetype"
@@ -71,6 +74,15 @@ FONT_FILENAME :: "assets/font/font2.ttf"
 // The font size of letters extracted from font
 FONT_SIZE :: 32
 
+// Decoded and trimmed textures are cached here by a hash of their file, so unchanged files are not
+// decoded again. When no input changed at all the atlas is not rebuilt, run with -force to
+// rebuild it anyway.
+ATLAS_CACHE_DIR :: "build/atlas_cache"
+
+// Bump when the cache format or the generated files change, so old caches aren't used. It is in
+// every cache file and in the inputs hash.
+ATLAS_CACHE_VERSION :: 2
+
 
 // ---------------------
 // ATLAS BUILDER PROGRAM
@@ -219,16 +231,7 @@ asset_name :: proc(path: string) -> string {
 	return fmt.tprintf("%s", strings.to_ada_case(slashpath.name(slashpath.base(path))))
 }
 
-load_png_tileset :: proc(filename: string, t: ^Tileset) {
-	data, data_ok := os.read_entire_file(filename)
-
-	if !data_ok {
-		log.error("Failed loading tileset", filename)
-		return
-	}
-
-	defer delete(data)
-
+load_png_tileset :: proc(filename: string, data: []u8, t: ^Tileset) {
 	img, err := png.load_from_bytes(data)
 
 	if err != nil {
@@ -253,15 +256,7 @@ load_png_tileset :: proc(filename: string, t: ^Tileset) {
 }
 
 // Loads a tileset. Currently only supports .ase tilesets
-load_tileset :: proc(filename: string, t: ^Tileset) {
-	data, data_ok := os.read_entire_file(filename)
-
-	if !data_ok {
-		log.error("Failed loading tileset", filename)
-		return
-	}
-
-	defer delete(data)
+load_tileset :: proc(filename: string, data: []u8, t: ^Tileset) {
 	doc: ase.Document
 
 	umerr := ase.unmarshal(&doc, data[:])
@@ -318,15 +313,10 @@ load_tileset :: proc(filename: string, t: ^Tileset) {
 
 load_ase_texture_data :: proc(
 	filename: string,
+	data: []u8,
 	textures: ^[dynamic]Texture_Data,
 	animations: ^[dynamic]Animation,
 ) {
-	data, data_ok := os.read_entire_file(filename)
-
-	if !data_ok {
-		return
-	}
-
 	doc: ase.Document
 
 	umerr := ase.unmarshal(&doc, data[:])
@@ -514,16 +504,7 @@ load_ase_texture_data :: proc(
 	}
 }
 
-load_png_texture_data :: proc(filename: string, textures: ^[dynamic]Texture_Data) {
-	data, data_ok := os.read_entire_file(filename)
-
-	if !data_ok {
-		log.error("Failed loading tileset", filename)
-		return
-	}
-
-	defer delete(data)
-
+load_png_texture_data :: proc(filename: string, data: []u8, textures: ^[dynamic]Texture_Data) {
 	img, err := png.load_from_bytes(data)
 
 	if err != nil {
@@ -552,12 +533,405 @@ load_png_texture_data :: proc(filename: string, textures: ^[dynamic]Texture_Data
 	append(textures, td)
 }
 
+Asset_Kind :: enum {
+	Ase,
+	Png,
+	Ase_Tileset,
+	Png_Tileset,
+}
+
+// One file in TEXTURES_DIR. Files are read and decoded in parallel, each into its own Asset, and
+// merged afterwards in the order of the directory listing.
+Asset :: struct {
+	path:       string,
+	kind:       Asset_Kind,
+	data:       []u8,
+	hash:       u64, // of the path and data, names the cache file
+	from_cache: bool,
+	textures:   [dynamic]Texture_Data,
+	animations: [dynamic]Animation,
+	tileset:    Tileset,
+}
+
+ATLAS_CACHE_MAGIC :: u32(0x434c5441) // "ATLC"
+
+read_asset :: proc(a: ^Asset) {
+	data, data_ok := os.read_entire_file(a.path)
+
+	if !data_ok {
+		log.error("Failed reading", a.path)
+		return
+	}
+
+	a.data = data
+
+	// The build settings are part of the key, a cached asset decoded with other tile settings is
+	// a miss instead of being reused
+	padding := 1 if TILE_ADD_PADDING else 0
+	settings := [?]int{ATLAS_CACHE_VERSION, TILE_SIZE, TILESET_WIDTH, padding}
+	h := hash.fnv64a(slice.to_bytes(settings[:]))
+	h = hash.fnv64a(transmute([]u8)a.path, h)
+	a.hash = hash.fnv64a(data, h)
+}
+
+// Loads the asset from the cache, or decodes it and stores the result in the cache
+decode_asset :: proc(a: ^Asset) {
+	if a.data == nil {
+		return
+	}
+
+	cache_path := asset_cache_path(a.hash)
+
+	if load_cached_asset(cache_path, a) {
+		a.from_cache = true
+		return
+	}
+
+	switch a.kind {
+	case .Ase:
+		load_ase_texture_data(a.path, a.data, &a.textures, &a.animations)
+	case .Png:
+		load_png_texture_data(a.path, a.data, &a.textures)
+	case .Ase_Tileset:
+		load_tileset(a.path, a.data, &a.tileset)
+	case .Png_Tileset:
+		load_png_tileset(a.path, a.data, &a.tileset)
+	}
+
+	for &td in a.textures {
+		trim_texture(&td)
+	}
+
+	// Files that failed to decode aren't cached, so the error shows up again next time
+	if len(a.textures) > 0 || len(a.animations) > 0 || a.tileset.pixels != nil {
+		save_cached_asset(cache_path, a)
+	}
+}
+
+asset_cache_path :: proc(h: u64) -> string {
+	return fmt.aprintf("%s/%016x.bin", ATLAS_CACHE_DIR, h)
+}
+
+// Drops the pixels outside the source rect, only those end up in the atlas
+trim_texture :: proc(td: ^Texture_Data) {
+	if td.source_offset == {} && td.source_size == td.pixels_size {
+		return
+	}
+
+	w := td.source_size.x
+	trimmed := make([]Color, w * td.source_size.y)
+
+	for y in 0 ..< td.source_size.y {
+		from := (td.source_offset.y + y) * td.pixels_size.x + td.source_offset.x
+		copy(trimmed[y * w:][:w], td.pixels[from:][:w])
+	}
+
+	delete(td.pixels)
+	td.pixels = trimmed
+	td.pixels_size = td.source_size
+	td.source_offset = {}
+}
+
+cache_write :: proc(w: ^[dynamic]u8, v: $T) {
+	v := v
+	append(w, ..slice.bytes_from_ptr(&v, size_of(T)))
+}
+
+cache_write_string :: proc(w: ^[dynamic]u8, s: string) {
+	cache_write(w, len(s))
+	append(w, s)
+}
+
+cache_write_pixels :: proc(w: ^[dynamic]u8, pixels: []Color) {
+	cache_write(w, len(pixels))
+	append(w, ..slice.to_bytes(pixels))
+}
+
+save_cached_asset :: proc(path: string, a: ^Asset) {
+	w: [dynamic]u8
+	defer delete(w)
+
+	cache_write(&w, ATLAS_CACHE_MAGIC)
+	cache_write(&w, u32(ATLAS_CACHE_VERSION))
+	cache_write(&w, len(a.textures))
+
+	for td in a.textures {
+		cache_write_string(&w, td.name)
+		cache_write(&w, td.source_size)
+		cache_write(&w, td.document_size)
+		cache_write(&w, td.offset)
+		cache_write(&w, td.duration)
+		cache_write_pixels(&w, td.pixels)
+	}
+
+	cache_write(&w, len(a.animations))
+
+	for an in a.animations {
+		cache_write_string(&w, an.name)
+		cache_write_string(&w, an.first_texture)
+		cache_write_string(&w, an.last_texture)
+		cache_write(&w, an.document_size)
+		cache_write(&w, an.loop_direction)
+		cache_write(&w, an.repeat)
+	}
+
+	cache_write(&w, a.tileset.pixels_size)
+	cache_write(&w, a.tileset.visible_pixels_size)
+	cache_write(&w, a.tileset.offset)
+	cache_write_pixels(&w, a.tileset.pixels)
+
+	if !os.write_entire_file(path, w[:]) {
+		log.warn("Failed writing cache file", path)
+	}
+}
+
+Cache_Reader :: struct {
+	data: []u8,
+	pos:  int,
+	ok:   bool,
+}
+
+cache_read :: proc(r: ^Cache_Reader, $T: typeid) -> (v: T) {
+	if !r.ok || r.pos + size_of(T) > len(r.data) {
+		r.ok = false
+		return
+	}
+
+	copy(slice.bytes_from_ptr(&v, size_of(T)), r.data[r.pos:][:size_of(T)])
+	r.pos += size_of(T)
+	return
+}
+
+cache_read_bytes :: proc(r: ^Cache_Reader, size: int) -> []u8 {
+	if !r.ok || size < 0 || r.pos + size > len(r.data) {
+		r.ok = false
+		return nil
+	}
+
+	b := r.data[r.pos:][:size]
+	r.pos += size
+	return b
+}
+
+cache_read_string :: proc(r: ^Cache_Reader) -> string {
+	return strings.clone(string(cache_read_bytes(r, cache_read(r, int))))
+}
+
+cache_read_pixels :: proc(r: ^Cache_Reader) -> []Color {
+	n := cache_read(r, int)
+	b := cache_read_bytes(r, n * size_of(Color))
+
+	if b == nil {
+		return nil
+	}
+
+	return slice.clone(slice.reinterpret([]Color, b))
+}
+
+load_cached_asset :: proc(path: string, a: ^Asset) -> bool {
+	data, data_ok := os.read_entire_file(path)
+
+	if !data_ok {
+		return false
+	}
+
+	defer delete(data)
+	r := Cache_Reader {
+		data = data,
+		ok   = true,
+	}
+
+	if cache_read(&r, u32) != ATLAS_CACHE_MAGIC || cache_read(&r, u32) != ATLAS_CACHE_VERSION {
+		return false
+	}
+
+	for _ in 0 ..< cache_read(&r, int) {
+		td: Texture_Data
+		td.name = cache_read_string(&r)
+		td.source_size = cache_read(&r, Vec2i)
+		td.pixels_size = td.source_size
+		td.document_size = cache_read(&r, Vec2i)
+		td.offset = cache_read(&r, Vec2i)
+		td.duration = cache_read(&r, f32)
+		td.pixels = cache_read_pixels(&r)
+		if !r.ok {
+			break
+		}
+		append(&a.textures, td)
+	}
+
+	for _ in 0 ..< cache_read(&r, int) {
+		an: Animation
+		an.name = cache_read_string(&r)
+		an.first_texture = cache_read_string(&r)
+		an.last_texture = cache_read_string(&r)
+		an.document_size = cache_read(&r, Vec2i)
+		an.loop_direction = cache_read(&r, ase.Tag_Loop_Dir)
+		an.repeat = cache_read(&r, u16)
+		if !r.ok {
+			break
+		}
+		append(&a.animations, an)
+	}
+
+	a.tileset.pixels_size = cache_read(&r, Vec2i)
+	a.tileset.visible_pixels_size = cache_read(&r, Vec2i)
+	a.tileset.offset = cache_read(&r, Vec2i)
+	a.tileset.pixels = cache_read_pixels(&r)
+
+	if !r.ok || r.pos != len(r.data) {
+		log.warn("Ignoring broken cache file", path)
+		clear(&a.textures)
+		clear(&a.animations)
+		a.tileset = {}
+		return false
+	}
+
+	return true
+}
+
+// Removes cache files that no current asset uses
+prune_asset_cache :: proc(assets: []Asset) {
+	d, derr := os.open(ATLAS_CACHE_DIR, os.O_RDONLY)
+	if derr != nil {
+		return
+	}
+	defer os.close(d)
+
+	file_infos, _ := os.read_dir(d, -1)
+	defer os.file_info_slice_delete(file_infos)
+
+	used := make(map[string]bool)
+	defer delete(used)
+
+	for a in assets {
+		used[slashpath.base(asset_cache_path(a.hash))] = true
+	}
+
+	for fi in file_infos {
+		if strings.has_suffix(fi.name, ".bin") && !used[fi.name] {
+			os.remove(fi.fullpath)
+		}
+	}
+}
+
+// Everything the atlas is made from: the name and contents of each texture file in order, the
+// font and the settings above
+atlas_inputs_hash :: proc(assets: []Asset, font_data: []u8) -> u64 {
+	settings := fmt.tprint(
+		ATLAS_CACHE_VERSION,
+		ATLAS_SIZE,
+		ATLAS_CROP,
+		TILESET_WIDTH,
+		TILE_SIZE,
+		TILE_ADD_PADDING,
+		PACKAGE_NAME,
+		LETTERS_IN_FONT,
+		FONT_SIZE,
+		ATLAS_PNG_OUTPUT_PATH,
+		ATLAS_ODIN_OUTPUT_PATH,
+	)
+	h := hash.fnv64a(transmute([]u8)settings)
+	h = hash.fnv64a(font_data, h)
+
+	for a in assets {
+		ah := a.hash
+		h = hash.fnv64a(slice.bytes_from_ptr(&ah, size_of(ah)), h)
+	}
+
+	return h
+}
+
+atlas_inputs_hash_path :: proc() -> string {
+	return ATLAS_CACHE_DIR + "/inputs.hash"
+}
+
+// True when the outputs exist and were made from exactly these inputs
+atlas_up_to_date :: proc(inputs_hash: u64) -> bool {
+	if !os.exists(ATLAS_PNG_OUTPUT_PATH) || !os.exists(ATLAS_ODIN_OUTPUT_PATH) {
+		return false
+	}
+
+	data, data_ok := os.read_entire_file(atlas_inputs_hash_path())
+
+	if !data_ok {
+		return false
+	}
+
+	defer delete(data)
+	last, parse_ok := strconv.parse_u64_of_base(strings.trim_space(string(data)), 16)
+	return parse_ok && last == inputs_hash
+}
+
+Glyph_Job :: struct {
+	font:    ^stbtt.fontinfo,
+	letters: []rune,
+	glyphs:  []Glyph,
+}
+
+// Rasterizes the letters in parallel, stb_truetype only reads the font info
+rasterize_glyphs :: proc(pool: ^jobs.Pool, font: ^stbtt.fontinfo, letters: []rune) -> []Glyph {
+	job := Glyph_Job {
+		font    = font,
+		letters = letters,
+		glyphs  = make([]Glyph, len(letters)),
+	}
+
+	jobs.parallel_for(pool, len(letters), 8, &job, proc(data: rawptr, start, end: int) {
+		job := (^Glyph_Job)(data)
+		for i in start ..< end {
+			job.glyphs[i] = rasterize_glyph(job.font, job.letters[i])
+		}
+	})
+
+	return job.glyphs
+}
+
+rasterize_glyph :: proc(fi: ^stbtt.fontinfo, r: rune) -> Glyph {
+	scale_factor := stbtt.ScaleForPixelHeight(fi, FONT_SIZE)
+
+	ascent: c.int
+	stbtt.GetFontVMetrics(fi, &ascent, nil, nil)
+
+	w, h, ox, oy: c.int
+	data := stbtt.GetCodepointBitmap(fi, scale_factor, scale_factor, r, &w, &h, &ox, &oy)
+	advance_x: c.int
+	stbtt.GetCodepointHMetrics(fi, r, &advance_x, nil)
+
+	rgba_data := make([]Color, w * h)
+
+	for i in 0 ..< w * h {
+		a := data[i]
+		rgba_data[i].r = 255
+		rgba_data[i].g = 255
+		rgba_data[i].b = 255
+		rgba_data[i].a = a
+	}
+
+	return {
+		image = {data = rgba_data, width = int(w), height = int(h)},
+		value = r,
+		offset = {int(ox), int(f32(oy) + f32(ascent) * scale_factor)},
+		advance_x = int(f32(advance_x) * scale_factor),
+	}
+}
+
+// Milliseconds since start, and start is moved on to now
+lap :: proc(start: ^time.Tick) -> f64 {
+	now := time.tick_now()
+	ms := time.duration_milliseconds(time.tick_diff(start^, now))
+	start^ = now
+	return ms
+}
+
 default_context: runtime.Context
 
 main :: proc() {
 	context.logger = log.create_console_logger(opt = {.Level})
 	default_context = context
 	start_time := time.now()
+	stage_start := time.tick_now()
+	force := slice.contains(os.args[1:], "-force")
 	textures: [dynamic]Texture_Data
 	animations: [dynamic]Animation
 
@@ -590,28 +964,72 @@ main :: proc() {
 		return time.diff(i.creation_time, j.creation_time) > 0
 	})
 
-	tileset: Tileset
+	assets: [dynamic]Asset
 
 	for fi in file_infos {
 		is_ase := strings.has_suffix(fi.name, ".ase") || strings.has_suffix(fi.name, ".aseprite")
 		is_png := strings.has_suffix(fi.name, ".png")
 		if is_ase || is_png {
-			path := fmt.tprintf("%s/%s", TEXTURES_DIR, fi.name)
+			a := Asset {
+				path = fmt.tprintf("%s/%s", TEXTURES_DIR, fi.name),
+			}
 			if strings.has_prefix(fi.name, "tileset") {
-				if is_ase {
-					load_tileset(path, &tileset)
-				}
-				if is_png {
-					load_png_tileset(path, &tileset)
-				}
-			} else if is_ase {
-				load_ase_texture_data(path, &textures, &animations)
-			} else if is_png {
-				load_png_texture_data(path, &textures)
+				a.kind = is_ase ? Asset_Kind.Ase_Tileset : Asset_Kind.Png_Tileset
+			} else {
+				a.kind = is_ase ? Asset_Kind.Ase : Asset_Kind.Png
 			}
+			append(&assets, a)
+		}
+	}
+
+	font_data, font_ok := os.read_entire_file(FONT_FILENAME)
+
+	pool := jobs.create_pool()
+	defer jobs.destroy_pool(pool)
+
+	// Jobs run with the worker's context, which has no logger
+	jobs.parallel_for(pool, len(assets), 1, &assets, proc(data: rawptr, start, end: int) {
+		context.logger = default_context.logger
+		for &a in (^[dynamic]Asset)(data)^[start:end] {
+			read_asset(&a)
+		}
+	})
+
+	inputs_hash := atlas_inputs_hash(assets[:], font_data)
+	scan_ms := lap(&stage_start)
+
+	if !force && atlas_up_to_date(inputs_hash) {
+		log.infof("No inputs changed, atlas is up to date (checked in %.2f ms)", scan_ms)
+		return
+	}
+
+	os.make_directory(slashpath.dir(ATLAS_CACHE_DIR))
+	os.make_directory(ATLAS_CACHE_DIR)
+
+	jobs.parallel_for(pool, len(assets), 1, &assets, proc(data: rawptr, start, end: int) {
+		context.logger = default_context.logger
+		for &a in (^[dynamic]Asset)(data)^[start:end] {
+			decode_asset(&a)
+		}
+	})
+
+	tileset: Tileset
+	cached_count := 0
+
+	for &a in assets {
+		append(&textures, ..a.textures[:])
+		append(&animations, ..a.animations[:])
+		if a.tileset.pixels != nil {
+			tileset = a.tileset
+		}
+		if a.from_cache {
+			cached_count += 1
 		}
 	}
 
+	prune_asset_cache(assets[:])
+	decode_ms := lap(&stage_start)
+
 	rc: stbrp.Context
 	rc_nodes: [ATLAS_SIZE]stbrp.Node
 	stbrp.init_target(&rc, ATLAS_SIZE, ATLAS_SIZE, raw_data(rc_nodes[:]), ATLAS_SIZE)
@@ -654,54 +1072,18 @@ main :: proc() {
 		return PackRectType(i >> 29)
 	}
 
-	if font_data, ok := os.read_entire_file(FONT_FILENAME); ok {
+	if font_ok {
 		fi: stbtt.fontinfo
 		if stbtt.InitFont(&fi, raw_data(font_data), 0) {
-			scale_factor := stbtt.ScaleForPixelHeight(&fi, FONT_SIZE)
-
-			ascent: c.int
-			stbtt.GetFontVMetrics(&fi, &ascent, nil, nil)
-
-			glyphs = make([]Glyph, len(letters))
-
-			for r, r_idx in letters {
-				w, h, ox, oy: c.int
-				data := stbtt.GetCodepointBitmap(
-					&fi,
-					scale_factor,
-					scale_factor,
-					r,
-					&w,
-					&h,
-					&ox,
-					&oy,
-				)
-				advance_x: c.int
-				stbtt.GetCodepointHMetrics(&fi, r, &advance_x, nil)
-
-				rgba_data := make([]Color, w * h)
-
-				for i in 0 ..< w * h {
-					a := data[i]
-					rgba_data[i].r = 255
-					rgba_data[i].g = 255
-					rgba_data[i].b = 255
-					rgba_data[i].a = a
-				}
-
-				glyphs[r_idx] = {
-					image = {data = rgba_data, width = int(w), height = int(h)},
-					value = r,
-					offset = {int(ox), int(f32(oy) + f32(ascent) * scale_factor)},
-					advance_x = int(f32(advance_x) * scale_factor),
-				}
+			glyphs = rasterize_glyphs(pool, &fi, letters)
 
+			for g, g_idx in glyphs {
 				append(
 					&pack_rects,
 					stbrp.Rect {
-						id = make_pack_rect_id(i32(r_idx), .Glyph),
-						w = stbrp.Coord(w) + 2,
-						h = stbrp.Coord(h) + 2,
+						id = make_pack_rect_id(i32(g_idx), .Glyph),
+						w = stbrp.Coord(g.image.width) + 2,
+						h = stbrp.Coord(g.image.height) + 2,
 					},
 				)
 			}
@@ -710,6 +1092,8 @@ main :: proc() {
 		log.warnf("No %s file found", FONT_FILENAME)
 	}
 
+	font_ms := lap(&stage_start)
+
 	for t, idx in textures {
 		append(
 			&pack_rects,
@@ -771,6 +1155,8 @@ main :: proc() {
 		log.error("Failed to pack some rects. ATLAS_SIZE too small?")
 	}
 
+	pack_ms := lap(&stage_start)
+
 	atlas_pixels := make([]Color, ATLAS_SIZE * ATLAS_SIZE)
 	atlas := Image {
 		data   = atlas_pixels,
@@ -919,18 +1305,26 @@ main :: proc() {
 		crop_size.y = max_y + 1
 	}
 
+	compose_ms := lap(&stage_start)
+
 	img_write :: proc "c" (ctx: rawptr, data: rawptr, size: c.int) {
 		context = default_context
 		dir := slashpath.dir(ATLAS_PNG_OUTPUT_PATH)
 		if dir != "" {
 			os.make_directory(dir)
 		}
-		os.write_entire_file(ATLAS_PNG_OUTPUT_PATH, slice.bytes_from_ptr(data, int(size)))
+		(^bool)(ctx)^ = os.write_entire_file(
+			ATLAS_PNG_OUTPUT_PATH,
+			slice.bytes_from_ptr(data, int(size)),
+		)
 	}
 
-	stbim.write_png_to_func(
+	// The inputs hash is only saved when both outputs were written, so a failed write is retried
+	// on the next run
+	png_written := false
+	png_encoded := stbim.write_png_to_func(
 		img_write,
-		nil,
+		&png_written,
 		c.int(crop_size.x),
 		c.int(crop_size.y),
 		4,
@@ -938,42 +1332,42 @@ main :: proc() {
 		ATLAS_SIZE * size_of(Color),
 	)
 
-	f, _ := os.open(ATLAS_ODIN_OUTPUT_PATH, os.O_WRONLY | os.O_CREATE | os.O_TRUNC)
-	defer os.close(f)
+	f := strings.builder_make()
+	defer strings.builder_destroy(&f)
 
-	fmt.fprintln(f, "// This file is generated by running the atlas_builder.")
-	fmt.fprintf(f, "package %s\n", PACKAGE_NAME)
-	fmt.fprintln(f, "")
-	fmt.fprintln(
-		f,
+	fmt.sbprintln(&f, "// This file is generated by running the atlas_builder.")
+	fmt.sbprintf(&f, "package %s\n", PACKAGE_NAME)
+	fmt.sbprintln(&f, "")
+	fmt.sbprintln(
+		&f,
 		"/*\nNote: This file assumes the existence of a type Rect that defines a rectangle in the same package, it can defined as:\n",
 	)
-	fmt.fprintln(f, "\tRect :: rl.Rectangle\n")
-	fmt.fprintln(f, "or if you don't use raylib:\n")
-	fmt.fprintln(f, "\tRect :: struct {")
-	fmt.fprintln(f, "\t\tx, y, width, height: f32,")
-	fmt.fprintln(f, "\t}\n")
-	fmt.fprintln(f, "or if you want to use integers (or any other numeric type):\n")
-	fmt.fprintln(f, "\tRect :: struct {")
-	fmt.fprintln(f, "\t\tx, y, width, height: int,")
-	fmt.fprintln(f, "\t}\n")
-	fmt.fprintln(
-		f,
+	fmt.sbprintln(&f, "\tRect :: rl.Rectangle\n")
+	fmt.sbprintln(&f, "or if you don't use raylib:\n")
+	fmt.sbprintln(&f, "\tRect :: struct {")
+	fmt.sbprintln(&f, "\t\tx, y, width, height: f32,")
+	fmt.sbprintln(&f, "\t}\n")
+	fmt.sbprintln(&f, "or if you want to use integers (or any other numeric type):\n")
+	fmt.sbprintln(&f, "\tRect :: struct {")
+	fmt.sbprintln(&f, "\t\tx, y, width, height: int,")
+	fmt.sbprintln(&f, "\t}\n")
+	fmt.sbprintln(
+		&f,
 		"Just make sure you have something along those lines the same package as this file.\n*/",
 	)
-	fmt.fprintln(f, "")
+	fmt.sbprintln(&f, "")
 
-	fmt.fprintf(f, "TEXTURE_ATLAS_FILENAME :: \"%s\"\n", ATLAS_PNG_OUTPUT_PATH)
-	fmt.fprintf(f, "ATLAS_FONT_SIZE :: %v\n", FONT_SIZE)
-	fmt.fprintf(f, "LETTERS_IN_FONT :: \"%s\"\n\n", LETTERS_IN_FONT)
+	fmt.sbprintf(&f, "TEXTURE_ATLAS_FILENAME :: \"%s\"\n", ATLAS_PNG_OUTPUT_PATH)
+	fmt.sbprintf(&f, "ATLAS_FONT_SIZE :: %v\n", FONT_SIZE)
+	fmt.sbprintf(&f, "LETTERS_IN_FONT :: \"%s\"\n\n", LETTERS_IN_FONT)
 
-	fmt.fprintln(
-		f,
+	fmt.sbprintln(
+		&f,
 		"// A generated square in the atlas you can use with rl.SetShapesTexture to make",
 	)
-	fmt.fprintln(f, "// raylib shapes such as rl.DrawRectangleRec() use the atlas.")
-	fmt.fprintf(
-		f,
+	fmt.sbprintln(&f, "// raylib shapes such as rl.DrawRectangleRec() use the atlas.")
+	fmt.sbprintf(
+		&f,
 		"SHAPES_TEXTURE_RECT :: Rect {{%v, %v, %v, %v}}\n\n",
 		shapes_texture_rect.x,
 		shapes_texture_rect.y,
@@ -981,48 +1375,48 @@ main :: proc() {
 		shapes_texture_rect.height,
 	)
 
-	fmt.fprintln(f, "Texture_Name :: enum {")
-	fmt.fprint(f, "\tNone,\n")
+	fmt.sbprintln(&f, "Texture_Name :: enum {")
+	fmt.sbprint(&f, "\tNone,\n")
 	for r in atlas_textures {
-		fmt.fprintf(f, "\t%s,\n", r.name)
+		fmt.sbprintf(&f, "\t%s,\n", r.name)
 	}
-	fmt.fprintln(f, "}")
-	fmt.fprintln(f, "")
+	fmt.sbprintln(&f, "}")
+	fmt.sbprintln(&f, "")
 
-	fmt.fprintln(f, "Atlas_Texture :: struct {")
-	fmt.fprintln(f, "\trect: Rect,")
-	fmt.fprintln(
-		f,
+	fmt.sbprintln(&f, "Atlas_Texture :: struct {")
+	fmt.sbprintln(&f, "\trect: Rect,")
+	fmt.sbprintln(
+		&f,
 		"\t// These offsets tell you how much space there is between the rect and the edge of the original document.",
 	)
-	fmt.fprintln(
-		f,
+	fmt.sbprintln(
+		&f,
 		"\t// The atlas is tightly packed, so empty pixels are removed. This can be especially apparent in animations where",
 	)
-	fmt.fprintln(
-		f,
+	fmt.sbprintln(
+		&f,
 		"\t// frames can have different offsets due to different amount of empty pixels around the frames.",
 	)
-	fmt.fprintln(
-		f,
+	fmt.sbprintln(
+		&f,
 		"\t// In many cases you need to add {offset_left, offset_top} to your position. But if you are",
 	)
-	fmt.fprintln(f, "\t// flipping a texture, then you might need offset_bottom or offset_right.")
-	fmt.fprintln(f, "\toffset_top: f32,")
-	fmt.fprintln(f, "\toffset_right: f32,")
-	fmt.fprintln(f, "\toffset_bottom: f32,")
-	fmt.fprintln(f, "\toffset_left: f32,")
-	fmt.fprintln(f, "\tdocument_size: [2]f32,")
-	fmt.fprintln(f, "\tduration: f32,")
-	fmt.fprintln(f, "}")
-	fmt.fprintln(f, "")
-
-	fmt.fprintln(f, "atlas_textures: [Texture_Name]Atlas_Texture = {")
-	fmt.fprintln(f, "\t.None = {},")
+	fmt.sbprintln(&f, "\t// flipping a texture, then you might need offset_bottom or offset_right.")
+	fmt.sbprintln(&f, "\toffset_top: f32,")
+	fmt.sbprintln(&f, "\toffset_right: f32,")
+	fmt.sbprintln(&f, "\toffset_bottom: f32,")
+	fmt.sbprintln(&f, "\toffset_left: f32,")
+	fmt.sbprintln(&f, "\tdocument_size: [2]f32,")
+	fmt.sbprintln(&f, "\tduration: f32,")
+	fmt.sbprintln(&f, "}")
+	fmt.sbprintln(&f, "")
+
+	fmt.sbprintln(&f, "atlas_textures: [Texture_Name]Atlas_Texture = {")
+	fmt.sbprintln(&f, "\t.None = {},")
 
 	for r in atlas_textures {
-		fmt.fprintf(
-			f,
+		fmt.sbprintf(
+			&f,
 			"\t.%s = {{ rect = {{%v, %v, %v, %v}}, offset_top = %v, offset_right = %v, offset_bottom = %v, offset_left = %v, document_size = {{%v, %v}}, duration = %f}},\n",
 			r.name,
 			r.rect.x,
@@ -1039,41 +1433,41 @@ main :: proc() {
 		)
 	}
 
-	fmt.fprintln(f, "}\n")
+	fmt.sbprintln(&f, "}\n")
 
-	fmt.fprintln(f, "Animation_Name :: enum {")
-	fmt.fprint(f, "\tNone,\n")
+	fmt.sbprintln(&f, "Animation_Name :: enum {")
+	fmt.sbprint(&f, "\tNone,\n")
 	for r in animations {
-		fmt.fprintf(f, "\t%s,\n", r.name)
-	}
-	fmt.fprintln(f, "}")
-	fmt.fprintln(f, "")
-
-	fmt.fprintln(f, "Tag_Loop_Dir :: enum {")
-	fmt.fprintln(f, "\tForward,")
-	fmt.fprintln(f, "\tReverse,")
-	fmt.fprintln(f, "\tPing_Pong,")
-	fmt.fprintln(f, "\tPing_Pong_Reverse,")
-	fmt.fprintln(f, "}")
-	fmt.fprintln(f, "")
-
-	fmt.fprintln(f, "// Any aseprite file with frames will create new animations. Also, any tags")
-	fmt.fprintln(f, "// within the aseprite file will make that that into a separate animation.")
-	fmt.fprintln(f, "Atlas_Animation :: struct {")
-	fmt.fprintln(f, "\tfirst_frame: Texture_Name,")
-	fmt.fprintln(f, "\tlast_frame: Texture_Name,")
-	fmt.fprintln(f, "\tdocument_size: [2]f32,")
-	fmt.fprintln(f, "\tloop_direction: Tag_Loop_Dir,")
-	fmt.fprintln(f, "\trepeat: u16,")
-	fmt.fprintln(f, "}")
-	fmt.fprintln(f, "")
-
-	fmt.fprintln(f, "atlas_animations := [Animation_Name]Atlas_Animation {")
-	fmt.fprint(f, "\t.None = {},\n")
+		fmt.sbprintf(&f, "\t%s,\n", r.name)
+	}
+	fmt.sbprintln(&f, "}")
+	fmt.sbprintln(&f, "")
+
+	fmt.sbprintln(&f, "Tag_Loop_Dir :: enum {")
+	fmt.sbprintln(&f, "\tForward,")
+	fmt.sbprintln(&f, "\tReverse,")
+	fmt.sbprintln(&f, "\tPing_Pong,")
+	fmt.sbprintln(&f, "\tPing_Pong_Reverse,")
+	fmt.sbprintln(&f, "}")
+	fmt.sbprintln(&f, "")
+
+	fmt.sbprintln(&f, "// Any aseprite file with frames will create new animations. Also, any tags")
+	fmt.sbprintln(&f, "// within the aseprite file will make that that into a separate animation.")
+	fmt.sbprintln(&f, "Atlas_Animation :: struct {")
+	fmt.sbprintln(&f, "\tfirst_frame: Texture_Name,")
+	fmt.sbprintln(&f, "\tlast_frame: Texture_Name,")
+	fmt.sbprintln(&f, "\tdocument_size: [2]f32,")
+	fmt.sbprintln(&f, "\tloop_direction: Tag_Loop_Dir,")
+	fmt.sbprintln(&f, "\trepeat: u16,")
+	fmt.sbprintln(&f, "}")
+	fmt.sbprintln(&f, "")
+
+	fmt.sbprintln(&f, "atlas_animations := [Animation_Name]Atlas_Animation {")
+	fmt.sbprint(&f, "\t.None = {},\n")
 
 	for a in animations {
-		fmt.fprintf(
-			f,
+		fmt.sbprintf(
+			&f,
 			"\t.%v = {{ first_frame = .%v, last_frame = .%v, loop_direction = .%v, repeat = %v, document_size = {{%v, %v}} }},\n",
 			a.name,
 			a.first_texture,
@@ -1085,25 +1479,25 @@ main :: proc() {
 		)
 	}
 
-	fmt.fprintln(f, "}\n")
+	fmt.sbprintln(&f, "}\n")
 
 
-	fmt.fprintln(f, "// All these are pre-generated so you can save tile IDs to data without")
-	fmt.fprintln(f, "// worrying about their order changing later.")
-	fmt.fprintln(f, "Tile_Id :: enum {")
+	fmt.sbprintln(&f, "// All these are pre-generated so you can save tile IDs to data without")
+	fmt.sbprintln(&f, "// worrying about their order changing later.")
+	fmt.sbprintln(&f, "Tile_Id :: enum {")
 	for y in 0 ..< TILESET_WIDTH {
 		for x in 0 ..< TILESET_WIDTH {
-			fmt.fprintf(f, "\tT0Y%vX%v,\n", y, x)
+			fmt.sbprintf(&f, "\tT0Y%vX%v,\n", y, x)
 		}
 	}
-	fmt.fprintln(f, "}")
-	fmt.fprintln(f, "")
+	fmt.sbprintln(&f, "}")
+	fmt.sbprintln(&f, "")
 
-	fmt.fprintln(f, "atlas_tiles := #partial [Tile_Id]Rect {")
+	fmt.sbprintln(&f, "atlas_tiles := #partial [Tile_Id]Rect {")
 
 	for at in atlas_tiles {
-		fmt.fprintf(
-			f,
+		fmt.sbprintf(
+			&f,
 			"\t.T0Y%vX%v = {{%v, %v, %v, %v}},\n",
 			at.coord.y,
 			at.coord.x,
@@ -1114,23 +1508,23 @@ main :: proc() {
 		)
 	}
 
-	fmt.fprintln(f, "}\n")
+	fmt.sbprintln(&f, "}\n")
 
 
-	fmt.fprintln(f, "Atlas_Glyph :: struct {")
-	fmt.fprintln(f, "\trect: Rect,")
-	fmt.fprintln(f, "\tvalue: rune,")
-	fmt.fprintln(f, "\toffset_x: int,")
-	fmt.fprintln(f, "\toffset_y: int,")
-	fmt.fprintln(f, "\tadvance_x: int,")
-	fmt.fprintln(f, "}")
-	fmt.fprintln(f, "")
+	fmt.sbprintln(&f, "Atlas_Glyph :: struct {")
+	fmt.sbprintln(&f, "\trect: Rect,")
+	fmt.sbprintln(&f, "\tvalue: rune,")
+	fmt.sbprintln(&f, "\toffset_x: int,")
+	fmt.sbprintln(&f, "\toffset_y: int,")
+	fmt.sbprintln(&f, "\tadvance_x: int,")
+	fmt.sbprintln(&f, "}")
+	fmt.sbprintln(&f, "")
 
-	fmt.fprintln(f, "atlas_glyphs: []Atlas_Glyph = {")
+	fmt.sbprintln(&f, "atlas_glyphs: []Atlas_Glyph = {")
 
 	for ag in atlas_glyphs {
-		fmt.fprintf(
-			f,
+		fmt.sbprintf(
+			&f,
 			"\t{{ rect = {{%v, %v, %v, %v}}, value = %q, offset_x = %v, offset_y = %v, advance_x = %v}},\n",
 			ag.rect.x,
 			ag.rect.y,
@@ -1143,11 +1537,40 @@ main :: proc() {
 		)
 	}
 
-	fmt.fprintln(f, "}")
+	fmt.sbprintln(&f, "}")
+
+	odin_written := os.write_entire_file(ATLAS_ODIN_OUTPUT_PATH, f.buf[:])
+	if png_encoded == 0 || !png_written {
+		log.error("Failed writing", ATLAS_PNG_OUTPUT_PATH)
+	}
+	if !odin_written {
+		log.error("Failed writing", ATLAS_ODIN_OUTPUT_PATH)
+	}
+
+	hash_text := fmt.tprintf("%016x", inputs_hash)
+	if png_encoded == 0 || !png_written || !odin_written {
+		os.remove(atlas_inputs_hash_path())
+	} else if !os.write_entire_file(atlas_inputs_hash_path(), transmute([]u8)hash_text) {
+		log.warn("Failed writing", atlas_inputs_hash_path())
+	}
+
+	write_ms := lap(&stage_start)
 
 	run_time_ms := time.duration_milliseconds(time.diff(start_time, time.now()))
 	log.infof(
 		ATLAS_PNG_OUTPUT_PATH + " and " + ATLAS_ODIN_OUTPUT_PATH + " created in %.2f ms",
 		run_time_ms,
 	)
+	log.infof(
+		"scan %.2f ms, decode %.2f ms (%v of %v files cached), font %.2f ms, pack %.2f ms, compose %.2f ms, write %.2f ms, %v workers",
+		scan_ms,
+		decode_ms,
+		cached_count,
+		len(assets),
+		font_ms,
+		pack_ms,
+		compose_ms,
+		write_ms,
+		jobs.worker_count(pool),
+	)
 }
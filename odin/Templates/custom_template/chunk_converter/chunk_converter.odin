@@ -4,7 +4,9 @@ import "base:runtime"
 import "core:bytes"
 import "core:encoding/json"
 import "core:fmt"
+import "core:hash"
 import "core:log"
+import "core:mem"
 import "core:os"
 import "core:path/filepath"
 import "core:strconv"
@@ -16,13 +18,15 @@ import "core:time"
 import "core:unicode"
 import "core:unicode/utf8"
 
+import "../jobs"
+
 // Import your chunk system (adjust path as needed)
 // import "../game" // Assuming your chunk code is in a game package
 
 // Redefine the types here for the tool (or import from your game package)
 CHUNK_SIZE :: 32
-COLLISION_CHUNK_VERSION :: 1
-VISUAL_CHUNK_VERSION :: 1
+COLLISION_CHUNK_VERSION :: 2
+VISUAL_CHUNK_VERSION :: 2
 
 ChunkCoord :: struct {
 	x, y: i32,
@@ -44,7 +48,7 @@ Tile_Type :: enum u8 {
 	TEST3    = 6,
 }
 
-Sprite_ID :: enum u32 {
+Sprite_ID :: enum u16 {
 	NONE         = 0,
 	GRASS_TILE   = 1,
 	STONE_TILE   = 2,
@@ -93,6 +97,8 @@ Command :: enum {
 	BINARY_TO_JSON,
 	CONVERT_ALL,
 	VALIDATE,
+	PACK_REGION,
+	UNPACK_REGION,
 }
 
 Config :: struct {
@@ -101,6 +107,8 @@ Config :: struct {
 	output_path: string,
 	chunk_type:  string, // "collision" or "visual"
 	recursive:   bool,
+	force:       bool, // convert even when the output is up to date
+	workers:     int, // for convert-all and validate, 0 is one per core
 }
 
 FileInfo :: struct {
@@ -109,6 +117,36 @@ FileInfo :: struct {
 	chunk_type: string, // "collision" or "visual"
 }
 
+// One file of convert-all, filled in by run_convert_job
+Convert_Job :: struct {
+	input:      string,
+	output:     string,
+	chunk_type: string,
+	direction:  Command,
+	recorded:   u64, // input hash in convert_hashes.txt, 0 if there is none
+	force:      bool,
+	hash:       u64, // of the input, 0 when it wasn't read
+	bytes:      int, // read
+	result:     Convert_Result,
+}
+
+Convert_Result :: enum {
+	Failed,
+	Converted,
+	Up_To_Date,
+}
+
+Validate_Job :: struct {
+	path:       string,
+	chunk_type: string,
+	bytes:      int, // read
+	valid:      bool,
+}
+
+// In the output directory of convert-all
+CONVERT_HASHES_FILE :: "convert_hashes.txt"
+VALIDATE_BLOCK_SIZE :: 16 * 1024
+
 // JSON structures for serialization
 JSON_Collision_Chunk :: struct {
 	coord_x: i32,
@@ -127,6 +165,68 @@ JSON_Decoration :: struct {
 	layer:  i32,
 }
 
+// Binary chunk files, version 2, must match source/chunk_format.odin
+// [4 bytes: magic] [2 bytes: version] [2 bytes: flags] [4 bytes: chunk_x] [4 bytes: chunk_y]
+// [4 bytes: payload size] [4 bytes: crc32 of the payload]
+// [payload: tile or sprite layer, raw or run-length encoded, then entities and decorations]
+// Version 1 files have no header and start with chunk_x, chunk_y.
+COLLISION_CHUNK_MAGIC :: u32(0x4C4F4343) // "CCOL"
+VISUAL_CHUNK_MAGIC :: u32(0x53495643) // "CVIS"
+
+Chunk_File_Flag :: enum u16 {
+	layer_rle,
+}
+
+Chunk_File_Flags :: bit_set[Chunk_File_Flag; u16]
+
+Chunk_File_Header :: struct {
+	magic:        u32,
+	version:      u16,
+	flags:        Chunk_File_Flags,
+	chunk_x:      i32,
+	chunk_y:      i32,
+	payload_size: u32,
+	checksum:     u32,
+}
+
+// Region files, must match source/region_file.odin
+// [4 bytes: magic] [4 bytes: version] [4 bytes: entry count] [4 bytes: unused]
+// [entry count * 20 bytes: index, sorted by kind, y, x]
+// [chunk data: each chunk is the same bytes as its .dat file, starting on a 16 byte boundary]
+REGION_FILE_MAGIC :: u32(0x4E475243) // "CRGN"
+REGION_FILE_VERSION :: 1
+REGION_DATA_ALIGN :: 16
+
+Region_Chunk_Kind :: enum u32 {
+	collision = 0,
+	visual    = 1,
+}
+
+region_kind_dirs := [Region_Chunk_Kind]string {
+	.collision = "collision",
+	.visual    = "visual",
+}
+
+Region_Header :: struct {
+	magic:   u32,
+	version: u32,
+	count:   u32,
+	unused:  u32,
+}
+
+Region_Entry :: struct {
+	x:      i32,
+	y:      i32,
+	kind:   u32,
+	offset: u32,
+	size:   u32,
+}
+
+Region_Chunk :: struct {
+	entry: Region_Entry,
+	data:  []byte,
+}
+
 JSON_Visual_Chunk :: struct {
 	coord_x:          i32,
 	coord_y:          i32,
@@ -154,6 +254,10 @@ main :: proc() {
 		convert_directory(config)
 	case .VALIDATE:
 		validate_chunks(config)
+	case .PACK_REGION:
+		pack_region(config)
+	case .UNPACK_REGION:
+		unpack_region(config)
 	}
 
 	run_time_ms := time.duration_milliseconds(time.diff(start_time, time.now()))
@@ -183,6 +287,10 @@ parse_command_line :: proc() -> Config {
 			config.command = .CONVERT_ALL
 		case "validate":
 			config.command = .VALIDATE
+		case "pack":
+			config.command = .PACK_REGION
+		case "unpack":
+			config.command = .UNPACK_REGION
 		case "-i", "--input":
 			if i + 1 < len(args) {
 				i += 1
@@ -200,6 +308,13 @@ parse_command_line :: proc() -> Config {
 			}
 		case "-r", "--recursive":
 			config.recursive = true
+		case "-f", "--force":
+			config.force = true
+		case "-j", "--jobs":
+			if i + 1 < len(args) {
+				i += 1
+				config.workers = strconv.parse_int(args[i]) or_else 0
+			}
 		}
 		i += 1
 	}
@@ -224,12 +339,16 @@ print_help :: proc() {
 	fmt.println("  b2j, binary-to-json    Convert binary chunk to JSON")
 	fmt.println("  convert-all            Convert all chunks in directory")
 	fmt.println("  validate               Validate chunk files")
+	fmt.println("  pack                   Pack binary chunks into one region file")
+	fmt.println("  unpack                 Unpack a region file into binary chunks")
 	fmt.println()
 	fmt.println("Options:")
 	fmt.println("  -i, --input <path>     Input file or directory")
 	fmt.println("  -o, --output <path>    Output file or directory")
 	fmt.println("  -t, --type <type>      Chunk type: 'collision' or 'visual'")
 	fmt.println("  -r, --recursive        Process directories recursively")
+	fmt.println("  -f, --force            Convert files even when their output is up to date")
+	fmt.println("  -j, --jobs <count>     Threads for convert-all and validate, default: all cores")
 	fmt.println("  -h, --help             Show this help")
 	fmt.println()
 	fmt.println("Examples:")
@@ -241,6 +360,12 @@ print_help :: proc() {
 	fmt.println()
 	fmt.println("  # Validate all chunks in directory")
 	fmt.println("  chunk_converter validate -i data/chunks -r")
+	fmt.println()
+	fmt.println("  # Pack all binary chunks into the region file the game maps")
+	fmt.println("  chunk_converter pack -i data/chunks/binary -o data/chunks/chunks.region")
+	fmt.println()
+	fmt.println("  # Unpack a region file back into collision/ and visual/ chunk files")
+	fmt.println("  chunk_converter unpack -i data/chunks/chunks.region -o data/chunks/binary")
 }
 
 convert_single_file :: proc(config: Config, direction: Command) {
@@ -271,7 +396,7 @@ convert_collision_chunk :: proc(input_path, output_path: string, direction: Comm
 		chunk, load_ok := load_collision_chunk_json(input_path)
 		if !load_ok {
 			fmt.printf(
-				"Failed to load chunk!: convert_collision_chunk :: proc (%s, %s, %s)",
+				"Failed to load chunk!: convert_collision_chunk :: proc (%s, %s, %s)\n",
 				input_path,
 				output_path,
 				direction,
@@ -323,164 +448,496 @@ convert_visual_chunk :: proc(input_path, output_path: string, direction: Command
 	return false
 }
 
+//Converts every chunk file under config.input_path into <output>/binary/<type> (from JSON) or
+//<output>/json/<type> (from binary), spread over the job pool one file per job. A worker only
+//holds the file it is converting, so memory stays the same however many files there are.
+//Outputs written after their input was last changed are skipped, and so are outputs whose input
+//still has the hash it had when they were written (convert_hashes.txt), unless -f is given.
 convert_directory :: proc(config: Config) {
 	if config.input_path == "" || config.output_path == "" {
 		fmt.println("Error: Input and output directories are required")
 		return
 	}
-	// Create output directory
-	if !os.exists(config.output_path) {
-		fmt.printf("Creating dir: %s\n", config.output_path)
-		os.make_directory(config.output_path, 0)
-	}
-	// Find all chunk files
+	start_time := time.now()
 	files := find_chunk_files(config.input_path, config.recursive)
 	defer delete(files)
-	fmt.printf("Found %i files\n", len(files))
-	for file in files {
-		fmt.printf("File info: %s\n", file.name)
-		fmt.printf("File chunk type: %s\n", file.chunk_type)
+
+	hashes_path := filepath.join({config.output_path, CONVERT_HASHES_FILE})
+	defer delete(hashes_path)
+	hashes: map[string]u64
+	hashes_data := load_convert_hashes(hashes_path, &hashes)
+	defer {
+		delete(hashes)
+		delete(hashes_data)
+	}
+
+	// The jobs only write files, the directories they go in are made here
+	if !make_directory_if_missing(config.output_path) {
+		return
+	}
+	made: [2][Region_Chunk_Kind]bool
+	batch := make([dynamic]Convert_Job, 0, len(files))
+	defer {
+		for job in batch {
+			delete(job.output)
+		}
+		delete(batch)
 	}
-	fmt.printf("------------------------------\n")
-	//Metrics
-	converted := 0
-	skipped := 0
-	failed := 0
-	//For every file found
 	for file_info in files {
-		// Determine conversion direction
-		is_json := strings.has_suffix(file_info.path, ".json")
-		is_binary := strings.has_suffix(file_info.path, ".dat")
-
-		//we only want to check .dat and .json files
-		if !is_json && !is_binary {continue}
-		//determine conversion based on file type
-		direction := Command.JSON_TO_BINARY if is_json else .BINARY_TO_JSON
-		output_name := file_info.name
-		type := ""
-		//if we have a json file, do binary conversion
-		if is_json {
-			type = "/binary"
-			folder_path := filepath.join({config.output_path, type})
-			if !os.exists(folder_path) {
-				err := os.make_directory(folder_path)
-				if err != nil {
-					fmt.printf("Err: %s\n", err)
-				}
-			}
-			output_name, _ = strings.replace(output_name, ".json", ".dat", 1)
-		} else {
-			type = "/json"
-			folder_path := filepath.join({config.output_path, type})
-			if !os.exists(folder_path) {
-				err := os.make_directory(folder_path)
-				if err != nil {
-					fmt.printf("Err: %s\n", err)
-				}
-			}
-			output_name, _ = strings.replace(output_name, ".dat", ".json", 1)
-		}
-		output_path: string
-		output_dir: string
-		// Check to see what type of file we are converting
-		if file_info.chunk_type == "collision" {
-			output_dir = filepath.join({config.output_path, type, "/collision"})
-			fmt.printf("Output dir: %s\n", output_dir)
-			//If directory doesn't exist, create it. 
-			if !os.exists(output_dir) {
-				fmt.printf("Creating dir: %s\n", output_dir)
-				err := os.make_directory(output_dir, 0)
-				if err != nil {
-					fmt.printf("Err: %s\n", err)
-				}
-			}
-			output_path = filepath.join({config.output_path, type, "/collision/", output_name})
-			exists := os.exists(output_path)
-			//only try to convert if file doesn't exist
-			if !exists {
-				if convert_collision_chunk(file_info.path, output_path, direction) {
-					fmt.printf("Converted: %s -> %s\n", file_info.path, output_path)
-					converted += 1
-				} else {
-					failed += 1
-					fmt.printf("Failed: %s\n", file_info.path)
-				}
-			} else {skipped += 1}
-		} else if file_info.chunk_type == "visual" {
-			output_dir = filepath.join({config.output_path, type, "/visual"})
-			fmt.printf("Output dir: %s\n", output_dir)
-			if !os.exists(output_dir) {
-				fmt.printf("Creating dir: %s\n", output_dir)
-				os.make_directory(output_dir, 0)
-			}
-			output_path = filepath.join({config.output_path, type, "/visual/", output_name})
-			exists := os.exists(output_path)
-			if !exists {
-				if convert_visual_chunk(file_info.path, output_path, direction) {
-					fmt.printf("Converted: %s -> %s\n", file_info.path, output_path)
-					converted += 1
-				} else {
-					failed += 1
-					fmt.printf("Failed: %s\n", file_info.path)
-				}
-			} else {skipped += 1}
-		}
-		fmt.printf("-----------------------------------------------------------------\n")
+		is_json := strings.has_suffix(file_info.name, ".json")
+		format_dir := "binary" if is_json else "json"
+		kind := Region_Chunk_Kind.collision if file_info.chunk_type == "collision" else .visual
+		if !made[int(is_json)][kind] {
+			format_path := filepath.join({config.output_path, format_dir})
+			type_path := filepath.join({format_path, region_kind_dirs[kind]})
+			made[int(is_json)][kind] =
+				make_directory_if_missing(format_path) && make_directory_if_missing(type_path)
+			delete(format_path)
+			delete(type_path)
+		}
+
+		name := strings.trim_suffix(file_info.name, ".json" if is_json else ".dat")
+		output_name := strings.concatenate({name, ".dat" if is_json else ".json"})
+		defer delete(output_name)
+		output := filepath.join({config.output_path, format_dir, file_info.chunk_type, output_name})
+		append(
+			&batch,
+			Convert_Job {
+				input = file_info.path,
+				output = output,
+				chunk_type = file_info.chunk_type,
+				direction = .JSON_TO_BINARY if is_json else .BINARY_TO_JSON,
+				recorded = hashes[file_info.path],
+				force = config.force,
+			},
+		)
 	}
+
+	pool := jobs.create_pool(config.workers)
+	defer jobs.destroy_pool(pool)
+	jobs.parallel_for(pool, len(batch), 1, &batch, proc(data: rawptr, start, end: int) {
+		for &job in (^[dynamic]Convert_Job)(data)^[start:end] {
+			run_convert_job(&job)
+		}
+	})
+	save_convert_hashes(hashes_path, batch[:])
+
+	counts: [Convert_Result]int
+	bytes := 0
+	for job in batch {
+		counts[job.result] += 1
+		bytes += job.bytes
+	}
+	seconds := max(time.duration_seconds(time.since(start_time)), 1e-6)
 	fmt.printf(
-		"\nConversion complete: %d successful, %d failed, %d skipped\n",
-		converted,
-		failed,
-		skipped,
+		"Converted %d, %d skipped, %d failed, %d files, %.2fs: %.0f files/s, %.1f MB/s, %d jobs\n",
+		counts[.Converted],
+		counts[.Up_To_Date],
+		counts[.Failed],
+		len(batch),
+		seconds,
+		f64(len(batch)) / seconds,
+		f64(bytes) / (1024 * 1024) / seconds,
+		jobs.worker_count(pool),
 	)
 }
 
+run_convert_job :: proc(job: ^Convert_Job) {
+	if !job.force && output_is_newer(job.input, job.output) {
+		job.result = .Up_To_Date
+		return
+	}
+	data, read_ok := os.read_entire_file(job.input)
+	if !read_ok {
+		fmt.printf("Failed: could not read %s\n", job.input)
+		return
+	}
+	job.bytes = len(data)
+	job.hash = hash.fnv64a(data)
+	delete(data)
+	if !job.force && job.hash == job.recorded && os.exists(job.output) {
+		job.result = .Up_To_Date
+		return
+	}
+
+	ok := false
+	if job.chunk_type == "collision" {
+		ok = convert_collision_chunk(job.input, job.output, job.direction)
+	} else {
+		ok = convert_visual_chunk(job.input, job.output, job.direction)
+	}
+	if ok {
+		job.result = .Converted
+	} else {
+		fmt.printf("Failed: %s\n", job.input)
+	}
+}
+
+//True when output exists and was written after input last changed
+output_is_newer :: proc(input, output: string) -> bool {
+	input_time, input_err := os.last_write_time_by_name(input)
+	output_time, output_err := os.last_write_time_by_name(output)
+	return input_err == os.ERROR_NONE && output_err == os.ERROR_NONE && output_time >= input_time
+}
+
+make_directory_if_missing :: proc(path: string) -> bool {
+	if os.exists(path) {
+		return true
+	}
+	if err := os.make_directory(path, 0o755); err != os.ERROR_NONE {
+		fmt.printf("Could not create %s: %v\n", path, err)
+		return false
+	}
+	return true
+}
+
+//Reads the "<hash> <input path>" lines save_convert_hashes writes into hashes. The keys point into
+//the returned data.
+load_convert_hashes :: proc(path: string, hashes: ^map[string]u64) -> []byte {
+	data, read_ok := os.read_entire_file(path)
+	if !read_ok {
+		return nil
+	}
+	text := string(data)
+	for line in strings.split_lines_iterator(&text) {
+		space := strings.index_byte(line, ' ')
+		if space == -1 {
+			continue
+		}
+		if h, ok := strconv.parse_u64_of_base(line[:space], 16); ok {
+			hashes[line[space + 1:]] = h
+		}
+	}
+	return data
+}
+
+//Input hashes of every file whose output is up to date, for the next run
+save_convert_hashes :: proc(path: string, batch: []Convert_Job) {
+	b := strings.builder_make()
+	defer strings.builder_destroy(&b)
+	for job in batch {
+		// Skipped by mtime, the input wasn't read and the old hash still holds
+		h := job.hash if job.hash != 0 else job.recorded
+		if job.result != .Failed && h != 0 {
+			fmt.sbprintf(&b, "%016x %s\n", h, job.input)
+		}
+	}
+	if !os.write_entire_file(path, b.buf[:]) {
+		fmt.printf("Failed to write %s\n", path)
+	}
+}
+
+//Checks every chunk file under config.input_path in parallel. Binary v2 files only have their
+//payload streamed through crc32 a block at a time, JSON and version 1 files, which have no
+//checksum, are loaded in full. Only invalid files are listed.
 validate_chunks :: proc(config: Config) {
 	if config.input_path == "" {
 		fmt.println("Error: Input path is required")
 		return
 	}
+	start_time := time.now()
 	files := find_chunk_files(config.input_path, config.recursive)
 	defer delete(files)
-	valid := 0
-	invalid := 0
-	for file_info in files {
-		is_valid := false
-		if file_info.chunk_type == "collision" {
-			if strings.has_suffix(file_info.path, ".json") {
-				_, load_ok := load_collision_chunk_json(file_info.path)
-				is_valid = load_ok
-			} else if strings.has_suffix(file_info.path, ".dat") {
-				_, load_ok := load_collision_chunk_binary(file_info.path)
-				is_valid = load_ok
-			}
-		} else if file_info.chunk_type == "visual" {
-			if strings.has_suffix(file_info.path, ".json") {
-				chunk, load_ok := load_visual_chunk_json(file_info.path)
-				if load_ok {
-					delete(chunk.entities)
-					delete(chunk.decorations)
-				}
-				is_valid = load_ok
-			} else if strings.has_suffix(file_info.path, ".dat") {
-				chunk, load_ok := load_visual_chunk_binary(file_info.path)
-				if load_ok {
-					delete(chunk.entities)
-					delete(chunk.decorations)
-				}
-				is_valid = load_ok
-			}
+	batch := make([]Validate_Job, len(files))
+	defer delete(batch)
+	for file_info, i in files {
+		batch[i] = {
+			path       = file_info.path,
+			chunk_type = file_info.chunk_type,
 		}
-		if is_valid {
+	}
+
+	pool := jobs.create_pool(config.workers)
+	defer jobs.destroy_pool(pool)
+	jobs.parallel_for(pool, len(batch), 1, &batch, proc(data: rawptr, start, end: int) {
+		for &job in (^[]Validate_Job)(data)^[start:end] {
+			validate_chunk_file(&job)
+		}
+	})
+
+	valid, bytes := 0, 0
+	for job in batch {
+		bytes += job.bytes
+		if job.valid {
 			valid += 1
-			fmt.printf("✓ Valid: %s\n", file_info.path)
 		} else {
-			invalid += 1
-			fmt.printf("✗ Invalid: %s\n", file_info.path)
+			fmt.printf("✗ Invalid: %s\n", job.path)
+		}
+	}
+	seconds := max(time.duration_seconds(time.since(start_time)), 1e-6)
+	fmt.printf(
+		"\nValidation complete: %d valid, %d invalid in %.2fs, %.0f files/s, %.1f MB/s, %d jobs\n",
+		valid,
+		len(batch) - valid,
+		seconds,
+		f64(len(batch)) / seconds,
+		f64(bytes) / (1024 * 1024) / seconds,
+		jobs.worker_count(pool),
+	)
+}
+
+validate_chunk_file :: proc(job: ^Validate_Job) {
+	is_collision := job.chunk_type == "collision"
+	if strings.has_suffix(job.path, ".dat") {
+		magic := COLLISION_CHUNK_MAGIC if is_collision else VISUAL_CHUNK_MAGIC
+		version := u16(COLLISION_CHUNK_VERSION if is_collision else VISUAL_CHUNK_VERSION)
+		valid, has_header, bytes := stream_chunk_checksum(job.path, magic, version)
+		if has_header {
+			job.valid, job.bytes = valid, bytes
+			return
+		}
+	}
+
+	job.bytes = int(max(os.file_size_from_path(job.path), 0))
+	is_json := strings.has_suffix(job.path, ".json")
+	if is_collision {
+		if is_json {
+			_, job.valid = load_collision_chunk_json(job.path)
+		} else {
+			_, job.valid = load_collision_chunk_binary(job.path)
+		}
+		return
+	}
+	chunk: Visual_Chunk
+	if is_json {
+		chunk, job.valid = load_visual_chunk_json(job.path)
+	} else {
+		chunk, job.valid = load_visual_chunk_binary(job.path)
+	}
+	delete(chunk.entities)
+	delete(chunk.decorations)
+}
+
+//Checks the version and payload checksum of a v2 chunk file through a fixed size buffer.
+//has_header is false when the file doesn't start with magic.
+stream_chunk_checksum :: proc(
+	path: string,
+	magic: u32,
+	version: u16,
+) -> (
+	valid: bool,
+	has_header: bool,
+	bytes: int,
+) {
+	f, open_err := os.open(path)
+	if open_err != os.ERROR_NONE {
+		fmt.printf("Could not read chunk file: %s\n", path)
+		return false, true, 0
+	}
+	defer os.close(f)
+	header: Chunk_File_Header
+	if read_up_to(f, mem.ptr_to_bytes(&header)) < size_of(header) || header.magic != magic {
+		return
+	}
+	has_header = true
+	bytes = size_of(header)
+	if header.version != version {
+		fmt.printf("Unknown chunk version %d in %s, expected %d\n", header.version, path, version)
+		return
+	}
+
+	block: [VALIDATE_BLOCK_SIZE]u8
+	checksum: u32
+	for remaining := int(header.payload_size); remaining > 0; {
+		n := read_up_to(f, block[:min(remaining, len(block))])
+		if n == 0 {
+			fmt.printf("Chunk file is truncated: %s\n", path)
+			return
+		}
+		checksum = hash.crc32(block[:n], checksum)
+		remaining -= n
+		bytes += n
+	}
+	if checksum != header.checksum {
+		fmt.printf("Chunk checksum mismatch in file: %s\n", path)
+		return
+	}
+	valid = true
+	return
+}
+
+//Reads until buf is full or the file ends
+read_up_to :: proc(f: os.Handle, buf: []byte) -> int {
+	n := 0
+	for n < len(buf) {
+		read, err := os.read(f, buf[n:])
+		if err != os.ERROR_NONE || read <= 0 {
+			break
+		}
+		n += read
+	}
+	return n
+}
+
+//Packs every binary chunk under config.input_path into one region file at config.output_path.
+//The coordinates in the index come from each chunk's header (or first 8 bytes for version 1
+//chunks), which is what the game checks when loading.
+pack_region :: proc(config: Config) {
+	if config.input_path == "" || config.output_path == "" {
+		fmt.println("Error: Input directory and output file are required")
+		return
+	}
+	files := find_chunk_files(config.input_path, true)
+	defer delete(files)
+
+	chunks := make([dynamic]Region_Chunk)
+	defer {
+		for chunk in chunks {
+			delete(chunk.data)
+		}
+		delete(chunks)
+	}
+	failed := 0
+	for file_info in files {
+		if !strings.has_suffix(file_info.path, ".dat") {continue}
+		data, read_ok := os.read_entire_file(file_info.path)
+		if !read_ok {
+			fmt.printf("Failed: could not read %s\n", file_info.path)
+			failed += 1
+			continue
+		}
+		if len(data) < 8 {
+			fmt.printf("Failed: %s is too small to be a chunk\n", file_info.path)
+			delete(data)
+			failed += 1
+			continue
+		}
+		kind := Region_Chunk_Kind.collision if file_info.chunk_type == "collision" else .visual
+		entry := Region_Entry {
+			x    = (cast(^i32)&data[0])^,
+			y    = (cast(^i32)&data[4])^,
+			kind = u32(kind),
+			size = u32(len(data)),
+		}
+		if chunk_file_has_header(data, COLLISION_CHUNK_MAGIC) ||
+		   chunk_file_has_header(data, VISUAL_CHUNK_MAGIC) {
+			header := (cast(^Chunk_File_Header)&data[0])^
+			entry.x = header.chunk_x
+			entry.y = header.chunk_y
+		}
+		append(&chunks, Region_Chunk{entry = entry, data = data})
+	}
+
+	// Sort the index so the game can binary search it
+	slice.sort_by(chunks[:], proc(a, b: Region_Chunk) -> bool {
+		return region_entry_less(a.entry, b.entry)
+	})
+	for i in 1 ..< len(chunks) {
+		a := chunks[i - 1].entry
+		b := chunks[i].entry
+		if a.kind == b.kind && a.x == b.x && a.y == b.y {
+			fmt.printf("Error: chunk (%d, %d) is in the input twice, not packing\n", a.x, a.y)
+			return
+		}
+	}
+
+	// Lay out the data after the index
+	index_size := size_of(Region_Header) + len(chunks) * size_of(Region_Entry)
+	offset := mem.align_forward_int(index_size, REGION_DATA_ALIGN)
+	for &chunk in chunks {
+		chunk.entry.offset = u32(offset)
+		offset = mem.align_forward_int(offset + len(chunk.data), REGION_DATA_ALIGN)
+	}
+
+	out := make([]byte, offset)
+	defer delete(out)
+	header := Region_Header {
+		magic   = REGION_FILE_MAGIC,
+		version = REGION_FILE_VERSION,
+		count   = u32(len(chunks)),
+	}
+	(cast(^Region_Header)&out[0])^ = header
+	entries := ([^]Region_Entry)(&out[size_of(Region_Header)])[:len(chunks)]
+	for chunk, i in chunks {
+		entries[i] = chunk.entry
+		copy(out[chunk.entry.offset:], chunk.data)
+	}
+
+	if !os.write_entire_file(config.output_path, out) {
+		fmt.printf("Failed to write region file: %s\n", config.output_path)
+		return
+	}
+	fmt.printf(
+		"Packed %d chunks into %s (%d bytes), %d failed\n",
+		len(chunks),
+		config.output_path,
+		len(out),
+		failed,
+	)
+}
+
+//Writes every chunk in the region file at config.input_path back out as
+//<output>/collision/chunk_X_Y.dat and <output>/visual/chunk_X_Y.dat
+unpack_region :: proc(config: Config) {
+	if config.input_path == "" || config.output_path == "" {
+		fmt.println("Error: Input file and output directory are required")
+		return
+	}
+	data, read_ok := os.read_entire_file(config.input_path)
+	if !read_ok {
+		fmt.printf("Could not read region file: %s\n", config.input_path)
+		return
+	}
+	defer delete(data)
+	if len(data) < size_of(Region_Header) {
+		fmt.printf("Region file too small: %s\n", config.input_path)
+		return
+	}
+	header := (cast(^Region_Header)&data[0])^
+	if header.magic != REGION_FILE_MAGIC || header.version != REGION_FILE_VERSION {
+		fmt.printf("Not a region file, or wrong version: %s\n", config.input_path)
+		return
+	}
+	index_end := size_of(Region_Header) + int(header.count) * size_of(Region_Entry)
+	if index_end > len(data) {
+		fmt.printf("Region file index is truncated: %s\n", config.input_path)
+		return
+	}
+	entries := ([^]Region_Entry)(&data[size_of(Region_Header)])[:header.count]
+
+	for dir in region_kind_dirs {
+		dir_path := filepath.join({config.output_path, dir})
+		defer delete(dir_path)
+		if !os.exists(dir_path) {
+			fmt.printf("Creating dir: %s\n", dir_path)
+			os.make_directory(dir_path, 0o755)
+		}
+	}
+
+	written := 0
+	failed := 0
+	for entry in entries {
+		if entry.kind > u32(max(Region_Chunk_Kind)) ||
+		   int(entry.offset) < index_end ||
+		   int(entry.offset) + int(entry.size) > len(data) {
+			fmt.printf("Failed: entry (%d, %d) is out of bounds\n", entry.x, entry.y)
+			failed += 1
+			continue
+		}
+		name := fmt.aprintf("chunk_%d_%d.dat", entry.x, entry.y)
+		defer delete(name)
+		output_path := filepath.join(
+			{config.output_path, region_kind_dirs[Region_Chunk_Kind(entry.kind)], name},
+		)
+		defer delete(output_path)
+		if os.write_entire_file(output_path, data[entry.offset:][:entry.size]) {
+			written += 1
+		} else {
+			fmt.printf("Failed to write %s\n", output_path)
+			failed += 1
 		}
 	}
+	fmt.printf("Unpacked %d chunks to %s, %d failed\n", written, config.output_path, failed)
+}
 
-	fmt.printf("\nValidation complete: %d valid, %d invalid\n", valid, invalid)
+region_entry_less :: proc(a, b: Region_Entry) -> bool {
+	if a.kind != b.kind {
+		return a.kind < b.kind
+	}
+	if a.y != b.y {
+		return a.y < b.y
+	}
+	return a.x < b.x
 }
 
 find_chunk_files :: proc(root_path: string, recursive: bool) -> [dynamic]FileInfo {
@@ -536,21 +993,34 @@ load_collision_chunk_binary :: proc(filepath: string) -> (Collision_Chunk, bool)
 		//return generate_default_collision_chunk(coord)
 	}
 	defer delete(data)
-	// Read header
-	reader := bytes.Reader {
-		s = data,
-	}
-	offset := 0
-	chunk_x := (cast(^i32)&data[offset])^;offset += 4
-	chunk_y := (cast(^i32)&data[offset])^;offset += 4
-	tile_data_start := 8
-	for y in 0 ..< CHUNK_SIZE {
-		for x in 0 ..< CHUNK_SIZE {
-			idx := tile_data_start + y * CHUNK_SIZE + x
-			chunk.tiles[y][x] = cast(Tile_Type)data[idx]
+
+	if chunk_file_has_header(data, COLLISION_CHUNK_MAGIC) {
+		header, payload, ok := read_chunk_file_header(data, COLLISION_CHUNK_VERSION, filepath)
+		if !ok {
+			return chunk, false
 		}
+		chunk.coord_x = header.chunk_x
+		chunk.coord_y = header.chunk_y
+		_, layer_ok := read_chunk_layer(
+			payload,
+			mem.ptr_to_bytes(&chunk.tiles),
+			size_of(Tile_Type),
+			.layer_rle in header.flags,
+		)
+		if !layer_ok {
+			fmt.printf("Broken tile layer in collision chunk: %s\n", filepath)
+			return chunk, false
+		}
+	} else {
+		// Version 1: [4 bytes: chunk_x] [4 bytes: chunk_y] [1024 bytes: tile data]
+		if len(data) < 8 + size_of(chunk.tiles) {
+			fmt.printf("Invalid collision chunk file size: %s\n", filepath)
+			return chunk, false
+		}
+		chunk.coord_x = (cast(^i32)&data[0])^
+		chunk.coord_y = (cast(^i32)&data[4])^
+		copy(mem.ptr_to_bytes(&chunk.tiles), data[8:])
 	}
-	fmt.printf("Loaded collision chunk (%d, %d) from binary file\n", chunk.coord_x, chunk.coord_y)
 	return chunk, true
 }
 
@@ -569,7 +1039,6 @@ load_collision_chunk_json :: proc(filepath: string) -> (Collision_Chunk, bool) {
 		fmt.printf("Failed to parse collision chunk JSON: %s, error: %v\n", filepath, parse_error)
 		return chunk, false
 	}
-	fmt.printf("Successfully parsed json_collision_chunk: %v\n", filepath)
 	chunk.coord_x = json_chunk.coord_x
 	chunk.coord_y = json_chunk.coord_y
 	// Convert data
@@ -615,39 +1084,35 @@ save_collision_chunk_json :: proc(filepath: string, chunk: Collision_Chunk) -> b
 		fmt.printf("Failed to save collision chunk JSON: %s\n", filepath)
 		return false
 	}
-
-	fmt.printf("Saved collision chunk (%d, %d) to JSON file\n", chunk.coord_x, chunk.coord_y)
 	return true
 }
 
 save_collision_chunk_binary :: proc(filepath: string, chunk: Collision_Chunk) -> bool {
-	// Implementation similar to your main code
-	// Calculate file size
-	file_size := 8 + CHUNK_SIZE * CHUNK_SIZE
-	data := make([]u8, file_size)
+	data := make([dynamic]u8)
 	defer delete(data)
-
-	// Write header
-	(cast(^i32)&data[0])^ = chunk.coord_x
-	(cast(^i32)&data[4])^ = chunk.coord_y
+	begin_chunk_file(&data)
 
 	// Write tile data
-	offset := 8
-	for y in 0 ..< CHUNK_SIZE {
-		for x in 0 ..< CHUNK_SIZE {
-			data[offset] = cast(u8)chunk.tiles[y][x]
-			offset += 1
-		}
+	flags: Chunk_File_Flags
+	tiles := chunk.tiles
+	if append_chunk_layer(&data, mem.ptr_to_bytes(&tiles), size_of(Tile_Type)) {
+		flags += {.layer_rle}
 	}
+	finish_chunk_file(
+		data[:],
+		COLLISION_CHUNK_MAGIC,
+		COLLISION_CHUNK_VERSION,
+		chunk.coord_x,
+		chunk.coord_y,
+		flags,
+	)
 
 	// Write to file
-	write_ok := os.write_entire_file(filepath, data)
+	write_ok := os.write_entire_file(filepath, data[:])
 	if !write_ok {
 		fmt.printf("Failed to save collision chunk: %v\n", filepath)
 		return false
 	}
-
-	fmt.printf("Saved collision chunk (%d, %d) to binary file\n", chunk.coord_x, chunk.coord_y)
 	return true
 }
 
@@ -677,8 +1142,6 @@ load_visual_chunk_json :: proc(filepath: string) -> (Visual_Chunk, bool) {
 		fmt.printf("Failed to parse collision chunk JSON: %s, error: %v\n", filepath, parse_error)
 		return chunk, false
 	}
-	fmt.printf("Successfully parsed json_visual_chunk: %v\n", filepath)
-
 	//check that our filename coord matches the loaded coords
 	json_filename_coord := get_coord_from_filepath(filepath)
 
@@ -753,18 +1216,23 @@ load_visual_chunk_binary :: proc(filepath: string) -> (Visual_Chunk, bool) {
 	data, read_ok := os.read_entire_file(filepath)
 	if !read_ok {
 		fmt.printf("Could not read visual chunk file: %s\n", filepath)
-		//return generate_default_visual_chunk(coord)
+		return chunk, false
 	}
 	defer delete(data)
 
-	if len(data) < 8 + CHUNK_SIZE * CHUNK_SIZE * 4 {
+	if chunk_file_has_header(data, VISUAL_CHUNK_MAGIC) {
+		return chunk, load_visual_chunk_v2(filepath, data, &chunk)
+	}
+
+	// Version 1: [4 bytes: chunk_x] [4 bytes: chunk_y] [4096 bytes: sprite data, u32 each]
+	// [4 bytes: entity_count] [entity_data...] [4 bytes: decoration_count] [decoration_data...]
+	if len(data) < 8 + CHUNK_SIZE * CHUNK_SIZE * 4 + 8 {
 		fmt.printf("Invalid visual chunk file size: %s\n", filepath)
-		//return generate_default_visual_chunk(coord)
+		return chunk, false
 	}
 
 	// Read header
 	offset := 0
-	//version := (cast(^i32)&data[offset])^;offset += 4
 	chunk_x := (cast(^i32)&data[offset])^;offset += 4
 	chunk_y := (cast(^i32)&data[offset])^;offset += 4
 
@@ -788,20 +1256,26 @@ load_visual_chunk_binary :: proc(filepath: string) -> (Visual_Chunk, bool) {
 	}
 
 	// Read entities
-	entity_count := (cast(^i32)&data[offset])^;offset += 4
-	fmt.printf("Load_Visual_Chunk_Binary\n")
-	for i in 0 ..< entity_count {
+	entity_count := int((cast(^i32)&data[offset])^);offset += 4
+	if entity_count < 0 || offset + entity_count * 12 + 4 > len(data) {
+		fmt.printf("Visual chunk is truncated: %s\n", filepath)
+		return chunk, false
+	}
+	for _ in 0 ..< entity_count {
 		entity := Entity{}
 		entity.kind = cast(EntityKind)(cast(^u32)&data[offset])^;offset += 4
-		fmt.printf("EntityKind: %v\n", entity.kind)
 		entity.pos.x = (cast(^f32)&data[offset])^;offset += 4
 		entity.pos.y = (cast(^f32)&data[offset])^;offset += 4
 		append(&chunk.entities, entity)
 	}
 
 	// Read decorations
-	decoration_count := (cast(^i32)&data[offset])^;offset += 4
-	for i in 0 ..< decoration_count {
+	decoration_count := int((cast(^i32)&data[offset])^);offset += 4
+	if decoration_count < 0 || offset + decoration_count * 16 > len(data) {
+		fmt.printf("Visual chunk is truncated: %s\n", filepath)
+		return chunk, false
+	}
+	for _ in 0 ..< decoration_count {
 		decoration := Decoration{}
 		decoration.pos.x = (cast(^f32)&data[offset])^;offset += 4
 		decoration.pos.y = (cast(^f32)&data[offset])^;offset += 4
@@ -809,7 +1283,62 @@ load_visual_chunk_binary :: proc(filepath: string) -> (Visual_Chunk, bool) {
 		decoration.layer = (cast(^i32)&data[offset])^;offset += 4
 		append(&chunk.decorations, decoration)
 	}
-	return chunk, true // Placeholder
+	return chunk, true
+}
+
+load_visual_chunk_v2 :: proc(filepath: string, data: []byte, chunk: ^Visual_Chunk) -> bool {
+	header, payload, ok := read_chunk_file_header(data, VISUAL_CHUNK_VERSION, filepath)
+	if !ok {
+		return false
+	}
+	chunk.coord_x = header.chunk_x
+	chunk.coord_y = header.chunk_y
+
+	// Sprite layer goes straight into the sprite array
+	offset, layer_ok := read_chunk_layer(
+		payload,
+		mem.ptr_to_bytes(&chunk.sprites),
+		size_of(Sprite_ID),
+		.layer_rle in header.flags,
+	)
+	if !layer_ok {
+		fmt.printf("Broken sprite layer in visual chunk: %s\n", filepath)
+		return false
+	}
+
+	// Read entities
+	if offset + 4 > len(payload) {
+		fmt.printf("Visual chunk is truncated: %s\n", filepath)
+		return false
+	}
+	entity_count := int((cast(^i32)&payload[offset])^);offset += 4
+	if entity_count < 0 || offset + entity_count * 12 + 4 > len(payload) {
+		fmt.printf("Visual chunk is truncated: %s\n", filepath)
+		return false
+	}
+	for _ in 0 ..< entity_count {
+		entity := Entity{}
+		entity.kind = cast(EntityKind)(cast(^i32)&payload[offset])^;offset += 4
+		entity.pos.x = (cast(^f32)&payload[offset])^;offset += 4
+		entity.pos.y = (cast(^f32)&payload[offset])^;offset += 4
+		append(&chunk.entities, entity)
+	}
+
+	// Read decorations
+	decoration_count := int((cast(^i32)&payload[offset])^);offset += 4
+	if decoration_count < 0 || offset + decoration_count * 16 > len(payload) {
+		fmt.printf("Visual chunk is truncated: %s\n", filepath)
+		return false
+	}
+	for _ in 0 ..< decoration_count {
+		decoration := Decoration{}
+		decoration.pos.x = (cast(^f32)&payload[offset])^;offset += 4
+		decoration.pos.y = (cast(^f32)&payload[offset])^;offset += 4
+		decoration.sprite = cast(Sprite_ID)(cast(^u32)&payload[offset])^;offset += 4
+		decoration.layer = (cast(^i32)&payload[offset])^;offset += 4
+		append(&chunk.decorations, decoration)
+	}
+	return true
 }
 
 //DONE
@@ -864,60 +1393,177 @@ save_visual_chunk_json :: proc(filepath: string, chunk: Visual_Chunk) -> bool {
 	write_ok := os.write_entire_file(filepath, json_data)
 	if !write_ok {
 		fmt.printf("Failed to save visual chunk JSON: %s\n", filepath)
-	} else {
-		fmt.printf("Saved visual chunk (%d, %d) to JSON\n", chunk.coord_x, chunk.coord_y)
+		return false
 	}
-
-	return true // Placeholder
+	return true
 }
 
 save_visual_chunk_binary :: proc(filepath: string, chunk: Visual_Chunk) -> bool {
-	// Calculate file size
-	base_size := 8 + CHUNK_SIZE * CHUNK_SIZE * 4 + 8 // header + sprites + counts
-	entity_size := len(chunk.entities) * (2 * 4 + 4) // 2 floats + 1 u32 per entity
-	decoration_size := len(chunk.decorations) * (2 * 4 + 4 + 4) // 2 floats + 2 i32s per decoration
-
-	file_size := base_size + entity_size + decoration_size
-	data := make([]u8, file_size)
+	data := make([dynamic]u8)
 	defer delete(data)
-
-	offset := 0
-	// Write header
-	(cast(^i32)&data[offset])^ = chunk.coord_x;offset += 4
-	(cast(^i32)&data[offset])^ = chunk.coord_y;offset += 4
+	begin_chunk_file(&data)
 
 	// Write sprite data
-	for y in 0 ..< CHUNK_SIZE {
-		for x in 0 ..< CHUNK_SIZE {
-			(cast(^u32)&data[offset])^ = cast(u32)chunk.sprites[y][x]
-			offset += 4
-		}
+	flags: Chunk_File_Flags
+	sprites := chunk.sprites
+	if append_chunk_layer(&data, mem.ptr_to_bytes(&sprites), size_of(Sprite_ID)) {
+		flags += {.layer_rle}
 	}
-	length := i32(len(chunk.entities))
-	fmt.printf("Num entities in visual chunk: %i\n", length)
+
 	// Write entities
-	(cast(^i32)&data[offset])^ = length;offset += 4
+	length := i32(len(chunk.entities))
+	append_chunk_value(&data, length)
 	for entity in chunk.entities {
-		(cast(^u32)&data[offset])^ = cast(u32)entity.kind;offset += 4
-		(cast(^f32)&data[offset])^ = entity.pos.x;offset += 4
-		(cast(^f32)&data[offset])^ = entity.pos.y;offset += 4
+		append_chunk_value(&data, i32(entity.kind))
+		append_chunk_value(&data, entity.pos.x)
+		append_chunk_value(&data, entity.pos.y)
 	}
 
 	// Write decorations
-	(cast(^i32)&data[offset])^ = i32(len(chunk.decorations));offset += 4
+	append_chunk_value(&data, i32(len(chunk.decorations)))
 	for decoration in chunk.decorations {
-		(cast(^f32)&data[offset])^ = decoration.pos.x;offset += 4
-		(cast(^f32)&data[offset])^ = decoration.pos.y;offset += 4
-		(cast(^u32)&data[offset])^ = cast(u32)decoration.sprite;offset += 4
-		(cast(^i32)&data[offset])^ = decoration.layer;offset += 4
+		append_chunk_value(&data, decoration.pos.x)
+		append_chunk_value(&data, decoration.pos.y)
+		append_chunk_value(&data, u32(decoration.sprite))
+		append_chunk_value(&data, decoration.layer)
 	}
+	finish_chunk_file(
+		data[:],
+		VISUAL_CHUNK_MAGIC,
+		VISUAL_CHUNK_VERSION,
+		chunk.coord_x,
+		chunk.coord_y,
+		flags,
+	)
 
 	// Write to file
-	write_ok := os.write_entire_file(filepath, data)
+	write_ok := os.write_entire_file(filepath, data[:])
 	if !write_ok {
 		fmt.printf("Failed to save visual chunk: %s\n", filepath)
-	} else {
-		fmt.printf("Saved visual chunk (%d, %d) to binary file\n", chunk.coord_x, chunk.coord_y)
+		return false
 	}
 	return true
 }
+
+chunk_file_has_header :: proc(data: []byte, magic: u32) -> bool {
+	return len(data) >= size_of(Chunk_File_Header) && (cast(^u32)&data[0])^ == magic
+}
+
+//Checks the version and the payload checksum. Returns the payload.
+read_chunk_file_header :: proc(
+	data: []byte,
+	version: u16,
+	filepath: string,
+) -> (
+	header: Chunk_File_Header,
+	payload: []byte,
+	ok: bool,
+) {
+	header = (cast(^Chunk_File_Header)&data[0])^
+	if header.version != version {
+		fmt.printf("Unknown chunk version %d in %s, expected %d\n", header.version, filepath, version)
+		return
+	}
+	if int(header.payload_size) > len(data) - size_of(Chunk_File_Header) {
+		fmt.printf("Chunk file is truncated: %s\n", filepath)
+		return
+	}
+	payload = data[size_of(Chunk_File_Header):][:header.payload_size]
+	if hash.crc32(payload) != header.checksum {
+		fmt.printf("Chunk checksum mismatch in file: %s\n", filepath)
+		return
+	}
+	return header, payload, true
+}
+
+//Reads one layer from the front of src into dst. Returns how many bytes of src it took up.
+read_chunk_layer :: proc(src: []byte, dst: []byte, elem_size: int, rle: bool) -> (int, bool) {
+	if !rle {
+		if len(src) < len(dst) {
+			return 0, false
+		}
+		copy(dst, src[:len(dst)])
+		return len(dst), true
+	}
+
+	if len(src) < 4 {
+		return 0, false
+	}
+	encoded_size := int((cast(^u32)&src[0])^)
+	if encoded_size > len(src) - 4 {
+		return 0, false
+	}
+	runs := src[4:][:encoded_size]
+	out := 0
+	for i := 0; i < len(runs); i += 1 + elem_size {
+		if i + 1 + elem_size > len(runs) {
+			return 0, false
+		}
+		count := int(runs[i])
+		if count == 0 || out + count * elem_size > len(dst) {
+			return 0, false
+		}
+		value := runs[i + 1:][:elem_size]
+		for _ in 0 ..< count {
+			copy(dst[out:], value)
+			out += elem_size
+		}
+	}
+	return 4 + encoded_size, out == len(dst)
+}
+
+begin_chunk_file :: proc(buf: ^[dynamic]byte) {
+	clear(buf)
+	resize(buf, size_of(Chunk_File_Header))
+}
+
+//Appends a layer, run-length encoded if that comes out smaller. Returns true if it was encoded.
+append_chunk_layer :: proc(buf: ^[dynamic]byte, layer: []byte, elem_size: int) -> bool {
+	start := len(buf^)
+	resize(buf, start + 4)
+	for i := 0; i < len(layer); {
+		value := layer[i:][:elem_size]
+		count := 1
+		for count < 255 &&
+		    i + (count + 1) * elem_size <= len(layer) &&
+		    string(layer[i + count * elem_size:][:elem_size]) == string(value) {
+			count += 1
+		}
+		append(buf, u8(count))
+		append(buf, ..value)
+		i += count * elem_size
+	}
+
+	encoded_size := len(buf^) - start - 4
+	if encoded_size < len(layer) {
+		(cast(^u32)&buf[start])^ = u32(encoded_size)
+		return true
+	}
+	resize(buf, start)
+	append(buf, ..layer)
+	return false
+}
+
+append_chunk_value :: proc(buf: ^[dynamic]byte, v: $T) {
+	v := v
+	append(buf, ..mem.ptr_to_bytes(&v))
+}
+
+finish_chunk_file :: proc(
+	buf: []byte,
+	magic: u32,
+	version: u16,
+	chunk_x, chunk_y: i32,
+	flags: Chunk_File_Flags,
+) {
+	payload := buf[size_of(Chunk_File_Header):]
+	(cast(^Chunk_File_Header)&buf[0])^ = Chunk_File_Header {
+		magic        = magic,
+		version      = version,
+		flags        = flags,
+		chunk_x      = chunk_x,
+		chunk_y      = chunk_y,
+		payload_size = u32(len(payload)),
+		checksum     = hash.crc32(payload),
+	}
+}
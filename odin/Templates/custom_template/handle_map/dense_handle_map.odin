@@ -0,0 +1,242 @@
+/* Sparse set flavour of Handle_Map.
+
+`items` only ever contains live items, packed at the front with no holes. A
+handle doesn't point into `items` directly. Instead `handle.idx` indexes the
+`slots` array, which stores where in `items` that item currently lives and the
+generation of the slot.
+
+Removing an item moves the last item into its place ("swap and pop"), so
+removal is O(1) and iterating never has to skip anything, no matter how much
+spawning and despawning has happened. Handles stay valid the whole time, only
+the position in `items` changes.
+
+The price: pointers returned by `get` (or the iterator) are only valid until
+the next `remove`. Adding never moves items, `items` grows in-place inside a
+static virtual arena, same as Handle_Map. If you need pointers that never move,
+use Handle_Map instead.
+
+Removing items while iterating: the item that fills the hole has not been
+visited yet and would be skipped. Collect the handles and remove them after the
+loop, or loop backwards over `items`.
+
+Example (assumes this package is imported under the alias `hm`):
+
+	entities := hm.make_dense(Entity, Entity_Handle, 10000)
+	h := hm.add(&entities, Entity { pos = { 5, 7 } })
+
+	for &e in entities.items {
+		e.pos += { 5, 1 }
+	}
+
+	hm.remove(&entities, h)
+	hm.delete(&entities)
+*/
+package handle_map_virtual
+
+import "base:builtin"
+import "base:runtime"
+import vmem "core:mem/virtual"
+
+Dense_Handle_Map :: struct($T: typeid, $HT: typeid, $Max: int) {
+	// Live items only. Each item must have a field `handle` of type `HT`, so
+	// you can get from an item back to its slot.
+	items:        [dynamic]T,
+
+	// Stores `items`, so adding doesn't move existing items.
+	items_arena:  ^vmem.Arena,
+
+	// Indexed by `handle.idx`. Slot 0 is a dummy, so `idx == 0` still means
+	// "no Handle".
+	slots:        [dynamic]Dense_Slot,
+
+	// Slots not in use, reused by `add`.
+	unused_slots: [dynamic]u32,
+}
+
+Dense_Slot :: struct {
+	// Index into `items`. Only meaningful while the slot is in use.
+	dense: u32,
+
+	// Bumped when the item is removed, so old handles stop matching.
+	gen:   u32,
+}
+
+// Like `make`, but for a Dense_Handle_Map. You can also just declare it, `add`
+// calls this the first time if needed.
+make_dense :: proc(
+	$T: typeid,
+	$HT: typeid,
+	$Max: int,
+	allocator := context.allocator,
+	loc := #caller_location,
+) -> (
+	Dense_Handle_Map(T, HT, Max),
+	vmem.Allocator_Error,
+) #optional_allocator_error {
+	arena_bootstrap: vmem.Arena
+	err := vmem.arena_init_static(&arena_bootstrap, uint(Max * size_of(T) + size_of(vmem.Arena)))
+
+	if err != nil {
+		return {}, err
+	}
+
+	// See `make` for why the arena is stored inside itself.
+	arena := new(vmem.Arena, vmem.arena_allocator(&arena_bootstrap), loc)
+	arena^ = arena_bootstrap
+
+	return {
+			items = runtime.make([dynamic]T, vmem.arena_allocator(arena), loc),
+			items_arena = arena,
+			slots = runtime.make([dynamic]Dense_Slot, allocator, loc),
+			unused_slots = runtime.make([dynamic]u32, allocator, loc),
+		},
+		nil
+}
+
+delete_dense :: proc(m: ^Dense_Handle_Map($T, $HT, $Max), loc := #caller_location) {
+	if m.items_arena != nil {
+		arena := m.items_arena^
+		vmem.arena_destroy(&arena)
+	}
+
+	runtime.delete(m.slots, loc)
+	runtime.delete(m.unused_slots, loc)
+}
+
+clear_dense :: proc(m: ^Dense_Handle_Map($T, $HT, $Max), loc := #caller_location) {
+	runtime.clear(&m.items)
+	runtime.clear(&m.slots)
+	runtime.clear(&m.unused_slots)
+}
+
+// The new item is appended to the end of `items`. Existing items don't move.
+add_dense :: proc(
+	m: ^Dense_Handle_Map($T, $HT, $Max),
+	v: T,
+	loc := #caller_location,
+) -> (
+	res: HT,
+	err: vmem.Allocator_Error,
+) #optional_allocator_error {
+	if m.items_arena == nil {
+		m^ = make_dense(T, HT, Max, loc = loc) or_return
+	}
+
+	if builtin.len(m.slots) == 0 {
+		append(&m.slots, Dense_Slot{}) or_return
+	}
+
+	slot_idx: u32
+
+	if builtin.len(m.unused_slots) > 0 {
+		slot_idx = pop(&m.unused_slots)
+	} else {
+		slot_idx = u32(builtin.len(m.slots))
+		append(&m.slots, Dense_Slot{gen = 1}) or_return
+	}
+
+	new_item := v
+	new_item.handle.idx = slot_idx
+	new_item.handle.gen = m.slots[slot_idx].gen
+	_, append_err := append(&m.items, new_item)
+
+	if append_err == .Out_Of_Memory {
+		// Same as `add`: try again with the exact amount that fits the arena.
+		reserve(&m.items, cap(m^))
+		_, append_err = append(&m.items, new_item)
+	}
+
+	if append_err != nil {
+		append(&m.unused_slots, slot_idx)
+		return {}, append_err
+	}
+
+	m.slots[slot_idx].dense = u32(builtin.len(m.items) - 1)
+	return new_item.handle, nil
+}
+
+// Resolve a handle to a pointer. The pointer is invalidated by the next
+// `remove` on this map, since that may move another item into its place.
+get_dense :: proc(m: Dense_Handle_Map($T, $HT, $Max), h: HT) -> ^T {
+	if h.idx <= 0 || h.idx >= u32(builtin.len(m.slots)) {
+		return nil
+	}
+
+	if slot := m.slots[h.idx]; slot.gen == h.gen {
+		return &m.items[slot.dense]
+	}
+
+	return nil
+}
+
+// Removes the item by moving the last item into its place. The moved item
+// keeps its handle, its slot is just pointed at the new position.
+remove_dense :: proc(m: ^Dense_Handle_Map($T, $HT, $Max), h: HT) {
+	if h.idx <= 0 || h.idx >= u32(builtin.len(m.slots)) {
+		return
+	}
+
+	slot := &m.slots[h.idx]
+
+	if slot.gen != h.gen {
+		return
+	}
+
+	last := u32(builtin.len(m.items) - 1)
+
+	if slot.dense != last {
+		m.items[slot.dense] = m.items[last]
+		m.slots[m.items[slot.dense].handle.idx].dense = slot.dense
+	}
+
+	pop(&m.items)
+	slot.gen += 1
+	append(&m.unused_slots, h.idx)
+}
+
+valid_dense :: proc(m: Dense_Handle_Map($T, $HT, $Max), h: HT) -> bool {
+	return get_dense(m, h) != nil
+}
+
+// Number of live items, which is also `len(m.items)`.
+len_dense :: proc(m: Dense_Handle_Map($T, $HT, $Max)) -> int {
+	return builtin.len(m.items)
+}
+
+// See `cap`.
+cap_dense :: proc(m: Dense_Handle_Map($T, $HT, $Max)) -> int {
+	if m.items_arena == nil {
+		return 0
+	}
+
+	return int((m.items_arena.total_reserved - size_of(vmem.Arena)) / size_of(T))
+}
+
+Dense_Handle_Map_Iterator :: struct($T: typeid, $HT: typeid, $Max: int) {
+	m:     ^Dense_Handle_Map(T, HT, Max),
+	index: int,
+}
+
+make_iter_dense :: proc(
+	m: ^Dense_Handle_Map($T, $HT, $Max),
+) -> Dense_Handle_Map_Iterator(T, HT, Max) {
+	return {m = m}
+}
+
+// Same usage as `iter`, but there is nothing to skip. Looping over `m.items`
+// directly does the same thing.
+iter_dense :: proc(
+	it: ^Dense_Handle_Map_Iterator($T, $HT, $Max),
+) -> (
+	val: ^T,
+	h: HT,
+	cond: bool,
+) {
+	if it.index < builtin.len(it.m.items) {
+		item := &it.m.items[it.index]
+		it.index += 1
+		return item, item.handle, true
+	}
+
+	return nil, {}, false
+}
@@ -18,6 +18,12 @@ Odin's virtual arena lets the dynamic array grow in-place as long as no other
 allocation into the arena has happened in-between, which is always the case here.
 So no pointers will ever move!
 
+There is also `Dense_Handle_Map` (see dense_handle_map.odin), a sparse set: the
+items are kept packed with no holes and handles go through an index table.
+Iterating it only touches live items, at the cost of pointers moving when an
+item is removed. Both kinds of map work with the procs below (`add`, `get`,
+`remove`, `iter` and so on), only creating them differs: `make` vs `make_dense`.
+
 Example (assumes this package is imported under the alias `hm`):
 
 	Entity_Handle :: hm.Handle
@@ -100,6 +106,48 @@ Handle_Map :: struct($T: typeid, $HT: typeid, $Max: int) {
 	unused_items: [dynamic]u32,
 }
 
+// These work on both Handle_Map and Dense_Handle_Map.
+delete :: proc {
+	delete_virtual,
+	delete_dense,
+}
+clear :: proc {
+	clear_virtual,
+	clear_dense,
+}
+add :: proc {
+	add_virtual,
+	add_dense,
+}
+get :: proc {
+	get_virtual,
+	get_dense,
+}
+remove :: proc {
+	remove_virtual,
+	remove_dense,
+}
+valid :: proc {
+	valid_virtual,
+	valid_dense,
+}
+len :: proc {
+	len_virtual,
+	len_dense,
+}
+cap :: proc {
+	cap_virtual,
+	cap_dense,
+}
+make_iter :: proc {
+	make_iter_virtual,
+	make_iter_dense,
+}
+iter :: proc {
+	iter_virtual,
+	iter_dense,
+}
+
 // Usually you can just declare the Handle_Map using
 // `hm: Handle_Map(Item_Type, Handle_Type, 10000)`, but if you want to override
 // the allocator used for `unused_items`, then you can instead do:
@@ -135,7 +183,7 @@ make :: proc(
 }
 
 // Deallocate all memory associated with the Handle_Map.
-delete :: proc(m: ^Handle_Map($T, $HT, $Max), loc := #caller_location) {
+delete_virtual :: proc(m: ^Handle_Map($T, $HT, $Max), loc := #caller_location) {
 	// We copy out the arena here since the arena itself is allocated into the
 	// arena. Destroying it directly would crash since the arena struct is lost
 	// while it still has cleanup to do.
@@ -153,7 +201,7 @@ delete :: proc(m: ^Handle_Map($T, $HT, $Max), loc := #caller_location) {
 }
 
 // Empties the handle map without deallocating any memory.
-clear :: proc(m: ^Handle_Map($T, $HT, $Max), loc := #caller_location) {
+clear_virtual :: proc(m: ^Handle_Map($T, $HT, $Max), loc := #caller_location) {
 	runtime.clear(&m.items)
 	runtime.clear(&m.unused_items)
 }
@@ -166,7 +214,7 @@ clear :: proc(m: ^Handle_Map($T, $HT, $Max), loc := #caller_location) {
 // to reallocate the dynamic array `items` in-place: No pointers will move.
 //
 // Will reuse slots from `unused_items` array if there are any.
-add :: proc(
+add_virtual :: proc(
 	m: ^Handle_Map($T, $HT, $Max),
 	v: T,
 	loc := #caller_location,
@@ -220,7 +268,7 @@ add :: proc(
 // permanently. The item may get reused if any part of your program destroys and
 // reuses that slot. Only store handles permanently and temporarily resolve them
 // into pointers as needed.
-get :: proc(m: Handle_Map($T, $HT, $Max), h: HT) -> ^T {
+get_virtual :: proc(m: Handle_Map($T, $HT, $Max), h: HT) -> ^T {
 	if h.idx <= 0 || h.idx >= u32(builtin.len(m.items)) {
 		return nil
 	}
@@ -236,7 +284,7 @@ get :: proc(m: Handle_Map($T, $HT, $Max), h: HT) -> ^T {
 // to this proc. The item is not really destroyed, rather its index is just
 // added to the `unused_items` array. `handle.idx` on the item is set to zero,
 // this is used by the `iter` proc in order to skip that item when iterating.
-remove :: proc(m: ^Handle_Map($T, $HT, $Max), h: HT) {
+remove_virtual :: proc(m: ^Handle_Map($T, $HT, $Max), h: HT) {
 	if h.idx <= 0 || h.idx >= u32(builtin.len(m.items)) {
 		return
 	}
@@ -251,12 +299,12 @@ remove :: proc(m: ^Handle_Map($T, $HT, $Max), h: HT) {
 }
 
 // Tells you if a handle maps to a valid item.
-valid :: proc(m: Handle_Map($T, $HT, $Max), h: HT) -> bool {
+valid_virtual :: proc(m: Handle_Map($T, $HT, $Max), h: HT) -> bool {
 	return get(m, h) != nil
 }
 
 // Tells you how many valid items there are in the handle map.
-len :: proc(m: Handle_Map($T, $HT, $Max)) -> int {
+len_virtual :: proc(m: Handle_Map($T, $HT, $Max)) -> int {
 	return builtin.len(m.items) - builtin.len(m.unused_items)
 }
 
@@ -266,7 +314,7 @@ len :: proc(m: Handle_Map($T, $HT, $Max)) -> int {
 //
 // Note: This does not just return `Max`. That's because the amount of memory
 // may have been rounded upwards to nearest page size.
-cap :: proc(m: Handle_Map($T, $HT, $Max)) -> int {
+cap_virtual :: proc(m: Handle_Map($T, $HT, $Max)) -> int {
 	if m.items_arena == nil {
 		return 0
 	}
@@ -281,7 +329,7 @@ Handle_Map_Iterator :: struct($T: typeid, $HT: typeid, $Max: int) {
 }
 
 // Create an iterator. Use with `iter` to do the actual iteration.
-make_iter :: proc(m: ^Handle_Map($T, $HT, $Max)) -> Handle_Map_Iterator(T, HT, Max) {
+make_iter_virtual :: proc(m: ^Handle_Map($T, $HT, $Max)) -> Handle_Map_Iterator(T, HT, Max) {
 	return {m = m}
 }
 
@@ -294,7 +342,7 @@ make_iter :: proc(m: ^Handle_Map($T, $HT, $Max)) -> Handle_Map_Iterator(T, HT, M
 // 
 // Instead of using an iterator you can also loop over `items` and check if
 // `item.handle.idx == 0` and in that case skip that item.
-iter :: proc(it: ^Handle_Map_Iterator($T, $HT, $Max)) -> (val: ^T, h: HT, cond: bool) {
+iter_virtual :: proc(it: ^Handle_Map_Iterator($T, $HT, $Max)) -> (val: ^T, h: HT, cond: bool) {
 	for _ in it.index ..< builtin.len(it.m.items) {
 		item := &it.m.items[it.index]
 		it.index += 1
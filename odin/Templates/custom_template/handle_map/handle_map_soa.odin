@@ -0,0 +1,247 @@
+/* Structure-of-arrays flavour of Handle_Map.
+
+Each item is split in two parts:
+
+- `Hot`: the fields touched every frame (position, velocity, colliders...).
+  These are stored in a `#soa[dynamic]Hot`, so every field of `Hot` gets its
+  own tightly packed array. A pass that only reads `pos` and `vel` only pulls
+  those two arrays through the cache, instead of dragging whole items along.
+- `Cold`: everything else. Stored in a plain dynamic array inside a static
+  virtual arena, just like `Handle_Map.items`, so pointers to it never move.
+
+Handles work the same as in Handle_Map: `Hot` must contain a `handle: HT`
+field, it carries the index and generation. Hot and cold data for a handle
+share the same index.
+
+The hot arrays are reallocated when they grow, so don't keep pointers into
+them. Resolve the handle with `soa_index` and index the arrays directly.
+
+Example (assumes this package is imported under the alias `hm`):
+
+	Entity_Hot :: struct {
+		handle: Entity_Handle,
+		pos:    [2]f32,
+		vel:    [2]f32,
+	}
+
+	Entity_Cold :: struct {
+		name: string,
+	}
+
+	entities: hm.Handle_Map_Soa(Entity_Hot, Entity_Cold, Entity_Handle, 10000)
+
+	h := hm.soa_add(&entities, Entity_Hot { vel = { 1, 0 } }, Entity_Cold { name = "goblin" })
+
+	// Hot loop, slot 0 is the dummy element
+	for i in 1 ..< len(entities.hot) {
+		if hm.soa_skip(entities, i) {
+			continue
+		}
+		entities.hot[i].pos += entities.hot[i].vel
+	}
+
+	if idx, ok := hm.soa_index(entities, h); ok {
+		entities.hot[idx].pos.y = 123
+	}
+
+	if c := hm.soa_get_cold(entities, h); c != nil {
+		c.name = "ogre"
+	}
+
+	hm.soa_delete(&entities)
+*/
+package handle_map_virtual
+
+import "base:builtin"
+import "base:runtime"
+import vmem "core:mem/virtual"
+
+// `Hot` and `Cold` are the two halves of an item, see the comment at the top of
+// this file. `Max` works like for Handle_Map: it sizes the virtual reserve for
+// the cold data and is the most items the map will hold.
+Handle_Map_Soa :: struct($Hot: typeid, $Cold: typeid, $HT: typeid, $Max: int) {
+	// One array per field of `Hot`. Index 0 is a dummy element, same as in
+	// Handle_Map.
+	hot:          #soa[dynamic]Hot,
+
+	// Same length as `hot`, lives in `cold_arena` so it can grow in-place.
+	cold:         [dynamic]Cold,
+	cold_arena:   ^vmem.Arena,
+
+	// The indices of unused slots.
+	unused_items: [dynamic]u32,
+}
+
+// Like `make` for Handle_Map. `allocator` is used for the hot arrays and
+// `unused_items`, the cold data always goes into its own virtual arena.
+soa_make :: proc(
+	$Hot: typeid,
+	$Cold: typeid,
+	$HT: typeid,
+	$Max: int,
+	allocator := context.allocator,
+	loc := #caller_location,
+) -> (
+	Handle_Map_Soa(Hot, Cold, HT, Max),
+	vmem.Allocator_Error,
+) #optional_allocator_error {
+	arena_bootstrap: vmem.Arena
+	// Max items plus the dummy item at index 0.
+	cold_size := (Max + 1) * size_of(Cold)
+	err := vmem.arena_init_static(&arena_bootstrap, uint(cold_size + size_of(vmem.Arena)))
+
+	if err != nil {
+		return {}, err
+	}
+
+	arena := new(vmem.Arena, vmem.arena_allocator(&arena_bootstrap), loc)
+	arena^ = arena_bootstrap
+
+	hot, hot_err := runtime.make_soa_dynamic_array(#soa[dynamic]Hot, allocator, loc)
+
+	if hot_err != nil {
+		vmem.arena_destroy(&arena_bootstrap)
+		return {}, hot_err
+	}
+
+	return {
+			hot = hot,
+			cold = runtime.make([dynamic]Cold, vmem.arena_allocator(arena), loc),
+			cold_arena = arena,
+			unused_items = runtime.make([dynamic]u32, allocator, loc),
+		},
+		nil
+}
+
+// Deallocate all memory associated with the Handle_Map_Soa.
+soa_delete :: proc(m: ^Handle_Map_Soa($Hot, $Cold, $HT, $Max), loc := #caller_location) {
+	// The arena struct is stored inside the arena, copy it out first. See `delete`.
+	if m.cold_arena != nil {
+		arena := m.cold_arena^
+		vmem.arena_destroy(&arena)
+	}
+
+	runtime.delete_soa_dynamic_array(m.hot, loc)
+	runtime.delete(m.unused_items, loc)
+	m^ = {}
+}
+
+// Empties the map without deallocating any memory.
+soa_clear :: proc(m: ^Handle_Map_Soa($Hot, $Cold, $HT, $Max)) {
+	runtime.clear_soa_dynamic_array(&m.hot)
+	runtime.clear(&m.cold)
+	runtime.clear(&m.unused_items)
+}
+
+// Add an item, given as its hot and cold parts. Returns a handle you can use as
+// a permanent reference. Reuses slots from `unused_items` if there are any.
+soa_add :: proc(
+	m: ^Handle_Map_Soa($Hot, $Cold, $HT, $Max),
+	hot: Hot,
+	cold: Cold,
+	loc := #caller_location,
+) -> (
+	res: HT,
+	err: vmem.Allocator_Error,
+) #optional_allocator_error {
+	if m.cold_arena == nil {
+		m^ = soa_make(Hot, Cold, HT, Max, loc = loc) or_return
+	}
+
+	hot := hot
+
+	if builtin.len(m.unused_items) > 0 {
+		reuse_idx := pop(&m.unused_items)
+		gen := m.hot[reuse_idx].handle.gen
+		hot.handle.idx = reuse_idx
+		hot.handle.gen = gen + 1
+		m.hot[reuse_idx] = hot
+		m.cold[reuse_idx] = cold
+		return hot.handle, nil
+	}
+
+	if builtin.len(m.hot) == 0 {
+		runtime.append_soa(&m.hot, Hot{}, loc) or_return
+		append(&m.cold, Cold{}, loc) or_return
+	}
+
+	// The hot arrays could keep growing, but the cold arena can't. Keep them
+	// the same length.
+	if builtin.len(m.hot) > Max {
+		return {}, .Out_Of_Memory
+	}
+
+	hot.handle.idx = u32(builtin.len(m.hot))
+	hot.handle.gen = 1
+	_, append_err := append(&m.cold, cold, loc)
+
+	if append_err != nil {
+		// Same as in `add`: growing the cold array past what's left of the
+		// arena fails, so try again with the exact number that fits.
+		if append_err == .Out_Of_Memory {
+			fits := int((m.cold_arena.total_reserved - size_of(vmem.Arena)) / size_of(Cold))
+			reserve(&m.cold, fits, loc) or_return
+			append(&m.cold, cold, loc) or_return
+		} else {
+			return {}, append_err
+		}
+	}
+
+	runtime.append_soa(&m.hot, hot, loc) or_return
+	return hot.handle, nil
+}
+
+// Resolve a handle to its index in `hot` and `cold`. Use the index right away,
+// it stays valid until the item is removed.
+soa_index :: proc(m: Handle_Map_Soa($Hot, $Cold, $HT, $Max), h: HT) -> (int, bool) {
+	if h.idx <= 0 || h.idx >= u32(builtin.len(m.hot)) {
+		return 0, false
+	}
+
+	if m.hot[h.idx].handle != h {
+		return 0, false
+	}
+
+	return int(h.idx), true
+}
+
+// Resolve a handle to a pointer to the cold part of the item. The pointer is
+// stable, but as with `get`, only store the handle permanently.
+soa_get_cold :: proc(m: Handle_Map_Soa($Hot, $Cold, $HT, $Max), h: HT) -> ^Cold {
+	if idx, ok := soa_index(m, h); ok {
+		return &m.cold[idx]
+	}
+
+	return nil
+}
+
+// Remove an item. Like `remove`, the slot is only marked as unused by setting
+// `handle.idx` to zero, the data stays until the slot is reused.
+soa_remove :: proc(m: ^Handle_Map_Soa($Hot, $Cold, $HT, $Max), h: HT) {
+	if idx, ok := soa_index(m^, h); ok {
+		append(&m.unused_items, h.idx)
+		m.hot[idx].handle.idx = 0
+	}
+}
+
+// Tells you if a handle maps to a valid item.
+soa_valid :: proc(m: Handle_Map_Soa($Hot, $Cold, $HT, $Max), h: HT) -> bool {
+	_, ok := soa_index(m, h)
+	return ok
+}
+
+// Tells you how many valid items there are in the map.
+soa_len :: proc(m: Handle_Map_Soa($Hot, $Cold, $HT, $Max)) -> int {
+	if builtin.len(m.hot) == 0 {
+		return 0
+	}
+
+	// minus the dummy element
+	return builtin.len(m.hot) - builtin.len(m.unused_items) - 1
+}
+
+// True if slot `i` is unused (or the dummy element) and should be skipped when
+// looping over `hot` or `cold` directly.
+soa_skip :: proc(m: Handle_Map_Soa($Hot, $Cold, $HT, $Max), i: int) -> bool {
+	return m.hot[i].handle.idx == 0
+}
@@ -0,0 +1,322 @@
+/* Work stealing job pool.
+
+A Pool owns a set of worker threads, each with its own deque of jobs. Jobs are spread over the
+deques round robin as they are submitted. A worker runs jobs from the bottom of its own deque
+and, once that is empty, steals from the top of the others, so an uneven split evens itself out.
+A thread that waits for jobs doesn't sleep, it steals and runs jobs too.
+
+The pool is meant to be created by the host exe and handed to the game, so the threads outlive
+hot reloads. Jobs are plain procedure pointers into whichever code submitted them. Every wait
+in the game returns before the frame ends, so no job is left running when the game DLL is
+swapped.
+
+	jobs.parallel_for(pool, len(items), 256, &items, proc(data: rawptr, start, end: int) {
+		items := (^[]Item)(data)
+		for &item in items[start:end] {
+			update(&item)
+		}
+	})
+
+Jobs that block on something else, like reading a file, go in with submit_background. Only the
+pool's threads pick those up, never a thread that is waiting on its own jobs, so a frame can't
+end up stuck behind a disk read.
+
+A nil pool, or one made with a single worker, runs every job on the calling thread, in the order
+it was submitted. That makes a run deterministic, whatever the jobs themselves do.
+*/
+package jobs
+
+import "core:os"
+import "core:sync"
+import "core:thread"
+import "core:time"
+
+//Number of workers, counting the thread that waits. 1 runs everything on the calling thread,
+//0 uses one per core.
+JOB_WORKERS :: #config(JOB_WORKERS, 0)
+DEQUE_SIZE :: 1024 // jobs per worker, submitting to a full deque runs the job straight away
+MAX_PHASES :: 16
+
+Job_Proc :: #type proc(data: rawptr, start, end: int)
+
+Job :: struct {
+	procedure:  Job_Proc,
+	data:       rawptr,
+	start, end: int,
+	counter:    ^Counter,
+}
+
+//Jobs not finished yet, see wait
+Counter :: struct {
+	pending: int,
+}
+
+//Owner pushes and pops at bottom, thieves take from top. jobs[top..bottom) wrap around.
+Deque :: struct {
+	mutex:  sync.Mutex,
+	jobs:   [DEQUE_SIZE]Job,
+	top:    int,
+	bottom: int,
+}
+
+Pool :: struct {
+	deques:     []Deque,
+	background: Deque, // shared, only used as a queue
+	threads:    []^thread.Thread,
+	running:    bool,
+	sema:       sync.Sema, // posted once per submitted job, idle workers sleep on it
+	next:       int, // deque the next job goes to
+}
+
+//A step of a frame that other steps can depend on, see run_phases
+Phase :: struct {
+	name:      string,
+	procedure: proc(data: rawptr),
+	data:      rawptr,
+	after:     bit_set[0 ..< MAX_PHASES], // phases that must be finished first
+}
+
+create_pool :: proc(workers := JOB_WORKERS, allocator := context.allocator) -> ^Pool {
+	workers := workers
+	if workers <= 0 {
+		workers = max(os.processor_core_count(), 1)
+	}
+	pool := new(Pool, allocator)
+	// The waiting thread counts as a worker, it steals while it waits
+	threads := workers - 1
+	if threads == 0 {
+		return pool
+	}
+	pool.deques = make([]Deque, threads, allocator)
+	pool.threads = make([]^thread.Thread, threads, allocator)
+	pool.running = true
+	for &t, i in pool.threads {
+		t = thread.create(worker_proc)
+		t.data = pool
+		t.user_index = i
+		thread.start(t)
+	}
+	return pool
+}
+
+destroy_pool :: proc(pool: ^Pool, allocator := context.allocator) {
+	if pool == nil {
+		return
+	}
+	sync.atomic_store(&pool.running, false)
+	sync.sema_post(&pool.sema, len(pool.threads))
+	for t in pool.threads {
+		thread.join(t)
+		thread.destroy(t)
+	}
+	delete(pool.threads, allocator)
+	delete(pool.deques, allocator)
+	free(pool, allocator)
+}
+
+//Threads that run jobs, the calling thread included
+worker_count :: proc(pool: ^Pool) -> int {
+	if pool == nil {
+		return 1
+	}
+	return len(pool.threads) + 1
+}
+
+//Queues a job, or runs it right away when the pool has no threads
+submit :: proc(pool: ^Pool, job: Job) {
+	sync.atomic_add(&job.counter.pending, 1)
+	if pool == nil || len(pool.deques) == 0 {
+		run_job(job)
+		return
+	}
+	i := sync.atomic_add(&pool.next, 1) % len(pool.deques)
+	d := &pool.deques[i]
+	sync.mutex_lock(&d.mutex)
+	if d.bottom - d.top == DEQUE_SIZE {
+		sync.mutex_unlock(&d.mutex)
+		run_job(job)
+		return
+	}
+	d.jobs[d.bottom % DEQUE_SIZE] = job
+	d.bottom += 1
+	sync.mutex_unlock(&d.mutex)
+	sync.sema_post(&pool.sema)
+}
+
+//Queues a job that may block for a while, or runs it right away when the pool has no threads
+submit_background :: proc(pool: ^Pool, job: Job) {
+	sync.atomic_add(&job.counter.pending, 1)
+	if pool == nil || len(pool.deques) == 0 {
+		run_job(job)
+		return
+	}
+	d := &pool.background
+	sync.mutex_lock(&d.mutex)
+	if d.bottom - d.top == DEQUE_SIZE {
+		sync.mutex_unlock(&d.mutex)
+		run_job(job)
+		return
+	}
+	d.jobs[d.bottom % DEQUE_SIZE] = job
+	d.bottom += 1
+	sync.mutex_unlock(&d.mutex)
+	sync.sema_post(&pool.sema)
+}
+
+//Runs jobs until every job counted by counter has finished. Background jobs are only helped
+//with when asked to, by a thread that is fine blocking on them.
+wait :: proc(pool: ^Pool, counter: ^Counter, background := false) {
+	for sync.atomic_load(&counter.pending) > 0 {
+		job, ok := steal(pool, -1)
+		if !ok && background {
+			job, ok = take(&pool.background)
+		}
+		if ok {
+			run_job(job)
+		} else {
+			sync.cpu_relax()
+		}
+	}
+}
+
+//Calls procedure over [0, count) in ranges of batch and waits for all of them. Ranges run in
+//order on a pool without threads.
+parallel_for :: proc(pool: ^Pool, count, batch: int, data: rawptr, procedure: Job_Proc) {
+	counter: Counter
+	batch := max(batch, 1)
+	for start := 0; start < count; start += batch {
+		submit(
+			pool,
+			{
+				procedure = procedure,
+				data = data,
+				start = start,
+				end = min(start + batch, count),
+				counter = &counter,
+			},
+		)
+	}
+	wait(pool, &counter)
+}
+
+//Runs phases as soon as the ones they come after have finished, returns when all have. A phase
+//may only come after phases earlier in the slice, which is also the order a pool without threads
+//runs them in.
+run_phases :: proc(pool: ^Pool, phases: []Phase) {
+	assert(len(phases) <= MAX_PHASES)
+	for phase, i in phases {
+		for before in phase.after {
+			assert(before < i, "a phase can only come after earlier phases")
+		}
+	}
+	if worker_count(pool) == 1 {
+		for phase in phases {
+			phase.procedure(phase.data)
+		}
+		return
+	}
+
+	runs: [MAX_PHASES]Phase_Run
+	counter: Counter
+	started, done: bit_set[0 ..< MAX_PHASES]
+	for done_count := 0; done_count < len(phases); {
+		for &phase, i in phases {
+			if i in started || !(phase.after <= done) {
+				continue
+			}
+			runs[i].phase = &phase
+			submit(pool, {procedure = run_phase_job, data = &runs[i], counter = &counter})
+			started += {i}
+		}
+		if job, ok := steal(pool, -1); ok {
+			run_job(job)
+		} else {
+			sync.cpu_relax()
+		}
+		for &run, i in runs[:len(phases)] {
+			if !(i in done) && sync.atomic_load(&run.done) {
+				done += {i}
+				done_count += 1
+			}
+		}
+	}
+	wait(pool, &counter)
+}
+
+@(private)
+Phase_Run :: struct {
+	phase: ^Phase,
+	done:  bool,
+}
+
+@(private)
+run_phase_job :: proc(data: rawptr, _, _: int) {
+	run := (^Phase_Run)(data)
+	run.phase.procedure(run.phase.data)
+	sync.atomic_store(&run.done, true)
+}
+
+@(private)
+run_job :: proc(job: Job) {
+	job.procedure(job.data, job.start, job.end)
+	sync.atomic_sub(&job.counter.pending, 1)
+}
+
+//Takes the oldest job of the first deque that has one, starting after skip
+@(private)
+steal :: proc(pool: ^Pool, skip: int) -> (job: Job, ok: bool) {
+	if pool == nil {
+		return
+	}
+	n := len(pool.deques)
+	for k in 1 ..= n {
+		if job, ok = take(&pool.deques[(skip + k + n) % n]); ok {
+			return
+		}
+	}
+	return
+}
+
+//Oldest job of a deque
+@(private)
+take :: proc(d: ^Deque) -> (job: Job, ok: bool) {
+	sync.mutex_lock(&d.mutex)
+	defer sync.mutex_unlock(&d.mutex)
+	if d.top == d.bottom {
+		return
+	}
+	d.top += 1
+	return d.jobs[(d.top - 1) % DEQUE_SIZE], true
+}
+
+//Newest job of the worker's own deque
+@(private)
+pop :: proc(d: ^Deque) -> (job: Job, ok: bool) {
+	sync.mutex_lock(&d.mutex)
+	defer sync.mutex_unlock(&d.mutex)
+	if d.top == d.bottom {
+		return
+	}
+	d.bottom -= 1
+	return d.jobs[d.bottom % DEQUE_SIZE], true
+}
+
+@(private)
+worker_proc :: proc(t: ^thread.Thread) {
+	pool := (^Pool)(t.data)
+	index := t.user_index
+	for sync.atomic_load(&pool.running) {
+		job, ok := pop(&pool.deques[index])
+		if !ok {
+			job, ok = steal(pool, index)
+		}
+		if !ok {
+			job, ok = take(&pool.background)
+		}
+		if ok {
+			run_job(job)
+			continue
+		}
+		sync.sema_wait_with_timeout(&pool.sema, time.Millisecond)
+	}
+}
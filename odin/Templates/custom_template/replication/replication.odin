@@ -0,0 +1,548 @@
+/* Snapshot replication of entity state, shared by the server and its clients.
+
+Every tick the server captures a World, the replicated state of each entity, quantized and sorted
+by id. Each client then gets a snapshot of the entities in the chunks around its view, delta
+encoded against the last snapshot it acknowledged:
+
+	server                                 client
+	capture the World of tick T
+	encode_snapshot, base B       ---->    apply_snapshot_part on top of its copy of B
+	                              <----    ack T, the next base
+
+Only what changed since the base is sent: entities that moved or animated, entities that came
+into view (in full) and ones that left it. A client that just joined, or hasn't acked anything in
+the last CLIENT_HISTORY ticks, gets everything in full.
+
+Positions and velocities are fixed point, 1/POS_SCALE pixel and 1/VEL_SCALE pixel per second.
+Deltas are zigzag varints, so a goblin that walked a pixel costs about four bytes.
+
+Clients keep CLIENT_HISTORY snapshots and show the world INTERPOLATION_DELAY ticks in the past,
+between the two snapshots around that time, see interpolate.
+
+Nothing here knows about sockets or the game. The server sends each part of an Encoder as one
+message, the game fills Worlds, see capture_replication_world in the game package.
+*/
+package replication
+
+import "core:math"
+import "core:sync"
+
+POS_SCALE :: 8
+VEL_SCALE :: 4
+//Chunks around the view chunk a client gets entities from, in each direction
+INTEREST_RADIUS :: 1
+//Snapshots a client keeps to decode deltas against, so also how old a base the server may use
+CLIENT_HISTORY :: 32
+//Worlds the server keeps. Has to be more than CLIENT_HISTORY, see world_at.
+WORLD_HISTORY :: 64
+//Payload bytes of one snapshot part, fits the server's messages
+PART_SIZE :: 1000
+PART_HEADER_SIZE :: 5 // base tick u32, flags u8
+PART_LAST :: 1 // flag of the part that completes a snapshot
+MAX_RECORD_SIZE :: 32
+//Ticks behind the newest snapshot that clients show, one lost or late snapshot is covered
+INTERPOLATION_DELAY :: 3
+
+#assert(WORLD_HISTORY > CLIENT_HISTORY + 1)
+
+//Replicated state of one entity
+State :: struct {
+	id:       u32, // entity slot
+	gen:      u32, // slot generation, a new one is a different entity. Not sent.
+	chunk:    [2]i32, // for culling. Not sent.
+	pos:      [2]i32,
+	vel:      [2]i32,
+	kind:     u8,
+	movement: u8,
+	frame:    u16, // animation frame
+}
+
+World :: struct {
+	tick:   u32,
+	states: [dynamic]State, // sorted by id
+}
+
+//Worlds of the last WORLD_HISTORY ticks. One thread captures, any number encode from them.
+World_History :: struct {
+	worlds: [WORLD_HISTORY]World,
+	latest: u32, // newest published tick, ticks count from 1
+}
+
+//Per client replication state on the server, owned by the thread that talks to the client
+Client_View :: struct {
+	joined: bool,
+	view:   [2]i32, // chunk the client looks at
+	acked:  u32, // newest snapshot the client has, 0 for none
+	views:  [CLIENT_HISTORY][2]i32, // view each recent snapshot was culled with, by tick
+}
+
+//Encoded parts of one snapshot, reused from tick to tick
+Encoder :: struct {
+	bytes: [dynamic]u8,
+	parts: [dynamic]int, // end of each part in bytes
+}
+
+Snapshot :: struct {
+	tick:   u32,
+	states: [dynamic]State, // sorted by id
+}
+
+//Client side, the snapshots received so far
+Client :: struct {
+	snapshots:   [CLIENT_HISTORY]Snapshot, // by tick
+	latest:      u32, // newest complete snapshot
+	next:        Snapshot, // the one being received
+	next_base:   u32,
+	base_cursor: int, // base states up to here are in next already
+	receiving:   bool,
+	dropped:     u32, // tick whose parts are ignored, it couldn't be decoded
+}
+
+//An entity as the client shows it
+Interpolated :: struct {
+	id:       u32,
+	pos:      [2]f32,
+	kind:     u8,
+	movement: u8,
+	frame:    u16,
+}
+
+@(private)
+Field :: enum u8 {
+	Pos_X,
+	Pos_Y,
+	Vel_X,
+	Vel_Y,
+	Movement,
+	Frame,
+}
+
+//Top two bits of a record's field byte
+@(private)
+Record_Op :: enum u8 {
+	Update,
+	New,
+	Remove,
+}
+
+quantize :: proc(v: f32, scale: f32) -> i32 {
+	return i32(math.round(v * scale))
+}
+
+dequantize :: proc(q: i32, scale: f32) -> f32 {
+	return f32(q) / scale
+}
+
+in_view :: #force_inline proc(view, chunk: [2]i32) -> bool {
+	d := chunk - view
+	return abs(d.x) <= INTEREST_RADIUS && abs(d.y) <= INTEREST_RADIUS
+}
+
+//Reserves every World for max_states entities. Capturing never grows them past that, so a
+//World being read while it is overwritten is torn, but never freed.
+init_world_history :: proc(h: ^World_History, max_states: int, allocator := context.allocator) {
+	for &w in h.worlds {
+		w.states = make([dynamic]State, 0, max_states, allocator)
+	}
+}
+
+delete_world_history :: proc(h: ^World_History) {
+	for &w in h.worlds {
+		delete(w.states)
+	}
+}
+
+//The World to capture tick into, publish it with publish_world when done
+begin_world :: proc(h: ^World_History, tick: u32) -> ^World {
+	w := &h.worlds[tick % WORLD_HISTORY]
+	w.tick = tick
+	clear(&w.states)
+	return w
+}
+
+publish_world :: proc(h: ^World_History, tick: u32) {
+	sync.atomic_store_explicit(&h.latest, tick, .Release)
+}
+
+latest_world :: proc(h: ^World_History) -> u32 {
+	return sync.atomic_load_explicit(&h.latest, .Acquire)
+}
+
+//The World of tick if it is safe to read, seen from latest. The capture after latest overwrites
+//the oldest World, so that one is already out.
+world_at :: proc(h: ^World_History, tick, latest: u32) -> ^World {
+	if tick == 0 || tick > latest || latest - tick >= WORLD_HISTORY - 1 {
+		return nil
+	}
+	return &h.worlds[tick % WORLD_HISTORY]
+}
+
+//False if the Worlds of tick were overwritten since they were looked up, anything read from
+//them has to be thrown away
+world_still_valid :: proc(h: ^World_History, tick: u32) -> bool {
+	return latest_world(h) - tick < WORLD_HISTORY - 1
+}
+
+delete_encoder :: proc(enc: ^Encoder) {
+	delete(enc.bytes)
+	delete(enc.parts)
+}
+
+//Part i of the last encoded snapshot
+encoder_part :: proc(enc: ^Encoder, i: int) -> []u8 {
+	start := 0 if i == 0 else enc.parts[i - 1]
+	return enc.bytes[start:enc.parts[i]]
+}
+
+//Encodes the snapshot of world for client as parts of at most PART_SIZE bytes. The base is the
+//snapshot the client acked if that is still around, otherwise everything goes in full. There is
+//always at least one part, an empty snapshot still moves the client's base forward.
+encode_snapshot :: proc(
+	enc: ^Encoder,
+	client: ^Client_View,
+	h: ^World_History,
+	world: ^World,
+) -> (
+	base_tick: u32,
+) {
+	clear(&enc.bytes)
+	clear(&enc.parts)
+
+	cur := world.states[:]
+	cur_view := client.view
+	client.views[world.tick % CLIENT_HISTORY] = cur_view
+	base: []State
+	base_view: [2]i32
+	if client.acked != 0 && world.tick - client.acked < CLIENT_HISTORY {
+		if w := world_at(h, client.acked, world.tick); w != nil {
+			base_tick = client.acked
+			base = w.states[:]
+			base_view = client.views[base_tick % CLIENT_HISTORY]
+		}
+	}
+
+	begin_part(enc, base_tick)
+	prev_id: u32
+	i, j := 0, 0
+	for i < len(cur) || j < len(base) {
+		if i < len(cur) && !in_view(cur_view, cur[i].chunk) {
+			i += 1
+			continue
+		}
+		if j < len(base) && !in_view(base_view, base[j].chunk) {
+			j += 1
+			continue
+		}
+
+		if len(bytes_in_part(enc)) + MAX_RECORD_SIZE > PART_SIZE {
+			enc.parts[len(enc.parts) - 1] = len(enc.bytes)
+			begin_part(enc, base_tick)
+			prev_id = 0
+		}
+
+		switch {
+		case j == len(base) || (i < len(cur) && cur[i].id < base[j].id):
+			put_new(enc, cur[i], prev_id)
+			prev_id = cur[i].id
+			i += 1
+		case i == len(cur) || base[j].id < cur[i].id:
+			put_record_start(enc, base[j].id - prev_id, .Remove, {})
+			prev_id = base[j].id
+			j += 1
+		case cur[i].gen != base[j].gen:
+			put_new(enc, cur[i], prev_id)
+			prev_id = cur[i].id
+			i += 1
+			j += 1
+		case:
+			if put_update(enc, cur[i], base[j], prev_id) {
+				prev_id = cur[i].id
+			}
+			i += 1
+			j += 1
+		}
+	}
+	enc.parts[len(enc.parts) - 1] = len(enc.bytes)
+	last := encoder_part(enc, len(enc.parts) - 1)
+	last[4] |= PART_LAST
+	return
+}
+
+@(private)
+begin_part :: proc(enc: ^Encoder, base_tick: u32) {
+	append(&enc.bytes, u8(base_tick), u8(base_tick >> 8), u8(base_tick >> 16), u8(base_tick >> 24))
+	append(&enc.bytes, 0)
+	append(&enc.parts, len(enc.bytes))
+}
+
+@(private)
+bytes_in_part :: proc(enc: ^Encoder) -> []u8 {
+	start := 0 if len(enc.parts) == 1 else enc.parts[len(enc.parts) - 2]
+	return enc.bytes[start:]
+}
+
+@(private)
+put_record_start :: proc(enc: ^Encoder, id_gap: u32, op: Record_Op, fields: bit_set[Field;u8]) {
+	put_uvarint(&enc.bytes, id_gap)
+	append(&enc.bytes, u8(op) << 6 | transmute(u8)fields)
+}
+
+@(private)
+put_new :: proc(enc: ^Encoder, s: State, prev_id: u32) {
+	put_record_start(enc, s.id - prev_id, .New, {})
+	append(&enc.bytes, s.kind, s.movement)
+	put_varint(&enc.bytes, s.pos.x)
+	put_varint(&enc.bytes, s.pos.y)
+	put_varint(&enc.bytes, s.vel.x)
+	put_varint(&enc.bytes, s.vel.y)
+	put_uvarint(&enc.bytes, u32(s.frame))
+}
+
+//Writes only the fields that changed, nothing at all if none did. Returns whether it wrote.
+@(private)
+put_update :: proc(enc: ^Encoder, s, base: State, prev_id: u32) -> bool {
+	fields: bit_set[Field;u8]
+	if s.pos.x != base.pos.x {fields += {.Pos_X}}
+	if s.pos.y != base.pos.y {fields += {.Pos_Y}}
+	if s.vel.x != base.vel.x {fields += {.Vel_X}}
+	if s.vel.y != base.vel.y {fields += {.Vel_Y}}
+	if s.movement != base.movement {fields += {.Movement}}
+	if s.frame != base.frame {fields += {.Frame}}
+	if fields == {} {
+		return false
+	}
+
+	put_record_start(enc, s.id - prev_id, .Update, fields)
+	if .Pos_X in fields {put_varint(&enc.bytes, s.pos.x - base.pos.x)}
+	if .Pos_Y in fields {put_varint(&enc.bytes, s.pos.y - base.pos.y)}
+	if .Vel_X in fields {put_varint(&enc.bytes, s.vel.x - base.vel.x)}
+	if .Vel_Y in fields {put_varint(&enc.bytes, s.vel.y - base.vel.y)}
+	if .Movement in fields {append(&enc.bytes, s.movement)}
+	if .Frame in fields {put_uvarint(&enc.bytes, u32(s.frame))}
+	return true
+}
+
+delete_client :: proc(c: ^Client) {
+	for &s in c.snapshots {
+		delete(s.states)
+	}
+	delete(c.next.states)
+}
+
+//Applies one part of the snapshot of tick. complete is true once the last part is in, tick is
+//then the newest snapshot and should be acked. ok is false when the part can't be decoded, the
+//rest of the snapshot is skipped and the server falls back to an older base or to full.
+apply_snapshot_part :: proc(c: ^Client, tick: u32, part: []u8) -> (complete, ok: bool) {
+	if tick == c.dropped {
+		return false, false
+	}
+	r := Reader {
+		data = part,
+		ok   = true,
+	}
+	base_tick := read_u32(&r)
+	flags := read_u8(&r)
+	if !c.receiving || c.next.tick != tick {
+		c.next.tick = tick
+		clear(&c.next.states)
+		c.next_base = base_tick
+		c.base_cursor = 0
+		c.receiving = true
+	}
+
+	base: []State
+	if base_tick != 0 {
+		b := &c.snapshots[base_tick % CLIENT_HISTORY]
+		if b.tick != base_tick || base_tick != c.next_base {
+			return drop_snapshot(c, tick)
+		}
+		base = b.states[:]
+	}
+
+	prev_id: u32
+	for r.ok && r.offset < len(r.data) {
+		id := prev_id + read_uvarint(&r)
+		prev_id = id
+		field_byte := read_u8(&r)
+		op := Record_Op(field_byte >> 6)
+		fields := transmute(bit_set[Field;u8])(field_byte & 0x3f)
+
+		//base entities before id didn't change
+		for c.base_cursor < len(base) && base[c.base_cursor].id < id {
+			append(&c.next.states, base[c.base_cursor])
+			c.base_cursor += 1
+		}
+		has_base := c.base_cursor < len(base) && base[c.base_cursor].id == id
+		if has_base {
+			c.base_cursor += 1
+		}
+
+		switch op {
+		case .Remove:
+		case .New:
+			s := State {
+				id = id,
+			}
+			s.kind = read_u8(&r)
+			s.movement = read_u8(&r)
+			s.pos.x = read_varint(&r)
+			s.pos.y = read_varint(&r)
+			s.vel.x = read_varint(&r)
+			s.vel.y = read_varint(&r)
+			s.frame = u16(read_uvarint(&r))
+			append(&c.next.states, s)
+		case .Update:
+			if !has_base {
+				return drop_snapshot(c, tick)
+			}
+			s := base[c.base_cursor - 1]
+			if .Pos_X in fields {s.pos.x += read_varint(&r)}
+			if .Pos_Y in fields {s.pos.y += read_varint(&r)}
+			if .Vel_X in fields {s.vel.x += read_varint(&r)}
+			if .Vel_Y in fields {s.vel.y += read_varint(&r)}
+			if .Movement in fields {s.movement = read_u8(&r)}
+			if .Frame in fields {s.frame = u16(read_uvarint(&r))}
+			append(&c.next.states, s)
+		case:
+			return drop_snapshot(c, tick)
+		}
+	}
+	if !r.ok {
+		return drop_snapshot(c, tick)
+	}
+	if flags & PART_LAST == 0 {
+		return false, true
+	}
+
+	append(&c.next.states, ..base[c.base_cursor:])
+	//the slot's old buffer becomes the next one to receive into
+	slot := &c.snapshots[tick % CLIENT_HISTORY]
+	slot^, c.next = c.next, slot^
+	c.latest = max(c.latest, tick)
+	c.receiving = false
+	return true, true
+}
+
+@(private)
+drop_snapshot :: proc(c: ^Client, tick: u32) -> (complete, ok: bool) {
+	c.dropped = tick
+	c.receiving = false
+	return false, false
+}
+
+//Entities as they were at render_tick, which is fractional. Positions are lerped between the
+//newest snapshot at or before render_tick and the oldest one after it. An entity that is only in
+//the later one shows up where that one has it. Returns false without a snapshot that old.
+interpolate :: proc(c: ^Client, render_tick: f64, out: ^[dynamic]Interpolated) -> bool {
+	clear(out)
+	a, b: ^Snapshot
+	for &s in c.snapshots {
+		if s.tick == 0 {
+			continue
+		}
+		if f64(s.tick) <= render_tick {
+			if a == nil || s.tick > a.tick {
+				a = &s
+			}
+		} else if b == nil || s.tick < b.tick {
+			b = &s
+		}
+	}
+	if a == nil {
+		return false
+	}
+	if b == nil {
+		b = a
+	}
+
+	t := f32(0)
+	if b.tick != a.tick {
+		t = f32((render_tick - f64(a.tick)) / f64(b.tick - a.tick))
+	}
+	i := 0
+	for s in b.states {
+		for i < len(a.states) && a.states[i].id < s.id {
+			i += 1
+		}
+		from := s.pos
+		if i < len(a.states) && a.states[i].id == s.id {
+			from = a.states[i].pos
+		}
+		append(
+			out,
+			Interpolated {
+				id = s.id,
+				pos = {
+					math.lerp(dequantize(from.x, POS_SCALE), dequantize(s.pos.x, POS_SCALE), t),
+					math.lerp(dequantize(from.y, POS_SCALE), dequantize(s.pos.y, POS_SCALE), t),
+				},
+				kind = s.kind,
+				movement = s.movement,
+				frame = s.frame,
+			},
+		)
+	}
+	return true
+}
+
+@(private)
+put_uvarint :: proc(b: ^[dynamic]u8, v: u32) {
+	v := v
+	for v >= 0x80 {
+		append(b, u8(v) | 0x80)
+		v >>= 7
+	}
+	append(b, u8(v))
+}
+
+@(private)
+put_varint :: proc(b: ^[dynamic]u8, v: i32) {
+	put_uvarint(b, u32((v << 1) ~ (v >> 31)))
+}
+
+//Reads past the end return 0 and clear ok
+@(private)
+Reader :: struct {
+	data:   []u8,
+	offset: int,
+	ok:     bool,
+}
+
+@(private)
+read_u8 :: proc(r: ^Reader) -> u8 {
+	if r.offset >= len(r.data) {
+		r.ok = false
+		return 0
+	}
+	r.offset += 1
+	return r.data[r.offset - 1]
+}
+
+@(private)
+read_u32 :: proc(r: ^Reader) -> u32 {
+	v: u32
+	for i in 0 ..< u32(4) {
+		v |= u32(read_u8(r)) << (8 * i)
+	}
+	return v
+}
+
+@(private)
+read_uvarint :: proc(r: ^Reader) -> u32 {
+	v: u32
+	for shift: u32 = 0; shift < 35; shift += 7 {
+		b := read_u8(r)
+		v |= u32(b & 0x7f) << shift
+		if b < 0x80 {
+			return v
+		}
+	}
+	r.ok = false
+	return 0
+}
+
+@(private)
+read_varint :: proc(r: ^Reader) -> i32 {
+	v := read_uvarint(r)
+	return i32(v >> 1) ~ -i32(v & 1)
+}
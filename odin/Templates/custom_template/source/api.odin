@@ -1,5 +1,6 @@
 package game
 
+import "../jobs"
 import rl "vendor:raylib"
 
 @(export)
@@ -14,6 +15,11 @@ game_init_window :: proc() {
 
 @(export)
 game_update :: proc() {
+	profile_frame_begin()
+	context.temp_allocator, context.allocator = begin_frame_memory(
+		g.frame_memory,
+		context.allocator,
+	)
 	update()
 	draw()
 }
@@ -49,6 +55,12 @@ game_hot_reloaded :: proc(mem: rawptr) {
 	refresh_globals()
 }
 
+//The host makes the pool and hands it over after every game_init
+@(export)
+game_set_job_pool :: proc(pool: rawptr) {
+	g.job_pool = (^jobs.Pool)(pool)
+}
+
 @(export)
 game_force_reload :: proc() -> bool {
 	return rl.IsKeyPressed(.F5)
@@ -0,0 +1,119 @@
+package game
+
+import hm "../handle_map"
+import "core:fmt"
+import "core:time"
+
+//Debug benchmarks, run from a key press in update_play and printed to the console.
+//They stall the game while running, so they are only meant for comparing numbers.
+
+BENCH_ENTITY_COUNT :: 100_000
+BENCH_PASSES :: 60
+
+//The fields the per-frame movement and collider passes touch. Everything else about an entity
+//is cold and sits in the Entity stored next to it.
+Bench_Entity_Hot :: struct {
+	handle:          Entity_Handle,
+	pos:             Vec2,
+	vel:             Vec2,
+	size:            Vec2,
+	ent_rect:        EntityRect,
+	rect:            Rect,
+	feet_collider:   Rect,
+	face_collider:   Rect,
+	head_collider:   Rect,
+	corner_collider: Rect,
+}
+
+//Runs the same movement + collider pass over BENCH_ENTITY_COUNT entities stored as one wide
+//struct per entity (hm.Handle_Map) and split into hot SoA arrays plus cold data
+//(hm.Handle_Map_Soa). Prints the best pass time for each. g.entities is neither of these, it is
+//an hm.Dense_Handle_Map.
+run_entity_layout_benchmark :: proc() {
+	aos: hm.Handle_Map(Entity, Entity_Handle, BENCH_ENTITY_COUNT + 1)
+	soa: hm.Handle_Map_Soa(Bench_Entity_Hot, Entity, Entity_Handle, BENCH_ENTITY_COUNT + 1)
+	defer hm.delete(&aos)
+	defer hm.soa_delete(&soa)
+
+	for i in 0 ..< BENCH_ENTITY_COUNT {
+		pos := Vec2{f32(i % 1000) * TILE_SIZE, -f32(i / 1000) * TILE_SIZE}
+		vel := Vec2{f32(i % 7) - 3, 0}
+		size := Vec2{TILE_SIZE, TILE_SIZE}
+		aos_entity := Entity {
+			pos  = pos,
+			vel  = vel,
+			size = size,
+			kind = .goblin,
+		}
+		if _, err := hm.add(&aos, aos_entity); err != nil {
+			fmt.printf("Entity layout benchmark: adding AoS entity %i failed: %v\n", i, err)
+			return
+		}
+		if _, err := hm.soa_add(
+			&soa,
+			Bench_Entity_Hot{pos = pos, vel = vel, size = size},
+			Entity{kind = .goblin},
+		); err != nil {
+			fmt.printf("Entity layout benchmark: adding SoA entity %i failed: %v\n", i, err)
+			return
+		}
+	}
+
+	// Both passes have to walk the same entities for the times to compare.
+	assert(hm.len(aos) == BENCH_ENTITY_COUNT && hm.soa_len(soa) == BENCH_ENTITY_COUNT)
+
+	dt := f32(1.0 / 60.0)
+	aos_best := max(f64)
+	soa_best := max(f64)
+	checksum: f32
+
+	for _ in 0 ..< BENCH_PASSES {
+		start := time.tick_now()
+		for &e in aos.items {
+			if hm.skip(e) {
+				continue
+			}
+			e.vel.y += 400 * dt
+			e.pos += e.vel * dt
+			e.rect = {e.pos.x - e.size.x / 2, e.pos.y - e.size.y, e.size.x, e.size.y}
+			e.feet_collider = {e.rect.x, e.rect.y + e.rect.height - 2, e.rect.width, 2}
+			e.head_collider = {e.rect.x, e.rect.y, e.rect.width, 2}
+			e.face_collider = {e.rect.x + e.rect.width - 2, e.rect.y, 2, e.rect.height}
+			e.ent_rect = rect_to_entity_rect(e.rect, e.pos)
+			checksum += e.pos.x
+		}
+		aos_best = min(aos_best, time.duration_milliseconds(time.tick_since(start)))
+
+		start = time.tick_now()
+		handle, pos, vel, size, ent_rect, rect, feet, face, head, _ := soa_unzip(soa.hot[:])
+		for i in 0 ..< len(handle) {
+			if handle[i].idx == 0 {
+				continue
+			}
+			vel[i].y += 400 * dt
+			pos[i] += vel[i] * dt
+			r := Rect{pos[i].x - size[i].x / 2, pos[i].y - size[i].y, size[i].x, size[i].y}
+			rect[i] = r
+			feet[i] = {r.x, r.y + r.height - 2, r.width, 2}
+			head[i] = {r.x, r.y, r.width, 2}
+			face[i] = {r.x + r.width - 2, r.y, 2, r.height}
+			ent_rect[i] = rect_to_entity_rect(r, pos[i])
+			checksum += pos[i].x
+		}
+		soa_best = min(soa_best, time.duration_milliseconds(time.tick_since(start)))
+	}
+
+	fmt.printf(
+		"Entity layout benchmark, %i entities, best of %i passes\n",
+		BENCH_ENTITY_COUNT,
+		BENCH_PASSES,
+	)
+	fmt.printf("  AoS Entity (%i bytes):        %.3fms\n", size_of(Entity), aos_best)
+	fmt.printf(
+		"  SoA hot (%i bytes) + cold:    %.3fms (%.2fx)\n",
+		size_of(Bench_Entity_Hot),
+		soa_best,
+		aos_best / soa_best,
+	)
+	fmt.printf("  checksum %v\n", checksum)
+}
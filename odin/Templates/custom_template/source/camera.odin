@@ -46,7 +46,7 @@ update_camera :: proc() {
 	zoom := f32(h / (CAMERA_ZOOM_BASE * CAMERA_ZOOM_MULT))
 	g.game_camera = {
 		zoom   = zoom,
-		target = get_player().pos,
+		target = entity_draw_pos(get_player()),
 		offset = {w / 2, h / 2},
 	}
 }
@@ -0,0 +1,225 @@
+package game
+
+import hm "../handle_map"
+import rl "vendor:raylib"
+
+//Keeps loaded chunks under a memory budget.
+//
+//Collision and visual chunks share one budget. When it is exceeded, the least recently used chunk
+//is evicted first, with distance from the player making a chunk count as older. Chunks that
+//update_chunks still wants are never evicted, they would just be requested again.
+//
+//Dirty visual chunks are encoded on eviction and written to disk by the chunk streamer's worker.
+//Their entities/decorations arrays and render texture go into a pool and are reused by the next
+//chunk that loads.
+
+//Bytes of chunk data kept loaded, override with -define:CHUNK_CACHE_BUDGET=N. The wanted set is
+//10 collision chunks of about 1KB and 8 visual chunks of at most about 5KB, under 50KB together.
+//4MB is around 80 times that, so a few hundred chunks the player has left stay loaded and walking
+//back over them is a hit instead of a reload.
+CHUNK_CACHE_BUDGET :: #config(CHUNK_CACHE_BUDGET, 4 * 1024 * 1024)
+//How many seconds older a chunk counts as for each chunk it is away from the player
+CHUNK_CACHE_DISTANCE_WEIGHT :: 1.0
+//Unloaded visual chunk arrays kept for reuse
+CHUNK_CACHE_POOL_SIZE :: 16
+
+Chunk_Cache_Stats :: struct {
+	hits:       i32, // wanted chunks that were already loaded
+	misses:     i32, // wanted chunks that had to be requested
+	evictions:  i32,
+	writebacks: i32, // dirty chunks written on eviction
+	used_bytes: int,
+}
+
+Visual_Chunk_Buffers :: struct {
+	entities:    [dynamic]Entity_Handle,
+	decorations: [dynamic]Decoration,
+	texture:     rl.RenderTexture2D, // id 0 until the chunk is first baked
+}
+
+Chunk_Cache :: struct {
+	budget: int,
+	pool:   [dynamic]Visual_Chunk_Buffers,
+	stats:  Chunk_Cache_Stats,
+}
+
+init_chunk_cache :: proc(cache: ^Chunk_Cache) {
+	cache.budget = CHUNK_CACHE_BUDGET
+	cache.pool = make([dynamic]Visual_Chunk_Buffers, 0, CHUNK_CACHE_POOL_SIZE)
+}
+
+delete_chunk_cache :: proc(cache: ^Chunk_Cache) {
+	for buffers in cache.pool {
+		delete_visual_chunk_buffers(buffers)
+	}
+	delete(cache.pool)
+}
+
+//Empty entities/decorations arrays and a texture for a new Visual_Chunk, from the pool when there are any
+take_visual_chunk_buffers :: proc(cache: ^Chunk_Cache) -> Visual_Chunk_Buffers {
+	if len(cache.pool) > 0 {
+		return pop(&cache.pool)
+	}
+	return {entities = make([dynamic]Entity_Handle), decorations = make([dynamic]Decoration)}
+}
+
+//Gives the arrays of an unloaded chunk back to the pool, or frees them if the pool is full
+release_visual_chunk_buffers :: proc(cache: ^Chunk_Cache, chunk: Visual_Chunk) {
+	buffers := Visual_Chunk_Buffers {
+		entities    = chunk.entities,
+		decorations = chunk.decorations,
+		texture     = chunk.texture,
+	}
+	if len(cache.pool) >= CHUNK_CACHE_POOL_SIZE {
+		delete_visual_chunk_buffers(buffers)
+		return
+	}
+	clear(&buffers.entities)
+	clear(&buffers.decorations)
+	append(&cache.pool, buffers)
+}
+
+delete_visual_chunk_buffers :: proc(buffers: Visual_Chunk_Buffers) {
+	delete(buffers.entities)
+	delete(buffers.decorations)
+	if buffers.texture.id != 0 {
+		rl.UnloadRenderTexture(buffers.texture)
+	}
+}
+
+//Marks a loaded chunk as used and counts the lookup. Returns false if the chunk isn't loaded.
+touch_chunk :: proc(level: ^Level, coord: ChunkCoord, kind: Chunk_Data_Kind, now: f64) -> bool {
+	switch kind {
+	case .collision:
+		if chunk, ok := &level.collision_map[coord]; ok {
+			chunk.last_access_time = now
+			level.cache.stats.hits += 1
+			return true
+		}
+	case .visual:
+		if chunk, ok := &level.active_chunks[coord]; ok {
+			chunk.last_access_time = now
+			level.cache.stats.hits += 1
+			return true
+		}
+	}
+	level.cache.stats.misses += 1
+	return false
+}
+
+collision_chunk_bytes :: proc(chunk: Collision_Chunk) -> int {
+	// mapped tiles live in the region file, not in our memory
+	if chunk.mapped || chunk.tiles == nil {
+		return size_of(Collision_Chunk)
+	}
+	return size_of(Collision_Chunk) + size_of(Collision_Tiles)
+}
+
+//CPU side only, the chunk's render texture lives on the GPU
+visual_chunk_bytes :: proc(chunk: Visual_Chunk) -> int {
+	return(
+		size_of(Visual_Chunk) +
+		cap(chunk.entities) * size_of(Entity_Handle) +
+		cap(chunk.decorations) * size_of(Decoration) \
+	)
+}
+
+chunk_cache_used_bytes :: proc(level: ^Level) -> int {
+	used := 0
+	for _, chunk in level.collision_map {
+		used += collision_chunk_bytes(chunk)
+	}
+	for _, chunk in level.active_chunks {
+		used += visual_chunk_bytes(chunk)
+	}
+	return used
+}
+
+//Evicts chunks until the cache is under budget, or only wanted chunks are left
+enforce_chunk_cache_budget :: proc(level: ^Level, streamer: ^Chunk_Streamer) {
+	cache := &level.cache
+	cache.stats.used_bytes = chunk_cache_used_bytes(level)
+	for cache.stats.used_bytes > cache.budget {
+		coord, kind, found := pick_chunk_to_evict(level)
+		if !found {
+			break
+		}
+		cache.stats.used_bytes -= evict_chunk(level, streamer, coord, kind)
+		cache.stats.evictions += 1
+	}
+}
+
+//Lowest score goes first: last use, minus CHUNK_CACHE_DISTANCE_WEIGHT seconds per chunk away
+pick_chunk_to_evict :: proc(
+	level: ^Level,
+) -> (
+	coord: ChunkCoord,
+	kind: Chunk_Data_Kind,
+	found: bool,
+) {
+	best_score := max(f64)
+	for c, chunk in level.collision_map {
+		if chunk_wanted(level, c, .collision) {
+			continue
+		}
+		score := chunk_eviction_score(level, c, chunk.last_access_time)
+		if score < best_score {
+			best_score = score
+			coord = c
+			kind = .collision
+			found = true
+		}
+	}
+	for c, chunk in level.active_chunks {
+		if chunk_wanted(level, c, .visual) {
+			continue
+		}
+		score := chunk_eviction_score(level, c, chunk.last_access_time)
+		if score < best_score {
+			best_score = score
+			coord = c
+			kind = .visual
+			found = true
+		}
+	}
+	return
+}
+
+chunk_eviction_score :: proc(level: ^Level, coord: ChunkCoord, last_access_time: f64) -> f64 {
+	distance := abs(coord.x - level.player_chunk.x) + abs(coord.y - level.player_chunk.y)
+	return last_access_time - f64(distance) * CHUNK_CACHE_DISTANCE_WEIGHT
+}
+
+//Unloads one chunk and returns how many bytes that freed
+evict_chunk :: proc(
+	level: ^Level,
+	streamer: ^Chunk_Streamer,
+	coord: ChunkCoord,
+	kind: Chunk_Data_Kind,
+) -> int {
+	switch kind {
+	case .collision:
+		chunk := level.collision_map[coord]
+		remove_collision_chunk(level, coord)
+		return collision_chunk_bytes(chunk)
+
+	case .visual:
+		chunk := level.active_chunks[coord]
+		if chunk.is_dirty {
+			// Hand the write to the worker, or write it here if no write slot is free right now
+			if !queue_chunk_write(streamer, coord, chunk) {
+				save_visual_chunk_to_disk(coord, chunk)
+			}
+			level.cache.stats.writebacks += 1
+		}
+		// Remove the entities the chunk spawned along with it
+		for handle in chunk.entities {
+			hm.remove(&g.entities, handle)
+		}
+		bytes := visual_chunk_bytes(chunk)
+		release_visual_chunk_buffers(&level.cache, chunk)
+		delete_key(&level.active_chunks, coord)
+		return bytes
+	}
+	return 0
+}
@@ -0,0 +1,174 @@
+package game
+
+import "core:fmt"
+import "core:hash"
+import "core:mem"
+
+//Binary chunk files, version 2. Shared by collision and visual chunks, the magic tells them apart.
+//
+// [4 bytes: magic] [2 bytes: version] [2 bytes: flags] [4 bytes: chunk_x] [4 bytes: chunk_y]
+// [4 bytes: payload size] [4 bytes: crc32 of the payload]
+// [payload]
+//
+// Collision payload: [tile layer, u8 per tile]
+// Visual payload:    [sprite layer, u16 per sprite]
+//                    [4 bytes: entity_count] [entity_count * 12 bytes: kind i32, pos x, pos y]
+//                    [4 bytes: decoration_count] [decoration_count * 16 bytes: pos x, pos y, sprite u32, layer i32]
+//
+// A layer is CHUNK_SIZE * CHUNK_SIZE values row by row, laid out exactly like the arrays in memory,
+// so an uncompressed layer is read with one copy (or not copied at all, see load_collision_chunk).
+// With .layer_rle set it is [4 bytes: encoded size] followed by runs of [1 byte: count] [value].
+//
+// Version 1 files have no header and start with chunk_x, chunk_y. They are still read.
+
+COLLISION_CHUNK_MAGIC :: u32(0x4C4F4343) // "CCOL"
+VISUAL_CHUNK_MAGIC :: u32(0x53495643) // "CVIS"
+
+Chunk_File_Flag :: enum u16 {
+	layer_rle, // the tile / sprite layer is run-length encoded
+}
+
+Chunk_File_Flags :: bit_set[Chunk_File_Flag; u16]
+
+Chunk_File_Header :: struct {
+	magic:        u32,
+	version:      u16,
+	flags:        Chunk_File_Flags,
+	chunk_x:      i32,
+	chunk_y:      i32,
+	payload_size: u32,
+	checksum:     u32,
+}
+
+//True if data starts with a version 2 header with this magic. Anything else is read as version 1.
+chunk_file_has_header :: proc(data: []byte, magic: u32) -> bool {
+	return len(data) >= size_of(Chunk_File_Header) && (cast(^u32)&data[0])^ == magic
+}
+
+//Checks the header against the expected version and coordinate, and the payload against its
+//checksum. Returns the payload.
+read_chunk_file_header :: proc(
+	data: []byte,
+	coord: ChunkCoord,
+	version: u16,
+	filepath: string,
+) -> (
+	header: Chunk_File_Header,
+	payload: []byte,
+	ok: bool,
+) {
+	header = (cast(^Chunk_File_Header)&data[0])^
+	if header.version != version {
+		fmt.printf("Unknown chunk version %i in %s, expected %i\n", header.version, filepath, version)
+		return
+	}
+	if header.chunk_x != coord.x || header.chunk_y != coord.y {
+		fmt.printf("Chunk coordinate mismatch in file: %s\n", filepath)
+		return
+	}
+	if int(header.payload_size) > len(data) - size_of(Chunk_File_Header) {
+		fmt.printf("Chunk file is truncated: %s\n", filepath)
+		return
+	}
+	payload = data[size_of(Chunk_File_Header):][:header.payload_size]
+	if hash.crc32(payload) != header.checksum {
+		fmt.printf("Chunk checksum mismatch in file: %s\n", filepath)
+		return
+	}
+	return header, payload, true
+}
+
+//Reads one layer from the front of src into dst, which is the in-memory array as bytes. Returns
+//how many bytes of src the layer took up.
+read_chunk_layer :: proc(src: []byte, dst: []byte, elem_size: int, rle: bool) -> (int, bool) {
+	if !rle {
+		if len(src) < len(dst) {
+			return 0, false
+		}
+		copy(dst, src[:len(dst)])
+		return len(dst), true
+	}
+
+	if len(src) < 4 {
+		return 0, false
+	}
+	encoded_size := int((cast(^u32)&src[0])^)
+	if encoded_size > len(src) - 4 {
+		return 0, false
+	}
+	runs := src[4:][:encoded_size]
+	out := 0
+	for i := 0; i < len(runs); i += 1 + elem_size {
+		if i + 1 + elem_size > len(runs) {
+			return 0, false
+		}
+		count := int(runs[i])
+		if count == 0 || out + count * elem_size > len(dst) {
+			return 0, false
+		}
+		value := runs[i + 1:][:elem_size]
+		for _ in 0 ..< count {
+			copy(dst[out:], value)
+			out += elem_size
+		}
+	}
+	return 4 + encoded_size, out == len(dst)
+}
+
+//Reserves room for the header at the start of buf. finish_chunk_file fills it in.
+begin_chunk_file :: proc(buf: ^[dynamic]byte) {
+	clear(buf)
+	resize(buf, size_of(Chunk_File_Header))
+}
+
+//Appends a layer, run-length encoded if that comes out smaller. Returns true if it was encoded.
+append_chunk_layer :: proc(buf: ^[dynamic]byte, layer: []byte, elem_size: int) -> bool {
+	start := len(buf^)
+	resize(buf, start + 4)
+	for i := 0; i < len(layer); {
+		value := layer[i:][:elem_size]
+		count := 1
+		for count < 255 &&
+		    i + (count + 1) * elem_size <= len(layer) &&
+		    string(layer[i + count * elem_size:][:elem_size]) == string(value) {
+			count += 1
+		}
+		append(buf, u8(count))
+		append(buf, ..value)
+		i += count * elem_size
+	}
+
+	encoded_size := len(buf^) - start - 4
+	if encoded_size < len(layer) {
+		(cast(^u32)&buf[start])^ = u32(encoded_size)
+		return true
+	}
+	resize(buf, start)
+	append(buf, ..layer)
+	return false
+}
+
+//Appends the bytes of v, for the fixed size fields after the layers
+append_chunk_value :: proc(buf: ^[dynamic]byte, v: $T) {
+	v := v
+	append(buf, ..mem.ptr_to_bytes(&v))
+}
+
+finish_chunk_file :: proc(
+	buf: []byte,
+	magic: u32,
+	version: u16,
+	coord: ChunkCoord,
+	flags: Chunk_File_Flags,
+) {
+	payload := buf[size_of(Chunk_File_Header):]
+	(cast(^Chunk_File_Header)&buf[0])^ = Chunk_File_Header {
+		magic        = magic,
+		version      = version,
+		flags        = flags,
+		chunk_x      = coord.x,
+		chunk_y      = coord.y,
+		payload_size = u32(len(payload)),
+		checksum     = hash.crc32(payload),
+	}
+}
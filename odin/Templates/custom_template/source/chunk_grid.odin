@@ -0,0 +1,133 @@
+package game
+
+import "core:math"
+import rl "vendor:raylib"
+
+//Dense lookup for collision tiles.
+//
+//One cell per chunk inside level.world_bounds, holding the chunk's tiles, or nil while it isn't
+//loaded. The collision_map still owns the chunks, add_collision_chunk / remove_collision_chunk
+//keep the grid in step with it. Looking up a tile is a floor per axis and two array loads, no
+//hashing.
+//
+//Tiles are addressed with global tile coordinates: x counts right from the left edge of chunk
+//x = 0, y counts upward from the ground like chunk y does (see world_pos_to_chunk). Inside a
+//chunk, tiles[y][x] is row y counted from the bottom of the chunk.
+
+Chunk_Grid :: struct {
+	min_chunk: ChunkCoord,
+	width:     i32,
+	height:    i32,
+	cells:     []^Collision_Tiles, // width * height, row by row
+}
+
+Tile_Coord :: struct {
+	x, y: i32,
+}
+
+//A run of tiles in one row of one chunk. tiles[0] is at (x, y), the rest continue to the right.
+Tile_Span :: struct {
+	tiles: []Tile_Type,
+	x, y:  i32,
+}
+
+init_chunk_grid :: proc(grid: ^Chunk_Grid, min_chunk, max_chunk: ChunkCoord) {
+	grid.min_chunk = min_chunk
+	grid.width = max_chunk.x - min_chunk.x + 1
+	grid.height = max_chunk.y - min_chunk.y + 1
+	grid.cells = make([]^Collision_Tiles, grid.width * grid.height)
+}
+
+delete_chunk_grid :: proc(grid: ^Chunk_Grid) {
+	delete(grid.cells)
+	grid^ = {}
+}
+
+//Index of the cell for coord, -1 outside the world bounds
+chunk_grid_index :: #force_inline proc(grid: ^Chunk_Grid, coord: ChunkCoord) -> i32 {
+	x := coord.x - grid.min_chunk.x
+	y := coord.y - grid.min_chunk.y
+	if x < 0 || x >= grid.width || y < 0 || y >= grid.height {
+		return -1
+	}
+	return y * grid.width + x
+}
+
+chunk_grid_set :: proc(grid: ^Chunk_Grid, coord: ChunkCoord, tiles: ^Collision_Tiles) {
+	if i := chunk_grid_index(grid, coord); i != -1 {
+		grid.cells[i] = tiles
+	}
+}
+
+//Tile under a world position. A tile covers [left, right) and [top, bottom) in world space.
+world_pos_to_tile :: proc(world_pos: [2]f32) -> Tile_Coord {
+	return {
+		i32(math.floor((world_pos.x + TOTAL_CHUNK_PIXELS / 2) / TILE_SIZE)),
+		i32(math.ceil(-world_pos.y / TILE_SIZE)) - 1,
+	}
+}
+
+//World space rectangle a tile covers
+tile_world_rect :: proc(tile: Tile_Coord) -> rl.Rectangle {
+	return {
+		f32(tile.x * TILE_SIZE - TOTAL_CHUNK_PIXELS / 2),
+		f32(-(tile.y + 1) * TILE_SIZE),
+		TILE_SIZE,
+		TILE_SIZE,
+	}
+}
+
+//Chunk a tile is in and its position inside that chunk. Floored, so tiles left of or below
+//chunk 0 land in the chunks before it.
+tile_to_chunk :: #force_inline proc(tile: Tile_Coord) -> (chunk: ChunkCoord, local: Tile_Coord) {
+	chunk = {math.floor_div(tile.x, CHUNK_SIZE), math.floor_div(tile.y, CHUNK_SIZE)}
+	local = {tile.x %% CHUNK_SIZE, tile.y %% CHUNK_SIZE}
+	return
+}
+
+get_tile :: proc(grid: ^Chunk_Grid, tile: Tile_Coord) -> Tile_Type {
+	chunk, local := tile_to_chunk(tile)
+	i := chunk_grid_index(grid, chunk)
+	if i == -1 || grid.cells[i] == nil {
+		return .EMPTY
+	}
+	return grid.cells[i][local.y][local.x]
+}
+
+get_tile_in_world :: proc(level: ^Level, world_pos: [2]f32) -> Tile_Type {
+	return get_tile(&level.grid, world_pos_to_tile(world_pos))
+}
+
+//Tiles overlapping rect, bottom row first, one span per chunk row. Chunks that aren't loaded are
+//left out, they count as empty. Returns how many spans were written to out, anything past
+//len(out) is dropped.
+get_tiles_in_rect :: proc(level: ^Level, rect: rl.Rectangle, out: []Tile_Span) -> int {
+	grid := &level.grid
+	half_chunk := f32(TOTAL_CHUNK_PIXELS / 2)
+	// Same half open edges as world_pos_to_tile, a rect touching a tile doesn't overlap it
+	x0 := i32(math.floor((rect.x + half_chunk) / TILE_SIZE))
+	x1 := i32(math.ceil((rect.x + rect.width + half_chunk) / TILE_SIZE)) - 1
+	y0 := i32(math.floor(-(rect.y + rect.height) / TILE_SIZE))
+	y1 := i32(math.ceil(-rect.y / TILE_SIZE)) - 1
+
+	count := 0
+	for y in y0 ..= y1 {
+		for x := x0; x <= x1; {
+			chunk, local := tile_to_chunk({x, y})
+			n := min(x1 - x + 1, CHUNK_SIZE - local.x)
+			if i := chunk_grid_index(grid, chunk); i != -1 && grid.cells[i] != nil {
+				if count == len(out) {
+					return count
+				}
+				out[count] = {
+					tiles = grid.cells[i][local.y][local.x:][:n],
+					x     = x,
+					y     = y,
+				}
+				count += 1
+			}
+			x += n
+		}
+	}
+	return count
+}
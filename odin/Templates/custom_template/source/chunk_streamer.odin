@@ -0,0 +1,434 @@
+package game
+
+import "../jobs"
+import "core:math/linalg"
+import "core:sync"
+import "core:thread"
+import "core:time"
+
+//Background chunk loading.
+//
+//update_chunks queues the chunks it wants, the worker thread reads and decodes them into one of
+//a fixed set of slots, and chunk_streamer_sync hands finished slots back to the main thread,
+//which creates the entities and inserts the chunk into the level.
+//
+//The main thread never waits on the worker: the handoff uses a try-lock and simply tries again
+//next frame if the worker happens to hold the mutex. The worker only holds it to pop a request or
+//push a result, never while touching the disk.
+//
+//The worker takes as many requests as there are free slots at once and decodes them as
+//background jobs on the job pool, one per slot, so several chunks are read at the same time.
+
+CHUNK_STREAM_SLOTS :: 8
+CHUNK_STREAM_MAX_REQUESTS :: 64
+//Dirty chunks that can be waiting to be written at once
+CHUNK_STREAM_WRITE_SLOTS :: 4
+//Seconds of player movement to look ahead when ranking requests, so chunks the player is heading
+//towards load before ones behind them
+CHUNK_STREAM_LOOKAHEAD :: f32(0.5)
+
+Chunk_Data_Kind :: enum {
+	collision,
+	visual,
+}
+
+Chunk_Data_Kinds :: bit_set[Chunk_Data_Kind]
+
+Chunk_Request :: struct {
+	coord:        ChunkCoord,
+	kinds:        Chunk_Data_Kinds,
+	priority:     f32, // distance in chunks, lowest is loaded first
+	requested_at: time.Tick,
+}
+
+//Preallocated decode target. Owned by the worker while busy and not in done, by the main thread
+//while it is in done or applied.
+Chunk_Slot :: struct {
+	request:         Chunk_Request,
+	busy:            bool,
+	collision:       Collision_Chunk,
+	collision_tiles: Collision_Tiles, // scratch for chunks that aren't in the region file
+	visual:          Decoded_Visual_Chunk,
+	visual_ok:       bool,
+}
+
+//An encoded chunk file waiting for the worker to write it. data is allocated and reused by the
+//main thread, the worker only reads it while busy is set.
+Chunk_Write_Slot :: struct {
+	coord: ChunkCoord,
+	data:  [dynamic]u8,
+	busy:  bool,
+}
+
+Chunk_Stream_Stats :: struct {
+	queue_depth:     i32, // requests waiting for the worker at the last handoff
+	in_flight:       i32, // slots being decoded or waiting to be picked up
+	loaded:          i32, // chunks handed to the level so far
+	last_latency_ms: f64, // request to handoff for the last chunk
+	avg_latency_ms:  f64,
+	max_latency_ms:  f64,
+}
+
+Chunk_Streamer :: struct {
+	mutex:        sync.Mutex,
+	cond:         sync.Cond,
+	worker:       ^thread.Thread,
+	region:       ^Region_File, // opened before the worker starts, read only afterwards
+
+	//guarded by mutex
+	running:      bool,
+	queue:        [CHUNK_STREAM_MAX_REQUESTS]Chunk_Request,
+	queue_len:    int,
+	done:         [CHUNK_STREAM_SLOTS]i32,
+	done_len:     int,
+	slots:        [CHUNK_STREAM_SLOTS]Chunk_Slot,
+	writes:       [CHUNK_STREAM_WRITE_SLOTS]Chunk_Write_Slot,
+	write_queue:  [CHUNK_STREAM_WRITE_SLOTS]i32,
+	write_len:    int,
+
+	//main thread only
+	outbox:       [CHUNK_STREAM_MAX_REQUESTS]Chunk_Request,
+	outbox_len:   int,
+	outbox_ready: bool, // outbox holds a full new request list, replace the queue with it
+	applied:      [CHUNK_STREAM_SLOTS]i32, // slots applied but not yet given back to the worker
+	applied_len:  int,
+	requested_at: map[ChunkCoord]time.Tick, // first time each pending chunk was asked for
+	stats:        Chunk_Stream_Stats,
+}
+
+init_chunk_streamer :: proc(region: ^Region_File) -> ^Chunk_Streamer {
+	s := new(Chunk_Streamer)
+	s.region = region
+	s.requested_at = make(map[ChunkCoord]time.Tick)
+	return s
+}
+
+//Starts the worker thread. Any running worker is stopped first, so this is also what restarts
+//the worker with the new code after a hot reload.
+start_chunk_streamer :: proc(s: ^Chunk_Streamer) {
+	stop_chunk_streamer(s)
+	s.running = true
+	s.worker = thread.create_and_start_with_poly_data(s, chunk_streamer_worker)
+}
+
+//Stops and joins the worker. Queued writes are finished first. Queued requests stay queued, slots
+//the worker finished stay in done.
+stop_chunk_streamer :: proc(s: ^Chunk_Streamer) {
+	if s.worker == nil {
+		return
+	}
+	sync.mutex_lock(&s.mutex)
+	s.running = false
+	sync.cond_broadcast(&s.cond)
+	sync.mutex_unlock(&s.mutex)
+
+	thread.join(s.worker)
+	thread.destroy(s.worker)
+	s.worker = nil
+}
+
+delete_chunk_streamer :: proc(s: ^Chunk_Streamer) {
+	stop_chunk_streamer(s)
+	for write in s.writes {
+		delete(write.data)
+	}
+	delete(s.requested_at)
+	free(s)
+}
+
+//Adds a chunk to the request list built this update. kinds is what is still missing for it.
+request_chunk :: proc(
+	s: ^Chunk_Streamer,
+	level: ^Level,
+	coord: ChunkCoord,
+	kinds: Chunk_Data_Kinds,
+	player_vel: Vec2,
+) {
+	if kinds == {} || !chunk_in_world_bounds(level, coord) {
+		return
+	}
+	for &req in s.outbox[:s.outbox_len] {
+		if req.coord == coord {
+			req.kinds += kinds
+			return
+		}
+	}
+	if s.outbox_len >= CHUNK_STREAM_MAX_REQUESTS {
+		return
+	}
+
+	requested_at, ok := s.requested_at[coord]
+	if !ok {
+		requested_at = time.tick_now()
+		s.requested_at[coord] = requested_at
+	}
+
+	s.outbox[s.outbox_len] = Chunk_Request {
+		coord        = coord,
+		kinds        = kinds,
+		priority     = chunk_stream_priority(coord, level.player_pos, player_vel),
+		requested_at = requested_at,
+	}
+	s.outbox_len += 1
+}
+
+//Distance in chunks from the chunk center to the player, or to where the player will be in
+//CHUNK_STREAM_LOOKAHEAD seconds if that is closer
+chunk_stream_priority :: proc(coord: ChunkCoord, player_pos, player_vel: Vec2) -> f32 {
+	center := chunk_center_world_pos(coord)
+	ahead := player_pos + player_vel * CHUNK_STREAM_LOOKAHEAD
+	dist := min(linalg.length(center - player_pos), linalg.length(center - ahead))
+	return dist / TOTAL_CHUNK_PIXELS
+}
+
+//Main thread handoff, call once per frame. Never blocks: if the worker holds the mutex right now
+//nothing is exchanged and it is tried again next frame.
+chunk_streamer_sync :: proc(s: ^Chunk_Streamer, level: ^Level) {
+	ready: [CHUNK_STREAM_SLOTS]i32
+	ready_len := 0
+
+	if sync.mutex_try_lock(&s.mutex) {
+		for slot_idx in s.applied[:s.applied_len] {
+			s.slots[slot_idx].busy = false
+		}
+		s.applied_len = 0
+
+		copy(ready[:], s.done[:s.done_len])
+		ready_len = s.done_len
+		s.done_len = 0
+
+		//replace the queue with this update's list, minus chunks the worker already has
+		if s.outbox_ready {
+			s.queue_len = 0
+			outer: for req in s.outbox[:s.outbox_len] {
+				for &slot in s.slots {
+					if slot.busy && slot.request.coord == req.coord {
+						continue outer
+					}
+				}
+				s.queue[s.queue_len] = req
+				s.queue_len += 1
+			}
+			s.outbox_len = 0
+			s.outbox_ready = false
+		}
+
+		s.stats.queue_depth = i32(s.queue_len)
+		s.stats.in_flight = 0
+		for &slot in s.slots {
+			if slot.busy {
+				s.stats.in_flight += 1
+			}
+		}
+
+		sync.cond_signal(&s.cond)
+		sync.mutex_unlock(&s.mutex)
+	}
+
+	for slot_idx in ready[:ready_len] {
+		apply_chunk_slot(s, level, &s.slots[slot_idx])
+		s.applied[s.applied_len] = slot_idx
+		s.applied_len += 1
+	}
+}
+
+//Syncs until everything requested so far has been decoded and applied. Blocks, so only for
+//headless runs, where chunks have to land on the same tick every run.
+finish_chunk_streaming :: proc(s: ^Chunk_Streamer, level: ^Level) {
+	for {
+		chunk_streamer_sync(s, level)
+
+		sync.mutex_lock(&s.mutex)
+		busy := 0
+		for &slot in s.slots {
+			if slot.busy {
+				busy += 1
+			}
+		}
+		//applied slots stay busy until the next sync gives them back
+		idle := !s.outbox_ready && s.queue_len == 0 && s.done_len == 0 && busy == s.applied_len
+		sync.mutex_unlock(&s.mutex)
+		if idle {
+			return
+		}
+		time.sleep(50 * time.Microsecond)
+	}
+}
+
+//Moves a finished slot into the level
+apply_chunk_slot :: proc(s: ^Chunk_Streamer, level: ^Level, slot: ^Chunk_Slot) {
+	coord := slot.request.coord
+	if .collision in slot.request.kinds && !(coord in level.collision_map) {
+		chunk := keep_collision_chunk(slot.collision)
+		chunk.last_access_time = g.current_time
+		add_collision_chunk(level, coord, chunk)
+	}
+	if .visual in slot.request.kinds && !(coord in level.active_chunks) {
+		chunk: Visual_Chunk
+		if slot.visual_ok {
+			chunk = build_visual_chunk(&level.cache, coord, &slot.visual)
+		} else {
+			chunk = generate_default_visual_chunk(&level.cache, coord)
+		}
+		chunk.last_access_time = g.current_time
+		level.active_chunks[coord] = chunk
+	}
+	delete_key(&s.requested_at, coord)
+
+	latency := time.duration_milliseconds(time.tick_since(slot.request.requested_at))
+	s.stats.loaded += 1
+	s.stats.last_latency_ms = latency
+	s.stats.max_latency_ms = max(s.stats.max_latency_ms, latency)
+	if s.stats.avg_latency_ms == 0 {
+		s.stats.avg_latency_ms = latency
+	} else {
+		s.stats.avg_latency_ms = s.stats.avg_latency_ms * 0.9 + latency * 0.1
+	}
+}
+
+//Encodes a dirty visual chunk into a free write slot and queues it for the worker. Returns false
+//without blocking if no slot is free or the worker holds the mutex, the caller saves it itself.
+queue_chunk_write :: proc(s: ^Chunk_Streamer, coord: ChunkCoord, chunk: Visual_Chunk) -> bool {
+	if !sync.mutex_try_lock(&s.mutex) {
+		return false
+	}
+	defer sync.mutex_unlock(&s.mutex)
+
+	for &write, i in s.writes {
+		if write.busy {
+			continue
+		}
+		encode_visual_chunk(coord, chunk, &write.data)
+		write.coord = coord
+		write.busy = true
+		s.write_queue[s.write_len] = i32(i)
+		s.write_len += 1
+		sync.cond_signal(&s.cond)
+		return true
+	}
+	return false
+}
+
+chunk_streamer_worker :: proc(s: ^Chunk_Streamer) {
+	profile_thread_name("chunk streamer")
+	for {
+		sync.mutex_lock(&s.mutex)
+		slot_idx := -1
+		write_idx := -1
+		for {
+			// Writes first, they hold on to a write slot until done and are never dropped
+			if s.write_len > 0 {
+				s.write_len -= 1
+				write_idx = int(s.write_queue[s.write_len])
+				break
+			}
+			if !s.running {
+				break
+			}
+			if s.queue_len > 0 {
+				slot_idx = find_free_chunk_slot(s)
+				if slot_idx != -1 {
+					break
+				}
+			}
+			sync.cond_wait(&s.cond, &s.mutex)
+		}
+
+		if write_idx != -1 {
+			sync.mutex_unlock(&s.mutex)
+			write := &s.writes[write_idx]
+			write_visual_chunk_file(write.coord, write.data[:])
+			free_all(context.temp_allocator)
+			sync.mutex_lock(&s.mutex)
+			write.busy = false
+			sync.mutex_unlock(&s.mutex)
+			continue
+		}
+		if !s.running {
+			sync.mutex_unlock(&s.mutex)
+			return
+		}
+
+		//take the most urgent requests, one per free slot, priorities are refreshed by every sync
+		batch := Chunk_Decode_Batch {
+			region = s.region,
+			slots  = &s.slots,
+		}
+		for ; slot_idx != -1 && s.queue_len > 0; slot_idx = find_free_chunk_slot(s) {
+			best := 0
+			for i in 1 ..< s.queue_len {
+				if s.queue[i].priority < s.queue[best].priority {
+					best = i
+				}
+			}
+			slot := &s.slots[slot_idx]
+			slot.request = s.queue[best]
+			slot.busy = true
+			s.queue_len -= 1
+			s.queue[best] = s.queue[s.queue_len]
+			batch.indices[batch.count] = i32(slot_idx)
+			batch.count += 1
+		}
+		sync.mutex_unlock(&s.mutex)
+
+		decode_chunk_batch(&batch)
+
+		sync.mutex_lock(&s.mutex)
+		for slot_idx in batch.indices[:batch.count] {
+			s.done[s.done_len] = slot_idx
+			s.done_len += 1
+		}
+		sync.mutex_unlock(&s.mutex)
+	}
+}
+
+Chunk_Decode_Batch :: struct {
+	region:  ^Region_File,
+	slots:   ^[CHUNK_STREAM_SLOTS]Chunk_Slot,
+	indices: [CHUNK_STREAM_SLOTS]i32,
+	count:   int,
+}
+
+//Decodes every slot of the batch, each as its own background job, and waits for all of them.
+//The worker helps with its own jobs while it waits, it has nothing else to do.
+decode_chunk_batch :: proc(batch: ^Chunk_Decode_Batch) {
+	counter: jobs.Counter
+	for i in 0 ..< batch.count {
+		jobs.submit_background(
+			job_pool(),
+			{procedure = decode_chunk_job, data = batch, start = i, end = i + 1, counter = &counter},
+		)
+	}
+	jobs.wait(job_pool(), &counter, background = true)
+}
+
+decode_chunk_job :: proc(data: rawptr, start, end: int) {
+	batch := (^Chunk_Decode_Batch)(data)
+	for i in start ..< end {
+		decode_chunk_slot(batch.region, &batch.slots[batch.indices[i]])
+	}
+	//paths and file reads go in this thread's temp allocator, nothing outlives the job.
+	//Background jobs only run on pool threads and the streamer, never inside a frame.
+	free_all(context.temp_allocator)
+}
+
+//Worker side: reads whatever the request asked for into the slot
+decode_chunk_slot :: proc(region: ^Region_File, slot: ^Chunk_Slot) {
+	profile_zone("decode_chunk_slot")
+	coord := slot.request.coord
+	if .collision in slot.request.kinds {
+		slot.collision = load_collision_chunk(region, coord, &slot.collision_tiles)
+	}
+	if .visual in slot.request.kinds {
+		slot.visual_ok = decode_visual_chunk_binary(region, coord, &slot.visual)
+	}
+}
+
+find_free_chunk_slot :: proc(s: ^Chunk_Streamer) -> int {
+	for &slot, i in s.slots {
+		if !slot.busy {
+			return i
+		}
+	}
+	return -1
+}
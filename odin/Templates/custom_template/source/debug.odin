@@ -18,6 +18,16 @@ debug_info_str: []cstring = {
 	"Anim_frame:",
 }
 
+//Profiler keys: F8 shows the flame graph of the last frame, F9 saves the trace
+update_debug_keys :: proc() {
+	if rl.IsKeyPressed(.F8) {
+		g.profiler.show = !g.profiler.show
+	}
+	if rl.IsKeyPressed(.F9) {
+		export_profile_trace(g.profiler, PROFILE_TRACE_PATH)
+	}
+}
+
 debug_player_draw :: proc() {
 	//p := get_player()
 	font_size := get_scaled_font_size()
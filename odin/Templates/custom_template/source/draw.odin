@@ -1,5 +1,4 @@
 package game
-import "core:fmt"
 import rl "vendor:raylib"
 
 draw_text_centered_spacing :: proc(
@@ -65,45 +64,67 @@ draw_text_right_aligned_spacing :: proc(
 	)
 }
 
-draw_visual_chunk :: proc(coord: ChunkCoord, chunk: Visual_Chunk, camera: rl.Camera2D) {
-	// Calculate world position of chunk (your existing logic)
-	chunk_world_pos := chunk_to_world_pos(coord)
-
-	// Convert world position to screen position
-	//chunk_screen_pos := world_to_screen(chunk_world_pos)
+//Visual chunks are baked into a render texture once and drawn with a single call after that.
+//Only chunks with texture_dirty set are baked again. Baking can't happen inside BeginMode2D, so
+//draw calls bake_visual_chunks before anything else each frame.
+bake_visual_chunks :: proc(level: ^Level) {
+	profile_zone("bake_visual_chunks")
+	for _, &chunk in level.active_chunks {
+		if chunk.texture_dirty {
+			bake_visual_chunk(&chunk)
+		}
+	}
+}
 
-	// Draw the sprite grid
+bake_visual_chunk :: proc(chunk: ^Visual_Chunk) {
+	if chunk.texture.id == 0 {
+		chunk.texture = rl.LoadRenderTexture(TOTAL_CHUNK_PIXELS, TOTAL_CHUNK_PIXELS)
+	}
+	rl.BeginTextureMode(chunk.texture)
+	rl.ClearBackground(rl.BLANK)
 	for y in 0 ..< CHUNK_SIZE {
 		for x in 0 ..< CHUNK_SIZE {
 			sprite_id := chunk.sprites[y][x]
 			if sprite_id != .NONE {
-				x_pos := x * TILE_SIZE - (CHUNK_SIZE * TILE_SIZE / 2)
-				y_pos :=
-					y - (y * TILE_SIZE) - int((coord.y * (TILE_SIZE * CHUNK_SIZE))) - TILE_SIZE
-				//fmt.printf("Printing tile at pos [x,y]: [%i,%i]\n", x_pos, y_pos)
-				// Calculate tile position in world space
-				//tile_world_pos := chunk_world_pos + {f32(x * TILE_SIZE), f32(y * TILE_SIZE)}
-
-				// Convert to screen space for Raylib
-
-
-				draw_sprite_at_screen_pos(sprite_id, Vec2{f32(x_pos), f32(y_pos)})
+				// Row 0 is the bottom of the chunk, same as the collision tiles
+				tile_pos := Vec2{f32(x * TILE_SIZE), f32(TOTAL_CHUNK_PIXELS - (y + 1) * TILE_SIZE)}
+				draw_sprite_at_screen_pos(sprite_id, tile_pos)
 			}
 		}
 	}
+	rl.EndTextureMode()
+	chunk.texture_dirty = false
+}
 
-	rl.DrawPixel(0,0,rl.BLACK)
-	/*
-	// Handle entities and decorations similarly
-	for entity in chunk.entities {
-		entity_screen_pos := world_to_screen(entity.pos, camera)
-		draw_sprite_at_screen_pos(entity.sprite, entity_screen_pos)
+//World space rectangle a chunk covers, matching tile_world_rect
+chunk_world_rect :: proc(coord: ChunkCoord) -> Rect {
+	return {
+		f32(coord.x * TOTAL_CHUNK_PIXELS - TOTAL_CHUNK_PIXELS / 2),
+		f32(-(coord.y + 1) * TOTAL_CHUNK_PIXELS),
+		TOTAL_CHUNK_PIXELS,
+		TOTAL_CHUNK_PIXELS,
 	}
+}
 
-	for decoration in chunk.decorations {
-		decoration_screen_pos := world_to_screen(decoration.pos, camera)
-		draw_sprite_at_screen_pos(decoration.sprite, decoration_screen_pos)
-	}*/
+//World space rectangle the camera sees
+camera_world_rect :: proc(camera: rl.Camera2D) -> Rect {
+	top_left := rl.GetScreenToWorld2D({0, 0}, camera)
+	bottom_right := rl.GetScreenToWorld2D(
+		{f32(rl.GetScreenWidth()), f32(rl.GetScreenHeight())},
+		camera,
+	)
+	return {top_left.x, top_left.y, bottom_right.x - top_left.x, bottom_right.y - top_left.y}
+}
+
+//One draw call for the whole chunk, nothing if it's off screen or not baked yet
+draw_visual_chunk :: proc(coord: ChunkCoord, chunk: ^Visual_Chunk, view: Rect) {
+	rect := chunk_world_rect(coord)
+	if chunk.texture.id == 0 || !rl.CheckCollisionRecs(rect, view) {
+		return
+	}
+	// Render textures are stored upside down, flip the source rect
+	source := Rect{0, 0, TOTAL_CHUNK_PIXELS, -TOTAL_CHUNK_PIXELS}
+	rl.DrawTextureRec(chunk.texture.texture, source, {rect.x, rect.y}, rl.WHITE)
 }
 
 
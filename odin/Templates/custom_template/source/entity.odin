@@ -1,6 +1,7 @@
 package game
 
 import hm "../handle_map"
+import "../jobs"
 import "core:fmt"
 import rl "vendor:raylib"
 
@@ -21,6 +22,9 @@ Entity :: struct {
 
 	// just put whatever state you need in here to make the game...
 	pos:                 Vec2,
+	//set along with pos when placing an entity, or it is drawn sliding over from where it was
+	prev_pos:            Vec2, // pos before the last fixed step, for drawing in between
+	has_prev_pos:        bool,
 	size:                Vec2,
 	dir:                 Entity_Direction,
 	last_movement:       Entity_Movement,
@@ -55,6 +59,8 @@ Entity :: struct {
 	feet_collider:       Rect,
 	face_collider:       Rect,
 	head_collider:       Rect,
+	//what the colliders touched in the collision tiles last update (see tile_physics.odin)
+	tile_contacts:       Tile_Contacts,
 
 
 	//AI Entity
@@ -145,6 +151,8 @@ create_random_entity :: proc(kind: EntityKind, pos: Vec2) {
 		Entity {
 			anim = animation_create(.Goblin_Idle),
 			pos = pos,
+			prev_pos = pos,
+			has_prev_pos = true,
 			dir = .left,
 			vel = {0, 0},
 			size = {},
@@ -170,6 +178,8 @@ create_entity :: proc(kind: EntityKind, pos: Vec2) -> Entity_Handle {
 		Entity {
 			anim = animation_create(.Goblin_Idle),
 			pos = pos,
+			prev_pos = pos,
+			has_prev_pos = true,
 			dir = .left,
 			vel = {0, 0},
 			size = {},
@@ -195,6 +205,8 @@ create_player_entity :: proc(pos: Vec2) {
 		Entity {
 			anim = animation_create(.Frog_Idle),
 			pos = pos,
+			prev_pos = pos,
+			has_prev_pos = true,
 			dir = .left,
 			vel = {0, 0},
 			size = {},
@@ -214,49 +226,55 @@ create_player_entity :: proc(pos: Vec2) {
 
 draw_entities :: proc(fade: f32) {
 	ENTITES_DRAWN = 0
-	//iter := hm.make_iter(&g.entities)
-	//     for e in hm.iter(&my_iter) {})
+	//Culling happens in batch_sprite against a view worked out once for the whole batch
+	begin_sprite_batch(g.sprite_batch, game_camera())
 	for &item in g.entities.items {
 		if hm.skip(item) {
 			// If you want to skip drawing this entity, you can continue here
 			continue
 		}
-		if within_camera_bounds(item.handle) == false {
-			// If the entity is not within camera bounds, skip drawing it
-			continue
+		if draw_entity(item.handle, fade) {
+			ENTITES_DRAWN += 1
 		}
+	}
+	flush_sprite_batch(g.sprite_batch)
 
-		draw_entity(item.handle, fade)
-		ENTITES_DRAWN += 1
+	//colliders on top of the sprites
+	if DEBUG_DRAW_COLLIDERS {
+		for &item in g.entities.items {
+			if !hm.skip(item) {
+				draw_entity_colliders(item.handle)
+			}
+		}
 	}
-	// do stuff
 }
 
-draw_entity :: proc(e: Entity_Handle, fade: f32) {
+//Queues the entity in g.sprite_batch, returns false if it wasn't (culled or invalid)
+draw_entity :: proc(e: Entity_Handle, fade: f32) -> bool {
 	// draw the entity
 	if !hm.valid(g.entities, e) {
 		fmt.printf("Entity handle %v is not valid, cannot draw it\n", e)
-		return
+		return false
 	}
-	draw_entity_generic(e, fade)
+	return draw_entity_generic(e, fade)
 }
 
-draw_entity_generic :: proc(entity_handle: Entity_Handle, fade: f32) {
+draw_entity_generic :: proc(entity_handle: Entity_Handle, fade: f32) -> bool {
 	//fmt.printf("Drawing entity with handle %v\n", entity_handle)
 	if !hm.valid(g.entities, entity_handle) {
 		fmt.printf("Entity handle %v is not valid, cannot draw it\n", entity_handle)
-		return
+		return false
 	}
 	ent := hm.get(g.entities, entity_handle)
 
 	if ent == nil {
 		fmt.printf("Entity with handle %v not found\n", entity_handle)
-		return
+		return false
 	}
 
 	if ent.kind == .nil {
 		fmt.printf("Entity with handle %v has no kind set, cannot draw it\n", entity_handle)
-		return
+		return false
 	}
 
 	anim_texture := animation_atlas_texture(ent.anim)
@@ -275,9 +293,10 @@ draw_entity_generic :: proc(entity_handle: Entity_Handle, fade: f32) {
 
 	//destination rect tells us where on screeen to draw the entity
 	//adjusted by the offset
+	pos := entity_draw_pos(ent)
 	dest := Rect {
-		ent.pos.x + offset.x,
-		ent.pos.y + offset.y,
+		pos.x + offset.x,
+		pos.y + offset.y,
 		anim_texture.rect.width,
 		anim_texture.rect.height,
 	}
@@ -313,10 +332,18 @@ draw_entity_generic :: proc(entity_handle: Entity_Handle, fade: f32) {
 		anim_texture.document_size.y - 1, // -1 because there's an outline in the player anim that takes an extra pixel
 	}
 
-	rl.DrawTexturePro(atlas, atlas_rect, dest, origin, rotation, rl.Fade(rl.WHITE, fade))
-	if DEBUG_DRAW_COLLIDERS {
-		draw_entity_colliders(entity_handle)
-	}
+	return batch_sprite(
+		g.sprite_batch,
+		{
+			texture = atlas,
+			source = atlas_rect,
+			dest = dest,
+			origin = origin,
+			rotation = rotation,
+			tint = rl.Fade(rl.WHITE, fade),
+			layer = SPRITE_LAYER_PLAYER if ent.kind == .player else SPRITE_LAYER_ENTITIES,
+		},
+	)
 }
 
 draw_entity_colliders :: proc(entity_handle: Entity_Handle) {
@@ -336,16 +363,38 @@ draw_entity_colliders :: proc(entity_handle: Entity_Handle) {
 	rl.DrawPixelV(ent.pos, rl.PURPLE)
 }
 
-update_entities :: proc(dt: f32) {
-	//iter := hm.make_iter(&g.entities)
-	//     for e in hm.iter(&my_iter) {})
-	for &item in g.entities.items {
-		if hm.skip(item) {
-			continue
-		}
+//Fills out with the entities whose collider rect overlaps rect, uses the quadtree so it doesn't
+//walk every entity. Returns how many handles were written.
+get_entities_in_rect :: proc(rect: Rect, out: []Entity_Handle) -> int {
+	return query_rect(quadtree, rect_to_entity_rect(rect, {rect.x, rect.y}), out)
+}
 
-		update_entity_generic(item.handle, dt)
-	}
+ENTITY_JOB_BATCH :: 64
+
+//Everything but the player, which fixed_step updates first, spread over the job pool. An NPC
+//only writes to itself and reads the level and the player, so they don't depend on each other.
+//Nothing may be added to or removed from g.entities in here.
+update_npc_entities :: proc(dt: f32) {
+	profile_zone("update_npc_entities")
+	dt := dt
+	jobs.parallel_for(
+		job_pool(),
+		len(g.entities.items),
+		ENTITY_JOB_BATCH,
+		&dt,
+		proc(data: rawptr, start, end: int) {
+			dt := (^f32)(data)^
+			//iter := hm.make_iter(&g.entities)
+			//     for e in hm.iter(&my_iter) {})
+			for &item in g.entities.items[start:end] {
+				if hm.skip(item) || item.handle == g.player_handle {
+					continue
+				}
+
+				update_entity_generic(item.handle, dt)
+			}
+		},
+	)
 }
 
 update_entity_generic :: proc(entity_handle: Entity_Handle, dt: f32) {
@@ -373,6 +422,10 @@ update_entity_generic :: proc(entity_handle: Entity_Handle, dt: f32) {
 		update_player(dt)
 	case .goblin:
 		update_goblin(entity_handle, dt)
+		ent.tile_contacts = move_entity(&g.level, ent, ent.vel * dt)
+		//contacts are tested with the feet and head colliders at the new position
+		update_entity_colliders(entity_handle)
+		ent.tile_contacts += entity_tile_contacts(&g.level, ent)
 	/*case .ogre:
 		update_ogre(entity_handle, dt)
 	case .big_boss_goblin:
@@ -465,7 +518,7 @@ update_goblin :: proc(entity_handle: Entity_Handle, dt: f32) {
 	//update the y velocity 
 	goblin.pos += (goblin.vel * dt)
 
-	//create_trail_effect(&g.particle_system, goblin.pos, goblin.vel)
+	//create_trail_effect(g.particle_system, goblin.pos, goblin.vel)
 	// Update animation based on movement
 	/*if goblin.movement == .walking {
 		goblin.anim = animation_create(.Frog_Move)
@@ -773,7 +826,7 @@ update_entity_colliders :: proc(entity_handle: Entity_Handle) {
 		p_height = r.height
 		ent.rect = {ent.pos.x - p_width / 2, ent.pos.y, p_width, p_height}
 	}
-
+	ent.ent_rect = rect_to_entity_rect(ent.rect, ent.pos)
 }
 
 
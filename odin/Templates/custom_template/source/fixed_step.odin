@@ -0,0 +1,115 @@
+package game
+
+import hm "../handle_map"
+import "../jobs"
+import rl "vendor:raylib"
+
+//Fixed timestep.
+//
+//Gameplay advances in steps of FIXED_DT no matter the frame rate. Each frame adds its time to
+//g.time_accumulator and run_fixed_steps takes as many whole steps out of it as fit, at most
+//MAX_CATCH_UP_STEPS. After a longer stall the rest is dropped and the game slows down for a
+//moment, rather than taking one huge step (tunneling) or spending the next frames catching up.
+//
+//Drawing happens every frame, in between two steps. Entities are drawn at
+//entity_draw_pos, between where they were before the last step and where they are now, by
+//g.step_alpha, so a 144 Hz render of a 60 Hz simulation still moves smoothly.
+//
+//Presses and releases of INPUT_LATCHED_KEYS are kept until the next step runs. On a frame
+//without a step they would otherwise be missed.
+//
+//The player goes first, on the main thread, it reads input, plays sounds, spawns particles and
+//can add or remove entities. After that the NPCs and the particles don't touch each other and
+//run as two phases on the job pool at the same time.
+
+FIXED_TICK_RATE :: #config(TICK_RATE, 60)
+FIXED_DT :: 1 / f32(FIXED_TICK_RATE)
+MAX_CATCH_UP_STEPS :: 5
+
+INPUT_LATCHED_KEYS := [?]rl.KeyboardKey{.R, .LEFT_SHIFT, .LEFT, .A, .RIGHT, .D, .SPACE, .W}
+
+Input_Latch :: struct {
+	pressed:  bit_set[0 ..< 16],
+	released: bit_set[0 ..< 16],
+}
+
+Fixed_Step_Stats :: struct {
+	steps:      i32, // steps taken last frame
+	dropped_ms: f64, // time thrown away since the start, when frames were too slow to catch up
+}
+
+//Runs the steps this frame's time pays for, then works out g.step_alpha for drawing
+run_fixed_steps :: proc(frame_dt: f32) {
+	latch_input()
+	g.time_accumulator += frame_dt
+	g.step_stats.steps = 0
+	for g.time_accumulator >= FIXED_DT {
+		if g.step_stats.steps == MAX_CATCH_UP_STEPS {
+			//too far behind, drop the whole steps that are left
+			behind := f32(int(g.time_accumulator / FIXED_DT)) * FIXED_DT
+			g.step_stats.dropped_ms += f64(behind) * 1000
+			g.time_accumulator -= behind
+			break
+		}
+		fixed_step()
+		g.time_accumulator -= FIXED_DT
+		g.step_stats.steps += 1
+	}
+	g.step_alpha = g.time_accumulator / FIXED_DT
+}
+
+fixed_step :: proc() {
+	profile_zone("fixed_step")
+	for &item in g.entities.items {
+		if !hm.skip(item) {
+			item.prev_pos = item.pos
+			item.has_prev_pos = true
+		}
+	}
+	dt = FIXED_DT
+	if hm.valid(g.entities, g.player_handle) {
+		update_entity_generic(g.player_handle, FIXED_DT)
+	}
+	phases := [?]jobs.Phase {
+		{name = "npcs", procedure = step_npcs},
+		{name = "particles", procedure = step_particles},
+	}
+	jobs.run_phases(job_pool(), phases[:])
+	g.input_latch = {}
+}
+
+step_npcs :: proc(_: rawptr) {
+	update_npc_entities(FIXED_DT)
+}
+
+step_particles :: proc(_: rawptr) {
+	update_particle_system(g.particle_system, FIXED_DT)
+}
+
+//Where to draw e this frame
+entity_draw_pos :: proc(e: ^Entity) -> Vec2 {
+	if !e.has_prev_pos {
+		return e.pos
+	}
+	return e.prev_pos + (e.pos - e.prev_pos) * g.step_alpha
+}
+
+latch_input :: proc() {
+	for key, i in INPUT_LATCHED_KEYS {
+		if frame_key_pressed(key) {
+			g.input_latch.pressed += {i}
+		}
+		if frame_key_released(key) {
+			g.input_latch.released += {i}
+		}
+	}
+}
+
+latched_key_index :: proc(key: rl.KeyboardKey) -> int {
+	for k, i in INPUT_LATCHED_KEYS {
+		if k == key {
+			return i
+		}
+	}
+	return -1
+}
@@ -0,0 +1,149 @@
+package game
+
+import "core:fmt"
+import "core:mem"
+import vmem "core:mem/virtual"
+import rl "vendor:raylib"
+
+//Per frame memory.
+//
+//Which allocator to use:
+//
+//- Anything that only lives until the end of the frame (paths, formatted strings, lists built
+//  and consumed in one update) goes in context.temp_allocator. During a frame it is the frame
+//  arena, which is reset at the start of the next one, so it is never freed by hand.
+//- Scratch that is only needed inside one proc can be given back early with scratch_scope(),
+//  everything allocated after it is dropped when the scope ends.
+//- context.allocator is the general heap, for things that outlive the frame. During a frame it
+//  counts every allocation, shown in the F4 overlay. Steady gameplay should show zero.
+//
+//Other threads keep their own context.temp_allocator and free it themselves.
+
+FRAME_ARENA_RESERVE :: 64 * mem.Megabyte
+//Allocation sizes are counted in buckets of powers of four: <=16, <=64, ... <=64KB, larger
+FRAME_ALLOC_BUCKETS :: 8
+
+Frame_Alloc_Stats :: struct {
+	allocs:     i32, // heap allocations and resizes
+	frees:      i32,
+	bytes:      i64,
+	histogram:  [FRAME_ALLOC_BUCKETS]i32,
+	arena_used: uint, // frame arena bytes in use when the frame ended
+}
+
+Frame_Memory :: struct {
+	arena:      vmem.Arena,
+	heap:       mem.Allocator, // where counted allocations go
+	stats:      Frame_Alloc_Stats, // this frame so far
+	last:       Frame_Alloc_Stats, // the last finished frame, drawn by the overlay
+	arena_peak: uint,
+}
+
+init_frame_memory :: proc() -> ^Frame_Memory {
+	fm := new(Frame_Memory)
+	if err := vmem.arena_init_static(&fm.arena, FRAME_ARENA_RESERVE); err != nil {
+		fmt.printf("ERR - Frame arena could not be reserved: %v\n", err)
+	}
+	return fm
+}
+
+delete_frame_memory :: proc(fm: ^Frame_Memory) {
+	vmem.arena_destroy(&fm.arena)
+	free(fm)
+}
+
+//Ends the last frame and starts a new one: the arena is reset and the counters start over.
+//Returns the allocators for the frame, put them in the context for update and draw.
+begin_frame_memory :: proc(
+	fm: ^Frame_Memory,
+	heap: mem.Allocator,
+) -> (
+	temp_allocator: mem.Allocator,
+	allocator: mem.Allocator,
+) {
+	fm.stats.arena_used = fm.arena.total_used
+	fm.arena_peak = max(fm.arena_peak, fm.arena.total_used)
+	fm.last = fm.stats
+	fm.stats = {}
+	vmem.arena_free_all(&fm.arena)
+
+	fm.heap = heap
+	return vmem.arena_allocator(&fm.arena), {procedure = frame_heap_allocator_proc, data = fm}
+}
+
+//Marks the frame arena, everything allocated from it after this is freed when the scope ends
+@(deferred_out = end_scratch_scope)
+scratch_scope :: proc() -> vmem.Arena_Temp {
+	return vmem.arena_temp_begin(&g.frame_memory.arena)
+}
+
+end_scratch_scope :: proc(temp: vmem.Arena_Temp) {
+	vmem.arena_temp_end(temp)
+}
+
+//Passes everything on to fm.heap, counting allocations on the way
+frame_heap_allocator_proc :: proc(
+	allocator_data: rawptr,
+	mode: mem.Allocator_Mode,
+	size, alignment: int,
+	old_memory: rawptr,
+	old_size: int,
+	loc := #caller_location,
+) -> (
+	[]byte,
+	mem.Allocator_Error,
+) {
+	fm := (^Frame_Memory)(allocator_data)
+	#partial switch mode {
+	case .Alloc, .Alloc_Non_Zeroed, .Resize, .Resize_Non_Zeroed:
+		fm.stats.allocs += 1
+		fm.stats.bytes += i64(size)
+		bucket := 0
+		for limit := 16; size > limit && bucket < FRAME_ALLOC_BUCKETS - 1; limit *= 4 {
+			bucket += 1
+		}
+		fm.stats.histogram[bucket] += 1
+	case .Free:
+		fm.stats.frees += 1
+	}
+	return fm.heap.procedure(fm.heap.data, mode, size, alignment, old_memory, old_size, loc)
+}
+
+//Two lines from pos upward: counts and arena use, then the sizes of the heap allocations
+draw_frame_memory_overlay :: proc(fm: ^Frame_Memory, pos: Vec2, font_size: f32) {
+	stats := fm.last
+	rl.DrawTextEx(
+		rl.GetFontDefault(),
+		rl.TextFormat(
+			"Heap %i allocs, %i frees, %iB this frame | frame arena %iKB, peak %iKB",
+			stats.allocs,
+			stats.frees,
+			i32(stats.bytes),
+			i32(stats.arena_used / 1024),
+			i32(fm.arena_peak / 1024),
+		),
+		pos,
+		font_size,
+		MENU_SPACING,
+		rl.BLACK,
+	)
+	h := stats.histogram
+	rl.DrawTextEx(
+		rl.GetFontDefault(),
+		rl.TextFormat(
+			"Heap sizes <=16B %i, 64B %i, 256B %i, 1KB %i, 4KB %i, 16KB %i, 64KB %i, more %i",
+			h[0],
+			h[1],
+			h[2],
+			h[3],
+			h[4],
+			h[5],
+			h[6],
+			h[7],
+		),
+		{pos.x, pos.y - 20},
+		font_size,
+		MENU_SPACING,
+		rl.BLACK,
+	)
+}
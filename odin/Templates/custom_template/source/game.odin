@@ -28,6 +28,7 @@ created.
 package game
 
 import hm "../handle_map"
+import "../jobs"
 import "core:fmt"
 import "core:mem"
 import rl "vendor:raylib"
@@ -138,13 +139,18 @@ Game_Memory :: struct {
 	in_menu:           bool,
 	editing:           bool,
 	finished:          bool,
+
+	//fixed timestep, see fixed_step.odin
 	time_accumulator:  f32,
+	step_alpha:        f32,
+	step_stats:        Fixed_Step_Stats,
+	input_latch:       Input_Latch,
 
 	//Globals
 	run:               bool,
 	won_at:            f64,
 	initialized:       bool,
-	entities:          hm.Handle_Map(Entity, Entity_Handle, MAX_ENTITIES),
+	entities:          hm.Dense_Handle_Map(Entity, Entity_Handle, MAX_ENTITIES),
 	player_handle:     Entity_Handle,
 	main_menu:         Menu,
 	options_menu:      Menu,
@@ -155,8 +161,26 @@ Game_Memory :: struct {
 	state_changed:     bool,
 	graphics_settings: Graphics_Settings,
 
-	//particles?
-	particle_system:   Particle_System,
+	//particles, allocated separately since the SoA arrays are a few MB
+	particle_system:   ^Particle_System,
+
+	//frame profiler rings, see profiler.odin
+	profiler:          ^Profiler,
+
+	//frame arena and heap allocation counts, see frame_memory.odin
+	frame_memory:      ^Frame_Memory,
+
+	//sprites queued for the frame, see sprite_batch.odin
+	sprite_batch:      ^Sprite_Batch,
+
+	//spatial partitioning, lives here so its node pool survives hot reloads
+	quadtree:          Quadtree,
+
+	//chunk streaming, the worker thread is restarted on hot reload
+	chunk_streamer:    ^Chunk_Streamer,
+
+	//worker threads, owned by the host so they outlive hot reloads, see game_set_job_pool
+	job_pool:          ^jobs.Pool,
 
 	//shader
 	frog_shader:       rl.Shader,
@@ -166,9 +190,12 @@ Game_Memory :: struct {
 
 	//current time
 	current_time:      f64,
+
+	//scripted input and fixed clock for headless runs, see headless.odin
+	sim:               Sim_State,
 }
 
-quadtree: Quadtree
+quadtree: ^Quadtree
 edit_tex: i32
 atlas: rl.Texture2D
 hit_sound: rl.Sound
@@ -223,7 +250,7 @@ init :: proc() {
 		state = .mainMenu,
 		atlas = rl.LoadTextureFromImage(atlas_image),
 		run = true,
-		entities = hm.make(Entity, Entity_Handle, MAX_ENTITIES, context.allocator),
+		entities = hm.make_dense(Entity, Entity_Handle, MAX_ENTITIES, context.allocator),
 		graphics_settings = Graphics_Settings {
 			borderless = false,
 			windowed = true,
@@ -233,6 +260,12 @@ init :: proc() {
 		//game_shader = Game_Shader{},
 	}
 	rl.SetShapesTexture(atlas, SHAPES_TEXTURE_RECT)
+	g.profiler = new(Profiler)
+	g.frame_memory = init_frame_memory()
+	g.particle_system = new(Particle_System)
+	init_particle_system(g.particle_system)
+	g.sprite_batch = new(Sprite_Batch)
+	init_sprite_batch(g.sprite_batch)
 
 	//This clears the handlemap and creates the player handle. 
 	reset_handles()
@@ -262,6 +295,9 @@ init :: proc() {
 	// Set up current level
 	init_menu()
 	init_level(&g.level)
+	quadtree = &g.quadtree
+	init_quadtree(quadtree, QUADTREE_QUAD_SIZE, QUADTREE_NUM_QUADS)
+	g.chunk_streamer = init_chunk_streamer(&g.level.region)
 
 	fmt.printf("Player Pos: %v\n", level.player_pos)
 	game_hot_reloaded(g)
@@ -270,6 +306,7 @@ init :: proc() {
 // Main update loop
 // Handles input first, THEN updates entities accordingly. 
 update :: proc() {
+	profile_zone("update")
 
 	update_camera()
 
@@ -292,16 +329,16 @@ update :: proc() {
 		g.graphics_settings.fullscreen = !g.graphics_settings.fullscreen
 	}
 	if rl.IsKeyPressed(.F4) {
-		fmt.printf("DEBUG TOGGLED!\n")
 		DEBUG_DRAW = !DEBUG_DRAW
 	}
+	update_debug_keys()
 
 	if rl.IsKeyPressed(.P) {
 		PAUSE = !PAUSE
 	}
 
-	//close game
-	if (rl.WindowShouldClose()) {
+	//close game, there is no window to close when headless
+	if !g.sim.headless && rl.WindowShouldClose() {
 		g.run = !g.run
 	}
 
@@ -329,24 +366,29 @@ update :: proc() {
 }
 
 update_play :: proc() {
-	dt = rl.GetFrameTime()
+	profile_zone("update_play")
+	dt = frame_time()
 	real_dt = dt
+	g.current_time = game_time()
 
 	update_level(&g.level, dt)
 
 	if rl.IsMouseButtonPressed(.LEFT) {
 		m_pos_world := rl.GetScreenToWorld2D(rl.GetMousePosition(), game_camera())
-		ent_iter := hm.make_iter(&g.entities)
-		for e, h in hm.iter(&ent_iter) {
-			if rl.CheckCollisionPointRec(m_pos_world, e.rect) {
-				if h == g.player_handle {
-					//we clicked on the player
-					fmt.printf("Clicked on player!\n")
-				} else {
-					//we clicked on another entity
-					fmt.printf("Clicked on entity with handle: %v\nof type: %v\n", h, e.kind)
-					e.debug_draw_bool = !e.debug_draw_bool
-				}
+		clicked: [64]Entity_Handle
+		num_clicked := get_entities_in_rect(Rect{m_pos_world.x, m_pos_world.y, 0, 0}, clicked[:])
+		for h in clicked[:num_clicked] {
+			e := hm.get(g.entities, h)
+			if e == nil {
+				continue
+			}
+			if h == g.player_handle {
+				//we clicked on the player
+				fmt.printf("Clicked on player!\n")
+			} else {
+				//we clicked on another entity
+				fmt.printf("Clicked on entity with handle: %v\nof type: %v\n", h, e.kind)
+				e.debug_draw_bool = !e.debug_draw_bool
 			}
 		}
 		if rl.CheckCollisionPointRec(m_pos_world, get_player().rect) {
@@ -374,6 +416,16 @@ update_play :: proc() {
 		DEBUG_DRAW_COLLIDERS = !DEBUG_DRAW_COLLIDERS
 	}
 
+	//Switch quadtree between incremental updates and full rebuilds to compare frame times
+	if rl.IsKeyPressed(.F3) {
+		toggle_quadtree_mode(quadtree)
+	}
+
+	//Compare AoS and SoA entity layouts, results go to the console
+	if rl.IsKeyPressed(.F7) {
+		run_entity_layout_benchmark()
+	}
+
 	//Pause game 
 	if rl.IsKeyPressed(.ESCAPE) {
 		//delete_current_level()
@@ -417,31 +469,24 @@ update_play :: proc() {
 		return
 	}
 
-	//PHYSICS
-	g.time_accumulator += dt
-	PHYSICS_STEP :: 1 / 60.0
-	/*for g.timentity_handle_accumulator >= PHYSICS_STEP {
-		//do physics step
-		//fmt.printf("TODO - Physics step\n")
-		g.time_accumulator -= PHYSICS_STEP
-		//physics_update()
-	}*/
+	//Entities and particles, in fixed steps
+	run_fixed_steps(dt)
+	update_chunks(g)
 
-	//Update player
-	update_entities(dt)
-	//update_player(dt)
+	quadtree_update(quadtree)
 }
 
 update_quadtree :: proc() {
-	fmt.printf("Update quadtree\n")
 	dt = rl.GetFrameTime()
 	real_dt = dt
 
-	build_quadtree()
+	quadtree_update(quadtree)
 }
 
 //main draw function
 draw :: proc() {
+	profile_zone("draw")
+	bake_visual_chunks(&g.level)
 
 	//used when inside menu to fade background images
 	fade: f32
@@ -533,6 +578,106 @@ draw :: proc() {
 		MENU_SPACING,
 		rl.BLACK,
 	)
+
+	if DEBUG_DRAW {
+		//broad phase pair count, the buffer caps it so the number saturates at len(pairs)
+		pairs: [256]Entity_Pair
+		num_pairs := query_pairs(quadtree, pairs[:])
+		rl.DrawTextEx(
+			rl.GetFontDefault(),
+			rl.TextFormat(
+				"Quadtree [F3] %s: %.3fms, moved %i, pairs %i | avg incremental %.3fms, rebuild %.3fms",
+				quadtree_mode_names[quadtree.mode],
+				quadtree.stats.update_ms,
+				quadtree.stats.moved,
+				i32(num_pairs),
+				quadtree.stats.avg_ms[.incremental],
+				quadtree.stats.avg_ms[.rebuild],
+			),
+			{10, f32(rl.GetScreenHeight()) - 40},
+			font_size,
+			MENU_SPACING,
+			rl.BLACK,
+		)
+		rl.DrawTextEx(
+			rl.GetFontDefault(),
+			rl.TextFormat(
+				"Quadtree nodes %i (pool %i), depth %i/%i, overflow %i",
+				quadtree.stats.nodes_used,
+				i32(len(quadtree.nodes)),
+				quadtree.stats.max_depth,
+				i32(QUADTREE_MAX_DEPTH),
+				quadtree.stats.overflow,
+			),
+			{10, f32(rl.GetScreenHeight()) - 60},
+			font_size,
+			MENU_SPACING,
+			rl.BLACK,
+		)
+		stream := g.chunk_streamer.stats
+		rl.DrawTextEx(
+			rl.GetFontDefault(),
+			rl.TextFormat(
+				"Chunks queued %i, in flight %i, loaded %i | latency %.2fms, avg %.2fms, max %.2fms",
+				stream.queue_depth,
+				stream.in_flight,
+				stream.loaded,
+				stream.last_latency_ms,
+				stream.avg_latency_ms,
+				stream.max_latency_ms,
+			),
+			{10, f32(rl.GetScreenHeight()) - 80},
+			font_size,
+			MENU_SPACING,
+			rl.BLACK,
+		)
+		cache := g.level.cache
+		rl.DrawTextEx(
+			rl.GetFontDefault(),
+			rl.TextFormat(
+				"Chunk cache %iKB/%iKB | hits %i, misses %i, evictions %i, writebacks %i",
+				i32(cache.stats.used_bytes / 1024),
+				i32(cache.budget / 1024),
+				cache.stats.hits,
+				cache.stats.misses,
+				cache.stats.evictions,
+				cache.stats.writebacks,
+			),
+			{10, f32(rl.GetScreenHeight()) - 100},
+			font_size,
+			MENU_SPACING,
+			rl.BLACK,
+		)
+		batch := g.sprite_batch.stats
+		rl.DrawTextEx(
+			rl.GetFontDefault(),
+			rl.TextFormat(
+				"Sprites %i batched, %i culled | %i draw calls",
+				batch.queued,
+				batch.culled,
+				batch.draw_calls,
+			),
+			{10, f32(rl.GetScreenHeight()) - 120},
+			font_size,
+			MENU_SPACING,
+			rl.BLACK,
+		)
+		draw_frame_memory_overlay(g.frame_memory, {10, f32(rl.GetScreenHeight()) - 140}, font_size)
+		rl.DrawTextEx(
+			rl.GetFontDefault(),
+			rl.TextFormat(
+				"Sim %iHz, %i steps this frame, alpha %.2f | dropped %.0fms",
+				i32(FIXED_TICK_RATE),
+				g.step_stats.steps,
+				g.step_alpha,
+				g.step_stats.dropped_ms,
+			),
+			{10, f32(rl.GetScreenHeight()) - 180},
+			font_size,
+			MENU_SPACING,
+			rl.BLACK,
+		)
+	}
 }
 
 draw_play :: proc(fade: f32) {
@@ -545,7 +690,7 @@ draw_play :: proc(fade: f32) {
 	rl.BeginMode2D(game_camera())
 	{
 		draw_level(fade)
-		draw_particle_system(&g.particle_system, fade)
+		draw_particle_system(g.particle_system, fade)
 		draw_entities(fade)
 		//draw_player(fade)
 
@@ -576,6 +721,9 @@ draw_play :: proc(fade: f32) {
 			}
 		}
 	}
+	if g.profiler.show {
+		draw_profiler_overlay(g.profiler)
+	}
 
 	rl.EndDrawing()
 }
@@ -585,7 +733,7 @@ draw_quadtree :: proc() {
 	rl.BeginDrawing()
 	//rl.ClearBackground(rl.SKYBLUE)
 	//Draw using game_camera
-	draw_quad_tree(&quadtree)
+	draw_quad_tree(quadtree)
 	rl.BeginMode2D(game_camera())
 	{
 		draw_level(fade)
@@ -608,12 +756,24 @@ game_should_run :: proc() -> bool {
 	return g.run
 }
 
+//Nil runs every job on the calling thread
+job_pool :: proc() -> ^jobs.Pool {
+	if g == nil {
+		return nil
+	}
+	return g.job_pool
+}
+
 refresh_globals :: proc() {
 	fmt.printfln("Refreshing globals")
 	reload_global_data()
 	atlas = g.atlas
 	font = g.font
 	level = g.level
+	quadtree = &g.quadtree
+	if g.chunk_streamer != nil {
+		start_chunk_streamer(g.chunk_streamer)
+	}
 	rl.GuiSetStyle(.DEFAULT, i32(rl.GuiDefaultProperty.TEXT_SIZE), MENU_FONT_SIZE)
 	//GLOB_player = hm.get(g.entities, g.player_handle)
 	//GLOB_player.anim = animation_create(.Frog_Move)
@@ -663,17 +823,30 @@ shutdown :: proc() {
 	//free(&level.platforms)
 	//delete(level.edit_screen.menu.nodes)
 
+	delete_chunk_streamer(g.chunk_streamer)
+	for _, chunk in g.level.collision_map {
+		delete_collision_chunk(chunk)
+	}
 	delete(g.level.collision_map)
-	for coord in level.active_chunks {
-		delete(level.active_chunks[coord].entities)
-		delete(level.active_chunks[coord].decorations)
+	delete_chunk_grid(&g.level.grid)
+	for _, chunk in g.level.active_chunks {
+		release_visual_chunk_buffers(&g.level.cache, chunk)
 	}
 	delete(g.level.active_chunks)
+	delete_chunk_cache(&g.level.cache)
+	close_region_file(&g.level.region)
+	delete_quadtree(quadtree)
+	free(g.particle_system)
+	free(g.profiler)
+	delete_sprite_batch(g.sprite_batch)
+	free(g.sprite_batch)
 
 
 	hm.delete(&g.entities)
 	mem.free(g.font.recs)
 	mem.free(g.font.glyphs)
+	//last, arrays made during a frame free through its counting allocator
+	delete_frame_memory(g.frame_memory)
 	free(g)
 }
 
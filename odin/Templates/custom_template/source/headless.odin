@@ -0,0 +1,122 @@
+package game
+
+import hm "../handle_map"
+import rl "vendor:raylib"
+
+//Running the game without a window.
+//
+//init_headless sets up the same game state as init, minus everything that needs a GPU (atlas,
+//font, shaders, menus). Gameplay code reads the keyboard and the clock through key_down,
+//key_pressed, key_released, frame_time and game_time, which return the scripted keys and a fixed
+//step instead of raylib's when g.sim.headless is set. Each tick then behaves the same on every
+//run, see sim_benchmark.odin.
+
+SIM_MAX_KEYS :: 8
+
+//Keys held during one tick
+Sim_Keys :: struct {
+	keys:  [SIM_MAX_KEYS]rl.KeyboardKey,
+	count: int,
+}
+
+Sim_State :: struct {
+	headless:  bool,
+	dt:        f32, // fixed step for every tick
+	time:      f64, // seconds simulated so far
+	keys:      Sim_Keys, // held this tick
+	last_keys: Sim_Keys, // held last tick, for pressed / released
+}
+
+init_headless :: proc(dt: f32) {
+	g = new(Game_Memory)
+	g^ = Game_Memory {
+		state = .play,
+		run = true,
+		entities = hm.make_dense(Entity, Entity_Handle, MAX_ENTITIES, context.allocator),
+		game_camera = {zoom = 1},
+		sim = {headless = true, dt = dt},
+	}
+	g.profiler = new(Profiler)
+	g.frame_memory = init_frame_memory()
+	g.particle_system = new(Particle_System)
+	init_particle_system(g.particle_system)
+	g.sprite_batch = new(Sprite_Batch)
+	init_sprite_batch(g.sprite_batch)
+
+	reset_handles()
+
+	init_level(&g.level)
+	quadtree = &g.quadtree
+	init_quadtree(quadtree, QUADTREE_QUAD_SIZE, QUADTREE_NUM_QUADS)
+	g.chunk_streamer = init_chunk_streamer(&g.level.region)
+	level = g.level
+	start_chunk_streamer(g.chunk_streamer)
+}
+
+//Moves the clock and the scripted keys on to the next tick
+step_headless :: proc(keys: Sim_Keys) {
+	g.sim.last_keys = g.sim.keys
+	g.sim.keys = keys
+	g.sim.time += f64(g.sim.dt)
+}
+
+sim_key_held :: proc(keys: Sim_Keys, key: rl.KeyboardKey) -> bool {
+	for k in keys.keys[:keys.count] {
+		if k == key {
+			return true
+		}
+	}
+	return false
+}
+
+key_down :: proc(key: rl.KeyboardKey) -> bool {
+	if g.sim.headless {
+		return sim_key_held(g.sim.keys, key)
+	}
+	return rl.IsKeyDown(key)
+}
+
+//Pressed since the last fixed step for INPUT_LATCHED_KEYS, this frame for the others
+key_pressed :: proc(key: rl.KeyboardKey) -> bool {
+	if i := latched_key_index(key); i != -1 {
+		return i in g.input_latch.pressed
+	}
+	return frame_key_pressed(key)
+}
+
+key_released :: proc(key: rl.KeyboardKey) -> bool {
+	if i := latched_key_index(key); i != -1 {
+		return i in g.input_latch.released
+	}
+	return frame_key_released(key)
+}
+
+frame_key_pressed :: proc(key: rl.KeyboardKey) -> bool {
+	if g.sim.headless {
+		return sim_key_held(g.sim.keys, key) && !sim_key_held(g.sim.last_keys, key)
+	}
+	return rl.IsKeyPressed(key)
+}
+
+frame_key_released :: proc(key: rl.KeyboardKey) -> bool {
+	if g.sim.headless {
+		return !sim_key_held(g.sim.keys, key) && sim_key_held(g.sim.last_keys, key)
+	}
+	return rl.IsKeyReleased(key)
+}
+
+//Seconds since the last frame
+frame_time :: proc() -> f32 {
+	if g.sim.headless {
+		return g.sim.dt
+	}
+	return rl.GetFrameTime()
+}
+
+//Seconds since the game started
+game_time :: proc() -> f64 {
+	if g.sim.headless {
+		return g.sim.time
+	}
+	return rl.GetTime()
+}
@@ -5,18 +5,25 @@ import "base:runtime"
 import "core:encoding/json"
 import "core:fmt"
 import "core:math"
+import "core:mem"
 import "core:os"
 import rl "vendor:raylib"
 
 // Binary file format constants
-COLLISION_CHUNK_VERSION :: 1
-VISUAL_CHUNK_VERSION :: 1
+COLLISION_CHUNK_VERSION :: 2
+VISUAL_CHUNK_VERSION :: 2
 
 Level :: struct {
 	//always loaded
 	collision_map:         map[ChunkCoord]Collision_Chunk,
+	//tiles of the collision_map chunks by position, for lookups (see chunk_grid.odin)
+	grid:                  Chunk_Grid,
 	//dynamically loaded visual content
 	active_chunks:         map[ChunkCoord]Visual_Chunk,
+	//packed chunk files, mapped once when the level starts (see region_file.odin)
+	region:                Region_File,
+	//memory budget and eviction for both chunk maps (see chunk_cache.odin)
+	cache:                 Chunk_Cache,
 	//level metadata
 	world_bounds:          struct {
 		min_chunk, max_chunk: ChunkCoord,
@@ -36,7 +43,13 @@ TILE_SIZE :: 16
 TOTAL_CHUNK_PIXELS :: CHUNK_SIZE * TILE_SIZE
 CHUNKS_ABOVE :: 2
 CHUNKS_BELOW :: 3
-VISUAL_UNLOAD_DISTANCE_IN_CHUNKS :: 2
+//Visual chunks are kept loaded in a smaller band around the player than collision chunks
+VISUAL_CHUNKS_ABOVE :: 2
+VISUAL_CHUNKS_BELOW :: 2
+//Limits for what a visual chunk file can hold, the decoded data is kept in fixed arrays so it can be
+//filled off the main thread without allocating
+CHUNK_MAX_ENTITIES :: 64
+CHUNK_MAX_DECORATIONS :: 128
 
 ChunkCoord :: struct {
 	x, y: i32,
@@ -56,7 +69,7 @@ Tile_Type :: enum u8 {
 	LADDER   = 4,
 }
 
-Sprite_ID :: enum u32 {
+Sprite_ID :: enum u16 {
 	NONE         = 0,
 	GRASS_TILE   = 1,
 	STONE_TILE   = 2,
@@ -64,9 +77,15 @@ Sprite_ID :: enum u32 {
 }
 
 // Chunk structures
+Collision_Tiles :: [CHUNK_SIZE][CHUNK_SIZE]Tile_Type
+
+//tiles points into the region file mapping when mapped is set. Otherwise the loaders fill a
+//scratch buffer given by the caller, and keep_collision_chunk gives the chunk its own copy.
 Collision_Chunk :: struct {
-	tiles:    [CHUNK_SIZE][CHUNK_SIZE]Tile_Type,
-	has_data: bool,
+	tiles:            ^Collision_Tiles,
+	has_data:         bool,
+	mapped:           bool,
+	last_access_time: f64,
 }
 
 Visual_Chunk :: struct {
@@ -77,6 +96,9 @@ Visual_Chunk :: struct {
 	decorations:      [dynamic]Decoration,
 	last_access_time: f64,
 	is_dirty:         bool, // Needs to be saved
+	//sprites baked into one texture, see bake_visual_chunk. Set texture_dirty when sprites change.
+	texture:          rl.RenderTexture2D,
+	texture_dirty:    bool,
 }
 
 //Chunks are 'stages' for each level. 
@@ -105,6 +127,22 @@ JSON_Decoration :: struct {
 	layer:  i32,
 }
 
+//An entity listed in a visual chunk file, created once the chunk reaches the main thread
+Chunk_Entity_Spawn :: struct {
+	kind: EntityKind,
+	pos:  Vec2,
+}
+
+//Visual chunk data straight from disk. Holds no handles or allocations, so the chunk streamer
+//can decode into it on its worker thread. build_visual_chunk turns it into a Visual_Chunk.
+Decoded_Visual_Chunk :: struct {
+	sprites:          [CHUNK_SIZE][CHUNK_SIZE]Sprite_ID,
+	entities:         [CHUNK_MAX_ENTITIES]Chunk_Entity_Spawn,
+	entity_count:     int,
+	decorations:      [CHUNK_MAX_DECORATIONS]Decoration,
+	decoration_count: int,
+}
+
 JSON_Visual_Chunk :: struct {
 	coord_x:     i32,
 	coord_y:     i32,
@@ -120,49 +158,119 @@ init_level :: proc(level: ^Level) {
 	level.collision_map = make(map[ChunkCoord]Collision_Chunk)
 	level.active_chunks = make(map[ChunkCoord]Visual_Chunk)
 	level.chunk_update_interval = 0.1 // Update chunks 10 times per second
+	init_chunk_cache(&level.cache)
 	// Set world bounds (example: 1 chunk wide, 20 chunks tall)
 	level.world_bounds.min_chunk = {0, 0}
 	level.world_bounds.max_chunk = {0, 19}
+	init_chunk_grid(&level.grid, level.world_bounds.min_chunk, level.world_bounds.max_chunk)
+	when USE_REGION_FILE {
+		level.region, _ = open_region_file(REGION_FILE_PATH)
+	}
+	scratch: Collision_Tiles
 	for y := 0; y < int(level.world_bounds.max_chunk.y); y += 1 {
-		level.collision_map[ChunkCoord{0, i32(y)}] = load_collision_chunk({0, i32(y)})
+		coord := ChunkCoord{0, i32(y)}
+		chunk := keep_collision_chunk(load_collision_chunk(&level.region, coord, &scratch))
+		chunk.last_access_time = game_time()
+		add_collision_chunk(level, coord, chunk)
 	}
 	//start player at ground level 0,0
 	level.player_chunk = ChunkCoord{0, 0}
 	level.player_pos = {0, 0}
 	for i := 0; i < int(level.player_chunk.y) + CHUNKS_ABOVE; i += 1 {
 		c := ChunkCoord{0, i32(i)}
-		load_visual_chunk(&g.level, c, rl.GetTime())
+		load_visual_chunk(&g.level, c, game_time())
 	}
 }
 
 //Fade draws the level with a fade
 draw_level :: proc(fade: f32) {
 	//fmt.printf("Level.active_chunks size: %i\n", len(level.active_chunks))
-	for coord in level.active_chunks {
-		chunk := level.active_chunks[coord]
-		draw_visual_chunk(coord, chunk, game_camera())
+	//g.level rather than the level global, chunks stream in and out so the map can reallocate
+	view := camera_world_rect(game_camera())
+	for coord, &chunk in g.level.active_chunks {
+		draw_visual_chunk(coord, &chunk, view)
 	}
 }
 
-load_collision_chunk :: proc(coord: ChunkCoord) -> Collision_Chunk {
+//Uses the region file if the chunk is in it, no copy is made in that case. Otherwise the chunk is
+//read into scratch. Safe to call off the main thread.
+load_collision_chunk :: proc(
+	region: ^Region_File,
+	coord: ChunkCoord,
+	scratch: ^Collision_Tiles,
+) -> Collision_Chunk {
+	if data, ok := region_chunk_data(region, coord, .collision); ok {
+		return decode_collision_chunk_data(coord, data, REGION_FILE_PATH, scratch, true)
+	}
 	when USE_BINARY_FORMAT {
 		fmt.printf("Loading collision chunk BINARY %v\n", coord)
-		return load_collision_chunk_from_binary(coord)
+		return load_collision_chunk_binary(coord, scratch)
 
 	} else {
 		fmt.printf("Loading collision chunk JSON %v\n", coord)
-		return load_collision_chunk_from_json(coord)
+		return load_collision_chunk_from_json(coord, scratch)
+	}
+}
+
+//Copies tiles that live in a scratch buffer to the heap, so the chunk can go into the
+//collision_map. Mapped chunks are returned as they are. Main thread only.
+keep_collision_chunk :: proc(chunk: Collision_Chunk) -> Collision_Chunk {
+	chunk := chunk
+	if chunk.tiles != nil && !chunk.mapped {
+		chunk.tiles = new_clone(chunk.tiles^)
+	}
+	return chunk
+}
+
+delete_collision_chunk :: proc(chunk: Collision_Chunk) {
+	if !chunk.mapped {
+		free(chunk.tiles)
+	}
+}
+
+//Puts a chunk into the collision_map and the chunk grid
+add_collision_chunk :: proc(level: ^Level, coord: ChunkCoord, chunk: Collision_Chunk) {
+	level.collision_map[coord] = chunk
+	chunk_grid_set(&level.grid, coord, chunk.tiles if chunk.has_data else nil)
+}
+
+//Takes a chunk out of the collision_map and the chunk grid and frees it
+remove_collision_chunk :: proc(level: ^Level, coord: ChunkCoord) {
+	chunk, ok := level.collision_map[coord]
+	if !ok {
+		return
 	}
+	chunk_grid_set(&level.grid, coord, nil)
+	delete_collision_chunk(chunk)
+	delete_key(&level.collision_map, coord)
 }
 
+//Chunks are drawn centered on x = chunk.x * chunk size, and chunk y counts upward from the
+//ground while world y grows downward (see draw_visual_chunk)
 world_pos_to_chunk :: proc(world_pos: [2]f32) -> ChunkCoord {
 	chunk_size_world := f32(CHUNK_SIZE * TILE_SIZE)
 	return {
-		i32(math.floor(world_pos.x / chunk_size_world)),
-		i32(math.floor(world_pos.y / chunk_size_world)), // Y increases downward
+		i32(math.floor((world_pos.x + chunk_size_world / 2) / chunk_size_world)),
+		i32(math.floor(-world_pos.y / chunk_size_world)),
 	}
 }
 
+//Center of a chunk in world space, matching world_pos_to_chunk
+chunk_center_world_pos :: proc(chunk: ChunkCoord) -> Vec2 {
+	chunk_size_world := f32(CHUNK_SIZE * TILE_SIZE)
+	return {f32(chunk.x) * chunk_size_world, -(f32(chunk.y) + 0.5) * chunk_size_world}
+}
+
+//True if coord is inside level.world_bounds
+chunk_in_world_bounds :: proc(level: ^Level, coord: ChunkCoord) -> bool {
+	return(
+		coord.x >= level.world_bounds.min_chunk.x &&
+		coord.x <= level.world_bounds.max_chunk.x &&
+		coord.y >= level.world_bounds.min_chunk.y &&
+		coord.y <= level.world_bounds.max_chunk.y \
+	)
+}
+
 chunk_to_world_pos :: proc(chunk: ChunkCoord) -> [2]f32 {
 	chunk_size_world := f32(CHUNK_SIZE * TILE_SIZE)
 	return {
@@ -171,25 +279,6 @@ chunk_to_world_pos :: proc(chunk: ChunkCoord) -> [2]f32 {
 	}
 }
 
-get_tile_in_world :: proc(level: ^Level, world_pos: [2]f32) -> Tile_Type {
-	chunk_coord := world_pos_to_chunk(world_pos)
-	// Check if collision chunk exists
-	collision_chunk, chunk_exists := &level.collision_map[chunk_coord]
-	if !chunk_exists || !collision_chunk.has_data {
-		return .EMPTY
-	}
-	// Convert to local tile coordinates within chunk
-	chunk_world_pos := chunk_to_world_pos(chunk_coord)
-	local_pos := world_pos - chunk_world_pos
-	tile_x := i32(local_pos.x / TILE_SIZE)
-	tile_y := i32(local_pos.y / TILE_SIZE)
-	// Bounds check
-	if tile_x < 0 || tile_x >= CHUNK_SIZE || tile_y < 0 || tile_y >= CHUNK_SIZE {
-		return .EMPTY
-	}
-	return collision_chunk.tiles[tile_y][tile_x]
-}
-
 // Collision chunk management
 ensure_collision_chunk_loaded :: proc(level: ^Level, coord: ChunkCoord) {
 	if coord in level.collision_map {return}
@@ -200,8 +289,10 @@ ensure_collision_chunk_loaded :: proc(level: ^Level, coord: ChunkCoord) {
 	   coord.y > level.world_bounds.max_chunk.y {
 		return
 	}
-	chunk := load_collision_chunk_binary(coord)
-	level.collision_map[coord] = chunk
+	scratch: Collision_Tiles
+	chunk := keep_collision_chunk(load_collision_chunk(&level.region, coord, &scratch))
+	chunk.last_access_time = game_time()
+	add_collision_chunk(level, coord, chunk)
 	fmt.printf("Loaded collision chunk (%d, %d)\n", coord.x, coord.y)
 }
 
@@ -226,147 +317,208 @@ load_visual_chunk :: proc(level: ^Level, coord: ChunkCoord, current_time: f64) {
 
 	fmt.printf("Trying to load visual chunk (%d, %d)\n", coord.x, coord.y)
 	// Load visual data
-	visual_chunk := load_visual_chunk_binary(coord)
+	visual_chunk := load_visual_chunk_binary(level, coord)
 	visual_chunk.last_access_time = current_time
 	level.active_chunks[coord] = visual_chunk
 	fmt.printf("Loaded visual chunk (%d, %d)\n", coord.x, coord.y)
 }
 
-unload_distant_visual_chunks :: proc(level: ^Level, player_chunk: ChunkCoord, current_time: f64) {
-	chunks_to_remove := make([dynamic]ChunkCoord, context.temp_allocator)
-	for coord, chunk in level.active_chunks {
-		// Calculate Manhattan distance
-		distance := abs(coord.x - player_chunk.x) + abs(coord.y - player_chunk.y)
-		if distance > VISUAL_UNLOAD_DISTANCE_IN_CHUNKS {
-			// Save chunk if dirty before unloading
-			if chunk.is_dirty {
-				save_visual_chunk_to_disk(coord, chunk)
-			}
-			append(&chunks_to_remove, coord)
-		}
+//True for chunks update_chunks keeps loaded around the player. The chunk cache never evicts these.
+chunk_wanted :: proc(level: ^Level, coord: ChunkCoord, kind: Chunk_Data_Kind) -> bool {
+	dx := coord.x - level.player_chunk.x
+	dy := coord.y - level.player_chunk.y
+	if dx < -1 || dx >= 1 { 	// Assuming narrow vertical levels
+		return false
 	}
-	// Remove distant chunks
-	for coord in chunks_to_remove {
-		delete_key(&level.active_chunks, coord)
-		fmt.printf("Unloaded visual chunk (%d, %d)\n", coord.x, coord.y)
+	switch kind {
+	case .collision:
+		return dy >= -CHUNKS_BELOW && dy < CHUNKS_ABOVE
+	case .visual:
+		return dy >= -VISUAL_CHUNKS_BELOW && dy < VISUAL_CHUNKS_ABOVE
 	}
+	return false
 }
 
 // Main chunk management update
+// Works out which chunks are needed around the player and hands them to the chunk streamer,
+// which loads them on its worker thread. Finished chunks are picked up every frame.
 update_chunks :: proc(game_memory: ^Game_Memory) {
+	profile_zone("update_chunks")
 	level := &game_memory.level
+	streamer := game_memory.chunk_streamer
 	current_time := game_memory.current_time
-	// Skip update if not enough time has passed
-	if current_time - level.last_chunk_update < level.chunk_update_interval {return}
-	level.last_chunk_update = current_time
-	// Update player chunk
-	level.player_chunk = world_pos_to_chunk(level.player_pos)
-	// Ensure collision chunks are loaded in a radius around player
-	for dy in -CHUNKS_BELOW ..< CHUNKS_ABOVE {
-		for dx in -1 ..< 1 { 	// Assuming narrow vertical levels
-			chunk_coord := ChunkCoord {
-				level.player_chunk.x + i32(dx),
-				level.player_chunk.y + i32(dy),
-			}
-			ensure_collision_chunk_loaded(level, chunk_coord)
-		}
+	player := get_player()
+	if player != nil {
+		level.player_pos = player.pos
 	}
-	// Load visual chunks near player
-	for dy in -2 ..< 2 {
-		for dx in -1 ..< 1 {
-			chunk_coord := ChunkCoord {
-				level.player_chunk.x + i32(dx),
-				level.player_chunk.y + i32(dy),
+
+	// Skip new requests if not enough time has passed, results are still collected every frame
+	if current_time - level.last_chunk_update >= level.chunk_update_interval {
+		level.last_chunk_update = current_time
+		// Update player chunk
+		level.player_chunk = world_pos_to_chunk(level.player_pos)
+		player_vel := player.vel if player != nil else Vec2{}
+
+		// Collision chunks in a radius around player, visual chunks a bit closer in. Loaded ones
+		// are marked as used so the cache keeps them.
+		for dy in -CHUNKS_BELOW ..< CHUNKS_ABOVE {
+			for dx in -1 ..< 1 { 	// Assuming narrow vertical levels
+				chunk_coord := ChunkCoord {
+					level.player_chunk.x + i32(dx),
+					level.player_chunk.y + i32(dy),
+				}
+				if !chunk_in_world_bounds(level, chunk_coord) {
+					continue
+				}
+				kinds: Chunk_Data_Kinds
+				if !touch_chunk(level, chunk_coord, .collision, current_time) {
+					kinds += {.collision}
+				}
+				if chunk_wanted(level, chunk_coord, .visual) &&
+				   !touch_chunk(level, chunk_coord, .visual, current_time) {
+					kinds += {.visual}
+				}
+				request_chunk(streamer, level, chunk_coord, kinds, player_vel)
 			}
-			load_visual_chunk(level, chunk_coord, current_time)
 		}
-	}
-	player := get_player()
-	player_velocity_y := player.vel.y
-	if player_velocity_y > 500.0 {
-		predicted_chunks := i32(abs(player_velocity_y) / f32(CHUNK_SIZE * TILE_SIZE))
-		for i in i32(1) ..< predicted_chunks {
-			chunk_coord := ChunkCoord{level.player_chunk.x, level.player_chunk.y - i}
-			ensure_collision_chunk_loaded(level, chunk_coord)
-			load_visual_chunk(level, chunk_coord, current_time)
+
+		// Falling fast, queue the chunks we are about to fall into as well. Priority takes care of
+		// ordering them by where the player is heading.
+		if player_vel.y > 500.0 {
+			predicted_chunks := i32(abs(player_vel.y) / f32(CHUNK_SIZE * TILE_SIZE))
+			for i in i32(1) ..< predicted_chunks {
+				chunk_coord := ChunkCoord{level.player_chunk.x, level.player_chunk.y - i}
+				if !chunk_in_world_bounds(level, chunk_coord) {
+					break
+				}
+				kinds: Chunk_Data_Kinds
+				if !touch_chunk(level, chunk_coord, .collision, current_time) {
+					kinds += {.collision}
+				}
+				if !touch_chunk(level, chunk_coord, .visual, current_time) {
+					kinds += {.visual}
+				}
+				request_chunk(streamer, level, chunk_coord, kinds, player_vel)
+			}
 		}
+		streamer.outbox_ready = true
+		enforce_chunk_cache_budget(level, streamer)
 	}
-	unload_distant_visual_chunks(level, level.player_chunk, current_time)
+
+	chunk_streamer_sync(streamer, level)
 }
 
-// File paths
+// File paths, in the temp allocator
 get_collision_chunk_path :: proc(coord: ChunkCoord) -> string {
-	return fmt.aprintf("data/chunks/binary/collision/chunk_%d_%d.dat", coord.x, coord.y)
+	return fmt.tprintf("data/chunks/binary/collision/chunk_%d_%d.dat", coord.x, coord.y)
 }
 
 get_visual_chunk_path :: proc(coord: ChunkCoord) -> string {
-	return fmt.aprintf("data/chunks/binary/visual/chunk_%d_%d.dat", coord.x, coord.y)
+	return fmt.tprintf("data/chunks/binary/visual/chunk_%d_%d.dat", coord.x, coord.y)
 }
 
-// Binary collision chunk format:
-// [4 bytes: chunk_x] [4 bytes: chunk_y] [1024 bytes: tile data]
-load_collision_chunk_binary :: proc(coord: ChunkCoord) -> Collision_Chunk {
-	chunk := Collision_Chunk {
-		has_data = false,
-	}
+// Binary collision chunk format, see chunk_format.odin
+load_collision_chunk_binary :: proc(
+	coord: ChunkCoord,
+	scratch: ^Collision_Tiles,
+) -> Collision_Chunk {
 	filepath := get_collision_chunk_path(coord)
-	defer delete(filepath)
 
-	data, read_ok := os.read_entire_file(filepath)
+	data, read_ok := os.read_entire_file(filepath, context.temp_allocator)
 	if !read_ok {
 		fmt.printf("Could not read collision chunk file: %s\n", filepath)
-		return generate_default_collision_chunk(coord)
+		return generate_default_collision_chunk(coord, scratch)
 	}
-	defer delete(data)
 
-	//start reading data
-	offset := 0
-	chunk_x := (cast(^i32)&data[offset])^;offset += 4
-	chunk_y := (cast(^i32)&data[offset])^;offset += 4
-	// Verify chunk coordinates match
-	if chunk_x != coord.x || chunk_y != coord.y {
-		fmt.printf("Chunk coordinate mismatch in file: %s\n", filepath)
-		return chunk
-		//return generate_default_collision_chunk(coord)
-	}
+	return decode_collision_chunk_data(coord, data, filepath, scratch, false)
+}
 
-	// Copy tile data directly
-	tile_data_start := 8
-	for y in 0 ..< CHUNK_SIZE {
-		for x in 0 ..< CHUNK_SIZE {
-			idx := tile_data_start + y * CHUNK_SIZE + x
-			chunk.tiles[y][x] = cast(Tile_Type)data[idx]
+// Decodes the bytes of one binary collision chunk, version 1 or 2. With in_place set and an
+// uncompressed tile layer, the chunk points straight at data instead of copying it to scratch, so
+// data has to outlive the chunk (the region file mapping does).
+decode_collision_chunk_data :: proc(
+	coord: ChunkCoord,
+	data: []byte,
+	filepath: string,
+	scratch: ^Collision_Tiles,
+	in_place: bool,
+) -> Collision_Chunk {
+	chunk := Collision_Chunk {
+		has_data = false,
+	}
+	tiles: []byte
+	if chunk_file_has_header(data, COLLISION_CHUNK_MAGIC) {
+		header, payload, ok := read_chunk_file_header(data, coord, COLLISION_CHUNK_VERSION, filepath)
+		if !ok {
+			return chunk
+		}
+		if .layer_rle in header.flags {
+			_, layer_ok := read_chunk_layer(payload, mem.ptr_to_bytes(scratch), 1, true)
+			if !layer_ok {
+				fmt.printf("Broken tile layer in collision chunk: %s\n", filepath)
+				return chunk
+			}
+			chunk.tiles = scratch
+			chunk.has_data = true
+			return chunk
+		}
+		tiles = payload
+	} else {
+		// Version 1: [4 bytes: chunk_x] [4 bytes: chunk_y] [1024 bytes: tile data]
+		if len(data) < 8 + size_of(Collision_Tiles) {
+			fmt.printf("Invalid collision chunk file size: %s\n", filepath)
+			return chunk
+		}
+		chunk_x := (cast(^i32)&data[0])^
+		chunk_y := (cast(^i32)&data[4])^
+		if chunk_x != coord.x || chunk_y != coord.y {
+			fmt.printf("Chunk coordinate mismatch in file: %s\n", filepath)
+			return chunk
 		}
+		tiles = data[8:]
 	}
 
+	if len(tiles) < size_of(Collision_Tiles) {
+		fmt.printf("Invalid collision chunk file size: %s\n", filepath)
+		return chunk
+	}
+	// Tile data is laid out exactly like Collision_Tiles
+	if in_place {
+		chunk.tiles = cast(^Collision_Tiles)raw_data(tiles)
+		chunk.mapped = true
+	} else {
+		scratch^ = (cast(^Collision_Tiles)raw_data(tiles))^
+		chunk.tiles = scratch
+	}
 	chunk.has_data = true
-	fmt.printf("Loaded collision chunk (%d, %d) from binary file\n", coord.x, coord.y)
 	return chunk
 }
 
-// JSON file paths
+// JSON file paths, in the temp allocator
 get_collision_chunk_json_path :: proc(coord: ChunkCoord) -> string {
-	return fmt.aprintf("data/chunks/json/collision/chunk_%d_%d.json", coord.x, coord.y)
+	return fmt.tprintf("data/chunks/json/collision/chunk_%d_%d.json", coord.x, coord.y)
 }
 
 get_visual_chunk_json_path :: proc(coord: ChunkCoord) -> string {
-	return fmt.aprintf("data/chunks/json/visual/chunk_%d_%d.json", coord.x, coord.y)
+	return fmt.tprintf("data/chunks/json/visual/chunk_%d_%d.json", coord.x, coord.y)
 }
 
 // JSON loading functions (use these instead of binary if you prefer JSON)
-load_collision_chunk_from_json :: proc(coord: ChunkCoord) -> Collision_Chunk {
+load_collision_chunk_from_json :: proc(
+	coord: ChunkCoord,
+	scratch: ^Collision_Tiles,
+) -> Collision_Chunk {
 	f_name := "load_collision_chunk_from_json::(coord:ChunkCoord)->Collision_Chunk : "
 	chunk := Collision_Chunk {
 		has_data = false,
 	}
 
 	filepath := get_collision_chunk_json_path(coord)
-	defer delete(filepath)
 
 	data, read_ok := os.read_entire_file(filepath)
 	if !read_ok {
 		fmt.printf("%s Could not read collision chunk JSON: %s\n", f_name, filepath)
-		return generate_default_collision_chunk(coord)
+		return generate_default_collision_chunk(coord, scratch)
 	}
 	defer delete(data)
 
@@ -375,22 +527,23 @@ load_collision_chunk_from_json :: proc(coord: ChunkCoord) -> Collision_Chunk {
 	parse_error := json.unmarshal(data, &json_chunk)
 	if parse_error != nil {
 		fmt.printf("Failed to parse collision chunk JSON: %s, error: %v\n", filepath, parse_error)
-		return generate_default_collision_chunk(coord)
+		return generate_default_collision_chunk(coord, scratch)
 	}
 
 	// Verify coordinates
 	if json_chunk.chunk_x != coord.x || json_chunk.chunk_y != coord.y {
 		fmt.printf("Collision chunk coordinate mismatch in JSON: %s\n", filepath)
-		return generate_default_collision_chunk(coord)
+		return generate_default_collision_chunk(coord, scratch)
 	}
 
 	// Convert data
 	for y in 0 ..< CHUNK_SIZE {
 		for x in 0 ..< CHUNK_SIZE {
-			chunk.tiles[y][x] = cast(Tile_Type)json_chunk.tiles[y][x]
+			scratch[y][x] = cast(Tile_Type)json_chunk.tiles[y][x]
 		}
 	}
 
+	chunk.tiles = scratch
 	chunk.has_data = true
 	fmt.printf("Loaded collision chunk (%d, %d) from JSON\n", coord.x, coord.y)
 
@@ -399,20 +552,13 @@ load_collision_chunk_from_json :: proc(coord: ChunkCoord) -> Collision_Chunk {
 	return chunk
 }
 
-load_visual_chunk_from_json :: proc(coord: ChunkCoord) -> Visual_Chunk {
-	chunk := Visual_Chunk {
-		entities    = make([dynamic]Entity_Handle),
-		decorations = make([dynamic]Decoration),
-		is_dirty    = false,
-	}
-
+load_visual_chunk_from_json :: proc(level: ^Level, coord: ChunkCoord) -> Visual_Chunk {
 	filepath := get_visual_chunk_json_path(coord)
-	defer delete(filepath)
 
 	data, read_ok := os.read_entire_file(filepath)
 	if !read_ok {
 		fmt.printf("Could not read visual chunk JSON: %s\n", filepath)
-		return generate_default_visual_chunk(coord)
+		return generate_default_visual_chunk(&level.cache, coord)
 	}
 	defer delete(data)
 
@@ -421,18 +567,25 @@ load_visual_chunk_from_json :: proc(coord: ChunkCoord) -> Visual_Chunk {
 	parse_error := json.unmarshal(data, &json_chunk)
 	if parse_error != nil {
 		fmt.printf("Failed to parse visual chunk JSON: %s, error: %v\n", filepath, parse_error)
-		return generate_default_visual_chunk(coord)
+		return generate_default_visual_chunk(&level.cache, coord)
 	}
 	fmt.printf("Successfully parsed json_visual_chunk: %v\n", filepath)
 
 	// Verify coordinates
 	if json_chunk.coord_x != coord.x || json_chunk.coord_y != coord.y {
 		fmt.printf("Visual chunk coordinate mismatch in JSON: %s\n", filepath)
-		return generate_default_visual_chunk(coord)
+		return generate_default_visual_chunk(&level.cache, coord)
 	}
 
-	chunk.coord_x = json_chunk.coord_x
-	chunk.coord_y = json_chunk.coord_y
+	buffers := take_visual_chunk_buffers(&level.cache)
+	chunk := Visual_Chunk {
+		coord_x       = json_chunk.coord_x,
+		coord_y       = json_chunk.coord_y,
+		entities      = buffers.entities,
+		decorations   = buffers.decorations,
+		texture       = buffers.texture,
+		texture_dirty = true,
+	}
 
 	// Convert sprite data
 	for y in 0 ..< CHUNK_SIZE {
@@ -444,7 +597,15 @@ load_visual_chunk_from_json :: proc(coord: ChunkCoord) -> Visual_Chunk {
 	// Convert entities
 	for json_entity in json_chunk.entities {
 		//create entity_handle 
-		entity := hm.add(&g.entities, Entity{pos = json_entity.pos, kind = json_entity.kind})
+		entity := hm.add(
+			&g.entities,
+			Entity {
+				pos = json_entity.pos,
+				prev_pos = json_entity.pos,
+				has_prev_pos = true,
+				kind = json_entity.kind,
+			},
+		)
 		append(&chunk.entities, entity)
 	}
 
@@ -463,8 +624,10 @@ load_visual_chunk_from_json :: proc(coord: ChunkCoord) -> Visual_Chunk {
 }
 
 save_collision_chunk_to_json :: proc(coord: ChunkCoord, chunk: Collision_Chunk) {
+	if chunk.tiles == nil {
+		return
+	}
 	filepath := get_collision_chunk_json_path(coord)
-	defer delete(filepath)
 
 	// Create directory if it doesn't exist
 	os.make_directory("data/chunks/collision", 0o755)
@@ -501,7 +664,6 @@ save_collision_chunk_to_json :: proc(coord: ChunkCoord, chunk: Collision_Chunk)
 
 save_visual_chunk_to_json :: proc(coord: ChunkCoord, chunk: Visual_Chunk) {
 	filepath := get_visual_chunk_json_path(coord)
-	defer delete(filepath)
 
 	// Create directory if it doesn't exist
 	os.make_directory("data/chunks/visual", 0o755)
@@ -566,28 +728,54 @@ save_visual_chunk_to_json :: proc(coord: ChunkCoord, chunk: Visual_Chunk) {
 // save_collision_chunk_binary -> save_collision_chunk_to_json
 // save_visual_chunk_to_disk -> save_visual_chunk_to_json
 
-// Binary visual chunk format:
-// [4 bytes: version] [4 bytes: chunk_x] [4 bytes: chunk_y] 
-// [4096 bytes: sprite data] [4 bytes: entity_count] [entity_data...] 
-// [4 bytes: decoration_count] [decoration_data...]
-load_visual_chunk_binary :: proc(coord: ChunkCoord) -> Visual_Chunk {
-	f_name := "load_visual_chunk_binary::(coord:ChunkCoord)->Visual_Chunk : "
-	chunk := Visual_Chunk {
-		entities    = make([dynamic]Entity_Handle),
-		decorations = make([dynamic]Decoration),
-		is_dirty    = false,
+// Binary visual chunk format, see chunk_format.odin
+load_visual_chunk_binary :: proc(level: ^Level, coord: ChunkCoord) -> Visual_Chunk {
+	decoded: Decoded_Visual_Chunk
+	if !decode_visual_chunk_binary(&level.region, coord, &decoded) {
+		return generate_default_visual_chunk(&level.cache, coord)
+	}
+	return build_visual_chunk(&level.cache, coord, &decoded)
+}
+
+// Reads a binary visual chunk into out, from the region file if it is in there, otherwise from its
+// own file. Only touches out, so it is safe to call off the main thread. Returns false if the chunk
+// is missing or broken.
+decode_visual_chunk_binary :: proc(
+	region: ^Region_File,
+	coord: ChunkCoord,
+	out: ^Decoded_Visual_Chunk,
+) -> bool {
+	if data, ok := region_chunk_data(region, coord, .visual); ok {
+		return decode_visual_chunk_data(coord, data, REGION_FILE_PATH, out)
 	}
 	filepath := get_visual_chunk_path(coord)
-	defer delete(filepath)
-	data, read_ok := os.read_entire_file(filepath)
+	data, read_ok := os.read_entire_file(filepath, context.temp_allocator)
 	if !read_ok {
 		fmt.printf("Could not read visual chunk file: %s\n", filepath)
-		return generate_default_visual_chunk(coord)
+		return false
 	}
-	defer delete(data)
+	return decode_visual_chunk_data(coord, data, filepath, out)
+}
+
+// Decodes the bytes of one binary visual chunk. filepath is only used for error messages.
+decode_visual_chunk_data :: proc(
+	coord: ChunkCoord,
+	data: []byte,
+	filepath: string,
+	out: ^Decoded_Visual_Chunk,
+) -> bool {
+	f_name := "decode_visual_chunk_data::(coord:ChunkCoord,data:[]byte,filepath:string,out:^Decoded_Visual_Chunk)->bool : "
+	out.entity_count = 0
+	out.decoration_count = 0
+	if chunk_file_has_header(data, VISUAL_CHUNK_MAGIC) {
+		return decode_visual_chunk_v2(coord, data, filepath, out)
+	}
+
+	// Version 1: [4 bytes: chunk_x] [4 bytes: chunk_y] [4096 bytes: sprite data, u32 each]
+	// [4 bytes: entity_count] [entity_data...] [4 bytes: decoration_count] [decoration_data...]
 	if len(data) < 12 + CHUNK_SIZE * CHUNK_SIZE * 4 {
 		fmt.printf("Invalid visual chunk file size: %s\n", filepath)
-		return generate_default_visual_chunk(coord)
+		return false
 	}
 
 	offset := 0
@@ -597,128 +785,250 @@ load_visual_chunk_binary :: proc(coord: ChunkCoord) -> Visual_Chunk {
 	// Verify coordinates
 	if chunk_x != coord.x || chunk_y != coord.y {
 		fmt.printf("%s Visual chunk coordinate mismatch in file: %s\n", f_name, filepath)
-		return generate_default_visual_chunk(coord)
+		return false
 	}
 	// Read sprite data
 	for y in 0 ..< CHUNK_SIZE {
 		for x in 0 ..< CHUNK_SIZE {
-			chunk.sprites[y][x] = cast(Sprite_ID)(cast(^u32)&data[offset])^
+			out.sprites[y][x] = cast(Sprite_ID)(cast(^u32)&data[offset])^
 			offset += 4
 		}
 	}
 	// Read entities
-	entity_count := (cast(^i32)&data[offset])^;offset += 4
-	for i := 0; i < int(entity_count); i += 1 {
-		kind := (cast(^EntityKind)&data[offset])^;offset += 4
-		pos_x := (cast(^f32)&data[offset])^;offset += 4
-		pos_y := (cast(^f32)&data[offset])^;offset += 4
-		handle := create_entity(kind, {pos_x, pos_y})
-		append(&chunk.entities, handle)
+	entity_count := int((cast(^i32)&data[offset])^);offset += 4
+	if entity_count > CHUNK_MAX_ENTITIES {
+		fmt.printf(
+			"%s %i entities in %s, only loading %i\n",
+			f_name,
+			entity_count,
+			filepath,
+			CHUNK_MAX_ENTITIES,
+		)
+		entity_count = CHUNK_MAX_ENTITIES
+	}
+	for i := 0; i < entity_count && offset + 12 <= len(data); i += 1 {
+		spawn := &out.entities[i]
+		spawn.kind = cast(EntityKind)(cast(^i32)&data[offset])^;offset += 4
+		spawn.pos.x = (cast(^f32)&data[offset])^;offset += 4
+		spawn.pos.y = (cast(^f32)&data[offset])^;offset += 4
+		out.entity_count += 1
 	}
 	// Read decorations
-	decoration_count := (cast(^i32)&data[offset])^;offset += 4
+	if offset + 4 > len(data) {
+		return true
+	}
+	decoration_count := int((cast(^i32)&data[offset])^);offset += 4
 	fmt.printf("%s Decoration count: %i\n", f_name, decoration_count)
-	for i := 0; i < int(decoration_count); i += 1 {
-		decoration := Decoration{}
+	decoration_count = min(decoration_count, CHUNK_MAX_DECORATIONS)
+	for i := 0; i < decoration_count && offset + 12 <= len(data); i += 1 {
+		decoration := &out.decorations[i]
+		decoration^ = {}
 		decoration.pos.x = (cast(^f32)&data[offset])^;offset += 4
 		decoration.pos.y = (cast(^f32)&data[offset])^;offset += 4
 		//decoration.sprite = cast(Texture_Name)(cast(^u32)&data[offset])^;offset += 4
 		decoration.layer = (cast(^i32)&data[offset])^;offset += 4
-		append(&chunk.decorations, decoration)
+		out.decoration_count += 1
+	}
+
+	fmt.printf("Decoded visual chunk (%d, %d) from binary file\n", coord.x, coord.y)
+	return true
+}
+
+decode_visual_chunk_v2 :: proc(
+	coord: ChunkCoord,
+	data: []byte,
+	filepath: string,
+	out: ^Decoded_Visual_Chunk,
+) -> bool {
+	header, payload, ok := read_chunk_file_header(data, coord, VISUAL_CHUNK_VERSION, filepath)
+	if !ok {
+		return false
+	}
+	// Sprite layer goes straight into the sprite array
+	offset, layer_ok := read_chunk_layer(
+		payload,
+		mem.ptr_to_bytes(&out.sprites),
+		size_of(Sprite_ID),
+		.layer_rle in header.flags,
+	)
+	if !layer_ok {
+		fmt.printf("Broken sprite layer in visual chunk: %s\n", filepath)
+		return false
 	}
 
-	fmt.printf("Loaded visual chunk (%d, %d) from binary file\n", coord.x, coord.y)
+	// Read entities
+	if offset + 4 > len(payload) {
+		fmt.printf("Visual chunk is truncated: %s\n", filepath)
+		return false
+	}
+	entity_count := int((cast(^i32)&payload[offset])^);offset += 4
+	if entity_count < 0 || offset + entity_count * 12 + 4 > len(payload) {
+		fmt.printf("Visual chunk is truncated: %s\n", filepath)
+		return false
+	}
+	if entity_count > CHUNK_MAX_ENTITIES {
+		fmt.printf("%i entities in %s, only loading %i\n", entity_count, filepath, CHUNK_MAX_ENTITIES)
+	}
+	for i in 0 ..< entity_count {
+		if i < CHUNK_MAX_ENTITIES {
+			spawn := &out.entities[i]
+			spawn.kind = cast(EntityKind)(cast(^i32)&payload[offset])^
+			spawn.pos.x = (cast(^f32)&payload[offset + 4])^
+			spawn.pos.y = (cast(^f32)&payload[offset + 8])^
+			out.entity_count += 1
+		}
+		offset += 12
+	}
+
+	// Read decorations
+	decoration_count := int((cast(^i32)&payload[offset])^);offset += 4
+	if decoration_count < 0 || offset + decoration_count * 16 > len(payload) {
+		fmt.printf("Visual chunk is truncated: %s\n", filepath)
+		return false
+	}
+	for i in 0 ..< min(decoration_count, CHUNK_MAX_DECORATIONS) {
+		decoration := &out.decorations[i]
+		decoration.pos.x = (cast(^f32)&payload[offset])^
+		decoration.pos.y = (cast(^f32)&payload[offset + 4])^
+		decoration.sprite = cast(Sprite_ID)(cast(^u32)&payload[offset + 8])^
+		decoration.layer = (cast(^i32)&payload[offset + 12])^
+		out.decoration_count += 1
+		offset += 16
+	}
+	return true
+}
+
+// Turns decoded chunk data into a Visual_Chunk, creating its entities. The arrays come from the
+// chunk cache pool. Main thread only.
+build_visual_chunk :: proc(
+	cache: ^Chunk_Cache,
+	coord: ChunkCoord,
+	decoded: ^Decoded_Visual_Chunk,
+) -> Visual_Chunk {
+	buffers := take_visual_chunk_buffers(cache)
+	reserve(&buffers.entities, decoded.entity_count)
+	reserve(&buffers.decorations, decoded.decoration_count)
+	chunk := Visual_Chunk {
+		coord_x       = coord.x,
+		coord_y       = coord.y,
+		sprites       = decoded.sprites,
+		entities      = buffers.entities,
+		decorations   = buffers.decorations,
+		texture       = buffers.texture,
+		texture_dirty = true,
+	}
+	for spawn in decoded.entities[:decoded.entity_count] {
+		append(&chunk.entities, create_entity(spawn.kind, spawn.pos))
+	}
+	append(&chunk.decorations, ..decoded.decorations[:decoded.decoration_count])
 	return chunk
 }
 
 save_collision_chunk_binary :: proc(coord: ChunkCoord, chunk: Collision_Chunk) {
-	fmt.printf("TODO - FIX COLLISION CHUNK SAVE TO DISK\n")
-	//return
-
+	if chunk.tiles == nil {
+		return
+	}
 	filepath := get_collision_chunk_path(coord)
-	defer delete(filepath)
 	// Create directory if it doesn't exist
-	os.make_directory("data/chunks/collision", 0)
-	// Calculate file size
-	file_size := 12 + CHUNK_SIZE * CHUNK_SIZE
-	data := make([]u8, file_size)
-	defer delete(data)
-	offset := 0
-	(cast(^i32)&data[offset])^ = coord.x;offset += 4
-	(cast(^i32)&data[offset])^ = coord.y;offset += 4
-	// Write tile data
-	for y in 0 ..< CHUNK_SIZE {
-		for x in 0 ..< CHUNK_SIZE {
-			data[offset] = cast(u8)chunk.tiles[y][x]
-			offset += 1
-		}
+	os.make_directory("data/chunks/binary/collision", 0o755)
+
+	data := make([dynamic]u8, context.temp_allocator)
+	begin_chunk_file(&data)
+	flags: Chunk_File_Flags
+	if append_chunk_layer(&data, mem.ptr_to_bytes(chunk.tiles), size_of(Tile_Type)) {
+		flags += {.layer_rle}
 	}
+	finish_chunk_file(data[:], COLLISION_CHUNK_MAGIC, COLLISION_CHUNK_VERSION, coord, flags)
+
 	// Write to file
-	write_ok := os.write_entire_file(filepath, data)
+	write_ok := os.write_entire_file(filepath, data[:])
 	if !write_ok {
 		fmt.printf("Failed to save collision chunk: %s\n", filepath)
 	} else {
-		fmt.printf("Saved collision chunk (%d, %d) to binary file\n", coord.x, coord.y)
+		fmt.printf(
+			"Saved collision chunk (%d, %d) to binary file, %i bytes\n",
+			coord.x,
+			coord.y,
+			len(data),
+		)
 	}
 }
 
 save_visual_chunk_to_disk :: proc(coord: ChunkCoord, chunk: Visual_Chunk) {
-	filepath := get_visual_chunk_path(coord)
-	defer delete(filepath)
-	// Create directory if it doesn't exist
-	os.make_directory("data/chunks/visual", 0o755)
-	// Calculate file size
-	base_size := 8 + CHUNK_SIZE * CHUNK_SIZE * 4 + 8 // header + sprites + counts
-	entity_size := len(chunk.entities) * (4 * 4 + 4) // 4 floats + 1 u32 per entity
-	decoration_size := len(chunk.decorations) * (2 * 4 + 4 + 4) // 2 floats + 2 i32s per decoration
-	file_size := base_size + entity_size + decoration_size
-	data := make([]u8, file_size)
-	defer delete(data)
-	offset := 0
-	// Write header
-	(cast(^i32)&data[offset])^ = VISUAL_CHUNK_VERSION;offset += 4
-	(cast(^i32)&data[offset])^ = coord.x;offset += 4
-	(cast(^i32)&data[offset])^ = coord.y;offset += 4
+	data := make([dynamic]u8, context.temp_allocator)
+	encode_visual_chunk(coord, chunk, &data)
+	write_visual_chunk_file(coord, data[:])
+}
+
+// Encodes a visual chunk into data, as a version 2 chunk file. Main thread only, it looks up the
+// chunk's entities.
+encode_visual_chunk :: proc(coord: ChunkCoord, chunk: Visual_Chunk, data: ^[dynamic]u8) {
+	begin_chunk_file(data)
+	flags: Chunk_File_Flags
 
 	// Write sprite data
-	for y in 0 ..< CHUNK_SIZE {
-		for x in 0 ..< CHUNK_SIZE {
-			(cast(^u32)&data[offset])^ = cast(u32)chunk.sprites[y][x]
-			offset += 4
-		}
+	sprites := chunk.sprites
+	if append_chunk_layer(data, mem.ptr_to_bytes(&sprites), size_of(Sprite_ID)) {
+		flags += {.layer_rle}
 	}
 
-	// Write entities
-	(cast(^i32)&data[offset])^ = i32(len(chunk.entities));offset += 4
+	// Write entities, skipping any that have been removed since the chunk loaded
+	entity_count_at := len(data^)
+	append_chunk_value(data, i32(0))
+	entity_count: i32
 	for handle in chunk.entities {
 		e := hm.get(g.entities, handle)
-		(cast(^f32)&data[offset])^ = e.pos.x;offset += 4
-		(cast(^f32)&data[offset])^ = e.pos.y;offset += 4
-		(cast(^f32)&data[offset])^ = e.vel.x;offset += 4
-		(cast(^f32)&data[offset])^ = e.vel.y;offset += 4
-		//(cast(^u32)&data[offset])^ = cast(u32)entity.sprite;offset += 4
+		if e == nil {
+			continue
+		}
+		append_chunk_value(data, i32(e.kind))
+		append_chunk_value(data, e.pos.x)
+		append_chunk_value(data, e.pos.y)
+		entity_count += 1
 	}
+	(cast(^i32)&data[entity_count_at])^ = entity_count
+
 	// Write decorations
-	(cast(^i32)&data[offset])^ = i32(len(chunk.decorations));offset += 4
+	append_chunk_value(data, i32(len(chunk.decorations)))
 	for decoration in chunk.decorations {
-		(cast(^f32)&data[offset])^ = decoration.pos.x;offset += 4
-		(cast(^f32)&data[offset])^ = decoration.pos.y;offset += 4
-		//(cast(^u32)&data[offset])^ = cast(u32)decoration.sprite;offset += 4
-		(cast(^i32)&data[offset])^ = decoration.layer;offset += 4
+		append_chunk_value(data, decoration.pos.x)
+		append_chunk_value(data, decoration.pos.y)
+		append_chunk_value(data, u32(decoration.sprite))
+		append_chunk_value(data, decoration.layer)
 	}
-	// Write to file
+	finish_chunk_file(data[:], VISUAL_CHUNK_MAGIC, VISUAL_CHUNK_VERSION, coord, flags)
+}
+
+// Writes an encoded visual chunk to its file. Safe to call off the main thread, the chunk
+// streamer uses it for write-back.
+write_visual_chunk_file :: proc(coord: ChunkCoord, data: []u8) -> bool {
+	profile_zone("write_visual_chunk_file")
+	filepath := get_visual_chunk_path(coord)
+	// Create directory if it doesn't exist
+	os.make_directory("data/chunks/binary/visual", 0o755)
+
 	write_ok := os.write_entire_file(filepath, data)
 	if !write_ok {
 		fmt.printf("Failed to save visual chunk: %s\n", filepath)
 	} else {
-		fmt.printf("Saved visual chunk (%d, %d) to binary file\n", coord.x, coord.y)
+		fmt.printf(
+			"Saved visual chunk (%d, %d) to binary file, %i bytes\n",
+			coord.x,
+			coord.y,
+			len(data),
+		)
 	}
+	return write_ok
 }
 
 // Fallback generation for missing chunks
-generate_default_collision_chunk :: proc(coord: ChunkCoord) -> Collision_Chunk {
+generate_default_collision_chunk :: proc(
+	coord: ChunkCoord,
+	scratch: ^Collision_Tiles,
+) -> Collision_Chunk {
 	fmt.printf("Generating default collision chunk at %v\n", coord)
 	chunk := Collision_Chunk {
+		tiles    = scratch,
 		has_data = true,
 	}
 	// Generate some basic terrain
@@ -741,11 +1051,13 @@ generate_default_collision_chunk :: proc(coord: ChunkCoord) -> Collision_Chunk {
 	return chunk
 }
 
-generate_default_visual_chunk :: proc(coord: ChunkCoord) -> Visual_Chunk {
+generate_default_visual_chunk :: proc(cache: ^Chunk_Cache, coord: ChunkCoord) -> Visual_Chunk {
+	buffers := take_visual_chunk_buffers(cache)
 	chunk := Visual_Chunk {
-		entities    = make([dynamic]Entity_Handle),
-		decorations = make([dynamic]Decoration),
-		is_dirty    = false,
+		entities      = buffers.entities,
+		decorations   = buffers.decorations,
+		texture       = buffers.texture,
+		texture_dirty = true,
 	}
 	// Generate matching visual sprites
 	for y in 0 ..< CHUNK_SIZE {
@@ -774,9 +1086,14 @@ cleanup_level :: proc(level: ^Level) {
 		if chunk.is_dirty {
 			save_visual_chunk_to_disk(coord, chunk)
 		}
-		delete(chunk.entities)
-		delete(chunk.decorations)
+		release_visual_chunk_buffers(&level.cache, chunk)
+	}
+	for _, chunk in level.collision_map {
+		delete_collision_chunk(chunk)
 	}
 	delete(level.collision_map)
+	delete_chunk_grid(&level.grid)
 	delete(level.active_chunks)
+	delete_chunk_cache(&level.cache)
+	close_region_file(&level.region)
 }
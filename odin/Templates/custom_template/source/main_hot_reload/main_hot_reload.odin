@@ -5,6 +5,7 @@ changes.
 
 package main
 
+import "../../jobs"
 import "core:c/libc"
 import "core:dynlib"
 import "core:fmt"
@@ -49,6 +50,7 @@ Game_API :: struct {
 	memory:            proc() -> rawptr,
 	memory_size:       proc() -> int,
 	hot_reloaded:      proc(mem: rawptr),
+	set_job_pool:      proc(pool: rawptr),
 	force_reload:      proc() -> bool,
 	force_restart:     proc() -> bool,
 	modification_time: os.File_Time,
@@ -132,9 +134,14 @@ main :: proc() {
 		return
 	}
 
+	// The worker threads belong to the exe so they keep running across reloads. Made with the
+	// untracked allocator, they are not the game's leaks.
+	job_pool := jobs.create_pool(allocator = default_allocator)
+
 	game_api_version += 1
 	game_api.init_window()
 	game_api.init()
+	game_api.set_job_pool(job_pool)
 
 	old_game_apis := make([dynamic]Game_API, default_allocator)
 
@@ -186,6 +193,7 @@ main :: proc() {
 					unload_game_api(&game_api)
 					game_api = new_game_api
 					game_api.init()
+					game_api.set_job_pool(job_pool)
 				}
 
 				game_api_version += 1
@@ -222,6 +230,7 @@ main :: proc() {
 
 	game_api.shutdown_window()
 	unload_game_api(&game_api)
+	jobs.destroy_pool(job_pool, default_allocator)
 	mem.tracking_allocator_destroy(&tracking_allocator)
 }
 
@@ -5,6 +5,7 @@ For making a release exe that does not use hot reload.
 package main_release
 
 import game ".."
+import "../../jobs"
 import "core:fmt"
 import "core:log"
 import "core:mem"
@@ -45,9 +46,11 @@ main :: proc() {
 		context.allocator = mem.tracking_allocator(&tracking_allocator)
 	}
 
+	job_pool := jobs.create_pool(allocator = logger_alloc)
 
 	game.game_init_window()
 	game.game_init()
+	game.game_set_job_pool(job_pool)
 
 	for !game.game_should_close() {
 		game.game_update()
@@ -57,6 +60,7 @@ main :: proc() {
 	free_all(context.temp_allocator)
 	game.game_shutdown()
 	game.game_shutdown_window()
+	jobs.destroy_pool(job_pool, logger_alloc)
 
 	when USE_TRACKING_ALLOCATOR {
 		for _, value in tracking_allocator.allocation_map {
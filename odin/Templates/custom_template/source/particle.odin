@@ -1,21 +1,22 @@
 package game
 
+import "core:fmt"
 import "core:math"
 import "core:math/rand"
+import "core:time"
+import "../jobs"
 import rl "vendor:raylib"
+import rlgl "vendor:raylib/rlgl"
 
-MAX_PARTICLES :: 400
-
-Particle :: struct {
-	position: Vec2,
-	velocity: Vec2,
-	life:     f32,
-	max_life: f32,
-	color:    rl.Color,
-	//size:     f32,
-	active:   bool,
-	type:     Particle_Type,
-}
+MAX_PARTICLES :: 100_000
+//Particles are updated PARTICLE_LANES at a time. The per-lane maths is plain array programming
+//on [PARTICLE_LANES]f32, which the compiler turns into SIMD instructions.
+PARTICLE_LANES :: 8
+PARTICLE_GRAVITY :: f32(200)
+PARTICLE_DRAG :: Vec2{0.98, 0.99} // velocity multiplier per update
+PARTICLE_JOB_BATCH :: 4096 // particles per job, a multiple of PARTICLE_LANES
+
+Particle_Lane :: [PARTICLE_LANES]f32
 
 Particle_Type :: enum {
 	jump, // Jump dust
@@ -24,32 +25,61 @@ Particle_Type :: enum {
 	trail, // Trail effect 
 }
 
+//One array per particle field. Live particles are always packed into [0, count), so spawning is
+//an append and dead particles are swapped out with the last live one.
 Particle_System :: struct {
-	particles:    [MAX_PARTICLES]Particle,
-	active_count: int,
+	pos_x:        [MAX_PARTICLES]f32,
+	pos_y:        [MAX_PARTICLES]f32,
+	vel_x:        [MAX_PARTICLES]f32,
+	vel_y:        [MAX_PARTICLES]f32,
+	life:         [MAX_PARTICLES]f32,
+	inv_max_life: [MAX_PARTICLES]f32,
+	alpha:        [MAX_PARTICLES]f32, // life / max_life, written by the update
+	color:        [MAX_PARTICLES]rl.Color,
+	count:        int,
 }
 
 // Initialize the particle system
-init_particle_system :: proc() -> Particle_System {
-	ps: Particle_System
-	ps.active_count = 0
+init_particle_system :: proc(ps: ^Particle_System) {
+	ps.count = 0
+}
 
-	// Initialize all particles as inactive
-	for i in 0 ..< MAX_PARTICLES {
-		ps.particles[i].active = false
+// Adds a particle at the end of the live range, returns false when the system is full
+spawn_particle :: proc(
+	ps: ^Particle_System,
+	pos: Vec2,
+	vel: Vec2,
+	life: f32,
+	color: rl.Color,
+) -> bool {
+	if ps.count >= MAX_PARTICLES || life <= 0 {
+		return false
 	}
-
-	return ps
+	i := ps.count
+	ps.pos_x[i] = pos.x
+	ps.pos_y[i] = pos.y
+	ps.vel_x[i] = vel.x
+	ps.vel_y[i] = vel.y
+	ps.life[i] = life
+	ps.inv_max_life[i] = 1 / life
+	ps.alpha[i] = 1
+	ps.color[i] = color
+	ps.count += 1
+	return true
 }
 
-// Find an inactive particle to reuse
-find_inactive_particle :: proc(ps: ^Particle_System) -> int {
-	for i in 0 ..< MAX_PARTICLES {
-		if !ps.particles[i].active {
-			return i
-		}
-	}
-	return -1 // No inactive particle found
+//Moves the last live particle into slot i
+remove_particle :: proc(ps: ^Particle_System, i: int) {
+	last := ps.count - 1
+	ps.pos_x[i] = ps.pos_x[last]
+	ps.pos_y[i] = ps.pos_y[last]
+	ps.vel_x[i] = ps.vel_x[last]
+	ps.vel_y[i] = ps.vel_y[last]
+	ps.life[i] = ps.life[last]
+	ps.inv_max_life[i] = ps.inv_max_life[last]
+	ps.alpha[i] = ps.alpha[last]
+	ps.color[i] = ps.color[last]
+	ps.count = last
 }
 
 // Create jump particles (dust going downward)
@@ -65,23 +95,16 @@ create_jump_effect :: proc(ps: ^Particle_System, player_pos: rl.Vector2, index:
 	)
 
 	for i := 0; i < 8; i += 1 {
-		index := find_inactive_particle(ps)
-		if index == -1 do continue
-
-		p := &ps.particles[index]
-		p.active = true
-		p.position = {
+		pos := Vec2 {
 			player_pos.x + f32(rand.int31() % 20 - 10), // Random spread around player
 			player_pos.y, // At player's feet
 		}
-		p.velocity = {
+		vel := Vec2 {
 			f32(rand.int31() % 40 - 20) * 0.1, // Small horizontal spread
 			f32(rand.int31() % 20 + 10) * 0.5, // Downward velocity
 		}
-		p.life = 0.6 + f32(rand.int31() % 20) * 0.01 // 0.6-0.8 seconds
-		p.max_life = p.life
-		p.color = col
-
+		life := 0.6 + f32(rand.int31() % 20) * 0.01 // 0.6-0.8 seconds
+		spawn_particle(ps, pos, vel, life, col)
 	}*/
 }
 
@@ -96,38 +119,24 @@ create_landing_effect :: proc(ps: ^Particle_System, player_pos: rl.Vector2, inde
 		i32(level.platforms[index].texture_rect.y),
 	)
 	for i := 1; i < 12; i += 1 {
-		index := find_inactive_particle(ps)
-		if index == -1 do continue
-
-		p := &ps.particles[index]
-		p.active = true
-		p.position = {player_pos.x + f32(rand.int31() % 16 - 8), player_pos.y}
+		pos := Vec2{player_pos.x + f32(rand.int31() % 16 - 8), player_pos.y}
 
 		// Create outward burst pattern
 		angle := f32(rand.int31() % 360) * math.RAD_PER_DEG
 		speed := 30.0 + f32(rand.int31() % 40)
-		p.velocity = {
+		vel := Vec2 {
 			math.cos(angle) * speed,
 			math.sin(angle) * speed - 20.0, // Slightly upward bias
 		}
 
-		p.life = 0.8 + f32(rand.int31() % 30) * 0.01
-		p.max_life = p.life
-		p.color = col // Sandy brown
-		//p.size = 3.0 + f32(rand.int31() % 3)
-		ps.active_count += 1
+		life := 0.8 + f32(rand.int31() % 30) * 0.01
+		spawn_particle(ps, pos, vel, life, col) // Sandy brown
 	}*/
 }
 
 // Create attack particles (directional burst)
 create_attack_effect :: proc(ps: ^Particle_System, attack_pos: rl.Vector2, dir: Entity_Direction) {
 	for i := 0; i < 6; i += 1 {
-		index := find_inactive_particle(ps)
-		if index == -1 do continue
-
-		p := &ps.particles[index]
-		p.active = true
-		p.position = attack_pos
 		direction := Vec2{0, 0}
 		// Determine direction based on attack direction
 		if dir == .left {
@@ -141,74 +150,157 @@ create_attack_effect :: proc(ps: ^Particle_System, attack_pos: rl.Vector2, dir:
 		angle := base_angle + spread
 		speed := 50.0 + f32(rand.int31() % 30)
 
-		p.velocity = {math.cos(angle) * speed, math.sin(angle) * speed}
-
-		p.life = 0.4 + f32(rand.int31() % 20) * 0.01
-		p.max_life = p.life
-		p.color = rl.GOLD // Golden color for impact
-		//p.size = 2.0 + f32(rand.int31() % 2)
-		ps.active_count += 1
+		vel := Vec2{math.cos(angle) * speed, math.sin(angle) * speed}
+		life := 0.4 + f32(rand.int31() % 20) * 0.01
+		if !spawn_particle(ps, attack_pos, vel, life, rl.GOLD) { // Golden color for impact
+			return
+		}
 	}
 }
 
 create_trail_effect :: proc(ps: ^Particle_System, player_pos: rl.Vector2, player_vel: Vec2) {
 	// Create a trail effect behind the player
-	index := find_inactive_particle(ps)
-	if index == -1 do return
-
-	p := &ps.particles[index]
-	p.active = true
-	p.position = player_pos
-	//p.velocity = {player_vel.x * 0.5, player_vel.y * 0.5} // Half the player's velocity
-	p.life = 0.5 + f32(rand.int31() % 20) * 0.01 // 0.5-0.7 seconds
-	p.max_life = p.life
-	p.color = get_random_colour() // Light gray for trail
-	//p.size = 1.5 + f32(rand.int31() % 2)
-	ps.active_count += 1
+	//vel := Vec2{player_vel.x * 0.5, player_vel.y * 0.5} // Half the player's velocity
+	life := 0.5 + f32(rand.int31() % 20) * 0.01 // 0.5-0.7 seconds
+	spawn_particle(ps, player_pos, {}, life, get_random_colour())
+}
+
+Particle_Job :: struct {
+	ps:         ^Particle_System,
+	delta_time: f32,
 }
 
 // Update all particles
+// Integration runs over whole lanes with no branches, split into ranges on the job pool. Dead
+// particles are compacted afterwards, on this thread.
 update_particle_system :: proc(ps: ^Particle_System, delta_time: f32) {
-	for i in 0 ..< MAX_PARTICLES {
-		if !ps.particles[i].active do continue
-
-		p := &ps.particles[i]
-
-		// Update position
-		p.position.x += p.velocity.x * delta_time
-		p.position.y += p.velocity.y * delta_time
+	profile_zone("update_particle_system")
+	job := Particle_Job{ps, delta_time}
+	jobs.parallel_for(
+		job_pool(),
+		ps.count,
+		PARTICLE_JOB_BATCH,
+		&job,
+		proc(data: rawptr, start, end: int) {
+			job := (^Particle_Job)(data)
+			integrate_particles(job.ps, job.delta_time, start, end)
+		},
+	)
 
-		// Apply gravity
-		p.velocity.y += 200.0 * delta_time
+	// Swap dead particles out. Don't advance i after a swap, the moved particle needs checking too
+	i := 0
+	for i < ps.count {
+		if ps.life[i] <= 0 {
+			remove_particle(ps, i)
+		} else {
+			i += 1
+		}
+	}
+}
 
-		// Apply air resistance
-		p.velocity.x *= 0.98
-		p.velocity.y *= 0.99
+// Moves particles [start, end) on by delta_time. start must be a multiple of PARTICLE_LANES.
+integrate_particles :: proc(ps: ^Particle_System, delta_time: f32, start, end: int) {
+	i := start
+	for ; i + PARTICLE_LANES <= end; i += PARTICLE_LANES {
+		px := (^Particle_Lane)(&ps.pos_x[i])
+		py := (^Particle_Lane)(&ps.pos_y[i])
+		vx := (^Particle_Lane)(&ps.vel_x[i])
+		vy := (^Particle_Lane)(&ps.vel_y[i])
+		life := (^Particle_Lane)(&ps.life[i])
+		inv_max_life := (^Particle_Lane)(&ps.inv_max_life[i])
+		alpha := (^Particle_Lane)(&ps.alpha[i])
 
-		// Update life
-		p.life -= delta_time
+		// Update position
+		px^ += vx^ * delta_time
+		py^ += vy^ * delta_time
 
-		// Fade out color based on remaining life
-		life_factor := p.life / p.max_life
-		p.color.a = u8(255 * life_factor)
+		// Apply gravity, then air resistance
+		vy^ += PARTICLE_GRAVITY * delta_time
+		vx^ *= PARTICLE_DRAG.x
+		vy^ *= PARTICLE_DRAG.y
 
-		// Shrink particle over time
-		//p.size = (2.0 + f32(rand.int31() % 3)) * life_factor
+		// Update life, alpha fades out with it
+		life^ -= delta_time
+		alpha^ = life^ * inv_max_life^
+	}
 
-		// Deactivate if life is over
-		if p.life <= 0 {
-			p.active = false
-			ps.active_count -= 1
-		}
+	// Leftovers that don't fill a whole lane
+	for ; i < end; i += 1 {
+		ps.pos_x[i] += ps.vel_x[i] * delta_time
+		ps.pos_y[i] += ps.vel_y[i] * delta_time
+		ps.vel_y[i] += PARTICLE_GRAVITY * delta_time
+		ps.vel_x[i] *= PARTICLE_DRAG.x
+		ps.vel_y[i] *= PARTICLE_DRAG.y
+		ps.life[i] -= delta_time
+		ps.alpha[i] = ps.life[i] * ps.inv_max_life[i]
 	}
 }
 
 // Draw all active particles
+// Every particle is a 1x1 quad with the shapes texture, which is what DrawPixelV does per call.
+// The texture is set once and nothing in the loop changes rlgl state, so they all go out in one
+// draw call (more only if they overflow rlgl's vertex buffer).
 draw_particle_system :: proc(ps: ^Particle_System, fade: f32) {
-	for i in 0 ..< MAX_PARTICLES {
-		if !ps.particles[i].active do continue
+	if ps.count == 0 {
+		return
+	}
+
+	shapes_tex := rl.GetShapesTexture()
+	shapes_rect := rl.GetShapesTextureRectangle()
+	u := (shapes_rect.x + shapes_rect.width / 2) / f32(shapes_tex.width)
+	v := (shapes_rect.y + shapes_rect.height / 2) / f32(shapes_tex.height)
+
+	rlgl.SetTexture(shapes_tex.id)
+	rlgl.Begin(rlgl.QUADS)
+	for i in 0 ..< ps.count {
+		c := ps.color[i]
+		a := u8(clamp(ps.alpha[i] * fade, 0, 1) * f32(c.a))
+		x := ps.pos_x[i]
+		y := ps.pos_y[i]
+		rlgl.Color4ub(c.r, c.g, c.b, a)
+		rlgl.TexCoord2f(u, v)
+		rlgl.Vertex2f(x, y)
+		rlgl.Vertex2f(x, y + 1)
+		rlgl.Vertex2f(x + 1, y + 1)
+		rlgl.Vertex2f(x + 1, y)
+	}
+	rlgl.End()
+	rlgl.SetTexture(0)
+}
 
-		p := &ps.particles[i]
-		rl.DrawPixelV(p.position, p.color)
+//Headless particle benchmark, see particle_benchmark/particle_benchmark.odin. Keeps count
+//particles alive (dead ones are respawned) and times frames of update_particle_system.
+run_particle_benchmark :: proc(count: int, frames: int) {
+	ps := new(Particle_System)
+	defer free(ps)
+
+	dt := f32(1.0 / 144.0)
+	total_ms: f64
+	best_ms := max(f64)
+	for _ in 0 ..< frames {
+		for ps.count < count {
+			angle := rand.float32() * math.TAU
+			speed := 30 + rand.float32() * 40
+			vel := Vec2{math.cos(angle) * speed, math.sin(angle) * speed}
+			if !spawn_particle(ps, {0, 0}, vel, 0.5 + rand.float32(), rl.GOLD) {
+				break
+			}
+		}
+
+		start := time.tick_now()
+		update_particle_system(ps, dt)
+		ms := time.duration_milliseconds(time.tick_since(start))
+		total_ms += ms
+		best_ms = min(best_ms, ms)
 	}
+
+	avg_ms := total_ms / f64(max(frames, 1))
+	fmt.printf(
+		"Particle benchmark: %i particles, %i frames, avg %.3fms, best %.3fms (144 FPS budget %.3fms)\n",
+		count,
+		frames,
+		avg_ms,
+		best_ms,
+		1000.0 / 144.0,
+	)
 }
@@ -0,0 +1,27 @@
+/*
+Headless particle benchmark, no window is opened.
+
+	odin run source/particle_benchmark -o:speed -- [particles] [frames]
+
+Defaults to 100000 particles over 1000 frames.
+*/
+
+package particle_benchmark
+
+import game ".."
+import "core:os"
+import "core:strconv"
+
+main :: proc() {
+	count := 100_000
+	frames := 1000
+
+	if len(os.args) > 1 {
+		count = strconv.parse_int(os.args[1]) or_else count
+	}
+	if len(os.args) > 2 {
+		frames = strconv.parse_int(os.args[2]) or_else frames
+	}
+
+	game.run_particle_benchmark(min(count, game.MAX_PARTICLES), frames)
+}
@@ -38,7 +38,8 @@ player_center :: proc() -> Vec2 {
 
 update_player :: proc(dt: f32) {
 	p := get_player()
-	p.is_on_ground = true
+	//Without gravity nothing would ever land, so the player counts as grounded everywhere
+	p.is_on_ground = !USE_GRAVITY || .feet in p.tile_contacts
 	//For keeping our input value so we continue to move outwards when jumping from the edge of a platform
 	if !p.side_jump {p.input = {}} else {
 		p.side_jump_timer += dt
@@ -70,9 +71,9 @@ update_player :: proc(dt: f32) {
 		}
 	} else {p.air_time = 0}*/
 
-	p.pos += (p.vel * dt)
+	contacts := move_entity(&g.level, p, p.vel * dt)
 
-	//create_trail_effect(&g.particle_system, p.pos, p.vel)
+	//create_trail_effect(g.particle_system, p.pos, p.vel)
 
 
 	//Checking if player is able to run
@@ -83,19 +84,19 @@ update_player :: proc(dt: f32) {
 	}*/
 
 	//Reset player position and states/actions
-	if rl.IsKeyPressed(.R) {
+	if key_pressed(.R) {
 		resetPlayer()
 	}
 
 	//Hold onto walls?
-	if rl.IsKeyDown(.LEFT_SHIFT) {
+	if key_down(.LEFT_SHIFT) {
 		p.can_wall_climb = true
 	} else {
 		p.can_wall_climb = false
 	}
 
 	//Movement - depends on orientation
-	if rl.IsKeyDown(.LEFT) || rl.IsKeyDown(.A) {
+	if key_down(.LEFT) || key_down(.A) {
 		switch (p.orientation) 
 		{
 		case .norm:
@@ -138,17 +139,17 @@ update_player :: proc(dt: f32) {
 
 	//if we have just landed
 	if p.last_movement == .jumping && p.is_on_ground {
-		create_landing_effect(&g.particle_system, p.pos, i32(p.platform_index))
+		create_landing_effect(g.particle_system, p.pos, i32(p.platform_index))
 		p.last_movement = .idle
 	}
 	//fixes issue where player cannot move left after moving around a platform
 	//from the left side to upside down. 
-	if rl.IsKeyReleased(.LEFT) || rl.IsKeyReleased(.A) {
+	if key_released(.LEFT) || key_released(.A) {
 		p.last_orientation = p.orientation
 	}
 
 	//right
-	if rl.IsKeyDown(.RIGHT) || rl.IsKeyDown(.D) {
+	if key_down(.RIGHT) || key_down(.D) {
 		switch (p.orientation) 
 		{
 		case .norm:
@@ -192,13 +193,13 @@ update_player :: proc(dt: f32) {
 		}
 	}
 
-	if rl.IsKeyReleased(.RIGHT) || rl.IsKeyReleased(.D) {
+	if key_released(.RIGHT) || key_released(.D) {
 		p.last_orientation = p.orientation
 	}
 
 	//Jumping
 	//We have a switch to determine the orientation so we can calculate the jump angle properly
-	if rl.IsKeyDown(.SPACE) || rl.IsKeyDown(.W) {
+	if key_down(.SPACE) || key_down(.W) {
 		switch p.orientation 
 		{
 		case .norm:
@@ -210,7 +211,7 @@ update_player :: proc(dt: f32) {
 				p.last_movement = .jumping
 				p.anim = animation_create(.Frog_Jump)
 				create_jump_effect(
-					&g.particle_system,
+					g.particle_system,
 					p.pos - {0, p.rect.height / 2},
 					i32(p.platform_index),
 				)
@@ -270,7 +271,7 @@ update_player :: proc(dt: f32) {
 
 	//Tongue attack?	
 	if rl.IsMouseButtonPressed(.LEFT) {
-		create_attack_effect(&g.particle_system, p.pos, p.dir)
+		create_attack_effect(g.particle_system, p.pos, p.dir)
 		fmt.printf("Player Attac\n")
 		/*if p.can_attack {
 			pos := rl.GetScreenToWorld2D(rl.GetMousePosition(), game_camera())
@@ -310,7 +311,7 @@ update_player :: proc(dt: f32) {
 
 	// Update player pos by the input
 	p.input = linalg.normalize0(p.input)
-	p.pos += p.input * dt * 75
+	contacts += move_entity(&g.level, p, p.input * dt * 75)
 
 	//Check if player is grounded using colliders with platforms
 	//collider update - based on orientation
@@ -360,6 +361,8 @@ update_player :: proc(dt: f32) {
 		}
 	}
 
+	p.tile_contacts = contacts + entity_tile_contacts(&g.level, p)
+
 	//checking if we have collided with feet collider - if we aren't moving we are idle. 
 	/*for platform in level.platforms {
 		if platform.exists {
@@ -523,7 +526,7 @@ update_player :: proc(dt: f32) {
 					level.player.current_anim = level.player.player_slide
 				}*/
 				if p.friction_face == .right {
-					p.vel.y = sliding_speed * rl.GetFrameTime()
+					p.vel.y = sliding_speed * frame_time()
 					p.state = .grounded
 
 				}
@@ -536,7 +539,7 @@ update_player :: proc(dt: f32) {
 					level.player.current_anim = level.player.player_slide
 				}*/
 				if p.friction_face == .left {
-					p.vel.y = sliding_speed * rl.GetFrameTime()
+					p.vel.y = sliding_speed * frame_time()
 					p.state = .grounded
 				}
 				p.vel.x = 0
@@ -606,6 +609,7 @@ update_player_colliders :: proc() {
 		p_height = r.height
 		p.rect = {p.pos.x - p_width / 2, p.pos.y, p_width, p_height}
 	}
+	p.ent_rect = rect_to_entity_rect(p.rect, p.pos)
 }
 
 //Rotates the player and it's colliders based on the rotation direction and facing
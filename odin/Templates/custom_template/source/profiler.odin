@@ -0,0 +1,294 @@
+package game
+
+import "core:fmt"
+import "core:os"
+import "core:strings"
+import "core:sync"
+import "core:time"
+import rl "vendor:raylib"
+
+//Frame profiler.
+//
+//Put profile_zone("name") at the top of a scope to time it, the zone ends when the scope does:
+//
+//	update_chunks :: proc(game_memory: ^Game_Memory) {
+//		profile_zone("update_chunks")
+//
+//Each thread writes finished zones into its own ring buffer, no locks are taken. The main thread
+//marks frames with profile_frame_begin. F8 shows the last frame as a flame graph, one row per
+//nesting depth and one lane per thread. F9 writes every event still in the rings to
+//PROFILE_TRACE_PATH in Chrome trace format (open it in chrome://tracing or ui.perfetto.dev).
+//
+//Build with -define:PROFILER=false to compile every zone out, the calls are removed entirely.
+//Zone names must be string literals, the rings keep the string, not a copy of it.
+
+PROFILER :: #config(PROFILER, ODIN_DEBUG)
+PROFILE_RING_SIZE :: 4096 // events per thread
+PROFILE_MAX_THREADS :: 16 // main, chunk streamer and the job pool workers
+PROFILE_MAX_DEPTH :: 16
+PROFILE_TRACE_PATH :: "profile_trace.json"
+
+Profile_Event :: struct {
+	name:  string,
+	start: i64, // tick nanoseconds
+	end:   i64,
+	depth: i32,
+}
+
+Profile_Thread :: struct {
+	id:     int,
+	name:   string,
+	events: [PROFILE_RING_SIZE]Profile_Event,
+	//events written so far, the newest is at (count - 1) % PROFILE_RING_SIZE. Only the owning
+	//thread writes it, others read it atomically and only look at events before it.
+	count:  u64,
+	open:   [PROFILE_MAX_DEPTH]Profile_Event,
+	depth:  i32,
+}
+
+Profiler :: struct {
+	threads:      [PROFILE_MAX_THREADS]Profile_Thread,
+	thread_count: int,
+	main_thread:  int, // id of the thread calling profile_frame_begin
+	frame_start:  i64,
+	last_frame:   [2]i64, // start and end of the last finished frame, drawn by the overlay
+	show:         bool,
+}
+
+//This thread's ring. Thread locals don't survive a hot reload, so it is looked up again by id.
+@(thread_local)
+profile_thread: ^Profile_Thread
+
+//Starts a zone that ends with the enclosing scope
+@(deferred_in = profile_zone_end, disabled = !PROFILER)
+profile_zone :: proc(name: string) {
+	t := get_profile_thread()
+	if t == nil {
+		return
+	}
+	if t.depth < PROFILE_MAX_DEPTH {
+		t.open[t.depth] = {
+			name  = name,
+			start = time.tick_now()._nsec,
+			depth = t.depth,
+		}
+	}
+	t.depth += 1
+}
+
+@(disabled = !PROFILER)
+profile_zone_end :: proc(name: string) {
+	t := profile_thread
+	if t == nil {
+		return
+	}
+	t.depth -= 1
+	if t.depth >= PROFILE_MAX_DEPTH {
+		return
+	}
+	event := t.open[t.depth]
+	event.end = time.tick_now()._nsec
+	t.events[t.count % PROFILE_RING_SIZE] = event
+	sync.atomic_store_explicit(&t.count, t.count + 1, .Release)
+}
+
+//Gives the calling thread a name in the overlay and the trace
+@(disabled = !PROFILER)
+profile_thread_name :: proc(name: string) {
+	if t := get_profile_thread(); t != nil {
+		t.name = name
+	}
+}
+
+//Call at the start of every frame on the main thread
+@(disabled = !PROFILER)
+profile_frame_begin :: proc() {
+	if g == nil || g.profiler == nil {
+		return
+	}
+	p := g.profiler
+	p.main_thread = sync.current_thread_id()
+	now := time.tick_now()._nsec
+	if p.frame_start != 0 {
+		p.last_frame = {p.frame_start, now}
+	}
+	p.frame_start = now
+}
+
+get_profile_thread :: proc() -> ^Profile_Thread {
+	if profile_thread != nil {
+		return profile_thread
+	}
+	// Headless runs (benchmarks) have no game memory
+	if g == nil || g.profiler == nil {
+		return nil
+	}
+	p := g.profiler
+	id := sync.current_thread_id()
+	count := sync.atomic_load(&p.thread_count)
+	for &t in p.threads[:count] {
+		if t.id == id {
+			profile_thread = &t
+			return profile_thread
+		}
+	}
+	i := sync.atomic_add(&p.thread_count, 1)
+	if i >= PROFILE_MAX_THREADS {
+		sync.atomic_sub(&p.thread_count, 1)
+		return nil
+	}
+	p.threads[i].id = id
+	profile_thread = &p.threads[i]
+	return profile_thread
+}
+
+PROFILE_ROW_HEIGHT :: 14
+PROFILE_LANE_GAP :: 6
+
+//Flame graph of the last frame across the top of the screen
+draw_profiler_overlay :: proc(p: ^Profiler) {
+	frame_start, frame_end := p.last_frame[0], p.last_frame[1]
+	if frame_end <= frame_start {
+		return
+	}
+	width := f32(rl.GetScreenWidth()) - 20
+	scale := width / f32(frame_end - frame_start)
+	font_size := f32(10)
+	y := f32(40)
+
+	frame_ms := f64(frame_end - frame_start) / 1e6
+	rl.DrawTextEx(
+		rl.GetFontDefault(),
+		rl.TextFormat("Frame %.2fms (F8 hide, F9 save trace)", frame_ms),
+		{10, y - 14},
+		font_size,
+		1,
+		rl.BLACK,
+	)
+
+	for &t in p.threads[:sync.atomic_load(&p.thread_count)] {
+		count := sync.atomic_load_explicit(&t.count, .Acquire)
+		max_depth := i32(0)
+		// Newest first. Events are written as they end, so once one ended before the frame
+		// started, everything older did too.
+		for n := u64(0); n < min(count, PROFILE_RING_SIZE - 1); n += 1 {
+			event := t.events[(count - 1 - n) % PROFILE_RING_SIZE]
+			if event.end < frame_start {
+				break
+			}
+			if event.start > frame_end {
+				continue
+			}
+			x0 := 10 + f32(max(event.start, frame_start) - frame_start) * scale
+			x1 := 10 + f32(min(event.end, frame_end) - frame_start) * scale
+			rect := Rect {
+				x0,
+				y + f32(event.depth) * PROFILE_ROW_HEIGHT,
+				max(x1 - x0, 1),
+				PROFILE_ROW_HEIGHT - 1,
+			}
+			rl.DrawRectangleRec(rect, profile_zone_color(event.name))
+			// %.*s, names are not nul terminated
+			label := rl.TextFormat(
+				"%.*s %.2fms",
+				i32(len(event.name)),
+				cstring(raw_data(event.name)),
+				f64(event.end - event.start) / 1e6,
+			)
+			if f32(rl.MeasureText(label, i32(font_size))) < rect.width - 4 {
+				label_pos := Vec2{x0 + 2, rect.y + 2}
+				rl.DrawTextEx(rl.GetFontDefault(), label, label_pos, font_size, 1, rl.BLACK)
+			}
+			max_depth = max(max_depth, event.depth)
+		}
+		name := profile_thread_label(p, &t)
+		rl.DrawTextEx(
+			rl.GetFontDefault(),
+			rl.TextFormat("%.*s", i32(len(name)), cstring(raw_data(name))),
+			{width - 60, y},
+			font_size,
+			1,
+			rl.DARKGRAY,
+		)
+		y += f32(max_depth + 1) * PROFILE_ROW_HEIGHT + PROFILE_LANE_GAP
+	}
+}
+
+//Threads without a name are the main thread or job pool workers
+profile_thread_label :: proc(p: ^Profiler, t: ^Profile_Thread) -> string {
+	if t.name != "" {
+		return t.name
+	}
+	return "main" if t.id == p.main_thread else "worker"
+}
+
+//Same name, same colour, so zones are easy to follow from frame to frame
+profile_zone_color :: proc(name: string) -> rl.Color {
+	h: u32 = 2166136261
+	for i in 0 ..< len(name) {
+		h = (h ~ u32(name[i])) * 16777619
+	}
+	return {u8(140 + h % 100), u8(140 + (h >> 8) % 100), u8(140 + (h >> 16) % 100), 230}
+}
+
+//Writes every event still in the rings as Chrome trace "complete" events
+export_profile_trace :: proc(p: ^Profiler, path: string) -> bool {
+	b := strings.builder_make()
+	defer strings.builder_destroy(&b)
+
+	//One snapshot of every ring's write count, so the base and the events agree. The slot at
+	//count % PROFILE_RING_SIZE is the one its thread writes next, it may be half written already.
+	thread_count := sync.atomic_load(&p.thread_count)
+	counts: [PROFILE_MAX_THREADS]u64
+	base := max(i64)
+	for &t, tid in p.threads[:thread_count] {
+		counts[tid] = sync.atomic_load_explicit(&t.count, .Acquire)
+		if counts[tid] > 0 {
+			oldest := counts[tid] - min(counts[tid], PROFILE_RING_SIZE - 1)
+			base = min(base, t.events[oldest % PROFILE_RING_SIZE].start)
+		}
+	}
+
+	strings.write_string(&b, "{\"traceEvents\":[\n")
+	written := 0
+	for &t, tid in p.threads[:thread_count] {
+		name := profile_thread_label(p, &t)
+		if written > 0 {
+			strings.write_string(&b, ",\n")
+		}
+		fmt.sbprintf(
+			&b,
+			`{"name":"thread_name","ph":"M","pid":1,"tid":%i,"args":{"name":"%s"}}`,
+			tid,
+			name,
+		)
+		written += 1
+
+		count := counts[tid]
+		for i := count - min(count, PROFILE_RING_SIZE - 1); i < count; i += 1 {
+			event := t.events[i % PROFILE_RING_SIZE]
+			//the thread kept going while we export, skip the event if its slot was reused since
+			if sync.atomic_load_explicit(&t.count, .Acquire) >= i + PROFILE_RING_SIZE {
+				continue
+			}
+			strings.write_string(&b, ",\n")
+			fmt.sbprintf(
+				&b,
+				`{"name":"%s","ph":"X","pid":1,"tid":%i,"ts":%.3f,"dur":%.3f}`,
+				event.name,
+				tid,
+				f64(event.start - base) / 1e3,
+				f64(event.end - event.start) / 1e3,
+			)
+			written += 1
+		}
+	}
+	strings.write_string(&b, "\n]}\n")
+
+	if !os.write_entire_file(path, b.buf[:]) {
+		fmt.printf("Failed to write profile trace: %s\n", path)
+		return false
+	}
+	fmt.printf("Wrote profile trace %s, %i events\n", path, written)
+	return true
+}
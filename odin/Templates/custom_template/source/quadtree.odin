@@ -1,26 +1,85 @@
 package game
 import hm "../handle_map"
+import "../jobs"
 import "core:fmt"
+import "core:math"
+import vmem "core:mem/virtual"
+import "core:time"
 import rl "vendor:raylib"
 
-MAX_NODES :: 1024
+//Nodes at this depth (root is depth 1) never split, extra entities just queue up in their list.
+//Stops a pile of entities at the same spot from subdividing forever.
+QUADTREE_MAX_DEPTH :: #config(QUADTREE_MAX_DEPTH, 10)
+//Most nodes a tree capped at QUADTREE_MAX_DEPTH can ever hold, 1 + 4 + 16 + ... 4^(depth-1).
+//The node pool reserves virtual memory for this many, pages are only committed as it grows.
+QUADTREE_NODE_RESERVE :: ((1 << (2 * QUADTREE_MAX_DEPTH)) - 1) / 3
 MAX_ENTITIES_PER_QUAD :: 4
+//Siblings are merged back into their parent once the whole group holds this many entities or less.
+//Kept below MAX_ENTITIES_PER_QUAD so a node sitting on the limit doesn't split/merge every frame.
+QUADTREE_MERGE_THRESHOLD :: MAX_ENTITIES_PER_QUAD / 2
+//Loose bounds are the node bounds scaled by this factor around the node center. An entity
+//only has to leave the loose bounds before it is moved to another node.
+QUADTREE_LOOSENESS :: f32(2)
+//Root covers QUADTREE_NUM_QUADS chunks in each direction, centered on the origin
+QUADTREE_QUAD_SIZE :: TOTAL_CHUNK_PIXELS
+QUADTREE_NUM_QUADS :: 40
+//Entities per job when the incremental update checks which ones left their node
+QUADTREE_JOB_BATCH :: 256
 quad_size: i32
 num_quads: i32
 
+Quadtree_Mode :: enum {
+	incremental, //only entities that left their node's loose bounds are re-inserted
+	rebuild, //tree is cleared and every entity re-inserted each update
+}
+
+quadtree_mode_names := [Quadtree_Mode]cstring {
+	.incremental = "incremental",
+	.rebuild     = "rebuild",
+}
+
 Quadtree :: struct {
-	nodes:      [MAX_NODES]QuadtreeNode,
-	node_count: i32,
+	//grows in place inside nodes_arena (same trick as handle_map), so node pointers never move
+	nodes:       [dynamic]QuadtreeNode,
+	nodes_arena: ^vmem.Arena,
+	//first index of 4-node child blocks released by merges, reused by subdivide
+	free_blocks: [dynamic]i32,
+	//indexed by Entity_Handle.idx, tracks which node each entity lives in
+	entries:     [dynamic]Quadtree_Entry,
+	mode:        Quadtree_Mode,
+	stats:       Quadtree_Stats,
 }
 
 QuadtreeNode :: struct {
-	bounds:        EntityRect,
-	entity_handle: [MAX_ENTITIES_PER_QUAD]Entity_Handle,
-	entity_count:  i32,
-	children:      [4]i32, // Indices into the node pool
-	parent:        i32,
-	has_children:  bool,
-	depth:         i32,
+	bounds:       EntityRect,
+	loose_bounds: EntityRect,
+	first_entry:  i32, // Head of this node's entry list, -1 when empty
+	entity_count: i32,
+	children:     [4]i32, // Indices into the node pool
+	parent:       i32,
+	has_children: bool,
+	active:       bool, // false once the node has been merged away and sits in free_blocks
+	depth:        i32,
+}
+
+//One per entity in the tree. Entries in the same node form a doubly linked list
+//so an entity can be unlinked without searching its node.
+Quadtree_Entry :: struct {
+	handle: Entity_Handle,
+	bounds: EntityRect,
+	node:   i32, // -1 when the entity is not in the tree
+	prev:   i32,
+	next:   i32,
+}
+
+Quadtree_Stats :: struct {
+	update_ms:  f64, // time spent in the last update
+	moved:      i32, // entities (re)inserted during the last update
+	//running average per mode, used to compare incremental against a full rebuild
+	avg_ms:     [Quadtree_Mode]f64,
+	nodes_used: i32, // active nodes including the root, len(tree.nodes) is the pool high-water mark
+	max_depth:  i32, // deepest node created since the tree was last initialized
+	overflow:   i32, // entities over MAX_ENTITIES_PER_QUAD sitting in nodes at QUADTREE_MAX_DEPTH
 }
 
 //To use quadtree propery you will require the struct below to be declared in one of your files
@@ -36,6 +95,30 @@ rect_overlaps :: proc(a, b: EntityRect) -> bool {
 	return a.min.x < b.max.x && a.max.x > b.min.x && a.min.y < b.max.y && a.max.y > b.min.y
 }
 
+// Checks if inner lies completely inside outer
+rect_contains :: proc(outer, inner: EntityRect) -> bool {
+	return(
+		inner.min.x >= outer.min.x &&
+		inner.max.x <= outer.max.x &&
+		inner.min.y >= outer.min.y &&
+		inner.max.y <= outer.max.y \
+	)
+}
+
+rect_center :: proc(r: EntityRect) -> Vec2 {
+	return (r.min + r.max) * 0.5
+}
+
+// Converts a raylib rect (e.g. Entity.rect) into the min/max form used by the quadtree
+rect_to_entity_rect :: proc(r: Rect, pos: Vec2) -> EntityRect {
+	return EntityRect{min = {r.x, r.y}, max = {r.x + r.width, r.y + r.height}, pos = pos}
+}
+
+compute_loose_bounds :: proc(bounds: EntityRect) -> EntityRect {
+	pad := (bounds.max - bounds.min) * ((QUADTREE_LOOSENESS - 1) / 2)
+	return EntityRect{min = bounds.min - pad, max = bounds.max + pad, pos = bounds.pos}
+}
+
 //Initializes the root node and quadtree
 init_quadtree :: proc(tree: ^Quadtree, QUAD_SIZE, NUM_QUADS: i32) {
 	quad_size = QUAD_SIZE
@@ -47,35 +130,209 @@ init_quadtree :: proc(tree: ^Quadtree, QUAD_SIZE, NUM_QUADS: i32) {
 	}
 	//	fmt.printf("bounds pos: %v,%v\n", root_bounds.min, root_bounds.max)
 
-	tree.node_count = 1
-	tree.nodes[0].depth = 1
-	tree.nodes[0] = QuadtreeNode {
+	if tree.nodes_arena == nil && !init_quadtree_node_pool(tree) {
+		return
+	}
+	clear(&tree.nodes)
+	append(&tree.nodes, QuadtreeNode {
 		bounds       = root_bounds,
+		loose_bounds = compute_loose_bounds(root_bounds),
+		first_entry  = -1,
 		entity_count = 0,
 		has_children = false,
+		active       = true,
 		parent       = -1,
+		depth        = 1,
+	})
+	tree.stats.nodes_used = 1
+	tree.stats.max_depth = 1
+	tree.stats.overflow = 0
+
+	clear(&tree.free_blocks)
+	for &entry in tree.entries {
+		entry = Quadtree_Entry {
+			node = -1,
+			prev = -1,
+			next = -1,
+		}
+	}
+}
+
+//Reserves the virtual memory for the node pool. The arena struct lives inside the arena
+//itself so the allocator held by tree.nodes stays valid, see handle_map.make
+init_quadtree_node_pool :: proc(tree: ^Quadtree) -> bool {
+	arena_bootstrap: vmem.Arena
+	err := vmem.arena_init_static(
+		&arena_bootstrap,
+		uint(QUADTREE_NODE_RESERVE * size_of(QuadtreeNode) + size_of(vmem.Arena)),
+	)
+	if err != nil {
+		fmt.printf("ERR - Quadtree node pool could not be reserved: %v\n", err)
+		return false
+	}
+
+	arena := new(vmem.Arena, vmem.arena_allocator(&arena_bootstrap))
+	arena^ = arena_bootstrap
+	tree.nodes_arena = arena
+	tree.nodes = make([dynamic]QuadtreeNode, vmem.arena_allocator(arena))
+	return true
+}
+
+delete_quadtree :: proc(tree: ^Quadtree) {
+	delete(tree.free_blocks)
+	delete(tree.entries)
+	//copy the arena out first, it is stored inside its own memory
+	if tree.nodes_arena != nil {
+		arena := tree.nodes_arena^
+		vmem.arena_destroy(&arena)
 	}
+	tree^ = {}
+}
+
+//Brings the tree in line with g.entities using the current mode and records timings
+quadtree_update :: proc(tree: ^Quadtree) {
+	profile_zone("quadtree_update")
+	if len(tree.nodes) == 0 {
+		init_quadtree(tree, QUADTREE_QUAD_SIZE, QUADTREE_NUM_QUADS)
+	}
+
+	start := time.tick_now()
+	switch tree.mode {
+	case .incremental:
+		update_quadtree_incremental(tree)
+	case .rebuild:
+		build_quadtree()
+	}
+	ms := time.duration_milliseconds(time.tick_since(start))
+
+	tree.stats.update_ms = ms
+	if tree.stats.avg_ms[tree.mode] == 0 {
+		tree.stats.avg_ms[tree.mode] = ms
+	} else {
+		tree.stats.avg_ms[tree.mode] = tree.stats.avg_ms[tree.mode] * 0.95 + ms * 0.05
+	}
+}
+
+//Toggles between incremental updates and the full per-frame rebuild
+toggle_quadtree_mode :: proc(tree: ^Quadtree) {
+	switch tree.mode {
+	case .incremental:
+		tree.mode = .rebuild
+	case .rebuild:
+		tree.mode = .incremental
+	}
+	fmt.printf("Quadtree mode: %v\n", tree.mode)
 }
 
 build_quadtree :: proc() {
+	profile_zone("build_quadtree")
 	reset_quadtree()
+	quadtree.stats.moved = 0
 	my_iter := hm.make_iter(&g.entities)
 	for item, handle in hm.iter(&my_iter) {
-		insert_entity(&quadtree, 0, handle, item.ent_rect)
+		insert_entity(quadtree, 0, handle, item.ent_rect)
+		quadtree.stats.moved += 1
+	}
+}
+
+//Only touches entities whose bounds changed and left the loose bounds of their node.
+//Entities that have not moved cost one rect compare. The compares run on the job pool, the
+//entities that have to move are then re-inserted on this thread, in g.entities order.
+update_quadtree_incremental :: proc(tree: ^Quadtree) {
+	//Drop entries whose entity was removed, or whose slot has been reused by a new entity.
+	//Entries are indexed by handle.idx, which is not the position in g.entities.items.
+	for &entry, idx in tree.entries {
+		if entry.node == -1 {continue}
+		if !hm.valid(g.entities, entry.handle) {
+			remove_entry(tree, i32(idx))
+		}
+	}
+
+	tree.stats.moved = 0
+	classify := Quadtree_Classify {
+		tree   = tree,
+		relink = make([]bool, len(g.entities.items), context.temp_allocator),
+	}
+	jobs.parallel_for(
+		job_pool(),
+		len(g.entities.items),
+		QUADTREE_JOB_BATCH,
+		&classify,
+		classify_quadtree_entries,
+	)
+
+	for &item, i in g.entities.items {
+		if !classify.relink[i] {continue}
+		idx := int(item.handle.idx)
+
+		if idx >= len(tree.entries) || tree.entries[idx].node == -1 {
+			insert_entity(tree, 0, item.handle, item.ent_rect)
+			tree.stats.moved += 1
+			continue
+		}
+
+		//Checked again, a merge caused by an earlier move may have left it in a bigger node
+		entry := &tree.entries[idx]
+		old_node := entry.node
+		if old_node == 0 || rect_contains(tree.nodes[old_node].loose_bounds, entry.bounds) {
+			continue
+		}
+
+		//Walk up until a node can hold the new bounds, then push it back down from there
+		target := tree.nodes[old_node].parent
+		for target > 0 && !rect_contains(tree.nodes[target].loose_bounds, entry.bounds) {
+			target = tree.nodes[target].parent
+		}
+		if target < 0 {target = 0}
+
+		unlink_entry(tree, i32(idx))
+		insert_entry(tree, target, i32(idx))
+		try_merge(tree, old_node)
+		tree.stats.moved += 1
+	}
+}
+
+Quadtree_Classify :: struct {
+	tree:   ^Quadtree,
+	relink: []bool, // per item in g.entities.items, true when it has to be (re)inserted
+}
+
+//Stores the new bounds of items [start, end) and flags the ones that left their node. Only
+//writes the items' own entries, the nodes are just read.
+classify_quadtree_entries :: proc(data: rawptr, start, end: int) {
+	classify := (^Quadtree_Classify)(data)
+	tree := classify.tree
+	for &item, i in g.entities.items[start:end] {
+		if hm.skip(item) {continue}
+		idx := int(item.handle.idx)
+
+		if idx >= len(tree.entries) || tree.entries[idx].node == -1 {
+			classify.relink[start + i] = true
+			continue
+		}
+
+		entry := &tree.entries[idx]
+		if entry.bounds == item.ent_rect {continue}
+		entry.bounds = item.ent_rect
+
+		old_node := entry.node
+		classify.relink[start + i] =
+			old_node != 0 && !rect_contains(tree.nodes[old_node].loose_bounds, entry.bounds)
 	}
 }
 
 //resets the quadtree and rebuilds it
 reset_quadtree :: proc() {
 	//fmt.printf("Resetting quadtree\n")
-	for i := 0; i < int(quadtree.node_count); i += 1 {
+	for i := 0; i < len(quadtree.nodes); i += 1 {
 		//fmt.printf("Resetting node: %i\n", i)
 		node := &quadtree.nodes[i]
 		node.entity_count = 0
+		node.first_entry = -1
 		node.has_children = false
 	}
 	if quad_size != 0 && num_quads != 0 {
-		init_quadtree(&quadtree, quad_size, num_quads)
+		init_quadtree(quadtree, quad_size, num_quads)
 	} else {
 		fmt.printf("ERR - quadsize and numquads not set!, Init Quadtree before calling reset!\n")
 	}
@@ -100,107 +357,209 @@ compute_child_bounds :: proc(parent_bounds: EntityRect, index: i32) -> EntityRec
 	return parent_bounds
 }
 
+//Returns the child of node whose bounds contain point p (same ordering as compute_child_bounds)
+child_for_point :: proc(node: ^QuadtreeNode, p: Vec2) -> i32 {
+	mid := rect_center(node.bounds)
+	index := 0
+	if p.x >= mid.x {index += 1}
+	if p.y >= mid.y {index += 2}
+	return node.children[index]
+}
+
 //Tree is the quadtree object
 //node index is the current tree node we are trying to insert into
-//entity id is the entity we are trying to insert
+//entity handle is the entity we are trying to insert
 //entity bounds is the bounds of the entity we are trying to insert
-//This function will insert the entity into the quadtree
+//This function will insert the entity into the quadtree, moving it if it is already tracked
 insert_entity :: proc(
 	tree: ^Quadtree,
 	node_index: i32,
 	entity_handle: Entity_Handle,
 	entity_bounds: EntityRect,
 ) {
-	//current node
-	node := &tree.nodes[node_index]
-	// If already subdivided, pass entity to children
+	entry_idx := i32(entity_handle.idx)
+	if entry_idx <= 0 {
+		return
+	}
 
-	//fmt.printf("insert_entity(%i) - :%v\n", entity_id, entity_bounds)
-	if node.has_children {
-		//fmt.printf("Node has children, passing off!\n")
-		for i := 0; i < 4; i += 1 {
-			child_idx := node.children[i]
-			if rect_overlaps(tree.nodes[child_idx].bounds, entity_bounds) {
-				/*fmt.printf(
-					"Child bound %v \noverlaps with entity %i\n",
-					tree.nodes[child_idx].bounds,
-					entity_bounds,
-				)*/
-				insert_entity(tree, child_idx, entity_handle, entity_bounds)
-				return
+	if int(entry_idx) >= len(tree.entries) {
+		old_len := len(tree.entries)
+		resize(&tree.entries, int(entry_idx) + 1)
+		for i in old_len ..< len(tree.entries) {
+			tree.entries[i] = Quadtree_Entry {
+				node = -1,
+				prev = -1,
+				next = -1,
 			}
 		}
 	}
-	//fmt.printf("No children, checking if there's room\n")
 
-	// Store entity if there's room
-	if node.entity_count < MAX_ENTITIES_PER_QUAD {
-		//fmt.printf("Inserting entity %i into node %i\n", entity_id, node_index)
-		node.entity_handle[node.entity_count] = entity_handle
-		node.entity_count += 1
+	if tree.entries[entry_idx].node != -1 {
+		unlink_entry(tree, entry_idx)
+	}
+	entry := &tree.entries[entry_idx]
+	entry.handle = entity_handle
+	entry.bounds = entity_bounds
+	insert_entry(tree, node_index, entry_idx)
+}
+
+//Pushes an entry down from node_index by its center, stopping at the first node whose
+//child can't hold it within its loose bounds. Splits the leaf once it goes over capacity.
+insert_entry :: proc(tree: ^Quadtree, node_index: i32, entry_idx: i32) {
+	bounds := tree.entries[entry_idx].bounds
+	center := rect_center(bounds)
+
+	current := node_index
+	for tree.nodes[current].has_children {
+		child := child_for_point(&tree.nodes[current], center)
+		if !rect_contains(tree.nodes[child].loose_bounds, bounds) {
+			break
+		}
+		current = child
+	}
+
+	link_entry(tree, current, entry_idx)
+	if !tree.nodes[current].has_children &&
+	   tree.nodes[current].entity_count > MAX_ENTITIES_PER_QUAD &&
+	   tree.nodes[current].depth < QUADTREE_MAX_DEPTH {
+		split_node(tree, current)
+	}
+}
+
+//Subdivides a full leaf and hands each entry down to the child that can hold it.
+//Children are not split further here, they split on their own next insert.
+split_node :: proc(tree: ^Quadtree, node_index: i32) {
+	if !subdivide(tree, node_index) {
 		return
 	}
-	//fmt.printf("Node is full, need to subdivide\n")
-	// Subdivide if needed
-	if !node.has_children {
-		//fmt.printf("Subdividing node: %i\n", node_index)
-		subdivide(tree, node_index)
-	}
-
-	// Reassign entities to children
-	i := 0
-	//loop over parent entities
-	//fmt.printf("Reassigning entities to children\n")
-	for i < int(node.entity_count) {
-		//check children of parent node for overlap with entity
-		/*fmt.printf(
-			"Reassigning entity %i, pos: %v:\n",
-			node.entities_id[i],
-			get_entity_bounds(ENTITIES[node.entities_id[i]]),
-		)*/
-		for j := 0; j < 4; j += 1 {
-			child_idx := node.children[j]
-			//fmt.printf("Checking child %i, %v:\n", child_idx, tree.nodes[child_idx].bounds)
-			if rect_overlaps(
-				tree.nodes[child_idx].bounds,
-				get_entity_bounds(node.entity_handle[i]),
-			) {
-				//fmt.printf("Child %i has entity %i\n", child_idx, node.entities_id[i])
-				insert_entity(
-					tree,
-					child_idx,
-					node.entity_handle[i],
-					get_entity_bounds(entity_handle),
-				)
-				node.entity_handle[i] = node.entity_handle[node.entity_count - 1] // Remove entity from parent
-				node.entity_count -= 1
-				i -= 1
-				break
-			} else {
-				//fmt.printf("Child %i does not have entity %i\n", child_idx, node.entities_id[i])
+
+	entry_idx := tree.nodes[node_index].first_entry
+	for entry_idx != -1 {
+		next_idx := tree.entries[entry_idx].next
+		bounds := tree.entries[entry_idx].bounds
+		child := child_for_point(&tree.nodes[node_index], rect_center(bounds))
+		if rect_contains(tree.nodes[child].loose_bounds, bounds) {
+			unlink_entry(tree, entry_idx)
+			link_entry(tree, child, entry_idx)
+		}
+		entry_idx = next_idx
+	}
+}
+
+link_entry :: proc(tree: ^Quadtree, node_index: i32, entry_idx: i32) {
+	node := &tree.nodes[node_index]
+	entry := &tree.entries[entry_idx]
+	entry.node = node_index
+	entry.prev = -1
+	entry.next = node.first_entry
+	if node.first_entry != -1 {
+		tree.entries[node.first_entry].prev = entry_idx
+	}
+	node.first_entry = entry_idx
+	node.entity_count += 1
+	if node.depth >= QUADTREE_MAX_DEPTH && node.entity_count > MAX_ENTITIES_PER_QUAD {
+		tree.stats.overflow += 1
+	}
+}
+
+unlink_entry :: proc(tree: ^Quadtree, entry_idx: i32) {
+	entry := &tree.entries[entry_idx]
+	node := &tree.nodes[entry.node]
+	if entry.prev != -1 {
+		tree.entries[entry.prev].next = entry.next
+	} else {
+		node.first_entry = entry.next
+	}
+	if entry.next != -1 {
+		tree.entries[entry.next].prev = entry.prev
+	}
+	if node.depth >= QUADTREE_MAX_DEPTH && node.entity_count > MAX_ENTITIES_PER_QUAD {
+		tree.stats.overflow -= 1
+	}
+	node.entity_count -= 1
+	entry.node = -1
+	entry.prev = -1
+	entry.next = -1
+}
+
+//Removes an entity from the tree and merges any siblings left under-full
+remove_entry :: proc(tree: ^Quadtree, entry_idx: i32) {
+	node_index := tree.entries[entry_idx].node
+	if node_index == -1 {
+		return
+	}
+	unlink_entry(tree, entry_idx)
+	try_merge(tree, node_index)
+}
+
+//Walks up from node_index collapsing any node whose children are all leaves and which,
+//together with those children, holds QUADTREE_MERGE_THRESHOLD entities or less.
+try_merge :: proc(tree: ^Quadtree, node_index: i32) {
+	current := node_index
+	for current != -1 {
+		node := &tree.nodes[current]
+		if !node.has_children {
+			current = node.parent
+			continue
+		}
+
+		total := node.entity_count
+		for child_idx in node.children {
+			if tree.nodes[child_idx].has_children {
+				return
+			}
+			total += tree.nodes[child_idx].entity_count
+		}
+		if total > QUADTREE_MERGE_THRESHOLD {
+			return
+		}
+
+		for child_idx in node.children {
+			entry_idx := tree.nodes[child_idx].first_entry
+			for entry_idx != -1 {
+				next_idx := tree.entries[entry_idx].next
+				unlink_entry(tree, entry_idx)
+				link_entry(tree, current, entry_idx)
+				entry_idx = next_idx
 			}
+			tree.nodes[child_idx].active = false
 		}
-		i += 1
+		append(&tree.free_blocks, node.children[0])
+		tree.stats.nodes_used -= 4
+		node.has_children = false
+		current = node.parent
 	}
-	// Insert the new entity
-	insert_entity(tree, node_index, entity_handle, entity_bounds)
 }
 
-subdivide :: proc(tree: ^Quadtree, node_index: i32) {
-	if tree.node_count + 4 >= MAX_NODES {
-		fmt.printf("Subdivide - max nodes reached\n")
-		return // Prevent overflow
+//Allocates 4 children for node_index, reusing a freed block when there is one
+subdivide :: proc(tree: ^Quadtree, node_index: i32) -> bool {
+	first_child: i32
+	if len(tree.free_blocks) > 0 {
+		first_child = pop(&tree.free_blocks)
+	} else {
+		//the pool is sized for a full tree at QUADTREE_MAX_DEPTH, so this only fails if
+		//something splits past the depth cap
+		first_child = i32(len(tree.nodes))
+		if len(tree.nodes) + 4 > QUADTREE_NODE_RESERVE ||
+		   resize(&tree.nodes, len(tree.nodes) + 4) != nil {
+			fmt.printf("Subdivide - node pool exhausted\n")
+			return false
+		}
 	}
 
 	node := &tree.nodes[node_index]
 	for i := 0; i < 4; i += 1 {
-		child_idx := tree.node_count
-		tree.node_count += 1
+		child_idx := first_child + i32(i)
+		child_bounds := compute_child_bounds(node.bounds, i32(i))
 		tree.nodes[child_idx] = QuadtreeNode {
-			bounds       = compute_child_bounds(node.bounds, i32(i)),
+			bounds       = child_bounds,
+			loose_bounds = compute_loose_bounds(child_bounds),
+			first_entry  = -1,
 			entity_count = 0,
 			has_children = false,
+			active       = true,
 			parent       = node_index,
+			depth        = node.depth + 1,
 		}
 		//fmt.printf("Child %i bounds: %v\n", i, tree.nodes[child_idx].bounds)
 
@@ -208,18 +567,275 @@ subdivide :: proc(tree: ^Quadtree, node_index: i32) {
 	}
 
 	node.has_children = true
+	tree.stats.nodes_used += 4
+	tree.stats.max_depth = max(tree.stats.max_depth, node.depth + 1)
+	return true
 }
 
-get_entity_bounds :: proc(e: Entity_Handle) -> EntityRect {
+//QUERIES
+//All queries write into a caller supplied buffer and return how many handles were written.
+//Nothing is allocated. When the buffer fills up the query stops early, so size it for the
+//worst case you care about (e.g. a [64]Entity_Handle on the stack).
 
-	/*shipheight: f32
+//An overlapping pair of entities produced by query_pairs
+Entity_Pair :: struct {
+	a, b: Entity_Handle,
+}
+
+//Entities whose bounds overlap rect
+query_rect :: proc(tree: ^Quadtree, rect: EntityRect, out: []Entity_Handle) -> int {
+	count := 0
+	if len(tree.nodes) > 0 {
+		query_rect_node(tree, 0, rect, out, &count)
+	}
+	return count
+}
+
+query_rect_node :: proc(
+	tree: ^Quadtree,
+	node_index: i32,
+	rect: EntityRect,
+	out: []Entity_Handle,
+	count: ^int,
+) {
+	node := &tree.nodes[node_index]
+	//the root keeps anything outside the world, so it is always searched
+	if node_index != 0 && !rect_overlaps(node.loose_bounds, rect) {
+		return
+	}
+
+	for entry_idx := node.first_entry; entry_idx != -1; entry_idx = tree.entries[entry_idx].next {
+		if count^ >= len(out) {return}
+		entry := &tree.entries[entry_idx]
+		if rect_overlaps(entry.bounds, rect) {
+			out[count^] = entry.handle
+			count^ += 1
+		}
+	}
+
+	if node.has_children {
+		for child_idx in node.children {
+			query_rect_node(tree, child_idx, rect, out, count)
+		}
+	}
+}
+
+//Entities whose bounds touch the circle at center with the given radius
+query_radius :: proc(tree: ^Quadtree, center: Vec2, radius: f32, out: []Entity_Handle) -> int {
+	count := 0
+	if len(tree.nodes) > 0 {
+		query_radius_node(tree, 0, center, radius, out, &count)
+	}
+	return count
+}
+
+query_radius_node :: proc(
+	tree: ^Quadtree,
+	node_index: i32,
+	center: Vec2,
+	radius: f32,
+	out: []Entity_Handle,
+	count: ^int,
+) {
+	node := &tree.nodes[node_index]
+	if node_index != 0 && !circle_overlaps_rect(center, radius, node.loose_bounds) {
+		return
+	}
 
-	if _, ok := e.type.(Entity_Player); ok {
-		shipheight = PLAYER_SHIPHEIGHT
-	} else if _, ok := e.type.(Entity_Enemy); ok {
-		shipheight = ENEMY_BASIC_SHIPHEIGHT
+	for entry_idx := node.first_entry; entry_idx != -1; entry_idx = tree.entries[entry_idx].next {
+		if count^ >= len(out) {return}
+		entry := &tree.entries[entry_idx]
+		if circle_overlaps_rect(center, radius, entry.bounds) {
+			out[count^] = entry.handle
+			count^ += 1
+		}
+	}
+
+	if node.has_children {
+		for child_idx in node.children {
+			query_radius_node(tree, child_idx, center, radius, out, count)
+		}
+	}
+}
+
+//Entities hit by the ray from origin along dir, up to max_dist. dir does not need to be
+//normalized, max_dist is measured in multiples of dir. Results are not sorted by distance.
+query_ray :: proc(
+	tree: ^Quadtree,
+	origin, dir: Vec2,
+	max_dist: f32,
+	out: []Entity_Handle,
+) -> int {
+	count := 0
+	if len(tree.nodes) > 0 {
+		inv_dir := Vec2{1 / dir.x, 1 / dir.y}
+		query_ray_node(tree, 0, origin, inv_dir, max_dist, out, &count)
+	}
+	return count
+}
+
+query_ray_node :: proc(
+	tree: ^Quadtree,
+	node_index: i32,
+	origin, inv_dir: Vec2,
+	max_dist: f32,
+	out: []Entity_Handle,
+	count: ^int,
+) {
+	node := &tree.nodes[node_index]
+	if node_index != 0 && !ray_overlaps_rect(origin, inv_dir, max_dist, node.loose_bounds) {
+		return
+	}
+
+	for entry_idx := node.first_entry; entry_idx != -1; entry_idx = tree.entries[entry_idx].next {
+		if count^ >= len(out) {return}
+		entry := &tree.entries[entry_idx]
+		if ray_overlaps_rect(origin, inv_dir, max_dist, entry.bounds) {
+			out[count^] = entry.handle
+			count^ += 1
+		}
+	}
+
+	if node.has_children {
+		for child_idx in node.children {
+			query_ray_node(tree, child_idx, origin, inv_dir, max_dist, out, count)
+		}
+	}
+}
+
+//Broad phase: every pair of entities whose bounds overlap, found in one pass over the tree.
+//Each pair is written once. Returns the number of pairs written to out.
+query_pairs :: proc(tree: ^Quadtree, out: []Entity_Pair) -> int {
+	count := 0
+	if len(tree.nodes) > 0 {
+		pairs_within_subtree(tree, 0, out, &count)
+	}
+	return count
+}
+
+//Pairs where both entities live somewhere inside the subtree at node_index
+pairs_within_subtree :: proc(tree: ^Quadtree, node_index: i32, out: []Entity_Pair, count: ^int) {
+	node := &tree.nodes[node_index]
+
+	//entries in this node against each other, and against everything below them
+	for a := node.first_entry; a != -1; a = tree.entries[a].next {
+		for b := tree.entries[a].next; b != -1; b = tree.entries[b].next {
+			emit_pair_if_overlapping(tree, a, b, out, count)
+		}
+		if node.has_children {
+			for child_idx in node.children {
+				pairs_entry_vs_subtree(tree, a, child_idx, out, count)
+			}
+		}
+	}
+
+	if !node.has_children {
+		return
+	}
+
+	//loose bounds overlap, so neighbouring children can hold overlapping entities
+	for i := 0; i < 4; i += 1 {
+		pairs_within_subtree(tree, node.children[i], out, count)
+		for j := i + 1; j < 4; j += 1 {
+			pairs_between_subtrees(tree, node.children[i], node.children[j], out, count)
+		}
+	}
+}
+
+//Pairs with one entity in subtree a and the other in subtree b
+pairs_between_subtrees :: proc(tree: ^Quadtree, a, b: i32, out: []Entity_Pair, count: ^int) {
+	node_a := &tree.nodes[a]
+	node_b := &tree.nodes[b]
+	if !rect_overlaps(node_a.loose_bounds, node_b.loose_bounds) {
+		return
+	}
+
+	for entry_idx := node_a.first_entry; entry_idx != -1; entry_idx = tree.entries[entry_idx].next {
+		pairs_entry_vs_subtree(tree, entry_idx, b, out, count)
+	}
+
+	if node_a.has_children {
+		for child_a in node_a.children {
+			for entry_idx := node_b.first_entry;
+			    entry_idx != -1;
+			    entry_idx = tree.entries[entry_idx].next {
+				pairs_entry_vs_subtree(tree, entry_idx, child_a, out, count)
+			}
+			if node_b.has_children {
+				for child_b in node_b.children {
+					pairs_between_subtrees(tree, child_a, child_b, out, count)
+				}
+			}
+		}
+	}
+}
+
+//Pairs between one entry and every entry in the subtree at node_index
+pairs_entry_vs_subtree :: proc(
+	tree: ^Quadtree,
+	entry_idx: i32,
+	node_index: i32,
+	out: []Entity_Pair,
+	count: ^int,
+) {
+	node := &tree.nodes[node_index]
+	if !rect_overlaps(node.loose_bounds, tree.entries[entry_idx].bounds) {
+		return
+	}
+
+	for other := node.first_entry; other != -1; other = tree.entries[other].next {
+		emit_pair_if_overlapping(tree, entry_idx, other, out, count)
+	}
+
+	if node.has_children {
+		for child_idx in node.children {
+			pairs_entry_vs_subtree(tree, entry_idx, child_idx, out, count)
+		}
+	}
+}
+
+emit_pair_if_overlapping :: proc(tree: ^Quadtree, a, b: i32, out: []Entity_Pair, count: ^int) {
+	if count^ >= len(out) {
+		return
+	}
+	if rect_overlaps(tree.entries[a].bounds, tree.entries[b].bounds) {
+		out[count^] = Entity_Pair{tree.entries[a].handle, tree.entries[b].handle}
+		count^ += 1
+	}
+}
+
+circle_overlaps_rect :: proc(center: Vec2, radius: f32, r: EntityRect) -> bool {
+	closest := Vec2{clamp(center.x, r.min.x, r.max.x), clamp(center.y, r.min.y, r.max.y)}
+	d := center - closest
+	return d.x * d.x + d.y * d.y <= radius * radius
+}
+
+//Slab test, inv_dir is 1/dir. An axis aligned ray has an infinite component there, which is
+//checked on its own like sweep_tiles skips an axis with nothing to move: 0 * inf would be NaN for
+//an origin on the rect's edge, and NaN fails every comparison.
+ray_overlaps_rect :: proc(origin, inv_dir: Vec2, max_dist: f32, r: EntityRect) -> bool {
+	t_near, t_far := f32(0), max_dist
+	for axis in 0 ..< 2 {
+		if math.is_inf(inv_dir[axis]) {
+			//parallel to this slab, the ray is inside it all the way or never
+			if origin[axis] < r.min[axis] || origin[axis] > r.max[axis] {
+				return false
+			}
+			continue
+		}
+		t1 := (r.min[axis] - origin[axis]) * inv_dir[axis]
+		t2 := (r.max[axis] - origin[axis]) * inv_dir[axis]
+		t_near = max(t_near, min(t1, t2))
+		t_far = min(t_far, max(t1, t2))
+	}
+	return t_near <= t_far
+}
+
+//Returns the bounds the quadtree uses for an entity (kept in sync by update_*_colliders)
+get_entity_bounds :: proc(e: Entity_Handle) -> EntityRect {
+	if ent := hm.get(g.entities, e); ent != nil {
+		return ent.ent_rect
 	}
-	*/
 	return EntityRect{}
 }
 
@@ -251,8 +867,8 @@ draw_quad_tree_node :: proc(quadTreeNode: QuadtreeNode) {
 //Draw the quadtree nodes boundary 
 draw_quad_tree :: proc(quadtree: ^Quadtree) {
 	//fmt.printf("Drawing quadtree!\n")
-	for i := 0; i < int(quadtree.node_count); i += 1 {
-		if !quadtree.nodes[i].has_children {
+	for i := 0; i < len(quadtree.nodes); i += 1 {
+		if quadtree.nodes[i].active && !quadtree.nodes[i].has_children {
 			draw_quad_tree_node(quadtree.nodes[i])
 		}
 	}
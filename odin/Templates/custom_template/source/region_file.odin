@@ -0,0 +1,146 @@
+package game
+
+import "core:fmt"
+import vmem "core:mem/virtual"
+
+//Many chunks packed into one file, memory mapped read only.
+//
+//Opening the region is one map call, after that looking up a chunk is a binary search over the
+//index and returns a slice of the mapping. Nothing is read or allocated per chunk, the OS pages
+//the data in when it is first touched. Uncompressed collision tiles are used straight from the
+//mapping (see decode_collision_chunk_data).
+//
+//Region files are built by the chunk_converter tool (chunk_converter pack / unpack).
+//
+// Region file format:
+// [4 bytes: magic] [4 bytes: version] [4 bytes: entry count] [4 bytes: unused]
+// [entry count * 20 bytes: index, see Region_Entry, sorted by kind, y, x]
+// [chunk data: each chunk is the same bytes as its .dat file, starting on a 16 byte boundary]
+
+REGION_FILE_MAGIC :: u32(0x4E475243) // "CRGN"
+REGION_FILE_VERSION :: 1
+REGION_FILE_PATH :: "data/chunks/chunks.region"
+//Load chunks from the region file if there is one, otherwise every chunk is its own file
+USE_REGION_FILE :: #config(USE_REGION_FILE, USE_BINARY_FORMAT)
+
+Region_Header :: struct {
+	magic:   u32,
+	version: u32,
+	count:   u32,
+	unused:  u32,
+}
+
+Region_Entry :: struct {
+	x:      i32,
+	y:      i32,
+	kind:   u32, // Chunk_Data_Kind
+	offset: u32, // from the start of the file
+	size:   u32,
+}
+
+Region_File :: struct {
+	data:    []byte, // the whole mapping, nil if no region file is open
+	entries: []Region_Entry, // points into data
+}
+
+//Maps the region file and checks its index. Every entry is bounds checked here, so lookups don't
+//have to.
+open_region_file :: proc(path: string) -> (Region_File, bool) {
+	data, map_err := vmem.map_file_from_path(path, {.Read})
+	if map_err != .None {
+		fmt.printf("Could not map region file: %s (%v)\n", path, map_err)
+		return {}, false
+	}
+
+	region := Region_File {
+		data = data,
+	}
+	if len(data) < size_of(Region_Header) {
+		fmt.printf("Region file too small: %s\n", path)
+		close_region_file(&region)
+		return {}, false
+	}
+
+	header := (^Region_Header)(raw_data(data))
+	if header.magic != REGION_FILE_MAGIC || header.version != REGION_FILE_VERSION {
+		fmt.printf(
+			"Not a region file, or wrong version: %s (version %i, want %i)\n",
+			path,
+			header.version,
+			REGION_FILE_VERSION,
+		)
+		close_region_file(&region)
+		return {}, false
+	}
+
+	index_end := size_of(Region_Header) + int(header.count) * size_of(Region_Entry)
+	if index_end > len(data) {
+		fmt.printf("Region file index is truncated: %s\n", path)
+		close_region_file(&region)
+		return {}, false
+	}
+	region.entries = ([^]Region_Entry)(&data[size_of(Region_Header)])[:header.count]
+
+	for entry in region.entries {
+		if int(entry.offset) < index_end || int(entry.offset) + int(entry.size) > len(data) {
+			fmt.printf("Region file entry (%d, %d) is out of bounds: %s\n", entry.x, entry.y, path)
+			close_region_file(&region)
+			return {}, false
+		}
+	}
+
+	fmt.printf("Mapped region file %s, %i chunks, %i bytes\n", path, len(region.entries), len(data))
+	return region, true
+}
+
+close_region_file :: proc(region: ^Region_File) {
+	if region.data != nil {
+		vmem.unmap_file(region.data)
+	}
+	region^ = {}
+}
+
+//The bytes of one chunk, straight from the mapping. Safe to call from any thread while the
+//region is open.
+region_chunk_data :: proc(
+	region: ^Region_File,
+	coord: ChunkCoord,
+	kind: Chunk_Data_Kind,
+) -> (
+	[]byte,
+	bool,
+) {
+	key := Region_Entry {
+		x    = coord.x,
+		y    = coord.y,
+		kind = u32(kind),
+	}
+	lo, hi := 0, len(region.entries)
+	for lo < hi {
+		mid := (lo + hi) / 2
+		if region_entry_less(region.entries[mid], key) {
+			lo = mid + 1
+		} else {
+			hi = mid
+		}
+	}
+	if lo == len(region.entries) {
+		return nil, false
+	}
+	entry := region.entries[lo]
+	if entry.x != coord.x || entry.y != coord.y || entry.kind != u32(kind) {
+		return nil, false
+	}
+	return region.data[entry.offset:][:entry.size], true
+}
+
+//Index order: kind, then y, then x. The converter sorts the same way when packing.
+region_entry_less :: proc(a, b: Region_Entry) -> bool {
+	if a.kind != b.kind {
+		return a.kind < b.kind
+	}
+	if a.y != b.y {
+		return a.y < b.y
+	}
+	return a.x < b.x
+}
@@ -0,0 +1,38 @@
+package game
+
+import hm "../handle_map"
+import "../replication"
+import "core:slice"
+
+//Fills world with the replicated state of every entity, see the replication package. The world
+//has room for MAX_ENTITIES, so nothing here allocates.
+capture_replication_world :: proc(world: ^replication.World) {
+	profile_zone("capture replication")
+	for &e in g.entities.items {
+		if hm.skip(e) {
+			continue
+		}
+		chunk := world_pos_to_chunk(e.pos)
+		append(
+			&world.states,
+			replication.State {
+				id = e.handle.idx,
+				gen = e.handle.gen,
+				chunk = {chunk.x, chunk.y},
+				pos = {
+					replication.quantize(e.pos.x, replication.POS_SCALE),
+					replication.quantize(e.pos.y, replication.POS_SCALE),
+				},
+				vel = {
+					replication.quantize(e.vel.x, replication.VEL_SCALE),
+					replication.quantize(e.vel.y, replication.VEL_SCALE),
+				},
+				kind = u8(e.kind),
+				movement = u8(e.movement),
+				frame = u16(e.anim.current_frame),
+			},
+		)
+	}
+	//items are in no particular order, removing one moves the last into its place
+	slice.sort_by(world.states[:], proc(a, b: replication.State) -> bool {return a.id < b.id})
+}
@@ -0,0 +1,344 @@
+package game
+
+import hm "../handle_map"
+import "../jobs"
+import "core:fmt"
+import "core:mem"
+import "core:os"
+import "core:strconv"
+import "core:strings"
+import "core:sync"
+import "core:time"
+import rl "vendor:raylib"
+
+//Headless simulation benchmark, run through source/sim_benchmark.
+//
+//Runs init_headless plus a number of update ticks, one fixed step each, with SIM_SCRIPT as the
+//keyboard and a crowd of wandering goblins as extra load. Chunk streaming is waited on after every
+//tick, so the same arguments always simulate the same thing. The per-system times come from the profiler
+//zones, so build with -define:PROFILER=true to get them, otherwise only the tick total is timed.
+//
+//The report can be saved as a baseline and later runs compared against it. A run fails when a
+//time is more than SIM_REGRESSION_TOLERANCE slower, when it allocates more, or when the end
+//state checksum differs (the simulation stopped being deterministic, or gameplay changed). The
+//checksum doesn't depend on the number of job workers, -define:JOB_WORKERS=1 has to match it.
+
+SIM_BASELINE_PATH :: "sim_baseline.txt"
+SIM_REGRESSION_TOLERANCE :: 0.15
+//Zones averaging less than this per tick are too noisy to compare
+SIM_MIN_ZONE_MS :: 0.02
+SIM_MAX_ZONES :: 32
+SIM_SCRIPT_LENGTH :: 600 // ticks, the script repeats after this
+
+//key is held for ticks [from, to) of each script repeat
+Sim_Input :: struct {
+	from, to: int,
+	key:      rl.KeyboardKey,
+}
+
+//Runs right and jumps, runs back left holding onto walls, resets, then again with WASD
+SIM_SCRIPT :: [?]Sim_Input {
+	{0, 180, .RIGHT},
+	{60, 70, .SPACE},
+	{150, 160, .SPACE},
+	{200, 400, .LEFT},
+	{220, 300, .LEFT_SHIFT},
+	{260, 270, .SPACE},
+	{420, 425, .R},
+	{450, 580, .D},
+	{500, 510, .W},
+}
+
+Sim_Zone :: struct {
+	name:     string,
+	total_ms: f64,
+	max_ms:   f64,
+	count:    int,
+}
+
+Sim_Report :: struct {
+	ticks:           int,
+	entities:        int,
+	tick_avg_ms:     f64,
+	tick_max_ms:     f64,
+	zones:           [SIM_MAX_ZONES]Sim_Zone,
+	zone_count:      int,
+	allocations:     i64, // made during the ticks, init is not counted
+	allocated_bytes: i64,
+	checksum:        u64, // of every entity position after the last tick
+}
+
+run_sim_benchmark :: proc(ticks: int, entities: int, pool: ^jobs.Pool) -> (report: Sim_Report) {
+	init_headless(FIXED_DT)
+	g.job_pool = pool
+	spawn_sim_entities(entities)
+	report.ticks = ticks
+	report.entities = hm.len(g.entities)
+
+	//zones from init aren't part of any tick
+	seen: [PROFILE_MAX_THREADS]u64
+	collect_sim_zones(nil, &seen)
+
+	tracking: mem.Tracking_Allocator
+	mem.tracking_allocator_init(&tracking, context.allocator)
+	defer mem.tracking_allocator_destroy(&tracking)
+
+	total_ms: f64
+	for tick in 0 ..< ticks {
+		context.temp_allocator, context.allocator = begin_frame_memory(
+			g.frame_memory,
+			mem.tracking_allocator(&tracking),
+		)
+		step_headless(sim_script_keys(tick))
+
+		start := time.tick_now()
+		profile_frame_begin()
+		update()
+		ms := time.duration_milliseconds(time.tick_since(start))
+		total_ms += ms
+		report.tick_max_ms = max(report.tick_max_ms, ms)
+
+		finish_chunk_streaming(g.chunk_streamer, &g.level)
+		collect_sim_zones(&report, &seen)
+	}
+
+	report.tick_avg_ms = total_ms / f64(max(ticks, 1))
+	report.allocations = tracking.total_allocation_count
+	report.allocated_bytes = tracking.total_memory_allocated
+	report.checksum = sim_checksum()
+	//some of what the ticks allocated is freed here, the tracker has to outlive it
+	shutdown()
+	return
+}
+
+//Goblins spread over the chunks around the start, walking at random speeds. Seeded, so every
+//run gets the same crowd.
+spawn_sim_entities :: proc(count: int) {
+	seed := u64(0x9E3779B97F4A7C15)
+	for _ in 0 ..< min(count, MAX_ENTITIES - hm.len(g.entities)) {
+		//inside chunk column 0, clear of its edges
+		x := sim_random(&seed) * (TOTAL_CHUNK_PIXELS - 2 * TILE_SIZE) - TOTAL_CHUNK_PIXELS / 2
+		y := sim_random(&seed) * (TOTAL_CHUNK_PIXELS - 2 * TILE_SIZE)
+		pos := Vec2{x + TILE_SIZE, -y - TILE_SIZE}
+		hm.add(
+			&g.entities,
+			Entity {
+				anim = animation_create(.Goblin_Idle),
+				pos = pos,
+				vel = {sim_random(&seed) * 80 - 40, 0},
+				dir = .left,
+				is_on_ground = true,
+				movement = .idle,
+				orientation = .norm,
+				kind = .goblin,
+			},
+		)
+	}
+}
+
+//xorshift, 0 to 1
+sim_random :: proc(state: ^u64) -> f32 {
+	state^ ~= state^ << 13
+	state^ ~= state^ >> 7
+	state^ ~= state^ << 17
+	return f32(state^ >> 40) / f32(1 << 24)
+}
+
+sim_script_keys :: proc(tick: int) -> (keys: Sim_Keys) {
+	t := tick % SIM_SCRIPT_LENGTH
+	for input in SIM_SCRIPT {
+		if t >= input.from && t < input.to && keys.count < SIM_MAX_KEYS {
+			keys.keys[keys.count] = input.key
+			keys.count += 1
+		}
+	}
+	return
+}
+
+//Adds the zones that finished since the last call to the report, nil just skips them
+collect_sim_zones :: proc(report: ^Sim_Report, seen: ^[PROFILE_MAX_THREADS]u64) {
+	p := g.profiler
+	for &t, i in p.threads[:sync.atomic_load(&p.thread_count)] {
+		count := sync.atomic_load_explicit(&t.count, .Acquire)
+		//anything older than the ring was overwritten before it could be counted
+		from := max(seen[i], count - min(count, PROFILE_RING_SIZE))
+		seen[i] = count
+		if report == nil {
+			continue
+		}
+		for n in from ..< count {
+			event := t.events[n % PROFILE_RING_SIZE]
+			add_sim_zone(report, event.name, f64(event.end - event.start) / 1e6)
+		}
+	}
+}
+
+add_sim_zone :: proc(report: ^Sim_Report, name: string, ms: f64) {
+	zone: ^Sim_Zone
+	for &z in report.zones[:report.zone_count] {
+		if z.name == name {
+			zone = &z
+			break
+		}
+	}
+	if zone == nil {
+		if report.zone_count == SIM_MAX_ZONES {
+			return
+		}
+		zone = &report.zones[report.zone_count]
+		zone.name = name
+		report.zone_count += 1
+	}
+	zone.total_ms += ms
+	zone.max_ms = max(zone.max_ms, ms)
+	zone.count += 1
+}
+
+//FNV-1a over every entity position
+sim_checksum :: proc() -> u64 {
+	h: u64 = 14695981039346656037
+	for &item in g.entities.items {
+		if hm.skip(item) {
+			continue
+		}
+		for v in transmute([2]u32)item.pos {
+			h = (h ~ u64(v)) * 1099511628211
+		}
+	}
+	return h
+}
+
+//Zone times are per tick, so runs of different lengths still compare
+sim_zone_avg_ms :: proc(report: Sim_Report, zone: Sim_Zone) -> f64 {
+	return zone.total_ms / f64(max(report.ticks, 1))
+}
+
+print_sim_report :: proc(report: Sim_Report) {
+	fmt.printf(
+		"Sim benchmark: %i ticks, %i entities, avg %.3fms, max %.3fms per tick\n",
+		report.ticks,
+		report.entities,
+		report.tick_avg_ms,
+		report.tick_max_ms,
+	)
+	for zone in report.zones[:report.zone_count] {
+		fmt.printf(
+			"  %-28s avg %.3fms, max %.3fms, %i calls\n",
+			zone.name,
+			sim_zone_avg_ms(report, zone),
+			zone.max_ms,
+			zone.count,
+		)
+	}
+	fmt.printf(
+		"  %i allocations, %i bytes, checksum %x\n",
+		report.allocations,
+		report.allocated_bytes,
+		report.checksum,
+	)
+}
+
+//One "key value" per line, zones as "zone name avg_ms"
+write_sim_baseline :: proc(report: Sim_Report, path: string) -> bool {
+	b := strings.builder_make()
+	defer strings.builder_destroy(&b)
+
+	fmt.sbprintf(&b, "ticks %i\n", report.ticks)
+	fmt.sbprintf(&b, "entities %i\n", report.entities)
+	fmt.sbprintf(&b, "tick_avg_ms %.4f\n", report.tick_avg_ms)
+	fmt.sbprintf(&b, "allocations %i\n", report.allocations)
+	fmt.sbprintf(&b, "allocated_bytes %i\n", report.allocated_bytes)
+	fmt.sbprintf(&b, "checksum %x\n", report.checksum)
+	for zone in report.zones[:report.zone_count] {
+		fmt.sbprintf(&b, "zone %s %.4f\n", zone.name, sim_zone_avg_ms(report, zone))
+	}
+
+	if !os.write_entire_file(path, b.buf[:]) {
+		fmt.printf("Failed to write sim baseline: %s\n", path)
+		return false
+	}
+	fmt.printf("Wrote sim baseline %s\n", path)
+	return true
+}
+
+//Prints every regression against the baseline at path, returns false if there were any
+compare_sim_baseline :: proc(report: Sim_Report, path: string) -> bool {
+	data, read_ok := os.read_entire_file(path)
+	if !read_ok {
+		fmt.printf("No sim baseline at %s, run with -save to write one\n", path)
+		return false
+	}
+	defer delete(data)
+
+	ok := true
+	same_run := true // the checksum only means something for the same ticks and entities
+	text := string(data)
+	for line in strings.split_lines_iterator(&text) {
+		fields := strings.fields(line)
+		defer delete(fields)
+		if len(fields) < 2 {
+			continue
+		}
+		key, value := fields[0], fields[len(fields) - 1]
+		switch key {
+		case "ticks":
+			if (strconv.parse_int(value) or_else 0) != report.ticks {
+				same_run = false
+			}
+		case "entities":
+			if (strconv.parse_int(value) or_else 0) != report.entities {
+				same_run = false
+			}
+		case "tick_avg_ms":
+			if !check_sim_time("tick", strconv.parse_f64(value) or_else 0, report.tick_avg_ms) {
+				ok = false
+			}
+		case "allocations":
+			base := strconv.parse_i64(value) or_else 0
+			if report.allocations > base {
+				fmt.printf("Regression: %i allocations, baseline %i\n", report.allocations, base)
+				ok = false
+			}
+		case "checksum":
+			base := strconv.parse_u64_of_base(value, 16) or_else 0
+			if same_run && report.checksum != base {
+				fmt.printf(
+					"Regression: checksum %x, baseline %x, the simulation changed\n",
+					report.checksum,
+					base,
+				)
+				ok = false
+			}
+		case "zone":
+			if len(fields) != 3 {
+				continue
+			}
+			for zone in report.zones[:report.zone_count] {
+				if zone.name == fields[1] {
+					base := strconv.parse_f64(value) or_else 0
+					if !check_sim_time(zone.name, base, sim_zone_avg_ms(report, zone)) {
+						ok = false
+					}
+				}
+			}
+		}
+	}
+	if ok {
+		fmt.printf("No regressions against %s\n", path)
+	}
+	return ok
+}
+
+check_sim_time :: proc(name: string, base_ms, ms: f64) -> bool {
+	if base_ms < SIM_MIN_ZONE_MS || ms <= base_ms * (1 + SIM_REGRESSION_TOLERANCE) {
+		return true
+	}
+	fmt.printf(
+		"Regression: %s avg %.3fms, baseline %.3fms (+%.0f%%)\n",
+		name,
+		ms,
+		base_ms,
+		(ms / base_ms - 1) * 100,
+	)
+	return false
+}
@@ -0,0 +1,52 @@
+/*
+Headless simulation benchmark, no window is opened. Run from the template folder, so the chunk
+data is found:
+
+	odin run source/sim_benchmark -o:speed -define:PROFILER=true -- [ticks] [entities] [-save]
+
+Defaults to 3600 ticks (a minute at 60 Hz) with 2000 extra goblins. Compares the run against
+sim_baseline.txt and exits with 1 on a regression. -save writes the run as the new baseline.
+
+Job workers default to one per core, -define:JOB_WORKERS=1 runs everything on the main thread.
+*/
+
+package sim_benchmark
+
+import game ".."
+import "../../jobs"
+import "core:os"
+import "core:strconv"
+
+main :: proc() {
+	ticks := 3600
+	entities := 2000
+	save := false
+
+	positional := 0
+	for arg in os.args[1:] {
+		if arg == "-save" {
+			save = true
+			continue
+		}
+		switch positional {
+		case 0:
+			ticks = strconv.parse_int(arg) or_else ticks
+		case 1:
+			entities = strconv.parse_int(arg) or_else entities
+		}
+		positional += 1
+	}
+
+	pool := jobs.create_pool()
+	report := game.run_sim_benchmark(ticks, entities, pool)
+	jobs.destroy_pool(pool)
+	game.print_sim_report(report)
+
+	if save {
+		if !game.write_sim_baseline(report, game.SIM_BASELINE_PATH) {
+			os.exit(1)
+		}
+	} else if !game.compare_sim_baseline(report, game.SIM_BASELINE_PATH) {
+		os.exit(1)
+	}
+}
@@ -0,0 +1,163 @@
+package game
+
+import "core:math"
+import "core:slice"
+import rl "vendor:raylib"
+import rlgl "vendor:raylib/rlgl"
+
+//Collects the frame's sprites and draws them together.
+//
+//Sprites are queued with batch_sprite between begin_sprite_batch and flush_sprite_batch. Queuing
+//culls against the camera view, which is worked out once in begin_sprite_batch. rlgl doesn't group
+//anything by itself, it flushes its vertex buffer on every texture or state change. What keeps
+//the draw calls down is the flush sorting by layer, then texture, so all sprites of one texture
+//(usually the whole atlas) are written into rlgl's buffer back to back and go out in one call.
+//
+//Sprites on the same layer and texture keep the order they were queued in.
+
+SPRITE_LAYER_ENTITIES :: 0
+SPRITE_LAYER_PLAYER :: 1
+
+Sprite_Quad :: struct {
+	texture:  rl.Texture2D,
+	source:   Rect, // negative width / height flips, like rl.DrawTexturePro
+	dest:     Rect,
+	origin:   Vec2,
+	rotation: f32, // degrees
+	tint:     rl.Color,
+	layer:    i32,
+}
+
+Sprite_Batch_Stats :: struct {
+	queued:     i32, // sprites that passed culling
+	culled:     i32,
+	draw_calls: i32, // 1 plus the texture switches while flushing, each switch flushes rlgl
+}
+
+Sprite_Batch :: struct {
+	quads: [dynamic]Sprite_Quad,
+	view:  Rect,
+	stats: Sprite_Batch_Stats, // of the last flush
+}
+
+init_sprite_batch :: proc(batch: ^Sprite_Batch) {
+	batch.quads = make([dynamic]Sprite_Quad, 0, MAX_ENTITIES)
+}
+
+delete_sprite_batch :: proc(batch: ^Sprite_Batch) {
+	delete(batch.quads)
+}
+
+begin_sprite_batch :: proc(batch: ^Sprite_Batch, camera: rl.Camera2D) {
+	clear(&batch.quads)
+	batch.view = camera_world_rect(camera)
+	batch.stats = {}
+}
+
+//Queues a sprite, returns false if it was culled
+batch_sprite :: proc(batch: ^Sprite_Batch, quad: Sprite_Quad) -> bool {
+	// Rotation is around the origin, so the sprite stays within this distance of dest.x, dest.y
+	reach :=
+		max(abs(quad.dest.width), abs(quad.dest.height)) +
+		max(abs(quad.origin.x), abs(quad.origin.y))
+	bounds := Rect{quad.dest.x - reach, quad.dest.y - reach, reach * 2, reach * 2}
+	if !rl.CheckCollisionRecs(bounds, batch.view) {
+		batch.stats.culled += 1
+		return false
+	}
+	append(&batch.quads, quad)
+	batch.stats.queued += 1
+	return true
+}
+
+flush_sprite_batch :: proc(batch: ^Sprite_Batch) {
+	profile_zone("flush_sprite_batch")
+	if len(batch.quads) == 0 {
+		return
+	}
+	slice.stable_sort_by(batch.quads[:], proc(a, b: Sprite_Quad) -> bool {
+		if a.layer != b.layer {
+			return a.layer < b.layer
+		}
+		return a.texture.id < b.texture.id
+	})
+
+	current_texture := batch.quads[0].texture.id
+	rlgl.SetTexture(current_texture)
+	rlgl.Begin(rlgl.QUADS)
+	batch.stats.draw_calls = 1
+	for quad in batch.quads {
+		if quad.texture.id != current_texture {
+			rlgl.End()
+			rlgl.SetTexture(quad.texture.id)
+			rlgl.Begin(rlgl.QUADS)
+			current_texture = quad.texture.id
+			batch.stats.draw_calls += 1
+		}
+		write_sprite_quad(quad)
+	}
+	rlgl.End()
+	rlgl.SetTexture(0)
+	clear(&batch.quads)
+}
+
+//The four corners and texture coordinates rl.DrawTexturePro would use, without its
+//Begin/End and texture switch per sprite
+write_sprite_quad :: proc(quad: Sprite_Quad) {
+	source := quad.source
+	dest := quad.dest
+	flip_x := source.width < 0
+	if flip_x {
+		source.width = -source.width
+	}
+	if source.height < 0 {
+		source.y -= source.height
+	}
+	dest.width = abs(dest.width)
+	dest.height = abs(dest.height)
+
+	top_left, top_right, bottom_left, bottom_right: Vec2
+	if quad.rotation == 0 {
+		x := dest.x - quad.origin.x
+		y := dest.y - quad.origin.y
+		top_left = {x, y}
+		top_right = {x + dest.width, y}
+		bottom_left = {x, y + dest.height}
+		bottom_right = {x + dest.width, y + dest.height}
+	} else {
+		sin_r := math.sin(quad.rotation * math.RAD_PER_DEG)
+		cos_r := math.cos(quad.rotation * math.RAD_PER_DEG)
+		pos := Vec2{dest.x, dest.y}
+		dx := -quad.origin.x
+		dy := -quad.origin.y
+		top_left = pos + rotate_corner({dx, dy}, sin_r, cos_r)
+		top_right = pos + rotate_corner({dx + dest.width, dy}, sin_r, cos_r)
+		bottom_left = pos + rotate_corner({dx, dy + dest.height}, sin_r, cos_r)
+		bottom_right = pos + rotate_corner({dx + dest.width, dy + dest.height}, sin_r, cos_r)
+	}
+
+	width := f32(quad.texture.width)
+	height := f32(quad.texture.height)
+	u0 := source.x / width
+	u1 := (source.x + source.width) / width
+	v0 := source.y / height
+	v1 := (source.y + source.height) / height
+	if flip_x {
+		u0, u1 = u1, u0
+	}
+
+	rlgl.Color4ub(quad.tint.r, quad.tint.g, quad.tint.b, quad.tint.a)
+	rlgl.Normal3f(0, 0, 1)
+	rlgl.TexCoord2f(u0, v0)
+	rlgl.Vertex2f(top_left.x, top_left.y)
+	rlgl.TexCoord2f(u0, v1)
+	rlgl.Vertex2f(bottom_left.x, bottom_left.y)
+	rlgl.TexCoord2f(u1, v1)
+	rlgl.Vertex2f(bottom_right.x, bottom_right.y)
+	rlgl.TexCoord2f(u1, v0)
+	rlgl.Vertex2f(top_right.x, top_right.y)
+}
+
+rotate_corner :: #force_inline proc(v: Vec2, sin_r, cos_r: f32) -> Vec2 {
+	return {v.x * cos_r - v.y * sin_r, v.x * sin_r + v.y * cos_r}
+}
@@ -0,0 +1,195 @@
+package game
+
+import "core:math"
+
+//Moves entities through the collision tiles.
+//
+//A move is swept one axis at a time, x first. The area the box passes over is looked up with
+//get_tiles_in_rect and the move stops at the nearest tile that blocks it, so a fast fall can't
+//skip over a tile, and the cost is the tiles passed over rather than the number of platforms.
+//Long moves are split into sweeps of at most MAX_TILE_SWEEP so the spans fit a fixed buffer.
+//
+//SOLID blocks from every side. PLATFORM only blocks a box coming down onto it from above, so
+//entities can jump up through one. SPIKE and LADDER never block, they show up as contacts.
+
+MAX_TILE_SWEEP :: f32(4 * TILE_SIZE)
+TILE_SWEEP_SPANS :: 64
+
+Tile_Contact :: enum u8 {
+	feet, // standing on SOLID, or on top of a PLATFORM
+	head, // head against SOLID
+	left, // a move to the left was blocked
+	right, // a move to the right was blocked
+	spike, // body overlaps a SPIKE tile
+	ladder, // body overlaps a LADDER tile
+}
+
+Tile_Contacts :: bit_set[Tile_Contact; u8]
+
+Tile_Types :: bit_set[Tile_Type; u8]
+
+//Moves e by delta, stopping at blocking tiles, and zeroes velocity into whatever blocked it.
+//e.rect is moved along with e.pos. Returns the sides that were blocked.
+move_entity :: proc(level: ^Level, e: ^Entity, delta: Vec2) -> Tile_Contacts {
+	contacts: Tile_Contacts
+
+	moved_x, blocked_x := sweep_tiles(level, e.rect, delta.x, 0)
+	e.pos.x += moved_x
+	e.rect.x += moved_x
+	if blocked_x {
+		if delta.x > 0 {
+			contacts += {.right}
+		} else {
+			contacts += {.left}
+		}
+		if math.sign(e.vel.x) == math.sign(delta.x) {
+			e.vel.x = 0
+		}
+	}
+
+	moved_y, blocked_y := sweep_tiles(level, e.rect, delta.y, 1)
+	e.pos.y += moved_y
+	e.rect.y += moved_y
+	if blocked_y {
+		if delta.y > 0 {
+			contacts += {.feet}
+		} else {
+			contacts += {.head}
+		}
+		if math.sign(e.vel.y) == math.sign(delta.y) {
+			e.vel.y = 0
+		}
+	}
+	return contacts
+}
+
+//How far box can move along axis (0 = x, 1 = y) out of amount, and whether a tile stopped it
+sweep_tiles :: proc(
+	level: ^Level,
+	box: Rect,
+	amount: f32,
+	axis: int,
+) -> (
+	moved: f32,
+	blocked: bool,
+) {
+	box := box
+	spans: [TILE_SWEEP_SPANS]Tile_Span
+	remaining := amount
+	for remaining != 0 {
+		step := clamp(remaining, -MAX_TILE_SWEEP, MAX_TILE_SWEEP)
+		remaining -= step
+
+		// Only the area in front of the leading edge, tiles the box already overlaps don't block
+		swept := box
+		if axis == 0 {
+			swept.x = box.x + box.width if step > 0 else box.x + step
+			swept.width = abs(step)
+		} else {
+			swept.y = box.y + box.height if step > 0 else box.y + step
+			swept.height = abs(step)
+		}
+
+		allowed := step
+		count := get_tiles_in_rect(level, swept, spans[:])
+		for span in spans[:count] {
+			for tile, i in span.tiles {
+				if !(tile == .SOLID || (tile == .PLATFORM && axis == 1 && step > 0)) {
+					continue
+				}
+				r := tile_world_rect({span.x + i32(i), span.y})
+				// Distance from the leading edge to the near side of the tile
+				if step > 0 {
+					near := r.x - (box.x + box.width) if axis == 0 else r.y - (box.y + box.height)
+					if near >= 0 && near < allowed {
+						allowed = near
+					}
+				} else {
+					near := r.x + r.width - box.x if axis == 0 else r.y + r.height - box.y
+					if near <= 0 && near > allowed {
+						allowed = near
+					}
+				}
+			}
+		}
+
+		moved += allowed
+		if axis == 0 {
+			box.x += allowed
+		} else {
+			box.y += allowed
+		}
+		if allowed != step {
+			return moved, true
+		}
+	}
+	return moved, false
+}
+
+//Contacts of e's colliders with the tiles one pixel past them, feet toward the ground of the
+//current orientation and head away from it, plus the tiles the body overlaps
+entity_tile_contacts :: proc(level: ^Level, e: ^Entity) -> Tile_Contacts {
+	down: Vec2
+	switch e.orientation {
+	case .norm:
+		down = {0, 1}
+	case .upside_down:
+		down = {0, -1}
+	case .rot_left:
+		down = {1, 0}
+	case .rot_right:
+		down = {-1, 0}
+	}
+
+	contacts: Tile_Contacts
+	feet := e.feet_collider
+	feet.x += down.x
+	feet.y += down.y
+	if .SOLID in tile_types_in_rect(level, feet) ||
+	   (e.orientation == .norm && on_platform_top(level, feet)) {
+		contacts += {.feet}
+	}
+	head := e.head_collider
+	head.x -= down.x
+	head.y -= down.y
+	if .SOLID in tile_types_in_rect(level, head) {
+		contacts += {.head}
+	}
+
+	body := tile_types_in_rect(level, e.rect)
+	if .SPIKE in body {
+		contacts += {.spike}
+	}
+	if .LADDER in body {
+		contacts += {.ladder}
+	}
+	return contacts
+}
+
+tile_types_in_rect :: proc(level: ^Level, rect: Rect) -> Tile_Types {
+	spans: [TILE_SWEEP_SPANS]Tile_Span
+	types: Tile_Types
+	for span in spans[:get_tiles_in_rect(level, rect, spans[:])] {
+		for tile in span.tiles {
+			types += {tile}
+		}
+	}
+	return types
+}
+
+//True if probe's top edge is within a pixel of the top of a PLATFORM tile it overlaps. Further
+//down means the entity is inside the platform, on its way up through it.
+on_platform_top :: proc(level: ^Level, probe: Rect) -> bool {
+	spans: [TILE_SWEEP_SPANS]Tile_Span
+	for span in spans[:get_tiles_in_rect(level, probe, spans[:])] {
+		for tile, i in span.tiles {
+			if tile != .PLATFORM {
+				continue
+			}
+			if abs(tile_world_rect({span.x + i32(i), span.y}).y - probe.y) < 1 {
+				return true
+			}
+		}
+	}
+	return false
+}
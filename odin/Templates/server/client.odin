@@ -0,0 +1,177 @@
+package main
+
+import "core:fmt"
+import "core:net"
+import "core:thread"
+import "core:time"
+
+import "../custom_template/replication"
+import "protocol"
+
+//Simulated clients for the -sim server, -clients on the command line:
+//
+//	odin run . -o:speed -- 2645 -clients [count] [seconds]
+//
+//Every client runs on its own thread with a blocking socket, like the server does where it has
+//no reactor. A client joins with a view chunk around the level start, acks each snapshot as soon
+//as it is complete and then interpolates the way a game client would before drawing. Now and then
+//it looks at a neighbouring chunk instead, so entities come into view and leave it. At the end
+//the averages per client are printed, next to the server's own status line that makes the
+//bandwidth and tick time under load measurable on one machine.
+
+SIM_CLIENTS :: 500
+SIM_CLIENT_SECONDS :: 30
+//Views are picked within this many chunks of the level start, where the goblins are
+SIM_CLIENT_VIEW_SPREAD :: 2
+SIM_CLIENT_MOVE_INTERVAL :: 3 * time.Second
+
+Sim_Client :: struct {
+	endpoint:  net.Endpoint,
+	deadline:  time.Tick,
+	view:      [2]i32,
+	seed:      u64,
+	connected: bool,
+	bytes:     int, // received
+	snapshots: int, // complete ones
+	errors:    int, // snapshot parts that couldn't be decoded
+	shown:     int, // interpolated entities, summed over snapshots
+}
+
+run_sim_clients :: proc(endpoint: net.Endpoint, count, seconds: int) {
+	fmt.printf(
+		"%d clients to %s for %d seconds\n",
+		count,
+		net.endpoint_to_string(endpoint),
+		seconds,
+	)
+	deadline := time.tick_add(time.tick_now(), time.Duration(seconds) * time.Second)
+	clients := make([]Sim_Client, count)
+	threads := make([]^thread.Thread, count)
+	defer {
+		delete(clients)
+		delete(threads)
+	}
+	seed := u64(0x2545F4914F6CDD1D)
+	for &c, i in clients {
+		c.endpoint = endpoint
+		c.deadline = deadline
+		c.seed = seed + u64(i) * 0x9E3779B97F4A7C15
+		c.view = {
+			i32(sim_client_random(&c.seed) % (2 * SIM_CLIENT_VIEW_SPREAD + 1)) -
+			SIM_CLIENT_VIEW_SPREAD,
+			i32(sim_client_random(&c.seed) % (SIM_CLIENT_VIEW_SPREAD + 1)),
+		}
+		threads[i] = thread.create_and_start_with_poly_data(&c, run_sim_client)
+	}
+	for t in threads {
+		thread.join(t)
+		thread.destroy(t)
+	}
+
+	connected, errors, bytes, snapshots, shown := 0, 0, 0, 0, 0
+	for c in clients {
+		if c.connected {
+			connected += 1
+		}
+		errors += c.errors
+		bytes += c.bytes
+		snapshots += c.snapshots
+		shown += c.shown
+	}
+	per_client := f64(seconds) * f64(max(connected, 1))
+	fmt.printf("%d of %d connected, %d decode errors\n", connected, count, errors)
+	fmt.printf(
+		"Per client %.1fKB/s, %.1f snapshots/s, %.1f entities in view\n",
+		f64(bytes) / 1024 / per_client,
+		f64(snapshots) / per_client,
+		f64(shown) / f64(max(snapshots, 1)),
+	)
+}
+
+run_sim_client :: proc(c: ^Sim_Client) {
+	sock, err := net.dial_tcp(c.endpoint)
+	if err != nil {
+		return
+	}
+	c.connected = true
+	net.set_option(sock, .TCP_Nodelay, true)
+	input := new(protocol.Recv_Buffer)
+	replica: replication.Client
+	shown: [dynamic]replication.Interpolated
+	defer {
+		send_sim_message(sock, .Disconnect, 0, nil)
+		net.close(sock)
+		free(input)
+		replication.delete_client(&replica)
+		delete(shown)
+	}
+
+	view: [protocol.VIEW_SIZE]u8
+	protocol.put_view(view[:], c.view)
+	if !send_sim_message(sock, .Join, 0, view[:]) {
+		return
+	}
+	moved_at := time.tick_now()
+	//the server sends every tick, so recv doesn't block for long
+	for time.tick_diff(time.tick_now(), c.deadline) > 0 {
+		n, recv_err := net.recv_tcp(sock, protocol.recv_span(input))
+		if recv_err != nil || n == 0 {
+			return
+		}
+		c.bytes += n
+		protocol.recv_commit(input, n)
+
+		for {
+			header, payload, result := protocol.peek_message(input)
+			if result == .Bad {
+				return
+			}
+			if result == .Need_More {
+				break
+			}
+			if header.type == .Snapshot {
+				complete, ok := replication.apply_snapshot_part(&replica, header.seq, payload)
+				if !ok {
+					c.errors += 1
+				}
+				if complete {
+					c.snapshots += 1
+					send_sim_message(sock, .Ack, header.seq, nil)
+					//a game would add how far it is into the current tick instead of half
+					render_tick := f64(replica.latest) - replication.INTERPOLATION_DELAY + 0.5
+					if replication.interpolate(&replica, render_tick, &shown) {
+						c.shown += len(shown)
+					}
+				}
+			}
+			protocol.consume_message(input, header)
+		}
+
+		if time.tick_since(moved_at) >= SIM_CLIENT_MOVE_INTERVAL {
+			moved_at = time.tick_now()
+			c.view.x += 1 if sim_client_random(&c.seed) % 2 == 0 else -1
+			protocol.put_view(view[:], c.view)
+			send_sim_message(sock, .View, 0, view[:])
+		}
+	}
+}
+
+send_sim_message :: proc(
+	sock: net.TCP_Socket,
+	type: protocol.Msg_Type,
+	seq: u32,
+	payload: []u8,
+) -> bool {
+	message: [protocol.HEADER_SIZE + protocol.VIEW_SIZE]u8
+	n := protocol.put_message(message[:], type, seq, payload)
+	_, err := net.send_tcp(sock, message[:n])
+	return err == nil
+}
+
+//xorshift
+sim_client_random :: proc(state: ^u64) -> u64 {
+	state^ ~= state^ << 13
+	state^ ~= state^ >> 7
+	state^ ~= state^ << 17
+	return state^
+}
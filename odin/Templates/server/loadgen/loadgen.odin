@@ -0,0 +1,188 @@
+/*
+Local load generator for the server. Opens a number of connections, then keeps all of them busy
+with small echo messages, one round trip at a time, and reports the connect rate and the echo
+latency.
+
+	odin run loadgen -o:speed -- [port] [connections] [seconds] [threads]
+
+Defaults to port 2645, 2000 connections, 10 seconds and 8 threads. Every connection is a file
+descriptor on both ends, raise the limit first when going past a thousand (ulimit -n 65536).
+*/
+package loadgen
+
+import "core:fmt"
+import "core:net"
+import "core:os"
+import "core:slice"
+import "core:strconv"
+import "core:sync"
+import "core:thread"
+import "core:time"
+
+import "../protocol"
+
+PAYLOAD_SIZE :: 32
+
+Worker :: struct {
+	endpoint:    net.Endpoint,
+	connections: int, // to open
+	sockets:     [dynamic]net.TCP_Socket,
+	failed:      int, // connects that didn't work
+	errors:      int, // round trips that didn't come back right
+	latencies:   [dynamic]f64, // microseconds per round trip
+	start:       ^sync.Barrier,
+	deadline:    ^time.Tick,
+}
+
+main :: proc() {
+	port := 2645
+	connections := 2000
+	seconds := 10
+	threads := 8
+	args := os.args[1:]
+	if len(args) > 0 {port = strconv.parse_int(args[0]) or_else port}
+	if len(args) > 1 {connections = strconv.parse_int(args[1]) or_else connections}
+	if len(args) > 2 {seconds = strconv.parse_int(args[2]) or_else seconds}
+	if len(args) > 3 {threads = max(strconv.parse_int(args[3]) or_else threads, 1)}
+
+	endpoint, endpoint_parsed := net.parse_endpoint("127.0.0.1")
+	if !endpoint_parsed {
+		fmt.printf("failed to parse endpoint\n")
+		os.exit(1)
+	}
+	endpoint.port = port
+
+	fmt.printf(
+		"%d connections to port %d from %d threads for %d seconds\n",
+		connections,
+		port,
+		threads,
+		seconds,
+	)
+
+	start: sync.Barrier
+	sync.barrier_init(&start, threads + 1)
+	deadline: time.Tick
+
+	workers := make([]Worker, threads)
+	worker_threads := make([]^thread.Thread, threads)
+	for &w, i in workers {
+		w.endpoint = endpoint
+		w.connections = connections / threads + (1 if i < connections % threads else 0)
+		w.start = &start
+		w.deadline = &deadline
+		worker_threads[i] = thread.create_and_start_with_poly_data(&w, run_worker)
+	}
+
+	//every worker is connected once they all reach the barrier, then the echo phase starts
+	connect_start := time.tick_now()
+	deadline = time.tick_add(connect_start, time.Duration(seconds) * time.Second)
+	sync.barrier_wait(&start)
+	connect_time := time.tick_since(connect_start)
+
+	for t in worker_threads {
+		thread.join(t)
+		thread.destroy(t)
+	}
+
+	open, failed, errors := 0, 0, 0
+	all: [dynamic]f64
+	for w in workers {
+		open += len(w.sockets)
+		failed += w.failed
+		errors += w.errors
+		append(&all, ..w.latencies[:])
+	}
+	slice.sort(all[:])
+
+	echo_seconds := f64(seconds) - time.duration_seconds(connect_time)
+	fmt.printf(
+		"Connected %d (%d failed) in %.2fs, %.0f connections/s\n",
+		open,
+		failed,
+		time.duration_seconds(connect_time),
+		f64(open) / max(time.duration_seconds(connect_time), 1e-6),
+	)
+	fmt.printf(
+		"%d echoes (%d errors), %.0f/s, latency p50 %.0fus, p99 %.0fus, max %.0fus\n",
+		len(all),
+		errors,
+		f64(len(all)) / max(echo_seconds, 1e-6),
+		percentile(all[:], 0.50),
+		percentile(all[:], 0.99),
+		percentile(all[:], 1),
+	)
+}
+
+//sorted has to be sorted
+percentile :: proc(sorted: []f64, p: f64) -> f64 {
+	if len(sorted) == 0 {
+		return 0
+	}
+	return sorted[min(int(p * f64(len(sorted))), len(sorted) - 1)]
+}
+
+//Connects, waits for the other workers, then does one round trip after the other over its
+//connections until the deadline
+run_worker :: proc(w: ^Worker) {
+	for _ in 0 ..< w.connections {
+		sock, err := net.dial_tcp(w.endpoint)
+		if err != nil {
+			w.failed += 1
+			continue
+		}
+		net.set_option(sock, .TCP_Nodelay, true)
+		append(&w.sockets, sock)
+	}
+	sync.barrier_wait(w.start)
+
+	payload: [PAYLOAD_SIZE]u8
+	slice.fill(payload[:], 'x')
+	message: [protocol.HEADER_SIZE + PAYLOAD_SIZE]u8
+	reply := new(protocol.Recv_Buffer)
+	defer free(reply)
+	for i := 0; len(w.sockets) > 0 && time.tick_diff(time.tick_now(), w.deadline^) > 0; i += 1 {
+		sock := w.sockets[i % len(w.sockets)]
+		seq := u32(i)
+		sent_at := time.tick_now()
+		protocol.put_message(message[:], .Echo, seq, payload[:])
+		if _, err := net.send_tcp(sock, message[:]); err != nil {
+			w.errors += 1
+			continue
+		}
+		if !receive_echo(sock, reply, seq) {
+			w.errors += 1
+			continue
+		}
+		append(&w.latencies, time.duration_microseconds(time.tick_since(sent_at)))
+	}
+
+	goodbye: [protocol.HEADER_SIZE]u8
+	protocol.put_header(goodbye[:], .Disconnect, 0, 0)
+	for sock in w.sockets {
+		net.send_tcp(sock, goodbye[:])
+		net.close(sock)
+	}
+}
+
+//Reads until the reply is complete, false if it doesn't arrive or isn't the echo of seq
+receive_echo :: proc(sock: net.TCP_Socket, reply: ^protocol.Recv_Buffer, seq: u32) -> bool {
+	for {
+		header, payload, result := protocol.peek_message(reply)
+		switch result {
+		case .Ok:
+			protocol.consume_message(reply, header)
+			return header.type == .Echo && header.seq == seq && len(payload) == PAYLOAD_SIZE
+		case .Bad:
+			reply.start, reply.end = 0, 0
+			return false
+		case .Need_More:
+		}
+		n, err := net.recv_tcp(sock, protocol.recv_span(reply))
+		if err != nil || n == 0 {
+			reply.start, reply.end = 0, 0
+			return false
+		}
+		protocol.recv_commit(reply, n)
+	}
+}
@@ -0,0 +1,126 @@
+/*
+Wire format between the server and its clients. A stream of messages, each a fixed header and
+then its payload, little endian:
+
+	size  u16  payload bytes after the header
+	type  u8   Msg_Type
+	seq   u32  sequence number of the sender, a reply carries the seq it answers
+
+Messages are parsed in place: incoming bytes are read into a Recv_Buffer and peek_message returns
+a payload slice straight into it, valid until the message is consumed. A message that is only
+partly received stays in the buffer until the rest arrives.
+*/
+package protocol
+
+import "core:encoding/endian"
+
+HEADER_SIZE :: 7
+MAX_PAYLOAD :: 1024
+MAX_MESSAGE :: HEADER_SIZE + MAX_PAYLOAD
+RECV_BUFFER_SIZE :: 4 * MAX_MESSAGE
+VIEW_SIZE :: 8 // chunk x and y, i32 each
+
+Msg_Type :: enum u8 {
+	Echo, // answered with the same payload
+	Ping, // answered with an empty Pong
+	Pong,
+	Disconnect, // the sender is going away, no answer
+	//Replication, see the replication package of custom_template. None are answered.
+	Join, // client wants snapshots, payload is its view
+	View, // client looks somewhere else now, payload is its view
+	Snapshot, // server, seq is the tick, payload one part of its snapshot
+	Ack, // client has the snapshot of tick seq
+}
+
+Header :: struct {
+	size: int,
+	type: Msg_Type,
+	seq:  u32,
+}
+
+Parse_Result :: enum {
+	Ok,
+	Need_More, // the message isn't complete yet
+	Bad, // not a valid message, the stream can't be trusted anymore
+}
+
+//Writes a header for a payload of size bytes, out needs HEADER_SIZE bytes
+put_header :: proc(out: []u8, type: Msg_Type, seq: u32, size: int) {
+	assert(size <= MAX_PAYLOAD)
+	endian.unchecked_put_u16le(out[0:], u16(size))
+	out[2] = u8(type)
+	endian.unchecked_put_u32le(out[3:], seq)
+}
+
+//Header and payload, out needs HEADER_SIZE + len(payload) bytes. Returns the bytes written.
+put_message :: proc(out: []u8, type: Msg_Type, seq: u32, payload: []u8) -> int {
+	put_header(out, type, seq, len(payload))
+	copy(out[HEADER_SIZE:], payload)
+	return HEADER_SIZE + len(payload)
+}
+
+put_view :: proc(out: []u8, chunk: [2]i32) {
+	endian.unchecked_put_u32le(out[0:], u32(chunk.x))
+	endian.unchecked_put_u32le(out[4:], u32(chunk.y))
+}
+
+parse_view :: proc(payload: []u8) -> (chunk: [2]i32, ok: bool) {
+	if len(payload) != VIEW_SIZE {
+		return
+	}
+	chunk.x = i32(endian.unchecked_get_u32le(payload[0:]))
+	chunk.y = i32(endian.unchecked_get_u32le(payload[4:]))
+	return chunk, true
+}
+
+//Parses the message at the start of buf
+parse_message :: proc(buf: []u8) -> (header: Header, payload: []u8, result: Parse_Result) {
+	if len(buf) < HEADER_SIZE {
+		return {}, nil, .Need_More
+	}
+	header.size = int(endian.unchecked_get_u16le(buf[0:]))
+	if header.size > MAX_PAYLOAD || buf[2] > u8(max(Msg_Type)) {
+		return {}, nil, .Bad
+	}
+	if len(buf) < HEADER_SIZE + header.size {
+		return {}, nil, .Need_More
+	}
+	header.type = Msg_Type(buf[2])
+	header.seq = endian.unchecked_get_u32le(buf[3:])
+	return header, buf[HEADER_SIZE:][:header.size], .Ok
+}
+
+//Received bytes not handled yet are data[start:end]. Only an incomplete message is ever moved,
+//to the front, when the end of the buffer is reached.
+Recv_Buffer :: struct {
+	data:  [RECV_BUFFER_SIZE]u8,
+	start: int,
+	end:   int,
+}
+
+//Free space to receive into, commit what was received with recv_commit. Empty when the buffer
+//is full of complete messages that haven't been consumed.
+recv_span :: proc(b: ^Recv_Buffer) -> []u8 {
+	if b.start == b.end {
+		b.start, b.end = 0, 0
+	} else if b.end == len(b.data) && b.start > 0 {
+		copy(b.data[:], b.data[b.start:b.end])
+		b.end -= b.start
+		b.start = 0
+	}
+	return b.data[b.end:]
+}
+
+recv_commit :: proc(b: ^Recv_Buffer, n: int) {
+	assert(b.end + n <= len(b.data))
+	b.end += n
+}
+
+//The next message, left in the buffer until consume_message
+peek_message :: proc(b: ^Recv_Buffer) -> (header: Header, payload: []u8, result: Parse_Result) {
+	return parse_message(b.data[b.start:b.end])
+}
+
+consume_message :: proc(b: ^Recv_Buffer, header: Header) {
+	b.start += HEADER_SIZE + header.size
+}
@@ -0,0 +1,592 @@
+#+build linux
+package main
+
+import "core:fmt"
+import "core:log"
+import "core:mem"
+import "core:net"
+import "core:sync"
+import "core:sys/linux"
+import "core:thread"
+import "core:time"
+
+import "../custom_template/replication"
+import "protocol"
+
+//Event driven server core.
+//
+//IO_THREADS threads each run their own epoll instance and own the connections they accepted, so
+//a connection is only ever touched by one thread and needs no locks. The listening socket is in
+//every instance with EPOLLEXCLUSIVE, the kernel wakes one thread per new connection.
+//
+//Sockets are non-blocking and registered edge triggered: an event only says something changed,
+//so every read and write loops until the kernel says EAGAIN. Incoming bytes go into the
+//connection's receive buffer and messages are handled in place from there, see protocol. Replies
+//are queued in the output ring and everything queued goes out in one send once the socket has
+//been read dry, so a burst of small messages costs one syscall.
+//
+//Back-pressure: a client that doesn't read its replies fills its output ring. Its messages are
+//then left unhandled and reading from it stops, so its own sends back up in the kernel instead
+//of in server memory. A client that makes no progress on its output for SLOW_CLIENT_TIMEOUT is
+//disconnected.
+//
+//A client that shuts down its sending side (EPOLLRDHUP, recv returns 0) is half-closed: reading
+//stops, the messages already received are still answered, and the connection is closed once the
+//output ring has been flushed.
+//
+//With a World_History (the -sim server) clients can also join replication. The tick loop wakes
+//every I/O thread through an eventfd once a World is published, and each thread encodes and sends
+//the snapshots of its own clients, so the encoding is spread over the I/O threads too. A snapshot
+//that doesn't fit in the output ring is skipped, the client's next one is a delta against an
+//older base.
+
+IO_THREADS :: #config(IO_THREADS, 4)
+MAX_CONNECTIONS_PER_THREAD :: 4096
+EPOLL_BATCH :: 256
+EPOLL_TIMEOUT_MS :: 100
+SLOW_CLIENT_TIMEOUT :: 10 * time.Second
+LISTEN_TAG :: max(u64)
+TICK_TAG :: max(u64) - 1
+
+#assert(RING_SIZE >= protocol.MAX_MESSAGE)
+#assert(replication.PART_SIZE <= protocol.MAX_PAYLOAD)
+
+Connection :: struct {
+	fd:          linux.Fd,
+	index:       i32, // slot in Io_Thread.conns
+	generation:  u32, // bumped on close, events for an earlier connection in the slot are ignored
+	open:        bool,
+	read_paused: bool, // receive buffer was full when reading stopped
+	read_closed: bool, // client sent everything it will, close once the output is flushed
+	stalled_at:  time.Tick, // since when output is waiting on the client, zero while it keeps up
+	input:       protocol.Recv_Buffer,
+	output:      Ring,
+	client:      replication.Client_View,
+}
+
+Io_Thread :: struct {
+	server:     ^Reactor,
+	thread:     ^thread.Thread,
+	epoll:      linux.Fd,
+	//slots are zeroed pages until first used, so the whole array costs little up front
+	conns:      []Connection,
+	free:       []i32,
+	free_count: int,
+	high_water: int, // slots past this were never used
+	last_sweep: time.Tick,
+	tick_fd:    linux.Fd, // eventfd, readable when there is a new World to send
+	sent_tick:  u32, // World last sent
+	encoder:    replication.Encoder,
+}
+
+Reactor_Stats :: struct {
+	open:      int,
+	accepted:  int,
+	closed:    int,
+	rejected:  int, // accepted while every slot of the thread was in use
+	timed_out: int, // slow clients
+	bytes_in:  int,
+	bytes_out: int,
+	msgs_in:   int,
+	msgs_out:  int,
+	sends:     int, // syscalls the output went out in
+	joined:    int, // clients receiving snapshots
+	snapshots: int,
+	skipped:   int, // snapshots that didn't fit in a client's output ring
+	send_ns:   int, // spent encoding and sending snapshots, over all I/O threads
+}
+
+Reactor :: struct {
+	listen_fd: linux.Fd,
+	running:   bool,
+	logger:    log.Logger, // of the thread that started the reactor
+	world:     ^replication.World_History, // nil when not replicating
+	io:        []Io_Thread,
+	stats:     Reactor_Stats, // updated with atomics by every I/O thread
+}
+
+//Starts the I/O threads on an already listening socket. Clients can join replication when a
+//world history is given, see wake_io_threads. Nil when the epoll setup failed.
+start_reactor :: proc(
+	listen_socket: net.TCP_Socket,
+	world: ^replication.World_History = nil,
+) -> ^Reactor {
+	r := new(Reactor)
+	r.listen_fd = linux.Fd(listen_socket)
+	r.running = true
+	r.logger = context.logger
+	r.world = world
+	if err := net.set_blocking(listen_socket, false); err != nil {
+		fmt.printf("Failed to make the listening socket non-blocking: %v\n", err)
+	}
+
+	r.io = make([]Io_Thread, IO_THREADS)
+	for &io, i in r.io {
+		if !init_io_thread(r, &io) {
+			stop_reactor(r)
+			return nil
+		}
+		io.thread = thread.create(io_thread_proc)
+		io.thread.data = &io
+		io.thread.user_index = i
+		thread.start(io.thread)
+	}
+	return r
+}
+
+//Once the epoll instance exists, stop_reactor cleans up whatever else got set up
+init_io_thread :: proc(r: ^Reactor, io: ^Io_Thread) -> bool {
+	io.server = r
+	io.tick_fd = -1
+	epoll, epoll_err := linux.epoll_create()
+	if epoll_err != .NONE {
+		fmt.printf("epoll_create failed: %v\n", epoll_err)
+		return false
+	}
+	io.epoll = epoll
+	io.conns = make([]Connection, MAX_CONNECTIONS_PER_THREAD)
+	io.free = make([]i32, MAX_CONNECTIONS_PER_THREAD)
+	for j in 0 ..< MAX_CONNECTIONS_PER_THREAD {
+		io.free[j] = i32(MAX_CONNECTIONS_PER_THREAD - 1 - j)
+	}
+	io.free_count = MAX_CONNECTIONS_PER_THREAD
+
+	listen_event := linux.EPoll_Event {
+		events = {.IN, .EXCLUSIVE},
+		data = {u64 = LISTEN_TAG},
+	}
+	if err := linux.epoll_ctl(io.epoll, .ADD, r.listen_fd, &listen_event); err != .NONE {
+		fmt.printf("Failed to watch the listening socket: %v\n", err)
+		return false
+	}
+	if r.world == nil {
+		return true
+	}
+	tick_fd, tick_err := linux.eventfd(0, {.NONBLOCK})
+	if tick_err != .NONE {
+		fmt.printf("eventfd failed: %v\n", tick_err)
+		return false
+	}
+	io.tick_fd = tick_fd
+	tick_event := linux.EPoll_Event {
+		events = {.IN},
+		data = {u64 = TICK_TAG},
+	}
+	if err := linux.epoll_ctl(io.epoll, .ADD, io.tick_fd, &tick_event); err != .NONE {
+		fmt.printf("Failed to watch the tick eventfd: %v\n", err)
+		return false
+	}
+	return true
+}
+
+stop_reactor :: proc(r: ^Reactor) {
+	sync.atomic_store(&r.running, false)
+	for &io in r.io {
+		if io.thread != nil {
+			thread.join(io.thread)
+			thread.destroy(io.thread)
+		}
+		if io.conns == nil {
+			continue // never got an epoll instance
+		}
+		for &conn in io.conns[:io.high_water] {
+			if conn.open {
+				linux.close(conn.fd)
+			}
+		}
+		linux.close(io.epoll)
+		if io.tick_fd >= 0 {
+			linux.close(io.tick_fd)
+		}
+		replication.delete_encoder(&io.encoder)
+		delete(io.conns)
+		delete(io.free)
+	}
+	delete(r.io)
+	free(r)
+}
+
+reactor_stats :: proc(r: ^Reactor) -> (stats: Reactor_Stats) {
+	stats.open = sync.atomic_load(&r.stats.open)
+	stats.accepted = sync.atomic_load(&r.stats.accepted)
+	stats.closed = sync.atomic_load(&r.stats.closed)
+	stats.rejected = sync.atomic_load(&r.stats.rejected)
+	stats.timed_out = sync.atomic_load(&r.stats.timed_out)
+	stats.bytes_in = sync.atomic_load(&r.stats.bytes_in)
+	stats.bytes_out = sync.atomic_load(&r.stats.bytes_out)
+	stats.msgs_in = sync.atomic_load(&r.stats.msgs_in)
+	stats.msgs_out = sync.atomic_load(&r.stats.msgs_out)
+	stats.sends = sync.atomic_load(&r.stats.sends)
+	stats.joined = sync.atomic_load(&r.stats.joined)
+	stats.snapshots = sync.atomic_load(&r.stats.snapshots)
+	stats.skipped = sync.atomic_load(&r.stats.skipped)
+	stats.send_ns = sync.atomic_load(&r.stats.send_ns)
+	return
+}
+
+io_thread_proc :: proc(t: ^thread.Thread) {
+	io := (^Io_Thread)(t.data)
+	context.logger = io.server.logger
+	events: [EPOLL_BATCH]linux.EPoll_Event
+	io.last_sweep = time.tick_now()
+	for sync.atomic_load(&io.server.running) {
+		n, err := linux.epoll_wait(io.epoll, raw_data(events[:]), EPOLL_BATCH, EPOLL_TIMEOUT_MS)
+		if err != .NONE && err != .EINTR {
+			fmt.printf("epoll_wait failed: %v\n", err)
+			break
+		}
+
+		for event in events[:max(n, 0)] {
+			if event.data.u64 == LISTEN_TAG {
+				accept_connections(io)
+				continue
+			}
+			if event.data.u64 == TICK_TAG {
+				send_snapshots(io)
+				continue
+			}
+			conn := connection_from_tag(io, event.data.u64)
+			if conn == nil {
+				continue
+			}
+			if .ERR in event.events || .HUP in event.events {
+				close_connection(io, conn)
+				continue
+			}
+			service_connection(io, conn)
+		}
+
+		if time.tick_since(io.last_sweep) >= time.Second {
+			io.last_sweep = time.tick_now()
+			close_stalled_connections(io)
+		}
+	}
+}
+
+accept_connections :: proc(io: ^Io_Thread) {
+	for {
+		addr: linux.Sock_Addr_In
+		fd, err := linux.accept(io.server.listen_fd, &addr, {.NONBLOCK})
+		#partial switch err {
+		case .NONE:
+		case .EINTR, .ECONNABORTED:
+			continue
+		case .EAGAIN:
+			return
+		case:
+			//EMFILE and friends, the connection stays queued until a descriptor is free
+			fmt.printf("Failed to accept connection: %v\n", err)
+			return
+		}
+
+		if io.free_count == 0 {
+			linux.close(fd)
+			sync.atomic_add(&io.server.stats.rejected, 1)
+			continue
+		}
+		//the slot is only taken once the socket is registered, events for it can't come in
+		//before then as this thread is the one that would handle them
+		index := io.free[io.free_count - 1]
+		conn := &io.conns[index]
+		event := linux.EPoll_Event {
+			events = {.IN, .OUT, .RDHUP, .ET},
+			data = {u64 = connection_tag(index, conn.generation)},
+		}
+		if ctl_err := linux.epoll_ctl(io.epoll, .ADD, fd, &event); ctl_err != .NONE {
+			fmt.printf("Failed to watch connection: %v\n", ctl_err)
+			linux.close(fd)
+			continue
+		}
+		io.free_count -= 1
+		conn.fd = fd
+		conn.index = index
+		conn.open = true
+		conn.read_paused = false
+		conn.read_closed = false
+		conn.stalled_at = {}
+		conn.input.start, conn.input.end = 0, 0
+		conn.output.read, conn.output.write = 0, 0
+		conn.client = {}
+		io.high_water = max(io.high_water, int(index) + 1)
+		sync.atomic_add(&io.server.stats.accepted, 1)
+		sync.atomic_add(&io.server.stats.open, 1)
+	}
+}
+
+connection_tag :: proc(index: i32, generation: u32) -> u64 {
+	return u64(generation) << 32 | u64(u32(index))
+}
+
+//Nil for events of a connection that has been closed since
+connection_from_tag :: proc(io: ^Io_Thread, tag: u64) -> ^Connection {
+	conn := &io.conns[u32(tag)]
+	if !conn.open || conn.generation != u32(tag >> 32) {
+		return nil
+	}
+	return conn
+}
+
+//Reads, handles and flushes until the socket has nothing more for now. Edge triggered, so
+//anything left behind here would not be reported again.
+service_connection :: proc(io: ^Io_Thread, conn: ^Connection) {
+	for {
+		read_connection(io, conn)
+		if !conn.open {
+			return
+		}
+		flushed := flush_connection(io, conn)
+		if !conn.open {
+			return
+		}
+		//Half-closed: a flush that made room may let more of the received messages be answered,
+		//once everything went out there is nothing left to do
+		if conn.read_closed {
+			if flushed > 0 {
+				continue
+			}
+			if ring_len(&conn.output) == 0 {
+				close_connection(io, conn)
+			}
+			return
+		}
+		//Reading stopped on a full buffer and the flush made room, the bytes still waiting in
+		//the socket won't raise another event
+		if !conn.read_paused || flushed == 0 {
+			return
+		}
+	}
+}
+
+read_connection :: proc(io: ^Io_Thread, conn: ^Connection) {
+	conn.read_paused = false
+	for {
+		if !handle_messages(io, conn) || conn.read_closed {
+			return
+		}
+		span := protocol.recv_span(&conn.input)
+		if len(span) == 0 {
+			conn.read_paused = true
+			return
+		}
+		n, err := linux.recv(conn.fd, span, {})
+		#partial switch err {
+		case .NONE:
+		case .EINTR:
+			continue
+		case .EAGAIN:
+			return
+		case:
+			close_connection(io, conn)
+			return
+		}
+		if n == 0 {
+			close_reading(io, conn)
+			return
+		}
+		protocol.recv_commit(&conn.input, n)
+		sync.atomic_add(&io.server.stats.bytes_in, n)
+	}
+}
+
+//Handles the complete messages in the receive buffer and queues the replies. Stops at a message
+//whose reply doesn't fit in the output ring, it is handled again after a flush. Returns false
+//when the connection got closed.
+handle_messages :: proc(io: ^Io_Thread, conn: ^Connection) -> bool {
+	handled, replied := 0, 0
+	defer if handled > 0 {
+		sync.atomic_add(&io.server.stats.msgs_in, handled)
+		sync.atomic_add(&io.server.stats.msgs_out, replied)
+	}
+	for {
+		header, payload, result := protocol.peek_message(&conn.input)
+		switch result {
+		case .Ok:
+		case .Need_More:
+			return true
+		case .Bad:
+			log.warnf("Bad message on connection %d, closing it", conn.index)
+			close_connection(io, conn)
+			return false
+		}
+
+		type, reply, answered := reply_for(header, payload)
+		if answered && ring_free(&conn.output) < protocol.HEADER_SIZE + len(reply) {
+			mark_stalled(conn)
+			return true
+		}
+		log_message("recv", header, payload)
+		handled += 1
+		#partial switch header.type {
+		case .Disconnect:
+			close_connection(io, conn)
+			return false
+		case .Join, .View:
+			view, view_ok := protocol.parse_view(payload)
+			if io.server.world == nil || !view_ok || conn.read_closed {
+				break
+			}
+			if !conn.client.joined {
+				conn.client.joined = true
+				sync.atomic_add(&io.server.stats.joined, 1)
+			}
+			conn.client.view = view
+		case .Ack:
+			//acks can overtake each other only in theory, the newest base is the one to keep
+			if header.seq > conn.client.acked && header.seq <= io.sent_tick {
+				conn.client.acked = header.seq
+			}
+		}
+		if answered {
+			queue_message(&conn.output, type, header.seq, reply)
+			replied += 1
+		}
+		protocol.consume_message(&conn.input, header)
+	}
+}
+
+//out needs room for the whole message
+queue_message :: proc(out: ^Ring, type: protocol.Msg_Type, seq: u32, payload: []u8) {
+	header: [protocol.HEADER_SIZE]u8
+	protocol.put_header(header[:], type, seq, len(payload))
+	ring_write(out, header[:])
+	ring_write(out, payload)
+}
+
+//Writes the output ring until it is empty or the socket is full, returns the bytes written
+flush_connection :: proc(io: ^Io_Thread, conn: ^Connection) -> int {
+	written, sends := 0, 0
+	send_loop: for ring_len(&conn.output) > 0 {
+		//both halves of a wrapped ring in one call
+		first := ring_read_span(&conn.output)
+		second := conn.output.data[:ring_len(&conn.output) - len(first)]
+		iov := [2]linux.IO_Vec {
+			{base = raw_data(first), len = uint(len(first))},
+			{base = raw_data(second), len = uint(len(second))},
+		}
+		msg := linux.Msg_Hdr {
+			iov = iov[:],
+		}
+		n, err := linux.sendmsg(conn.fd, &msg, {.NOSIGNAL})
+		#partial switch err {
+		case .NONE:
+		case .EINTR:
+			continue
+		case .EAGAIN:
+			break send_loop
+		case:
+			close_connection(io, conn)
+			return written
+		}
+		ring_consume(&conn.output, n)
+		written += n
+		sends += 1
+	}
+	sync.atomic_add(&io.server.stats.bytes_out, written)
+	sync.atomic_add(&io.server.stats.sends, sends)
+
+	if ring_len(&conn.output) == 0 {
+		conn.stalled_at = {}
+	} else if written > 0 {
+		//still behind, but reading, the timeout counts from here
+		conn.stalled_at = time.tick_now()
+	} else {
+		mark_stalled(conn)
+	}
+	return written
+}
+
+//Output is waiting on the client. Only a flush that gets bytes out resets this.
+mark_stalled :: proc(conn: ^Connection) {
+	if conn.stalled_at == {} {
+		conn.stalled_at = time.tick_now()
+	}
+}
+
+//Encodes the newest World for every joined client of this thread and sends it straight away
+send_snapshots :: proc(io: ^Io_Thread) {
+	//level triggered, reading resets the eventfd
+	wakeups: u64
+	linux.read(io.tick_fd, mem.ptr_to_bytes(&wakeups))
+
+	h := io.server.world
+	tick := replication.latest_world(h)
+	world := replication.world_at(h, tick, tick)
+	if world == nil || tick == io.sent_tick {
+		return
+	}
+	io.sent_tick = tick
+
+	start := time.tick_now()
+	sent, skipped := 0, 0
+	for &conn in io.conns[:io.high_water] {
+		if !conn.open || !conn.client.joined {
+			continue
+		}
+		enc := &io.encoder
+		base := replication.encode_snapshot(enc, &conn.client, h, world)
+		//this thread fell so far behind that the tick loop overwrote what it just read, the
+		//clients get the next one instead
+		if !replication.world_still_valid(h, base if base != 0 else tick) {
+			break
+		}
+		if ring_free(&conn.output) < len(enc.bytes) + len(enc.parts) * protocol.HEADER_SIZE {
+			mark_stalled(&conn)
+			skipped += 1
+			continue
+		}
+		for i in 0 ..< len(enc.parts) {
+			queue_message(&conn.output, .Snapshot, tick, replication.encoder_part(enc, i))
+		}
+		sent += 1
+		flush_connection(io, &conn)
+	}
+	sync.atomic_add(&io.server.stats.snapshots, sent)
+	sync.atomic_add(&io.server.stats.skipped, skipped)
+	sync.atomic_add(&io.server.stats.send_ns, int(time.tick_since(start)))
+}
+
+//Called by the tick loop after publishing a World
+wake_io_threads :: proc(r: ^Reactor) {
+	one := u64(1)
+	for &io in r.io {
+		linux.write(io.tick_fd, mem.ptr_to_bytes(&one))
+	}
+}
+
+close_stalled_connections :: proc(io: ^Io_Thread) {
+	for &conn in io.conns[:io.high_water] {
+		if conn.open &&
+		   conn.stalled_at != {} &&
+		   time.tick_since(conn.stalled_at) > SLOW_CLIENT_TIMEOUT {
+			sync.atomic_add(&io.server.stats.timed_out, 1)
+			close_connection(io, &conn)
+		}
+	}
+}
+
+//The client shut down its sending side. Snapshots stop too, or the output would never run dry.
+close_reading :: proc(io: ^Io_Thread, conn: ^Connection) {
+	conn.read_closed = true
+	if conn.client.joined {
+		conn.client.joined = false
+		sync.atomic_sub(&io.server.stats.joined, 1)
+	}
+}
+
+close_connection :: proc(io: ^Io_Thread, conn: ^Connection) {
+	if !conn.open {
+		return
+	}
+	//closing the descriptor also removes it from the epoll set
+	linux.close(conn.fd)
+	conn.open = false
+	if conn.client.joined {
+		conn.client.joined = false
+		sync.atomic_sub(&io.server.stats.joined, 1)
+	}
+	conn.generation += 1
+	io.free[io.free_count] = conn.index
+	io.free_count += 1
+	sync.atomic_sub(&io.server.stats.open, 1)
+	sync.atomic_add(&io.server.stats.closed, 1)
+}
@@ -0,0 +1,57 @@
+package main
+
+//Fixed size byte ring, one per direction per connection. read and write run freely and wrap
+//through u32, the bytes in use are [read, write) modulo RING_SIZE.
+//Big enough for a full snapshot of a crowded view, see replication
+RING_SIZE :: 64 * 1024 // power of two
+
+Ring :: struct {
+	data:  [RING_SIZE]u8,
+	read:  u32,
+	write: u32,
+}
+
+ring_len :: proc(r: ^Ring) -> int {
+	return int(r.write - r.read)
+}
+
+ring_free :: proc(r: ^Ring) -> int {
+	return RING_SIZE - ring_len(r)
+}
+
+//Longest run of free bytes that can be written without wrapping, commit with ring_commit
+ring_write_span :: proc(r: ^Ring) -> []u8 {
+	start := int(r.write % RING_SIZE)
+	return r.data[start:][:min(RING_SIZE - start, ring_free(r))]
+}
+
+ring_commit :: proc(r: ^Ring, n: int) {
+	assert(n <= ring_free(r))
+	r.write += u32(n)
+}
+
+//Longest run of used bytes that can be read without wrapping, drop them with ring_consume
+ring_read_span :: proc(r: ^Ring) -> []u8 {
+	start := int(r.read % RING_SIZE)
+	return r.data[start:][:min(RING_SIZE - start, ring_len(r))]
+}
+
+ring_consume :: proc(r: ^Ring, n: int) {
+	assert(n <= ring_len(r))
+	r.read += u32(n)
+}
+
+//Copies as much of bytes as fits, returns how much that was
+ring_write :: proc(r: ^Ring, bytes: []u8) -> int {
+	written := 0
+	for written < len(bytes) {
+		span := ring_write_span(r)
+		if len(span) == 0 {
+			break
+		}
+		n := copy(span, bytes[written:])
+		ring_commit(r, n)
+		written += n
+	}
+	return written
+}
@@ -11,14 +11,27 @@ import "core:sys/unix"
 import "core:thread"
 import "core:time"
 
+import "protocol"
+
 
 NAME :: "odin-server"
 VERSION :: "0.1.0"
+//Seconds between status lines
+STATS_INTERVAL :: 5
+//Logs every message, -define:DEBUG_LOG=true
+DEBUG_LOG :: #config(DEBUG_LOG, false)
+
+main :: proc() {
+	server_init()
+}
 
 server_init :: proc() {
-	context.logger = log.create_console_logger()
-	if (len(os.args) != 2) {
-		fmt.printf("Usage: %s <port>\n", os.args[0])
+	context.logger = log.create_console_logger(.Debug if DEBUG_LOG else .Info)
+	if (len(os.args) < 2) {
+		fmt.printf(
+			"Usage: %s <port> [-sim [entities] | -clients [count] [seconds] | -udp]\n",
+			os.args[0],
+		)
 		os.exit(1)
 	}
 
@@ -28,6 +41,26 @@ server_init :: proc() {
 		os.exit(1)
 	}
 
+	//-sim runs the game and replicates it, see sim_server_linux.odin. -clients connects simulated
+	//clients to such a server, see client.odin. -udp echoes over the UDP transport instead of TCP,
+	//see udp_server.odin.
+	mode := os.args[2] if len(os.args) > 2 else ""
+	extra := os.args[min(3, len(os.args)):]
+	if mode == "-udp" {
+		run_udp_server(port)
+		return
+	}
+	if mode == "-clients" {
+		count := SIM_CLIENTS
+		seconds := SIM_CLIENT_SECONDS
+		if len(extra) > 0 {count = strconv.parse_int(extra[0]) or_else count}
+		if len(extra) > 1 {seconds = strconv.parse_int(extra[1]) or_else seconds}
+		server, _ := net.parse_endpoint("127.0.0.1")
+		server.port = port
+		run_sim_clients(server, count, seconds)
+		return
+	}
+
 	fmt.printf("Starting %s version %s on port %d...\n", NAME, VERSION, port)
 
 	endpoint, endpoint_parsed := net.parse_endpoint("0.0.0.0")
@@ -43,8 +76,51 @@ server_init :: proc() {
 		os.exit(1)
 	}
 
-	fmt.printf("Listening on TCP: %s", net.endpoint_to_string(endpoint))
+	fmt.printf("Listening on TCP: %s\n", net.endpoint_to_string(endpoint))
+
+	//Linux gets the epoll reactor, see reactor_linux.odin. Elsewhere every client still gets its
+	//own thread.
+	when ODIN_OS == .Linux {
+		if mode == "-sim" {
+			entities := SIM_ENTITIES
+			if len(extra) > 0 {entities = strconv.parse_int(extra[0]) or_else entities}
+			run_sim_server(listen_socket, entities)
+		}
+		reactor := start_reactor(listen_socket)
+		if reactor == nil {
+			os.exit(1)
+		}
+		fmt.printf(
+			"%d I/O threads, up to %d connections each\n",
+			IO_THREADS,
+			MAX_CONNECTIONS_PER_THREAD,
+		)
+		for {
+			time.sleep(STATS_INTERVAL * time.Second)
+			stats := reactor_stats(reactor)
+			fmt.printf(
+				"%d open, %d accepted, %d closed, %d rejected, %d slow, %dKB in, %dKB out\n",
+				stats.open,
+				stats.accepted,
+				stats.closed,
+				stats.rejected,
+				stats.timed_out,
+				stats.bytes_in / 1024,
+				stats.bytes_out / 1024,
+			)
+			fmt.printf(
+				"%d messages in, %d out in %d sends\n",
+				stats.msgs_in,
+				stats.msgs_out,
+				stats.sends,
+			)
+		}
+	}
 
+	if mode == "-sim" {
+		fmt.printf("-sim needs the epoll reactor, which is Linux only for now\n")
+		os.exit(1)
+	}
 	for {
 		cli, _, err_accept := net.accept_tcp(listen_socket)
 		if err_accept != nil {
@@ -68,51 +144,91 @@ server_init :: proc() {
 	}*/
 }
 
+//Thread per client with blocking sockets. The replies to everything one recv brought in are
+//gathered and sent together.
 handle_msg :: proc(sock: net.TCP_Socket) {
-	buffer: [256]u8
-	for {
-		bytes_recv, err_recv := net.recv_tcp(sock, buffer[:])
-		if err_recv != nil {
-			fmt.println("Failed to receive data")
-		}
-		received := buffer[:bytes_recv]
-		if len(received) == 0 ||
-		   is_ctrl_d(received) ||
-		   is_empty(received) ||
-		   is_telnet_ctrl_c(received) {
-			fmt.println("Disconnecting client")
+	input := new(protocol.Recv_Buffer)
+	output := make([]u8, protocol.RECV_BUFFER_SIZE)
+	defer {
+		free(input)
+		delete(output)
+		net.close(sock)
+	}
+	recv_loop: for {
+		//only an incomplete message is left between reads, so there is always room
+		bytes_recv, err_recv := net.recv_tcp(sock, protocol.recv_span(input))
+		if err_recv != nil || bytes_recv == 0 {
 			break
 		}
-		fmt.printfln("Server received [ %d bytes ]: %s", len(received), received)
-		bytes_sent, err_send := net.send_tcp(sock, received)
-		if err_send != nil {
-			fmt.println("Failed to send data")
+		protocol.recv_commit(input, bytes_recv)
+
+		queued := 0
+		for {
+			header, payload, result := protocol.peek_message(input)
+			if result == .Need_More {
+				break
+			}
+			if result == .Bad {
+				log.warn("Bad message, disconnecting client")
+				break recv_loop
+			}
+			log_message("recv", header, payload)
+			protocol.consume_message(input, header)
+			if header.type == .Disconnect {
+				break recv_loop
+			}
+			type, reply := reply_for(header, payload) or_continue
+			if queued + protocol.HEADER_SIZE + len(reply) > len(output) {
+				if !send_all(sock, output[:queued]) {
+					break recv_loop
+				}
+				queued = 0
+			}
+			queued += protocol.put_message(output[queued:], type, header.seq, reply)
+		}
+		if !send_all(sock, output[:queued]) {
+			break
 		}
-		sent := received[:bytes_sent]
-		fmt.printfln("Server sent [ %d bytes ]: %s", len(sent), sent)
 	}
-	net.close(sock)
 }
 
-is_ctrl_d :: proc(bytes: []u8) -> bool {
-	return len(bytes) == 1 && bytes[0] == 4
+send_all :: proc(sock: net.TCP_Socket, bytes: []u8) -> bool {
+	if len(bytes) == 0 {
+		return true
+	}
+	_, err := net.send_tcp(sock, bytes)
+	return err == nil
 }
 
-is_empty :: proc(bytes: []u8) -> bool {
-	return(
-		(len(bytes) == 2 && bytes[0] == '\r' && bytes[1] == '\n') ||
-		(len(bytes) == 1 && bytes[0] == '\n') \
-	)
+//What the server answers a message with, ok is false for messages it doesn't answer
+reply_for :: proc(
+	header: protocol.Header,
+	payload: []u8,
+) -> (
+	type: protocol.Msg_Type,
+	reply: []u8,
+	ok: bool,
+) {
+	#partial switch header.type {
+	case .Echo:
+		return .Echo, payload, true
+	case .Ping:
+		return .Pong, nil, true
+	}
+	return
 }
 
-is_telnet_ctrl_c :: proc(bytes: []u8) -> bool {
-	return(
-		(len(bytes) == 3 && bytes[0] == 255 && bytes[1] == 251 && bytes[2] == 6) ||
-		(len(bytes) == 5 &&
-				bytes[0] == 255 &&
-				bytes[1] == 244 &&
-				bytes[2] == 255 &&
-				bytes[3] == 253 &&
-				bytes[4] == 6) \
+//One line per message at debug level. Checked up front, so nothing is formatted otherwise.
+log_message :: proc(direction: string, header: protocol.Header, payload: []u8) {
+	if context.logger.lowest_level > .Debug {
+		return
+	}
+	log.debugf(
+		"%s %v seq %d [ %d bytes ]: %v",
+		direction,
+		header.type,
+		header.seq,
+		header.size,
+		payload,
 	)
 }
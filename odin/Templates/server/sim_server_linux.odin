@@ -0,0 +1,106 @@
+#+build linux
+package main
+
+import "core:fmt"
+import "core:net"
+import "core:os"
+import "core:time"
+
+import hm "../custom_template/handle_map"
+import game "../custom_template/source"
+import "../custom_template/jobs"
+import "../custom_template/replication"
+
+//Authoritative game server, -sim on the command line.
+//
+//Runs the custom_template simulation headless at its fixed tick rate, set up like its sim
+//benchmark: the scripted player plus a crowd of wandering goblins. After every tick the entities
+//are captured into a World and the I/O threads are woken to send each joined client its
+//snapshot, see the replication package. The game loads its chunks relative to the working
+//directory, so start it from the custom_template folder:
+//
+//	odin run ../server -o:speed -- 2645 -sim [goblins]
+//
+//Simulated clients for it are in client.odin. The status line has the tick time and what a
+//client gets per second.
+
+SIM_ENTITIES :: 2000
+
+run_sim_server :: proc(listen_socket: net.TCP_Socket, entities: int) {
+	pool := jobs.create_pool()
+	game.init_headless(game.FIXED_DT)
+	game.g.job_pool = pool
+	game.spawn_sim_entities(entities)
+
+	world := new(replication.World_History)
+	replication.init_world_history(world, game.MAX_ENTITIES)
+	reactor := start_reactor(listen_socket, world)
+	if reactor == nil {
+		os.exit(1)
+	}
+	fmt.printf(
+		"Simulating %d entities at %d ticks/s, %d I/O threads\n",
+		hm.len(game.g.entities),
+		game.FIXED_TICK_RATE,
+		IO_THREADS,
+	)
+
+	heap := context.allocator
+	tick_duration := time.Duration(f64(time.Second) * f64(game.FIXED_DT))
+	next_tick := time.tick_now()
+	stats_at := next_tick
+	ticks, late := 0, 0
+	tick_total_ms, tick_max_ms: f64
+	last := reactor_stats(reactor)
+	for tick := u32(1); ; tick += 1 {
+		start := time.tick_now()
+		context.temp_allocator, context.allocator = game.begin_frame_memory(
+			game.g.frame_memory,
+			heap,
+		)
+		game.step_headless(game.sim_script_keys(int(tick)))
+		game.profile_frame_begin()
+		game.update()
+		game.capture_replication_world(replication.begin_world(world, tick))
+		replication.publish_world(world, tick)
+		wake_io_threads(reactor)
+
+		ms := time.duration_milliseconds(time.tick_since(start))
+		ticks += 1
+		tick_total_ms += ms
+		tick_max_ms = max(tick_max_ms, ms)
+
+		if time.tick_since(stats_at) >= STATS_INTERVAL * time.Second {
+			seconds := time.duration_seconds(time.tick_since(stats_at))
+			stats := reactor_stats(reactor)
+			bytes_out := f64(stats.bytes_out - last.bytes_out)
+			fmt.printf(
+				"tick avg %.3fms, max %.3fms, %d late\n",
+				tick_total_ms / f64(ticks),
+				tick_max_ms,
+				late,
+			)
+			fmt.printf(
+				"%d clients, %.1fKB/s each, %d snapshots, %d skipped, %.3fms sending per tick\n",
+				stats.joined,
+				bytes_out / 1024 / seconds / f64(max(stats.joined, 1)),
+				stats.snapshots - last.snapshots,
+				stats.skipped - last.skipped,
+				f64(stats.send_ns - last.send_ns) / 1e6 / f64(ticks),
+			)
+			last = stats
+			stats_at = time.tick_now()
+			ticks, late = 0, 0
+			tick_total_ms, tick_max_ms = 0, 0
+		}
+
+		//a tick that ran long isn't caught up on, the next one just starts late
+		next_tick = time.tick_add(next_tick, tick_duration)
+		if wait := time.tick_diff(time.tick_now(), next_tick); wait > 0 {
+			time.sleep(wait)
+		} else {
+			late += 1
+			next_tick = time.tick_now()
+		}
+	}
+}
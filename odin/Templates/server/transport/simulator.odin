@@ -0,0 +1,115 @@
+package transport
+
+import "core:net"
+
+//A network in memory, for testing transports against latency, jitter and loss on one machine.
+//
+//Each Transport gets a Sim_Port with an address of its own and talks through sim_link. Packets
+//are held until now passes their delivery time, which is latency plus or minus up to jitter, so
+//jitter also reorders them. Time only moves when the caller sets now, so a simulated minute takes
+//as long as the work in it, and the same seed always loses the same packets.
+
+Sim_Network :: struct {
+	now:       f64, // seconds, set by the caller
+	latency:   f64, // one way, seconds
+	jitter:    f64, // seconds
+	loss:      f64, // 0 to 1
+	duplicate: f64, // 0 to 1, packets delivered twice
+	seed:      u64,
+	in_flight: [dynamic]Sim_Packet,
+	stats:     Sim_Stats,
+}
+
+Sim_Stats :: struct {
+	sent:       int,
+	lost:       int,
+	duplicated: int,
+	delivered:  int,
+}
+
+Sim_Packet :: struct {
+	deliver_at: f64,
+	from, to:   net.Endpoint,
+	size:       int,
+	data:       [MTU]u8,
+}
+
+Sim_Port :: struct {
+	network: ^Sim_Network,
+	address: net.Endpoint,
+}
+
+//Loopback address for simulated port number port
+sim_address :: proc(port: int) -> net.Endpoint {
+	return {address = net.IP4_Loopback, port = port}
+}
+
+sim_link :: proc(port: ^Sim_Port) -> Link {
+	return {data = port, send = sim_send, recv = sim_recv}
+}
+
+delete_sim_network :: proc(n: ^Sim_Network) {
+	delete(n.in_flight)
+}
+
+@(private)
+sim_send :: proc(data: rawptr, to: net.Endpoint, packet: []u8) {
+	port := (^Sim_Port)(data)
+	n := port.network
+	n.stats.sent += 1
+	if sim_random(n) < n.loss {
+		n.stats.lost += 1
+		return
+	}
+	copies := 1
+	if sim_random(n) < n.duplicate {
+		copies = 2
+		n.stats.duplicated += 1
+	}
+	for _ in 0 ..< copies {
+		p := Sim_Packet {
+			deliver_at = n.now + max(n.latency + (sim_random(n) * 2 - 1) * n.jitter, 0),
+			from       = port.address,
+			to         = to,
+			size       = min(len(packet), MTU),
+		}
+		copy(p.data[:], packet)
+		append(&n.in_flight, p)
+	}
+}
+
+//The packet for this port that is due first, if any is due yet
+@(private)
+sim_recv :: proc(data: rawptr, buf: []u8) -> (size: int, from: net.Endpoint) {
+	port := (^Sim_Port)(data)
+	n := port.network
+	next := -1
+	for &p, i in n.in_flight {
+		if p.to == port.address &&
+		   p.deliver_at <= n.now &&
+		   (next == -1 || p.deliver_at < n.in_flight[next].deliver_at) {
+			next = i
+		}
+	}
+	if next == -1 {
+		return 0, {}
+	}
+	p := &n.in_flight[next]
+	size = copy(buf, p.data[:p.size])
+	from = p.from
+	unordered_remove(&n.in_flight, next)
+	n.stats.delivered += 1
+	return
+}
+
+//xorshift, 0 to 1
+@(private)
+sim_random :: proc(n: ^Sim_Network) -> f64 {
+	if n.seed == 0 {
+		n.seed = 0x9E3779B97F4A7C15
+	}
+	n.seed ~= n.seed << 13
+	n.seed ~= n.seed >> 7
+	n.seed ~= n.seed << 17
+	return f64(n.seed >> 11) / f64(u64(1) << 53)
+}
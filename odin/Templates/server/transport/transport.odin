@@ -0,0 +1,914 @@
+/*
+Connection oriented transport over UDP, for traffic that shouldn't wait behind a lost packet.
+
+A Transport owns one socket (or a simulated one, see Sim_Network) and talks to up to MAX_PEERS
+peers. Servers create theirs with accept set, clients call connect. Once a frame:
+
+	transport.poll(t, now)       // receive, timeouts, fills t.events
+	for e in t.events {...}      // Connected, Disconnected, Message
+	transport.send(t, peer, .Reliable_Ordered, data)
+	transport.flush(t, now)      // everything queued goes out, coalesced into few packets
+
+Handshake: the client sends Request with a random salt, padded so the answer is never bigger
+than what was asked. The server answers Challenge with its own salt, the client proves it got it
+with Response. Both sides then put the session (made from both salts) in every packet, which
+keeps stale and spoofed packets out.
+
+Every payload packet has a sequence number and acks the newest packet received plus the 32
+before it as a bitfield, so one packet that makes it through acks everything that arrived
+before it. Messages go on one of two channels:
+
+	Unreliable_Sequenced  never resent, anything older than the newest one received is dropped
+	Reliable_Ordered      resent until the packet carrying it is acked, delivered in order
+
+Messages queued between flushes share packets of up to MTU bytes. Longer ones are split into
+fragments of MAX_FRAGMENT: reliable fragments are just consecutive messages, unreliable ones are
+put back together on arrival, and a message that misses a fragment is dropped as a whole.
+
+There is no congestion control, a peer can have RELIABLE_WINDOW reliable messages in flight and
+send returns false beyond that.
+*/
+package transport
+
+import "core:encoding/endian"
+import "core:net"
+
+MTU :: 1200 // bytes per datagram, fits any path without IP fragmentation
+PROTOCOL_ID :: 0x0D1E
+MAX_PEERS :: 64
+PACKET_HEADER_SIZE :: 15 // protocol u16, type u8, session u32, seq u16, ack u16, ack bits u32
+MESSAGE_HEADER_SIZE :: 7 // flags u8, id u16, fragment index u8 and count u8 (unreliable), size u16
+MAX_FRAGMENT :: MTU - PACKET_HEADER_SIZE - MESSAGE_HEADER_SIZE
+MAX_MESSAGE_SIZE :: 64 * 1024
+MAX_FRAGMENTS :: (MAX_MESSAGE_SIZE + MAX_FRAGMENT - 1) / MAX_FRAGMENT
+PACKET_WINDOW :: 256 // sent packets remembered until acked
+RELIABLE_WINDOW :: 256 // reliable messages in flight per peer
+MAX_RELIABLE_PER_PACKET :: 32
+CONNECT_REQUEST_SIZE :: 64
+HANDSHAKE_RESEND :: 0.1 // seconds
+KEEPALIVE_INTERVAL :: 0.1
+TIMEOUT :: 5.0
+MIN_RESEND_DELAY :: 0.05
+DISCONNECT_REPEAT :: 3 // Disconnect is sent this often, it isn't acked
+
+#assert(MAX_FRAGMENTS <= 64)
+#assert(MAX_FRAGMENTS <= RELIABLE_WINDOW)
+
+Channel :: enum u8 {
+	Unreliable_Sequenced,
+	Reliable_Ordered,
+}
+
+Event_Kind :: enum {
+	Connected,
+	Disconnected,
+	Message,
+}
+
+Event :: struct {
+	kind:    Event_Kind,
+	peer:    int,
+	channel: Channel,
+	data:    []u8, // valid until the next poll
+	start:   int, // of data in event_bytes
+}
+
+//Where datagrams go, a UDP socket (udp_link) or the simulator (sim_link). recv doesn't block,
+//it returns 0 when there is nothing.
+Link :: struct {
+	data: rawptr,
+	send: proc(data: rawptr, to: net.Endpoint, packet: []u8),
+	recv: proc(data: rawptr, buf: []u8) -> (n: int, from: net.Endpoint),
+}
+
+Stats :: struct {
+	packets_sent:     int,
+	packets_received: int,
+	bytes_sent:       int,
+	bytes_received:   int,
+	packets_acked:    int,
+	packets_lost:     int, // fell out of the window without an ack
+	resent:           int, // reliable messages sent more than once
+	dropped:          int, // packets that were invalid, duplicates or from nobody we know
+}
+
+Transport :: struct {
+	link:        Link,
+	accept:      bool, // answer connection requests
+	peers:       [MAX_PEERS]Peer,
+	events:      [dynamic]Event,
+	event_bytes: [dynamic]u8,
+	rng:         u64,
+	stats:       Stats,
+}
+
+Peer_State :: enum {
+	Free,
+	Requesting, // client, sends Request until challenged
+	Challenged, // server, waits for the Response
+	Responding, // client, sends Response until the first payload packet
+	Connected,
+}
+
+Peer :: struct {
+	state:             Peer_State,
+	address:           net.Endpoint,
+	client_salt:       u64,
+	server_salt:       u64,
+	session:           u32,
+	last_received:     f64,
+	last_sent:         f64,
+	need_ack:          bool, // received something since the last packet sent
+	rtt:               f64, // smoothed, seconds
+
+	//packets
+	next_seq:          u16, // from 1, so the ack of a peer that received nothing matches nothing
+	remote_seq:        u16, // newest received
+	received_bits:     u32, // bit i: remote_seq - 1 - i was received
+	has_received:      bool,
+	sent:              [PACKET_WINDOW]Sent_Packet, // by seq
+
+	//Reliable_Ordered
+	out:               [RELIABLE_WINDOW]Reliable_Out, // by id
+	out_next:          u16, // id of the next message sent
+	out_oldest:        u16, // oldest not acked
+	in:                [RELIABLE_WINDOW]Reliable_In, // by id
+	in_next:           u16, // id of the next message delivered
+	assembling:        [dynamic]u8, // fragments of a reliable message delivered so far
+
+	//Unreliable_Sequenced
+	unreliable_out:    [dynamic]u8, // encoded messages waiting for the next flush
+	unreliable_seq:    u16,
+	unreliable_latest: u16, // newest delivered
+	has_unreliable:    bool,
+	fragments:         Fragment_Assembly,
+}
+
+Sent_Packet :: struct {
+	used:           bool,
+	acked:          bool,
+	seq:            u16,
+	time:           f64,
+	reliable:       [MAX_RELIABLE_PER_PACKET]u16, // message ids it carried
+	reliable_count: int,
+}
+
+Reliable_Out :: struct {
+	used:    bool,
+	acked:   bool,
+	sent:    bool,
+	id:      u16,
+	flags:   u8,
+	sent_at: f64,
+	data:    [dynamic]u8,
+}
+
+Reliable_In :: struct {
+	received: bool,
+	id:       u16,
+	flags:    u8,
+	data:     [dynamic]u8,
+}
+
+//The unreliable message being put back together, only the newest one is
+Fragment_Assembly :: struct {
+	active:    bool,
+	seq:       u16,
+	count:     int,
+	received:  bit_set[0 ..< 64;u64],
+	last_size: int,
+	data:      [dynamic]u8,
+}
+
+@(private)
+Packet_Type :: enum u8 {
+	Request,
+	Challenge,
+	Response,
+	Denied,
+	Payload,
+	Disconnect,
+}
+
+@(private)
+MSG_RELIABLE :: 1
+@(private)
+MSG_FRAGMENT :: 2
+@(private)
+MSG_LAST :: 4 // last fragment of a reliable message
+
+init :: proc(t: ^Transport, link: Link, accept: bool, seed: u64) {
+	t.link = link
+	t.accept = accept
+	t.rng = seed | 1
+}
+
+destroy :: proc(t: ^Transport) {
+	for &p in t.peers {
+		free_peer(&p)
+	}
+	delete(t.events)
+	delete(t.event_bytes)
+}
+
+//Starts connecting, the Connected or Disconnected event tells how it went. Returns the peer, -1
+//when every peer is in use.
+connect :: proc(t: ^Transport, address: net.Endpoint, now: f64) -> int {
+	i := free_peer_index(t)
+	if i == -1 {
+		return -1
+	}
+	p := &t.peers[i]
+	p.state = .Requesting
+	p.next_seq = 1
+	p.address = address
+	p.client_salt = random(t)
+	p.last_received = now
+	send_request(t, p, now)
+	return i
+}
+
+disconnect :: proc(t: ^Transport, peer: int) {
+	p := &t.peers[peer]
+	if p.state == .Connected || p.state == .Responding {
+		for _ in 0 ..< DISCONNECT_REPEAT {
+			w := begin_control(.Disconnect)
+			put_u32(&w, p.session)
+			send_packet(t, p.address, w, 0, nil)
+		}
+	}
+	free_peer(p)
+}
+
+is_connected :: proc(t: ^Transport, peer: int) -> bool {
+	return t.peers[peer].state == .Connected
+}
+
+rtt :: proc(t: ^Transport, peer: int) -> f64 {
+	return t.peers[peer].rtt
+}
+
+//Queues a message for the next flush. False when the peer isn't connected, the message is too
+//long or the reliable window has no room for it right now.
+send :: proc(t: ^Transport, peer: int, channel: Channel, data: []u8) -> bool {
+	p := &t.peers[peer]
+	if p.state != .Connected || len(data) > MAX_MESSAGE_SIZE {
+		return false
+	}
+	count := max((len(data) + MAX_FRAGMENT - 1) / MAX_FRAGMENT, 1)
+	switch channel {
+	case .Unreliable_Sequenced:
+		seq := p.unreliable_seq
+		p.unreliable_seq += 1
+		for i in 0 ..< count {
+			part := fragment(data, i)
+			flags := u8(MSG_FRAGMENT) if count > 1 else 0
+			header: [MESSAGE_HEADER_SIZE]u8
+			header[0] = flags
+			endian.unchecked_put_u16le(header[1:], seq)
+			n := 3
+			if count > 1 {
+				header[3] = u8(i)
+				header[4] = u8(count)
+				n = 5
+			}
+			endian.unchecked_put_u16le(header[n:], u16(len(part)))
+			append(&p.unreliable_out, ..header[:n + 2])
+			append(&p.unreliable_out, ..part)
+		}
+	case .Reliable_Ordered:
+		if int(p.out_next - p.out_oldest) + count > RELIABLE_WINDOW {
+			return false
+		}
+		for i in 0 ..< count {
+			m := &p.out[p.out_next % RELIABLE_WINDOW]
+			m.used, m.acked, m.sent = true, false, false
+			m.id = p.out_next
+			m.flags = MSG_RELIABLE
+			if count > 1 {
+				m.flags |= MSG_FRAGMENT
+				if i == count - 1 {
+					m.flags |= MSG_LAST
+				}
+			}
+			clear(&m.data)
+			append(&m.data, ..fragment(data, i))
+			p.out_next += 1
+		}
+	}
+	return true
+}
+
+//Receives every waiting packet and drops peers that timed out. t.events has what happened.
+poll :: proc(t: ^Transport, now: f64) {
+	clear(&t.events)
+	clear(&t.event_bytes)
+	buf: [MTU]u8
+	for {
+		n, from := t.link.recv(t.link.data, buf[:])
+		if n == 0 {
+			break
+		}
+		t.stats.packets_received += 1
+		t.stats.bytes_received += n
+		handle_packet(t, from, buf[:n], now)
+	}
+
+	for &p, i in t.peers {
+		if p.state != .Free && now - p.last_received > TIMEOUT {
+			append(&t.events, Event{kind = .Disconnected, peer = i})
+			free_peer(&p)
+		}
+	}
+	//event_bytes may have moved while it grew
+	for &e in t.events {
+		if e.kind == .Message {
+			e.data = t.event_bytes[e.start:][:len(e.data)]
+		}
+	}
+}
+
+//Sends what was queued since the last flush, resends reliable messages that weren't acked in
+//time, and keeps quiet connections alive
+flush :: proc(t: ^Transport, now: f64) {
+	for &p in t.peers {
+		switch p.state {
+		case .Free, .Challenged:
+		case .Requesting:
+			if now - p.last_sent >= HANDSHAKE_RESEND {
+				send_request(t, &p, now)
+			}
+		case .Responding:
+			if now - p.last_sent >= HANDSHAKE_RESEND {
+				send_response(t, &p, now)
+			}
+		case .Connected:
+			flush_peer(t, &p, now)
+		}
+	}
+}
+
+@(private)
+flush_peer :: proc(t: ^Transport, p: ^Peer, now: f64) {
+	resend_delay := max(p.rtt * 1.5, MIN_RESEND_DELAY)
+	id := p.out_oldest
+	unreliable := p.unreliable_out[:]
+	defer clear(&p.unreliable_out)
+	for {
+		w := begin_control(.Payload)
+		w.len = PACKET_HEADER_SIZE // filled in once it is clear the packet goes out
+		reliable: [MAX_RELIABLE_PER_PACKET]u16
+		reliable_count := 0
+
+		//reliable first, they are the older messages
+		for id != p.out_next && reliable_count < MAX_RELIABLE_PER_PACKET {
+			m := &p.out[id % RELIABLE_WINDOW]
+			if m.acked || (m.sent && now - m.sent_at < resend_delay) {
+				id += 1
+				continue
+			}
+			if w.len + 5 + len(m.data) > MTU {
+				break
+			}
+			if m.sent {
+				t.stats.resent += 1
+			}
+			m.sent = true
+			m.sent_at = now
+			put_u8(&w, m.flags)
+			put_u16(&w, m.id)
+			put_u16(&w, u16(len(m.data)))
+			put_bytes(&w, m.data[:])
+			reliable[reliable_count] = m.id
+			reliable_count += 1
+			id += 1
+		}
+		for len(unreliable) > 0 {
+			n := encoded_message_size(unreliable)
+			if w.len + n > MTU {
+				break
+			}
+			put_bytes(&w, unreliable[:n])
+			unreliable = unreliable[n:]
+		}
+
+		has_messages := w.len > PACKET_HEADER_SIZE
+		if !has_messages && !p.need_ack && now - p.last_sent < KEEPALIVE_INTERVAL {
+			return
+		}
+
+		seq := p.next_seq
+		p.next_seq += 1
+		sent := &p.sent[seq % PACKET_WINDOW]
+		if sent.used && !sent.acked {
+			t.stats.packets_lost += 1
+		}
+		sent^ = {
+			used           = true,
+			seq            = seq,
+			time           = now,
+			reliable       = reliable,
+			reliable_count = reliable_count,
+		}
+		end := w.len
+		w.len = 3
+		put_u32(&w, p.session)
+		put_u16(&w, seq)
+		put_u16(&w, p.remote_seq)
+		put_u32(&w, p.received_bits)
+		w.len = end
+		send_packet(t, p.address, w, now, p)
+		p.need_ack = false
+
+		//the reliable loop only stops short of out_next when the packet is full
+		more := len(unreliable) > 0 || id != p.out_next
+		if !has_messages || !more {
+			return
+		}
+	}
+}
+
+@(private)
+handle_packet :: proc(t: ^Transport, from: net.Endpoint, packet: []u8, now: f64) {
+	r := Reader {
+		data = packet,
+		ok   = true,
+	}
+	protocol := read_u16(&r)
+	type := Packet_Type(read_u8(&r))
+	if protocol != PROTOCOL_ID || type > max(Packet_Type) || !r.ok {
+		t.stats.dropped += 1
+		return
+	}
+	i := find_peer(t, from)
+	p := &t.peers[i] if i != -1 else nil
+
+	switch type {
+	case .Request:
+		client_salt := read_u64(&r)
+		if !t.accept || len(packet) < CONNECT_REQUEST_SIZE || !r.ok {
+			break
+		}
+		if p != nil {
+			//a repeat, the Challenge got lost
+			if p.state == .Challenged && p.client_salt == client_salt {
+				send_challenge(t, p, now)
+			}
+			return
+		}
+		i = free_peer_index(t)
+		if i == -1 {
+			w := begin_control(.Denied)
+			put_u64(&w, client_salt)
+			send_packet(t, from, w, now, nil)
+			return
+		}
+		p = &t.peers[i]
+		p.state = .Challenged
+		p.next_seq = 1
+		p.address = from
+		p.client_salt = client_salt
+		p.server_salt = random(t)
+		p.session = make_session(client_salt, p.server_salt)
+		p.last_received = now
+		send_challenge(t, p, now)
+		return
+	case .Challenge:
+		client_salt := read_u64(&r)
+		server_salt := read_u64(&r)
+		if p == nil || p.state != .Requesting || p.client_salt != client_salt || !r.ok {
+			break
+		}
+		p.server_salt = server_salt
+		p.session = make_session(client_salt, server_salt)
+		p.state = .Responding
+		p.last_received = now
+		send_response(t, p, now)
+		return
+	case .Response:
+		session := read_u32(&r)
+		if p == nil || p.state != .Challenged || p.session != session || !r.ok {
+			break
+		}
+		p.state = .Connected
+		p.last_received = now
+		p.need_ack = true // the client waits for a payload packet
+		append(&t.events, Event{kind = .Connected, peer = i})
+		return
+	case .Denied:
+		client_salt := read_u64(&r)
+		if p == nil || p.state != .Requesting || p.client_salt != client_salt || !r.ok {
+			break
+		}
+		append(&t.events, Event{kind = .Disconnected, peer = i})
+		free_peer(p)
+		return
+	case .Disconnect:
+		session := read_u32(&r)
+		if p == nil || p.state < .Responding || p.session != session || !r.ok {
+			break
+		}
+		append(&t.events, Event{kind = .Disconnected, peer = i})
+		free_peer(p)
+		return
+	case .Payload:
+		session := read_u32(&r)
+		if p == nil || p.state < .Responding || p.session != session || !r.ok {
+			break
+		}
+		if p.state == .Responding {
+			p.state = .Connected
+			append(&t.events, Event{kind = .Connected, peer = i})
+		}
+		if handle_payload(t, i, &r, now) {
+			return
+		}
+	}
+	t.stats.dropped += 1
+}
+
+@(private)
+handle_payload :: proc(t: ^Transport, peer: int, r: ^Reader, now: f64) -> bool {
+	p := &t.peers[peer]
+	seq := read_u16(r)
+	ack := read_u16(r)
+	ack_bits := read_u32(r)
+	if !r.ok || !record_received(p, seq) {
+		return false
+	}
+	p.last_received = now
+	p.need_ack = true
+	handle_acks(t, p, ack, ack_bits, now)
+
+	for r.ok && r.offset < len(r.data) {
+		flags := read_u8(r)
+		id := read_u16(r)
+		index, count := 0, 1
+		if flags & MSG_FRAGMENT != 0 && flags & MSG_RELIABLE == 0 {
+			index = int(read_u8(r))
+			count = int(read_u8(r))
+		}
+		size := int(read_u16(r))
+		if !r.ok || size > len(r.data) - r.offset || size > MAX_FRAGMENT {
+			//what came before was fine, the packet still counts as received
+			return true
+		}
+		data := r.data[r.offset:][:size]
+		r.offset += size
+		if flags & MSG_RELIABLE != 0 {
+			receive_reliable(t, peer, id, flags, data)
+		} else {
+			receive_unreliable(t, peer, id, index, count, data)
+		}
+	}
+	return true
+}
+
+//False for a duplicate, or a packet too old to be acked anymore
+@(private)
+record_received :: proc(p: ^Peer, seq: u16) -> bool {
+	if !p.has_received {
+		p.has_received = true
+		p.remote_seq = seq
+		return true
+	}
+	if seq_newer(seq, p.remote_seq) {
+		shift := u32(seq - p.remote_seq)
+		p.received_bits = (p.received_bits << shift) | (1 << (shift - 1)) if shift <= 32 else 0
+		p.remote_seq = seq
+		return true
+	}
+	age := u32(p.remote_seq - seq)
+	if age == 0 || age > 32 {
+		return false
+	}
+	bit := u32(1) << (age - 1)
+	if p.received_bits & bit != 0 {
+		return false
+	}
+	p.received_bits |= bit
+	return true
+}
+
+@(private)
+handle_acks :: proc(t: ^Transport, p: ^Peer, ack: u16, ack_bits: u32, now: f64) {
+	for i in 0 ..= 32 {
+		if i > 0 && ack_bits & (1 << u32(i - 1)) == 0 {
+			continue
+		}
+		seq := ack - u16(i)
+		sent := &p.sent[seq % PACKET_WINDOW]
+		if !sent.used || sent.seq != seq || sent.acked {
+			continue
+		}
+		sent.acked = true
+		t.stats.packets_acked += 1
+		sample := now - sent.time
+		p.rtt = sample if p.rtt == 0 else p.rtt + (sample - p.rtt) * 0.1
+		for id in sent.reliable[:sent.reliable_count] {
+			m := &p.out[id % RELIABLE_WINDOW]
+			if m.used && m.id == id {
+				m.acked = true
+			}
+		}
+	}
+	for p.out_oldest != p.out_next {
+		m := &p.out[p.out_oldest % RELIABLE_WINDOW]
+		if !m.acked {
+			break
+		}
+		m.used = false
+		p.out_oldest += 1
+	}
+}
+
+@(private)
+receive_reliable :: proc(t: ^Transport, peer: int, id: u16, flags: u8, data: []u8) {
+	p := &t.peers[peer]
+	ahead := id - p.in_next
+	if ahead >= RELIABLE_WINDOW {
+		return // delivered already (wrapped around), or further ahead than the sender may be
+	}
+	slot := &p.in[id % RELIABLE_WINDOW]
+	if slot.received && slot.id == id {
+		return
+	}
+	slot.received = true
+	slot.id = id
+	slot.flags = flags
+	clear(&slot.data)
+	append(&slot.data, ..data)
+
+	for {
+		s := &p.in[p.in_next % RELIABLE_WINDOW]
+		if !s.received || s.id != p.in_next {
+			return
+		}
+		s.received = false
+		p.in_next += 1
+		if s.flags & MSG_FRAGMENT == 0 {
+			push_message(t, peer, .Reliable_Ordered, s.data[:])
+			continue
+		}
+		append(&p.assembling, ..s.data[:])
+		if s.flags & MSG_LAST != 0 {
+			push_message(t, peer, .Reliable_Ordered, p.assembling[:])
+			clear(&p.assembling)
+		}
+	}
+}
+
+@(private)
+receive_unreliable :: proc(t: ^Transport, peer: int, seq: u16, index, count: int, data: []u8) {
+	p := &t.peers[peer]
+	if p.has_unreliable && !seq_newer(seq, p.unreliable_latest) {
+		return
+	}
+	if count == 1 {
+		p.unreliable_latest = seq
+		p.has_unreliable = true
+		push_message(t, peer, .Unreliable_Sequenced, data)
+		return
+	}
+	if count > MAX_FRAGMENTS || index >= count {
+		return
+	}
+	//every fragment but the last is full, that is how they are put back in place
+	if index < count - 1 && len(data) != MAX_FRAGMENT {
+		return
+	}
+
+	f := &p.fragments
+	if !f.active || f.seq != seq {
+		if f.active && seq_newer(f.seq, seq) {
+			return
+		}
+		//a newer message, whatever is left of the one before is lost
+		f.active = true
+		f.seq = seq
+		f.count = count
+		f.received = {}
+		resize(&f.data, count * MAX_FRAGMENT)
+	}
+	if count != f.count || index in f.received {
+		return
+	}
+	copy(f.data[index * MAX_FRAGMENT:], data)
+	if index == count - 1 {
+		f.last_size = len(data)
+	}
+	f.received += {index}
+	if card(f.received) == count {
+		f.active = false
+		p.unreliable_latest = seq
+		p.has_unreliable = true
+		size := (count - 1) * MAX_FRAGMENT + f.last_size
+		push_message(t, peer, .Unreliable_Sequenced, f.data[:size])
+	}
+}
+
+@(private)
+push_message :: proc(t: ^Transport, peer: int, channel: Channel, data: []u8) {
+	start := len(t.event_bytes)
+	append(&t.event_bytes, ..data)
+	append(
+		&t.events,
+		Event {
+			kind = .Message,
+			peer = peer,
+			channel = channel,
+			data = t.event_bytes[start:],
+			start = start,
+		},
+	)
+}
+
+@(private)
+send_request :: proc(t: ^Transport, p: ^Peer, now: f64) {
+	w := begin_control(.Request)
+	put_u64(&w, p.client_salt)
+	w.len = CONNECT_REQUEST_SIZE // zero padding
+	send_packet(t, p.address, w, now, p)
+}
+
+@(private)
+send_challenge :: proc(t: ^Transport, p: ^Peer, now: f64) {
+	w := begin_control(.Challenge)
+	put_u64(&w, p.client_salt)
+	put_u64(&w, p.server_salt)
+	send_packet(t, p.address, w, now, p)
+}
+
+@(private)
+send_response :: proc(t: ^Transport, p: ^Peer, now: f64) {
+	w := begin_control(.Response)
+	put_u32(&w, p.session)
+	send_packet(t, p.address, w, now, p)
+}
+
+@(private)
+send_packet :: proc(t: ^Transport, to: net.Endpoint, w: Writer, now: f64, p: ^Peer) {
+	t.link.send(t.link.data, to, w.buf[:w.len])
+	t.stats.packets_sent += 1
+	t.stats.bytes_sent += w.len
+	if p != nil {
+		p.last_sent = now
+	}
+}
+
+@(private)
+find_peer :: proc(t: ^Transport, address: net.Endpoint) -> int {
+	for &p, i in t.peers {
+		if p.state != .Free && p.address == address {
+			return i
+		}
+	}
+	return -1
+}
+
+@(private)
+free_peer_index :: proc(t: ^Transport) -> int {
+	for &p, i in t.peers {
+		if p.state == .Free {
+			return i
+		}
+	}
+	return -1
+}
+
+@(private)
+free_peer :: proc(p: ^Peer) {
+	for &m in p.out {
+		delete(m.data)
+	}
+	for &m in p.in {
+		delete(m.data)
+	}
+	delete(p.assembling)
+	delete(p.unreliable_out)
+	delete(p.fragments.data)
+	p^ = {}
+}
+
+@(private)
+make_session :: proc(client_salt, server_salt: u64) -> u32 {
+	return u32(((client_salt ~ server_salt) * 0x9E3779B97F4A7C15) >> 32)
+}
+
+//xorshift
+@(private)
+random :: proc(t: ^Transport) -> u64 {
+	t.rng ~= t.rng << 13
+	t.rng ~= t.rng >> 7
+	t.rng ~= t.rng << 17
+	return t.rng
+}
+
+//a is after b, with wraparound
+@(private)
+seq_newer :: #force_inline proc(a, b: u16) -> bool {
+	return i16(a - b) > 0
+}
+
+@(private)
+fragment :: proc(data: []u8, i: int) -> []u8 {
+	start := i * MAX_FRAGMENT
+	return data[start:][:min(MAX_FRAGMENT, len(data) - start)]
+}
+
+//Size of the encoded unreliable message at the start of bytes
+@(private)
+encoded_message_size :: proc(bytes: []u8) -> int {
+	header := 5 if bytes[0] & MSG_FRAGMENT != 0 else 3
+	return header + 2 + int(endian.unchecked_get_u16le(bytes[header:]))
+}
+
+@(private)
+Writer :: struct {
+	buf: [MTU]u8,
+	len: int,
+}
+
+@(private)
+begin_control :: proc(type: Packet_Type) -> (w: Writer) {
+	put_u16(&w, PROTOCOL_ID)
+	put_u8(&w, u8(type))
+	return
+}
+
+@(private)
+put_u8 :: proc(w: ^Writer, v: u8) {
+	w.buf[w.len] = v
+	w.len += 1
+}
+
+@(private)
+put_u16 :: proc(w: ^Writer, v: u16) {
+	endian.unchecked_put_u16le(w.buf[w.len:], v)
+	w.len += 2
+}
+
+@(private)
+put_u32 :: proc(w: ^Writer, v: u32) {
+	endian.unchecked_put_u32le(w.buf[w.len:], v)
+	w.len += 4
+}
+
+@(private)
+put_u64 :: proc(w: ^Writer, v: u64) {
+	endian.unchecked_put_u64le(w.buf[w.len:], v)
+	w.len += 8
+}
+
+@(private)
+put_bytes :: proc(w: ^Writer, bytes: []u8) {
+	w.len += copy(w.buf[w.len:], bytes)
+}
+
+//Reads past the end return 0 and clear ok
+@(private)
+Reader :: struct {
+	data:   []u8,
+	offset: int,
+	ok:     bool,
+}
+
+@(private)
+read_u8 :: proc(r: ^Reader) -> u8 {
+	if r.offset + 1 > len(r.data) {
+		r.ok = false
+		return 0
+	}
+	r.offset += 1
+	return r.data[r.offset - 1]
+}
+
+@(private)
+read_u16 :: proc(r: ^Reader) -> u16 {
+	if r.offset + 2 > len(r.data) {
+		r.ok = false
+		return 0
+	}
+	r.offset += 2
+	return endian.unchecked_get_u16le(r.data[r.offset - 2:])
+}
+
+@(private)
+read_u32 :: proc(r: ^Reader) -> u32 {
+	if r.offset + 4 > len(r.data) {
+		r.ok = false
+		return 0
+	}
+	r.offset += 4
+	return endian.unchecked_get_u32le(r.data[r.offset - 4:])
+}
+
+@(private)
+read_u64 :: proc(r: ^Reader) -> u64 {
+	if r.offset + 8 > len(r.data) {
+		r.ok = false
+		return 0
+	}
+	r.offset += 8
+	return endian.unchecked_get_u64le(r.data[r.offset - 8:])
+}
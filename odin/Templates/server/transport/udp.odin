@@ -0,0 +1,49 @@
+package transport
+
+import "core:fmt"
+import "core:net"
+
+//Non-blocking UDP socket on port of every local address, 0 picks a free port
+open_udp :: proc(port: int) -> (sock: net.UDP_Socket, ok: bool) {
+	s, err := net.make_bound_udp_socket(net.IP4_Any, port)
+	if err != nil {
+		fmt.printf("Failed to open UDP port %d: %v\n", port, err)
+		return
+	}
+	if blocking_err := net.set_blocking(s, false); blocking_err != nil {
+		fmt.printf("Failed to make the UDP socket non-blocking: %v\n", blocking_err)
+		net.close(s)
+		return
+	}
+	return s, true
+}
+
+//sock has to stay where it is while the link is used
+udp_link :: proc(sock: ^net.UDP_Socket) -> Link {
+	return {data = sock, send = udp_send, recv = udp_recv}
+}
+
+@(private)
+udp_send :: proc(data: rawptr, to: net.Endpoint, packet: []u8) {
+	//a full send buffer loses the packet, the same as the network would
+	net.send_udp((^net.UDP_Socket)(data)^, packet, to)
+}
+
+//Most errors in a row udp_recv reads past before it gives up until the next poll
+UDP_MAX_RECV_ERRORS :: 64
+
+@(private)
+udp_recv :: proc(data: rawptr, buf: []u8) -> (n: int, from: net.Endpoint) {
+	for _ in 0 ..< UDP_MAX_RECV_ERRORS {
+		size, remote, err := net.recv_udp((^net.UDP_Socket)(data)^, buf)
+		if err == nil {
+			return size, remote
+		}
+		if err == net.UDP_Recv_Error.Would_Block || err == net.UDP_Recv_Error.Timeout {
+			return 0, {}
+		}
+		//an ICMP error (ECONNREFUSED and friends) from an earlier send, it has nothing to do
+		//with the datagrams still waiting behind it
+	}
+	return 0, {}
+}
@@ -0,0 +1,282 @@
+/*
+Throughput and latency of the UDP transport, over the network simulator or real UDP on localhost.
+
+	odin run transport_bench -o:speed -- [latency_ms] [jitter_ms] [loss_percent] [seconds] [-udp]
+
+Defaults to 50ms one way, 10ms jitter, 5% loss and 10 seconds. Every tick a client sends the
+server an input on the unreliable channel and a few reliable messages, and now and then a message
+big enough to be fragmented on both channels. The server echoes all of it back. The simulator runs
+on a clock of 1ms steps that only moves when the work of a step is done, so the seconds are
+simulated ones. With -udp the traffic goes over two real sockets in real time instead, and the
+latency, jitter and loss arguments are ignored.
+*/
+package transport_bench
+
+import "core:encoding/endian"
+import "core:fmt"
+import "core:net"
+import "core:os"
+import "core:slice"
+import "core:strconv"
+import "core:time"
+
+import "../transport"
+
+TICK :: 1.0 / 60
+STEP :: 0.001
+UDP_PORT :: 2646
+RELIABLE_PER_TICK :: 4
+RELIABLE_SIZE :: 100
+INPUT_SIZE :: 32
+BIG_SIZE :: 8000 // 7 fragments
+BIG_INTERVAL :: 30 // ticks
+MESSAGE_HEADER_SIZE :: 13 // kind u8, number u32, sent at f64
+
+Kind :: enum u8 {
+	Input,
+	Reliable,
+	Big_Unreliable,
+	Big_Reliable,
+}
+
+Client :: struct {
+	t:                  ^transport.Transport,
+	peer:               int,
+	sent:               [Kind]int,
+	received:           [Kind]int,
+	next_reliable:      u32,
+	expected_reliable:  u32, // next one that should come back
+	out_of_order:       int,
+	reliable_bytes:     int, // echoed back
+	input_latencies:    [dynamic]f64, // ms
+	reliable_latencies: [dynamic]f64,
+}
+
+main :: proc() {
+	latency_ms, jitter_ms, loss_percent, seconds := 50, 10, 5, 10
+	use_udp := false
+	args: [dynamic]string
+	for arg in os.args[1:] {
+		if arg == "-udp" {
+			use_udp = true
+		} else {
+			append(&args, arg)
+		}
+	}
+	if len(args) > 0 {latency_ms = strconv.parse_int(args[0]) or_else latency_ms}
+	if len(args) > 1 {jitter_ms = strconv.parse_int(args[1]) or_else jitter_ms}
+	if len(args) > 2 {loss_percent = strconv.parse_int(args[2]) or_else loss_percent}
+	if len(args) > 3 {seconds = strconv.parse_int(args[3]) or_else seconds}
+
+	network := transport.Sim_Network {
+		latency = f64(latency_ms) / 1000,
+		jitter  = f64(jitter_ms) / 1000,
+		loss    = f64(loss_percent) / 100,
+		seed    = 0x2545F4914F6CDD1D,
+	}
+	defer transport.delete_sim_network(&network)
+	server_port := transport.Sim_Port{&network, transport.sim_address(1)}
+	client_port := transport.Sim_Port{&network, transport.sim_address(2)}
+	server_link := transport.sim_link(&server_port)
+	client_link := transport.sim_link(&client_port)
+	server_address := server_port.address
+
+	server_sock, client_sock: net.UDP_Socket
+	if use_udp {
+		ok: bool
+		server_sock, ok = transport.open_udp(UDP_PORT)
+		if !ok {
+			os.exit(1)
+		}
+		client_sock, ok = transport.open_udp(0)
+		if !ok {
+			os.exit(1)
+		}
+		server_link = transport.udp_link(&server_sock)
+		client_link = transport.udp_link(&client_sock)
+		server_address = {net.IP4_Loopback, UDP_PORT}
+		fmt.printf("Loopback UDP for %d seconds\n", seconds)
+	} else {
+		fmt.printf(
+			"Simulated %dms latency, %dms jitter, %d%% loss for %d seconds\n",
+			latency_ms,
+			jitter_ms,
+			loss_percent,
+			seconds,
+		)
+	}
+	defer if use_udp {
+		net.close(server_sock)
+		net.close(client_sock)
+	}
+
+	//both are big, the peers have their windows inline
+	server := new(transport.Transport)
+	transport.init(server, server_link, true, 1)
+	c := Client {
+		t = new(transport.Transport),
+	}
+	transport.init(c.t, client_link, false, 2)
+	defer {
+		transport.destroy(server)
+		transport.destroy(c.t)
+		free(server)
+		free(c.t)
+		delete(c.input_latencies)
+		delete(c.reliable_latencies)
+	}
+
+	start := time.tick_now()
+	now, next_tick := 0.0, 0.0
+	c.peer = transport.connect(c.t, server_address, now)
+	tick := 0
+	for now < f64(seconds) {
+		network.now = now
+		transport.poll(server, now)
+		for e in server.events {
+			if e.kind == .Message {
+				//a full reliable window loses the echo, which shows up as out of order
+				transport.send(server, e.peer, e.channel, e.data)
+			}
+		}
+		transport.poll(c.t, now)
+		for e in c.t.events {
+			receive(&c, e, now)
+		}
+
+		if now >= next_tick {
+			if transport.is_connected(c.t, c.peer) {
+				send_tick(&c, tick, now)
+				tick += 1
+			}
+			transport.flush(c.t, now)
+			transport.flush(server, now)
+			next_tick += TICK
+		}
+
+		if use_udp {
+			time.sleep(time.Millisecond)
+			now = time.duration_seconds(time.tick_since(start))
+		} else {
+			now += STEP
+		}
+	}
+	report(&c, f64(seconds))
+	transport.disconnect(c.t, c.peer)
+	if !use_udp {
+		fmt.printf(
+			"Network: %d packets, %d lost, %d delivered, %d still in flight\n",
+			network.stats.sent,
+			network.stats.lost,
+			network.stats.delivered,
+			len(network.in_flight),
+		)
+	}
+	fmt.printf("Took %.2fs\n", time.duration_seconds(time.tick_since(start)))
+}
+
+send_tick :: proc(c: ^Client, tick: int, now: f64) {
+	buf: [BIG_SIZE]u8
+	put_message(buf[:], .Input, u32(tick), now)
+	if transport.send(c.t, c.peer, .Unreliable_Sequenced, buf[:INPUT_SIZE]) {
+		c.sent[.Input] += 1
+	}
+	for _ in 0 ..< RELIABLE_PER_TICK {
+		put_message(buf[:], .Reliable, c.next_reliable, now)
+		//a full window just means it goes next tick
+		if !transport.send(c.t, c.peer, .Reliable_Ordered, buf[:RELIABLE_SIZE]) {
+			break
+		}
+		c.next_reliable += 1
+		c.sent[.Reliable] += 1
+	}
+	if tick % BIG_INTERVAL == 0 {
+		put_message(buf[:], .Big_Unreliable, u32(tick), now)
+		if transport.send(c.t, c.peer, .Unreliable_Sequenced, buf[:]) {
+			c.sent[.Big_Unreliable] += 1
+		}
+		put_message(buf[:], .Big_Reliable, u32(tick), now)
+		if transport.send(c.t, c.peer, .Reliable_Ordered, buf[:]) {
+			c.sent[.Big_Reliable] += 1
+		}
+	}
+}
+
+receive :: proc(c: ^Client, e: transport.Event, now: f64) {
+	switch e.kind {
+	case .Connected:
+		fmt.printf("Connected at %.0fms\n", now * 1000)
+	case .Disconnected:
+		fmt.printf("Disconnected at %.0fms\n", now * 1000)
+	case .Message:
+		if len(e.data) < MESSAGE_HEADER_SIZE || e.data[0] > u8(max(Kind)) {
+			return
+		}
+		kind := Kind(e.data[0])
+		number := endian.unchecked_get_u32le(e.data[1:])
+		sent_at := transmute(f64)endian.unchecked_get_u64le(e.data[5:])
+		ms := (now - sent_at) * 1000
+		c.received[kind] += 1
+		#partial switch kind {
+		case .Input:
+			append(&c.input_latencies, ms)
+		case .Reliable:
+			if number != c.expected_reliable {
+				c.out_of_order += 1
+			}
+			c.expected_reliable = number + 1
+			c.reliable_bytes += len(e.data)
+			append(&c.reliable_latencies, ms)
+		}
+	}
+}
+
+put_message :: proc(buf: []u8, kind: Kind, number: u32, now: f64) {
+	buf[0] = u8(kind)
+	endian.unchecked_put_u32le(buf[1:], number)
+	endian.unchecked_put_u64le(buf[5:], transmute(u64)now)
+}
+
+report :: proc(c: ^Client, seconds: f64) {
+	slice.sort(c.input_latencies[:])
+	slice.sort(c.reliable_latencies[:])
+	fmt.printf(
+		"Unreliable: %d of %d inputs back (%.1f%%), p50 %.1fms, p99 %.1fms, big %d/%d\n",
+		c.received[.Input],
+		c.sent[.Input],
+		100 * f64(c.received[.Input]) / f64(max(c.sent[.Input], 1)),
+		percentile(c.input_latencies[:], 0.50),
+		percentile(c.input_latencies[:], 0.99),
+		c.received[.Big_Unreliable],
+		c.sent[.Big_Unreliable],
+	)
+	fmt.printf(
+		"Reliable: %d of %d back, %d out of order, p50 %.1fms, p99 %.1fms, %.1fKB/s, big %d/%d\n",
+		c.received[.Reliable],
+		c.sent[.Reliable],
+		c.out_of_order,
+		percentile(c.reliable_latencies[:], 0.50),
+		percentile(c.reliable_latencies[:], 0.99),
+		f64(c.reliable_bytes) / 1024 / seconds,
+		c.received[.Big_Reliable],
+		c.sent[.Big_Reliable],
+	)
+	stats := c.t.stats
+	fmt.printf(
+		"Client: %d packets sent, %.1fKB/s, %d acked, %d lost, %d resent, rtt %.1fms\n",
+		stats.packets_sent,
+		f64(stats.bytes_sent) / 1024 / seconds,
+		stats.packets_acked,
+		stats.packets_lost,
+		stats.resent,
+		transport.rtt(c.t, c.peer) * 1000,
+	)
+}
+
+//sorted has to be sorted
+percentile :: proc(sorted: []f64, p: f64) -> f64 {
+	if len(sorted) == 0 {
+		return 0
+	}
+	return sorted[min(int(p * f64(len(sorted))), len(sorted) - 1)]
+}
@@ -0,0 +1,63 @@
+package main
+
+import "core:fmt"
+import "core:net"
+import "core:os"
+import "core:time"
+
+import "transport"
+
+//Echo server on the UDP transport, -udp on the command line. Every message goes back to its
+//sender on the channel it came in on. transport_bench doesn't use it, with -udp the bench runs
+//its own server in process on port 2646, so run this one on another port next to it.
+
+UDP_TICK :: time.Second / 60
+
+run_udp_server :: proc(port: int) {
+	sock, ok := transport.open_udp(port)
+	if !ok {
+		os.exit(1)
+	}
+	defer net.close(sock)
+	t := new(transport.Transport)
+	defer {
+		transport.destroy(t)
+		free(t)
+	}
+	transport.init(t, transport.udp_link(&sock), true, u64(time.tick_now()._nsec))
+	fmt.printf("Listening on UDP port %d, up to %d peers\n", port, transport.MAX_PEERS)
+
+	start := time.tick_now()
+	stats_at := start
+	next_flush := start
+	for {
+		now := time.duration_seconds(time.tick_since(start))
+		transport.poll(t, now)
+		for e in t.events {
+			if e.kind == .Message {
+				transport.send(t, e.peer, e.channel, e.data)
+			}
+		}
+		if time.tick_diff(next_flush, time.tick_now()) >= 0 {
+			transport.flush(t, now)
+			next_flush = time.tick_add(next_flush, UDP_TICK)
+		}
+		if time.tick_since(stats_at) >= STATS_INTERVAL * time.Second {
+			connected := 0
+			for peer in 0 ..< transport.MAX_PEERS {
+				connected += 1 if transport.is_connected(t, peer) else 0
+			}
+			fmt.printf(
+				"%d peers, %d packets in, %d out, %d lost, %d resent, %d dropped\n",
+				connected,
+				t.stats.packets_received,
+				t.stats.packets_sent,
+				t.stats.packets_lost,
+				t.stats.resent,
+				t.stats.dropped,
+			)
+			stats_at = time.tick_now()
+		}
+		time.sleep(time.Millisecond)
+	}
+}